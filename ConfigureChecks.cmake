@@ -67,6 +67,7 @@ check_include_file("winsock2.h"          HAVE_WINSOCK2_H)
 include(CheckFunctionExists)
 include(CMakePushCheckState)
 check_function_exists("chown"            HAVE_CHOWN)
+check_function_exists("copy_file_range"  HAVE_COPY_FILE_RANGE)
 
 cmake_push_check_state()
 set(CMAKE_REQUIRED_LIBRARIES ¼{CMAKE_DL_LIBS})
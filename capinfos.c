@@ -94,6 +94,7 @@
 #include <wsutil/report_err.h>
 #include <wsutil/privileges.h>
 #include <wsutil/str_util.h>
+#include <wsutil/pktindex.h>
 
 #ifdef HAVE_LIBGCRYPT
 #include <wsutil/wsgcrypt.h>
@@ -168,6 +169,16 @@ static gboolean cap_order = TRUE;           /* Report if packets are in chronolo
 static gboolean cap_file_hashes = TRUE;     /* Calculate file hashes */
 #endif
 
+/*
+ * Files are opened and read by worker threads, if we have them; the
+ * results are reported in command-line order by the main thread.
+ */
+#if GLIB_CHECK_VERSION(2,31,18)
+#define CAPINFOS_WORKER_THREADS
+#endif
+
+static guint num_workers = 1;               /* Files processed in parallel */
+
 #ifdef USE_GOPTION
 static gboolean cap_help = FALSE;
 static gboolean table_report = FALSE;
@@ -329,6 +340,22 @@ typedef struct _capture_info {
   int          *encap_counts;           /* array of per_packet encap counts; array has one entry per wtap_encap type */
 } capture_info;
 
+/*
+ * One input file.  Everything a worker finds out about the file,
+ * including the messages it would have printed, is kept here until
+ * the file's turn comes to be reported.
+ */
+typedef struct _cap_file_job {
+  const char   *filename;
+  gboolean      opened;                 /* wtap_open_offline() succeeded */
+  int           status;                 /* 0, or our exit status if reading failed */
+  GString      *errors;                 /* messages for stderr */
+  capture_info  cf_info;
+#ifdef CAPINFOS_WORKER_THREADS
+  gboolean      done;                   /* a worker has finished with the file */
+#endif
+} cap_file_job_t;
+
 
 static void
 enable_all_infos(void)
@@ -823,8 +850,47 @@ print_stats_table(const gchar *filename, capture_info *cf_info)
   printf("\n");
 }
 
+/*
+ * Do we need anything from the records other than how many there are?
+ */
+static gboolean
+need_record_details(void)
+{
+  return cap_snaplen || cap_data_size ||
+         cap_duration || cap_start_time || cap_end_time ||
+         cap_data_rate_byte || cap_data_rate_bit ||
+         cap_packet_size || cap_packet_rate || cap_order ||
+         cap_file_encap;  /* pcap-ng may turn out to be per-packet */
+}
+
+static gboolean
+packet_count_from_index(const char *filename, gint64 size, guint32 *count)
+{
+  gchar      *index_filename;
+  pktindex_t *idx;
+  int         err;
+
+  if (need_record_details())
+    return FALSE;
+
+  index_filename = pktindex_filename(filename);
+  idx = pktindex_read(index_filename, &err);
+  g_free(index_filename);
+  if (idx == NULL)
+    return FALSE;
+  if ((gint64)idx->data_size != size) {
+    /* The file has changed since it was indexed. */
+    pktindex_free(idx);
+    return FALSE;
+  }
+  *count = idx->frame_count;
+  pktindex_free(idx);
+  return TRUE;
+}
+
 static int
-process_cap_file(wtap *wth, const char *filename)
+process_cap_file(wtap *wth, const char *filename, capture_info *cf_info,
+                 GString *errors)
 {
   int                   err;
   gchar                *err_info;
@@ -836,7 +902,6 @@ process_cap_file(wtap *wth, const char *filename)
   guint32               snaplen_min_inferred = 0xffffffff;
   guint32               snaplen_max_inferred =          0;
   const struct wtap_pkthdr *phdr;
-  capture_info          cf_info;
   gboolean              have_times = TRUE;
   double                start_time = 0;
   double                stop_time  = 0;
@@ -848,61 +913,81 @@ process_cap_file(wtap *wth, const char *filename)
   gchar                *p;
 
 
-  cf_info.encap_counts = g_new0(int,WTAP_NUM_ENCAP_TYPES);
+  cf_info->encap_counts = g_new0(int,WTAP_NUM_ENCAP_TYPES);
+
+  /* File size */
+  size = wtap_file_size(wth, &err);
+  if (size == -1) {
+    g_string_append_printf(errors,
+        "capinfos: Can't get size of \"%s\": %s.\n",
+        filename, g_strerror(err));
+    g_free(cf_info->encap_counts);
+    return 1;
+  }
+
+  /* We never look at the packet data; don't read it if we can avoid it. */
+  wtap_set_metadata_only(wth);
 
-  /* Tally up data that we need to parse through the file to find */
-  while (wtap_read(wth, &err, &err_info, &data_offset))  {
-    phdr = wtap_phdr(wth);
-    if (phdr->presence_flags & WTAP_HAS_TS) {
-      prev_time = cur_time;
-      cur_time = secs_nsecs(&phdr->ts);
-      if(packet==0) {
-        start_time = cur_time;
-        stop_time = cur_time;
+  err = 0;
+  if (!cap_packet_count && !need_record_details()) {
+    /* Everything we want is in the file header. */
+  } else if (packet_count_from_index(filename, size, &packet)) {
+    /* The packet index told us how many packets there are. */
+  } else {
+    /* Tally up data that we need to parse through the file to find */
+    while (wtap_read(wth, &err, &err_info, &data_offset))  {
+      phdr = wtap_phdr(wth);
+      if (phdr->presence_flags & WTAP_HAS_TS) {
         prev_time = cur_time;
+        cur_time = secs_nsecs(&phdr->ts);
+        if(packet==0) {
+          start_time = cur_time;
+          stop_time = cur_time;
+          prev_time = cur_time;
+        }
+        if (cur_time < prev_time) {
+          order = NOT_IN_ORDER;
+        }
+        if (cur_time < start_time) {
+          start_time = cur_time;
+        }
+        if (cur_time > stop_time) {
+          stop_time = cur_time;
+        }
+      } else {
+        have_times = FALSE; /* at least one packet has no time stamp */
+        if (order != NOT_IN_ORDER)
+          order = ORDER_UNKNOWN;
       }
-      if (cur_time < prev_time) {
-        order = NOT_IN_ORDER;
-      }
-      if (cur_time < start_time) {
-        start_time = cur_time;
-      }
-      if (cur_time > stop_time) {
-        stop_time = cur_time;
-      }
-    } else {
-      have_times = FALSE; /* at least one packet has no time stamp */
-      if (order != NOT_IN_ORDER)
-        order = ORDER_UNKNOWN;
-    }
 
-    bytes+=phdr->len;
-    packet++;
-
-    /* If caplen < len for a rcd, then presumably           */
-    /* 'Limit packet capture length' was done for this rcd. */
-    /* Keep track as to the min/max actual snapshot lengths */
-    /*  seen for this file.                                 */
-    if (phdr->caplen < phdr->len) {
-      if (phdr->caplen < snaplen_min_inferred)
-        snaplen_min_inferred = phdr->caplen;
-      if (phdr->caplen > snaplen_max_inferred)
-        snaplen_max_inferred = phdr->caplen;
-    }
+      bytes+=phdr->len;
+      packet++;
+
+      /* If caplen < len for a rcd, then presumably           */
+      /* 'Limit packet capture length' was done for this rcd. */
+      /* Keep track as to the min/max actual snapshot lengths */
+      /*  seen for this file.                                 */
+      if (phdr->caplen < phdr->len) {
+        if (phdr->caplen < snaplen_min_inferred)
+          snaplen_min_inferred = phdr->caplen;
+        if (phdr->caplen > snaplen_max_inferred)
+          snaplen_max_inferred = phdr->caplen;
+      }
 
-    /* Per-packet encapsulation */
-    if (wtap_file_encap(wth) == WTAP_ENCAP_PER_PACKET) {
-      if ((phdr->pkt_encap > 0) && (phdr->pkt_encap < WTAP_NUM_ENCAP_TYPES)) {
-        cf_info.encap_counts[phdr->pkt_encap] += 1;
-      } else {
-        fprintf(stderr, "capinfos: Unknown per-packet encapsulation: %d [frame number: %d]\n", phdr->pkt_encap, packet);
+      /* Per-packet encapsulation */
+      if (wtap_file_encap(wth) == WTAP_ENCAP_PER_PACKET) {
+        if ((phdr->pkt_encap > 0) && (phdr->pkt_encap < WTAP_NUM_ENCAP_TYPES)) {
+          cf_info->encap_counts[phdr->pkt_encap] += 1;
+        } else {
+          g_string_append_printf(errors, "capinfos: Unknown per-packet encapsulation: %d [frame number: %d]\n", phdr->pkt_encap, packet);
+        }
       }
-    }
 
-  } /* while */
+    } /* while */
+  }
 
   if (err != 0) {
-    fprintf(stderr,
+    g_string_append_printf(errors,
         "capinfos: An error occurred after reading %u packets from \"%s\": %s.\n",
         packet, filename, wtap_strerror(err));
     switch (err) {
@@ -911,80 +996,70 @@ process_cap_file(wtap *wth, const char *filename)
       case WTAP_ERR_UNSUPPORTED_ENCAP:
       case WTAP_ERR_BAD_FILE:
       case WTAP_ERR_DECOMPRESS:
-        fprintf(stderr, "(%s)\n", err_info);
+        g_string_append_printf(errors, "(%s)\n", err_info);
         g_free(err_info);
         break;
     }
-    g_free(cf_info.encap_counts);
+    g_free(cf_info->encap_counts);
     return 1;
   }
 
-  /* File size */
-  size = wtap_file_size(wth, &err);
-  if (size == -1) {
-    fprintf(stderr,
-        "capinfos: Can't get size of \"%s\": %s.\n",
-        filename, g_strerror(err));
-    g_free(cf_info.encap_counts);
-    return 1;
-  }
-
-  cf_info.filesize = size;
+  cf_info->filesize = size;
 
   /* File Type */
-  cf_info.file_type = wtap_file_type(wth);
-  cf_info.iscompressed = wtap_iscompressed(wth);
+  cf_info->file_type = wtap_file_type(wth);
+  cf_info->iscompressed = wtap_iscompressed(wth);
 
   /* File Encapsulation */
-  cf_info.file_encap = wtap_file_encap(wth);
+  cf_info->file_encap = wtap_file_encap(wth);
 
   /* Packet size limit (snaplen) */
-  cf_info.snaplen = wtap_snapshot_length(wth);
-  if(cf_info.snaplen > 0)
-    cf_info.snap_set = TRUE;
+  cf_info->snaplen = wtap_snapshot_length(wth);
+  if(cf_info->snaplen > 0)
+    cf_info->snap_set = TRUE;
   else
-    cf_info.snap_set = FALSE;
+    cf_info->snap_set = FALSE;
 
-  cf_info.snaplen_min_inferred = snaplen_min_inferred;
-  cf_info.snaplen_max_inferred = snaplen_max_inferred;
+  cf_info->snaplen_min_inferred = snaplen_min_inferred;
+  cf_info->snaplen_max_inferred = snaplen_max_inferred;
 
   /* # of packets */
-  cf_info.packet_count = packet;
+  cf_info->packet_count = packet;
 
   /* File Times */
-  cf_info.times_known = have_times;
-  cf_info.start_time = start_time;
-  cf_info.stop_time = stop_time;
-  cf_info.duration = stop_time-start_time;
-  cf_info.know_order = know_order;
-  cf_info.order = order;
+  cf_info->times_known = have_times;
+  cf_info->start_time = start_time;
+  cf_info->stop_time = stop_time;
+  cf_info->duration = stop_time-start_time;
+  cf_info->know_order = know_order;
+  cf_info->order = order;
 
   /* Number of packet bytes */
-  cf_info.packet_bytes = bytes;
+  cf_info->packet_bytes = bytes;
 
-  cf_info.data_rate   = 0.0;
-  cf_info.packet_rate = 0.0;
-  cf_info.packet_size = 0.0;
+  cf_info->data_rate   = 0.0;
+  cf_info->packet_rate = 0.0;
+  cf_info->packet_size = 0.0;
 
   if (packet > 0) {
-    if (cf_info.duration > 0.0) {
-      cf_info.data_rate   = (double)bytes  / (stop_time-start_time); /* Data rate per second */
-      cf_info.packet_rate = (double)packet / (stop_time-start_time); /* packet rate per second */
+    if (cf_info->duration > 0.0) {
+      cf_info->data_rate   = (double)bytes  / (stop_time-start_time); /* Data rate per second */
+      cf_info->packet_rate = (double)packet / (stop_time-start_time); /* packet rate per second */
     }
-    cf_info.packet_size = (double)bytes / packet;                  /* Avg packet size      */
+    cf_info->packet_size = (double)bytes / packet;                  /* Avg packet size      */
   }
 
-  cf_info.comment = NULL;
+  cf_info->comment = NULL;
   shb_inf = wtap_file_get_shb_info(wth);
   if (shb_inf) {
     /* opt_comment is always 0-terminated by pcapng_read_section_header_block */
-    cf_info.comment = g_strdup(shb_inf->opt_comment);
+    cf_info->comment = g_strdup(shb_inf->opt_comment);
   }
   g_free(shb_inf);
-  if (cf_info.comment) {
+  if (cf_info->comment) {
     /* multi-line comments would conflict with the formatting that capinfos uses
        we replace linefeeds with spaces */
-    p = cf_info.comment;
+    p = cf_info->comment;
     while (*p != '\0') {
       if (*p=='\n')
         *p=' ';
@@ -992,17 +1067,132 @@ process_cap_file(wtap *wth, const char *filename)
     }
   }
 
-  if(long_report) {
-    print_stats(filename, &cf_info);
-  } else {
-    print_stats_table(filename, &cf_info);
+  return 0;
+}
+
+#ifdef CAPINFOS_WORKER_THREADS
+/*
+ * Some of the file readers, and so the heuristics wtap_open_offline()
+ * runs to find the one for a file, keep their state in globals (the
+ * Ascend and K12 text scanners, for example).  Only one thread at a time
+ * may open a file, or read one of the files whose reader does that.
+ */
+static GMutex wtap_open_mtx;
+
+static gboolean
+reader_is_reentrant(wtap *wth)
+{
+  switch (wtap_file_type(wth)) {
+
+    case WTAP_FILE_ASCEND:
+    case WTAP_FILE_K12TEXT:
+      return FALSE;
+  }
+  return TRUE;
+}
+#endif
+
+/* Open and read one file; this may run in a worker thread. */
+static void
+process_cap_file_job(cap_file_job_t *job)
+{
+  wtap  *wth;
+  int    err;
+  gchar *err_info;
+
+#ifdef CAPINFOS_WORKER_THREADS
+  g_mutex_lock(&wtap_open_mtx);
+#endif
+  wth = wtap_open_offline(job->filename, &err, &err_info, FALSE);
+#ifdef CAPINFOS_WORKER_THREADS
+  if (!wth || reader_is_reentrant(wth))
+    g_mutex_unlock(&wtap_open_mtx);
+#endif
+  if (!wth) {
+    g_string_append_printf(job->errors, "capinfos: Can't open %s: %s\n",
+        job->filename, wtap_strerror(err));
+    switch (err) {
+
+      case WTAP_ERR_UNSUPPORTED:
+      case WTAP_ERR_UNSUPPORTED_ENCAP:
+      case WTAP_ERR_BAD_FILE:
+        g_string_append_printf(job->errors, "(%s)\n", err_info);
+        g_free(err_info);
+        break;
+    }
+    return;
   }
 
-  g_free(cf_info.encap_counts);
-  g_free(cf_info.comment);
+  job->opened = TRUE;
+  job->status = process_cap_file(wth, job->filename, &job->cf_info, job->errors);
+#ifdef CAPINFOS_WORKER_THREADS
+  if (!reader_is_reentrant(wth)) {
+    wtap_close(wth);
+    g_mutex_unlock(&wtap_open_mtx);
+    return;
+  }
+#endif
+  wtap_close(wth);
+}
 
-  return 0;
+#ifdef CAPINFOS_WORKER_THREADS
+static cap_file_job_t *worker_jobs;
+static guint           worker_job_count;
+static guint           next_worker_job;   /* next job not yet taken by a worker */
+static GMutex          worker_mtx;
+static GCond           worker_cond;
+
+static gpointer
+worker_thread(gpointer data _U_)
+{
+  cap_file_job_t *job;
+
+  for (;;) {
+    g_mutex_lock(&worker_mtx);
+    if (next_worker_job == worker_job_count) {
+      g_mutex_unlock(&worker_mtx);
+      break;
+    }
+    job = &worker_jobs[next_worker_job++];
+    g_mutex_unlock(&worker_mtx);
+
+    process_cap_file_job(job);
+
+    g_mutex_lock(&worker_mtx);
+    job->done = TRUE;
+    g_cond_broadcast(&worker_cond);
+    g_mutex_unlock(&worker_mtx);
+  }
+  return NULL;
+}
+
+/* Wait until a worker has finished with a job */
+static void
+wait_for_job(cap_file_job_t *job)
+{
+  g_mutex_lock(&worker_mtx);
+  while (!job->done)
+    g_cond_wait(&worker_cond, &worker_mtx);
+  g_mutex_unlock(&worker_mtx);
+}
+
+/*
+ * Let the workers finish the files they're on, without starting any
+ * more, and wait for them to exit.
+ */
+static void
+stop_workers(GThread **workers, guint worker_count)
+{
+  guint i;
+
+  g_mutex_lock(&worker_mtx);
+  next_worker_job = worker_job_count;
+  g_mutex_unlock(&worker_mtx);
+  for (i = 0; i < worker_count; i++)
+    g_thread_join(workers[i]);
+  g_free(workers);
 }
+#endif /* CAPINFOS_WORKER_THREADS */
 
 static void
 usage(gboolean is_error)
@@ -1075,6 +1265,7 @@ usage(gboolean is_error)
   fprintf(output, "  -h display this help and exit\n");
   fprintf(output, "  -C cancel processing if file open fails (default is to continue)\n");
   fprintf(output, "  -A generate all infos (default)\n");
+  fprintf(output, "  -j <workers> process up to <workers> files at the same time\n");
   fprintf(output, "\n");
   fprintf(output, "Options are processed from left to right order with later options superceding\n");
   fprintf(output, "or adding to earlier options.\n");
@@ -1113,13 +1304,15 @@ hash_to_str(const unsigned char *hash, size_t length, char *str) {
 int
 main(int argc, char *argv[])
 {
-  wtap  *wth;
-  int    err;
-  gchar *err_info;
   int    opt;
   int    overall_error_status;
-
-  int status = 0;
+  cap_file_job_t *jobs, *job;
+  guint  job_count, i;
+  char  *p;
+#ifdef CAPINFOS_WORKER_THREADS
+  GThread **workers = NULL;
+  guint  worker_count = 0;
+#endif
 #ifdef HAVE_PLUGINS
   char  *init_progfile_dir_error;
 #endif
@@ -1205,7 +1398,7 @@ main(int argc, char *argv[])
   g_option_context_free(ctx);
 
 #endif /* USE_GOPTION */
-  while ((opt = getopt(argc, argv, "tEcs" FILE_HASH_OPT "dluaeyizvhxokCALTMRrSNqQBmb")) !=-1) {
+  while ((opt = getopt(argc, argv, "tEcs" FILE_HASH_OPT "dluaeyizvhxokCALTMRrSNqQBmbj:")) !=-1) {
 
     switch (opt) {
 
@@ -1303,6 +1496,15 @@ main(int argc, char *argv[])
         enable_all_infos();
         break;
 
+      case 'j':
+        num_workers = (guint)strtoul(optarg, &p, 10);
+        if (p == optarg || *p != '\0' || num_workers == 0) {
+          fprintf(stderr, "capinfos: \"%s\" isn't a valid number of files to process at once\n",
+                  optarg);
+          exit(1);
+        }
+        break;
+
       case 'L':
         long_report = TRUE;
         break;
@@ -1385,15 +1587,50 @@ main(int argc, char *argv[])
 
   overall_error_status = 0;
 
-  for (opt = optind; opt < argc; opt++) {
+  job_count = argc - optind;
+  jobs = g_new0(cap_file_job_t, job_count);
+  for (i = 0; i < job_count; i++) {
+    jobs[i].filename = argv[optind + i];
+    jobs[i].errors = g_string_new("");
+  }
+
+#ifdef CAPINFOS_WORKER_THREADS
+  if (num_workers > 1 && job_count > 1) {
+    /*
+     * Wiretap sets up its tables of file types the first time a file
+     * is opened; have that happen before there's more than one thread,
+     * by doing the first file ourselves.
+     */
+    process_cap_file_job(&jobs[0]);
+    jobs[0].done = TRUE;
+
+    worker_jobs = jobs;
+    worker_job_count = job_count;
+    next_worker_job = 1;
+    worker_count = MIN(num_workers, job_count - 1);
+    workers = g_new(GThread *, worker_count);
+    for (i = 0; i < worker_count; i++)
+      workers[i] = g_thread_new("capinfos worker", worker_thread, NULL);
+  }
+#endif
+
+  for (i = 0; i < job_count; i++) {
+    job = &jobs[i];
+
+#ifdef CAPINFOS_WORKER_THREADS
+    if (worker_count != 0)
+      wait_for_job(job);
+    else
+#endif
+      process_cap_file_job(job);
 
 #ifdef HAVE_LIBGCRYPT
     g_strlcpy(file_sha1, "<unknown>", HASH_STR_SIZE);
     g_strlcpy(file_rmd160, "<unknown>", HASH_STR_SIZE);
     g_strlcpy(file_md5, "<unknown>", HASH_STR_SIZE);
 
-    if (cap_file_hashes) {
-      fh = ws_fopen(argv[opt], "rb");
+    if (cap_file_hashes && job->opened && job->status == 0) {
+      fh = ws_fopen(job->filename, "rb");
       if (fh && hd) {
         while((hash_bytes = fread(hash_buf, 1, HASH_BUF_SIZE, fh)) > 0) {
           gcry_md_write(hd, hash_buf, hash_bytes);
@@ -1408,36 +1645,42 @@ main(int argc, char *argv[])
     }
 #endif /* HAVE_LIBGCRYPT */
 
-    wth = wtap_open_offline(argv[opt], &err, &err_info, FALSE);
-
-    if (!wth) {
-      fprintf(stderr, "capinfos: Can't open %s: %s\n", argv[opt],
-          wtap_strerror(err));
-      switch (err) {
-
-        case WTAP_ERR_UNSUPPORTED:
-        case WTAP_ERR_UNSUPPORTED_ENCAP:
-        case WTAP_ERR_BAD_FILE:
-          fprintf(stderr, "(%s)\n", err_info);
-          g_free(err_info);
-          break;
-      }
+    if (!job->opened) {
+      fputs(job->errors->str, stderr);
       overall_error_status = 1; /* remember that an error has occurred */
-      if(!continue_after_wtap_open_offline_failure)
+      if(!continue_after_wtap_open_offline_failure) {
+#ifdef CAPINFOS_WORKER_THREADS
+        stop_workers(workers, worker_count);
+#endif
         exit(1); /* error status */
-    }
-
-    if(wth) {
-      if ((opt > optind) && (long_report))
+      }
+    } else {
+      if ((i > 0) && (long_report))
         printf("\n");
-      status = process_cap_file(wth, argv[opt]);
+      fputs(job->errors->str, stderr);
+      if (job->status) {
+#ifdef CAPINFOS_WORKER_THREADS
+        stop_workers(workers, worker_count);
+#endif
+        exit(job->status);
+      }
 
-      wtap_close(wth);
-      if (status)
-        exit(status);
+      if(long_report) {
+        print_stats(job->filename, &job->cf_info);
+      } else {
+        print_stats_table(job->filename, &job->cf_info);
+      }
+      g_free(job->cf_info.encap_counts);
+      g_free(job->cf_info.comment);
     }
+    g_string_free(job->errors, TRUE);
   }
 
+#ifdef CAPINFOS_WORKER_THREADS
+  stop_workers(workers, worker_count);
+#endif
+  g_free(jobs);
+
   return overall_error_status;
 }
 
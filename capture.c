@@ -363,6 +363,9 @@ capture_input_new_file(capture_session *cap_session, gchar *new_file)
     /* Attempt to open the capture file and set up to read from it. */
     switch(cf_start_tail((capture_file *)cap_session->cf, capture_opts->save_file, is_tempfile, &err)) {
     case CF_OK:
+      /* take what dumpcap writes from shared memory, where we can */
+      if (cap_session->shm_ring != NULL)
+        wtap_set_shm_ring(((capture_file *)cap_session->cf)->wth, cap_session->shm_ring);
       break;
     case CF_ERROR:
       /* Don't unlink (delete) the save file - leave it around,
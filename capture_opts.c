@@ -93,6 +93,7 @@ capture_opts_init(capture_options *capture_opts)
 #else
   capture_opts->use_pcapng                      = FALSE;            /* Save as pcap by default */
 #endif
+  capture_opts->use_shm_ring                    = FALSE;
   capture_opts->real_time_mode                  = TRUE;
   capture_opts->show_info                       = TRUE;
   capture_opts->quit_after_cap                  = getenv("WIRESHARK_QUIT_AFTER_CAPTURE") ? TRUE : FALSE;
@@ -206,6 +207,7 @@ capture_opts_log(const char *log_domain, GLogLevelFlags log_level, capture_optio
     g_log(log_domain, log_level, "SaveFile            : %s", (capture_opts->save_file) ? capture_opts->save_file : "");
     g_log(log_domain, log_level, "GroupReadAccess     : %u", capture_opts->group_read_access);
     g_log(log_domain, log_level, "Fileformat          : %s", (capture_opts->use_pcapng) ? "PCAPNG" : "PCAP");
+    g_log(log_domain, log_level, "UseShmRing          : %u", capture_opts->use_shm_ring);
     g_log(log_domain, log_level, "RealTimeMode        : %u", capture_opts->real_time_mode);
     g_log(log_domain, log_level, "ShowInfo            : %u", capture_opts->show_info);
     g_log(log_domain, log_level, "QuitAfterCap        : %u", capture_opts->quit_after_cap);
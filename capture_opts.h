@@ -51,6 +51,10 @@ extern "C" {
 /* this does not clash with tshark's -2 option which returns '2' */
 #define LONGOPT_NUM_CAP_COMMENT 2
 
+/* dumpcap only: the shared memory ring through which the parent reads
+   the capture data (see wsutil/shm_ring.h) */
+#define LONGOPT_NUM_SHM_RING 3
+
 
 #ifdef HAVE_PCAP_REMOTE
 /* Type of capture source */
@@ -180,6 +184,9 @@ typedef struct capture_options_tag {
     gchar    *save_file;            /**< the capture file name */
     gboolean group_read_access;     /**< TRUE is group read permission needs to be set */
     gboolean use_pcapng;            /**< TRUE if file format is pcapng */
+    gboolean use_shm_ring;          /**< TRUE to read the capture data through
+                                         shared memory while capturing, where
+                                         possible */
 
     /* GUI related */
     gboolean real_time_mode;        /**< Update list of packets in real time */
@@ -25,6 +25,8 @@
 #ifndef __CAPTURE_SESSION_H__
 #define __CAPTURE_SESSION_H__
 
+#include <wsutil/shm_ring.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif /* __cplusplus */
@@ -53,6 +55,8 @@ typedef struct {
     gboolean session_started;
     capture_options *capture_opts;  /**< options for this capture */
     void *cf;                       /**< handle to cfile (note: untyped handle) */
+    shm_ring_t *shm_ring;           /**< ring through which the child hands us
+                                         what it writes, or NULL */
 } capture_session;
 
 extern void
@@ -135,6 +135,18 @@ capture_session_init(capture_session *cap_session, void *cf)
     cap_session->group                           = getgid();
 #endif
     cap_session->session_started                 = FALSE;
+    cap_session->shm_ring                        = NULL;
+}
+
+/* Let go of the shared memory ring of a capture session; the capture file
+   we're reading from keeps it as long as it needs it */
+static void
+sync_pipe_free_shm_ring(capture_session *cap_session)
+{
+    if (cap_session->shm_ring != NULL) {
+        shm_ring_unref(cap_session->shm_ring);
+        cap_session->shm_ring = NULL;
+    }
 }
 
 /* Append an arg (realloc) to an argc/argv array */
@@ -535,6 +547,22 @@ sync_pipe_start(capture_options *capture_opts, capture_session *cap_session, voi
 #endif
 #endif
 
+    /* If we're going to read the packets while they're being captured,
+       have dumpcap hand them to us through shared memory, too */
+    sync_pipe_free_shm_ring(cap_session);
+    if (capture_opts->use_shm_ring && capture_opts->real_time_mode) {
+        int shm_err;
+
+        cap_session->shm_ring = shm_ring_create(SHM_RING_DEFAULT_SIZE, &shm_err);
+        if (cap_session->shm_ring != NULL) {
+            argv = sync_pipe_add_arg(argv, &argc, "--shm-ring");
+            argv = sync_pipe_add_arg(argv, &argc, shm_ring_path(cap_session->shm_ring));
+        } else {
+            g_log(LOG_DOMAIN_CAPTURE, G_LOG_LEVEL_DEBUG,
+                  "sync_pipe_start: no shared memory ring: %s", g_strerror(shm_err));
+        }
+    }
+
     if (capture_opts->save_file) {
         argv = sync_pipe_add_arg(argv, &argc, "-w");
         argv = sync_pipe_add_arg(argv, &argc, capture_opts->save_file);
@@ -635,6 +663,7 @@ sync_pipe_start(capture_options *capture_opts, capture_session *cap_session, voi
             g_free( (gpointer) argv[i]);
         }
         g_free(argv);
+        sync_pipe_free_shm_ring(cap_session);
         return FALSE;
     }
 
@@ -691,6 +720,7 @@ sync_pipe_start(capture_options *capture_opts, capture_session *cap_session, voi
 #ifdef _WIN32
         ws_close(cap_session->signal_pipe_write_fd);
 #endif
+        sync_pipe_free_shm_ring(cap_session);
         return FALSE;
     }
 
@@ -1733,6 +1763,7 @@ sync_pipe_input_cb(gint source, gpointer user_data)
 #ifdef _WIN32
         ws_close(cap_session->signal_pipe_write_fd);
 #endif
+        sync_pipe_free_shm_ring(cap_session);
         capture_input_closed(cap_session, primary_msg);
         g_free(primary_msg);
         return FALSE;
@@ -1741,6 +1772,10 @@ sync_pipe_input_cb(gint source, gpointer user_data)
     /* we got a valid message block from the child, process it */
     switch(indicator) {
     case SP_FILE:
+        /* The child has the shared memory ring open by now, if it's
+           going to use it; don't leave its file lying around */
+        if (cap_session->shm_ring != NULL)
+            shm_ring_unlink(cap_session->shm_ring);
         if(!capture_input_new_file(cap_session, buffer)) {
             g_log(LOG_DOMAIN_CAPTURE, G_LOG_LEVEL_DEBUG, "sync_pipe_input_cb: file failed, closing capture");
 
@@ -1762,6 +1797,7 @@ sync_pipe_input_cb(gint source, gpointer user_data)
                This can also happen if the user specified "-", meaning
                "standard output", as the capture file. */
             sync_pipe_stop(cap_session);
+            sync_pipe_free_shm_ring(cap_session);
             capture_input_closed(cap_session, NULL);
             return FALSE;
         }
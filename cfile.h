@@ -95,6 +95,8 @@ typedef struct _capture_file {
   dfilter_t   *dfcode;          /* Compiled display filter program */
   gchar       *dfilter;         /* Display filter string */
   gboolean     redissecting;    /* TRUE if currently redissecting (cf_redissect_packets) */
+  gboolean     rescanning;      /* TRUE if currently rescanning the packet list */
+  gboolean     refilter;        /* TRUE if the display filter changed during a rescan */
   /* search */
   gchar       *sfilter;         /* Filter, hex value, or string being searched */
   gboolean     hex;             /* TRUE if "Hex value" search was last selected */
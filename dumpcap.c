@@ -110,6 +110,8 @@
 #endif
 
 #include <wsutil/privileges.h>
+#include <wsutil/flowindex.h>
+#include <wsutil/shm_ring.h>
 
 #include "sync_pipe.h"
 
@@ -148,11 +150,21 @@ FILE *debug_log;   /* for logging debug messages to  */
                    /*  is defined                    */
 #endif
 
-static GAsyncQueue *pcap_queue;
-static gint64 pcap_queue_bytes;
-static gint64 pcap_queue_packets;
+/* Used by the capture threads to wake up the writer when it's idle */
+static GAsyncQueue *pcap_writer_wakeup;
+static volatile gint pcap_writer_idle;
 static gint64 pcap_queue_byte_limit = 0;
 static gint64 pcap_queue_packet_limit = 0;
+static guint  pcap_order_window = 0;    /* msecs; 0 means write packets in the order they're dequeued */
+
+/* Index of the flows in the current output file, if we're writing one */
+static gboolean             write_flow_index = FALSE;
+static flowindex_builder_t *flow_index = NULL;
+
+/* Shared memory ring through which our parent reads what we write to the
+   capture file, if it gave us one */
+static char       *shm_ring_name = NULL;
+static shm_ring_t *shm_ring = NULL;
 
 static gboolean capture_child = FALSE; /* FALSE: standalone call, TRUE: this is an Wireshark capture child */
 #ifdef _WIN32
@@ -244,6 +256,44 @@ typedef enum {
     PIPNEXIST
 } cap_pipe_err_t;
 
+/*
+ * Packets captured by a capture thread are handed to the writer through a
+ * ring buffer, one per interface.  There is a single producer (the capture
+ * thread) and a single consumer (the writer), so no locks are needed: the
+ * producer only advances head, the consumer only advances tail, and each
+ * reads the other's counter with g_atomic_int_get().
+ *
+ * The counters are free-running byte counts; the size of the buffer is a
+ * power of 2, so they can wrap.  Each record is a pcap_ring_rec followed
+ * by the packet data, padded to a multiple of PCAP_RING_ALIGNMENT bytes.
+ * A record never wraps around the end of the buffer; if it doesn't fit,
+ * the rest of the buffer is skipped, marked by a record with a rec_len
+ * of 0 if there's room for one.
+ */
+typedef struct _pcap_ring_rec {
+    struct pcap_pkthdr  phdr;
+    guint32             rec_len;    /**< bytes from here to the next record */
+    gint64              queued;     /**< when the packet was queued, in usecs; only set with -O */
+} pcap_ring_rec;
+
+#define PCAP_RING_ALIGNMENT     8
+#define PCAP_RING_ALIGN(n)      (((n) + (PCAP_RING_ALIGNMENT - 1)) & ~(gsize)(PCAP_RING_ALIGNMENT - 1))
+#define PCAP_RING_REC_HDR_LEN   PCAP_RING_ALIGN(sizeof(pcap_ring_rec))
+#define PCAP_RING_DEFAULT_SIZE  (16 * 1024 * 1024)  /* if there's no byte limit */
+#define PCAP_RING_MAX_SIZE      (64 * 1024 * 1024)  /* whatever the byte limit */
+#define PCAP_RING_BATCH         256                 /* packets written per ring per turn */
+
+typedef struct _pcap_ring {
+    guint8        *buf;
+    gsize          size;
+    volatile gint  head;        /**< written by the producer */
+    volatile gint  tail;        /**< written by the consumer */
+    guint          read;        /**< consumer's position; copied to tail after a batch */
+    guint          pushed;      /**< packets added; producer only */
+    volatile gint  popped;      /**< packets removed; written by the consumer */
+    gint           unpublished; /**< packets removed since tail was last updated */
+} pcap_ring;
+
 typedef struct _pcap_options {
     guint32                      received;
     guint32                      dropped;
@@ -255,6 +305,7 @@ typedef struct _pcap_options {
     gboolean                     pcap_err;
     guint                        interface_id;
     GThread                     *tid;
+    pcap_ring                    ring;                   /**< packets queued for the writer, if use_threads */
     int                          snaplen;
     int                          linktype;
     gboolean                     ts_nsec;                /**< TRUE if we're using nanosecond precision. */
@@ -304,12 +355,6 @@ typedef struct _loop_data {
     guint32   autostop_files;
 } loop_data;
 
-typedef struct _pcap_queue_element {
-    pcap_options       *pcap_opts;
-    struct pcap_pkthdr  phdr;
-    u_char             *pd;
-} pcap_queue_element;
-
 /*
  * Standard secondary message for unexpected errors.
  */
@@ -513,7 +558,11 @@ print_usage(gboolean print_ver)
     fprintf(output, "  -N <packet_limit>        maximum number of packets buffered within dumpcap\n");
     fprintf(output, "  -C <byte_limit>          maximum number of bytes used for buffering packets\n");
     fprintf(output, "                           within dumpcap\n");
+    fprintf(output, "  -O <msecs>               write packets from multiple interfaces in\n");
+    fprintf(output, "                           timestamp order, holding them up to <msecs>\n");
     fprintf(output, "  -t                       use a separate thread per interface\n");
+    fprintf(output, "  -x                       write a flow index (" FLOWINDEX_FILE_SUFFIX ") next to each\n");
+    fprintf(output, "                           output file\n");
     fprintf(output, "  -q                       don't report packet capture counts\n");
     fprintf(output, "  -v                       print version information and exit\n");
     fprintf(output, "  -h                       display this help and exit\n");
@@ -2575,6 +2624,7 @@ capture_loop_open_input(capture_options *capture_opts, loop_data *ld,
         pcap_opts->pcap_err = FALSE;
         pcap_opts->interface_id = i;
         pcap_opts->tid = NULL;
+        memset(&pcap_opts->ring, 0, sizeof(pcap_ring));
         pcap_opts->snaplen = 0;
         pcap_opts->linktype = -1;
         pcap_opts->ts_nsec = FALSE;
@@ -2805,6 +2855,19 @@ capture_loop_init_filter(pcap_t *pcap_h, gboolean from_cap_pipe,
 
 
 /* set up to write to the already-opened capture output file/files */
+/* write to the capture file, and copy what we wrote to the shared memory
+   ring, if we have one */
+static gboolean
+capture_loop_write_to_file(void *write_data_info, const guint8 *data,
+                           long data_length, guint64 *bytes_written, int *err)
+{
+    if (!libpcap_write_to_file(write_data_info, data, data_length, bytes_written, err))
+        return FALSE;
+    if (shm_ring != NULL)
+        shm_ring_write(shm_ring, data, data_length);
+    return TRUE;
+}
+
 static gboolean
 capture_loop_init_output(capture_options *capture_opts, loop_data *ld, char *errmsg, int errmsg_len)
 {
@@ -2833,6 +2896,8 @@ capture_loop_init_output(capture_options *capture_opts, loop_data *ld, char *err
         }
     }
     if (ld->pdh) {
+        if (shm_ring != NULL)
+            shm_ring_start_file(shm_ring, fileno(ld->pdh));
         if (capture_opts->use_pcapng) {
             char appname[100];
             GString             *os_info_str;
@@ -2841,7 +2906,7 @@ capture_loop_init_output(capture_options *capture_opts, loop_data *ld, char *err
             get_os_version_info(os_info_str);
 
             g_snprintf(appname, sizeof(appname), "Dumpcap " VERSION "%s", wireshark_svnversion);
-            successful = libpcap_write_session_header_block(libpcap_write_to_file, ld->pdh,
+            successful = libpcap_write_session_header_block(capture_loop_write_to_file, ld->pdh,
                                 (const char *)capture_opts->capture_comment,   /* Comment*/
                                 NULL,                        /* HW*/
                                 os_info_str->str,            /* OS*/
@@ -2858,7 +2923,7 @@ capture_loop_init_output(capture_options *capture_opts, loop_data *ld, char *err
                 } else {
                     pcap_opts->snaplen = pcap_snapshot(pcap_opts->pcap_h);
                 }
-                successful = libpcap_write_interface_description_block(libpcap_write_to_file, global_ld.pdh,
+                successful = libpcap_write_interface_description_block(capture_loop_write_to_file, global_ld.pdh,
                                                                        NULL,                       /* OPT_COMMENT       1 */
                                                                        interface_opts.name,        /* IDB_NAME          2 */
                                                                        interface_opts.descr,       /* IDB_DESCRIPTION   3 */
@@ -2881,7 +2946,7 @@ capture_loop_init_output(capture_options *capture_opts, loop_data *ld, char *err
             } else {
                 pcap_opts->snaplen = pcap_snapshot(pcap_opts->pcap_h);
             }
-            successful = libpcap_write_file_header(libpcap_write_to_file, ld->pdh, pcap_opts->linktype, pcap_opts->snaplen,
+            successful = libpcap_write_file_header(capture_loop_write_to_file, ld->pdh, pcap_opts->linktype, pcap_opts->snaplen,
                                                    pcap_opts->ts_nsec, &ld->bytes_written, &err);
         }
         if (!successful) {
@@ -2916,6 +2981,35 @@ capture_loop_init_output(capture_options *capture_opts, loop_data *ld, char *err
     return TRUE;
 }
 
+/* write the flow index for the current output file, and start a new
+   one if there'll be another file */
+static void
+capture_loop_write_flow_index(capture_options *capture_opts, gboolean next_file)
+{
+    gchar *index_filename;
+    int    err;
+
+    if (flow_index == NULL)
+        return;
+
+    if (capture_opts->multi_files_on) {
+        /* The ringbuffer writes it, in the background if it can, so
+           as not to hold up the switch, and frees it */
+        ringbuf_write_flow_index(flow_index);
+    } else {
+        index_filename = flowindex_filename(capture_opts->save_file);
+        if (!flowindex_builder_write(flow_index, index_filename, &err)) {
+            /* The capture file itself is fine, so just complain and go on */
+            g_log(LOG_DOMAIN_CAPTURE_CHILD, G_LOG_LEVEL_WARNING,
+                  "Couldn't write the flow index \"%s\": %s",
+                  index_filename, g_strerror(err));
+        }
+        g_free(index_filename);
+        flowindex_builder_free(flow_index);
+    }
+    flow_index = next_file ? flowindex_builder_new() : NULL;
+}
+
 static gboolean
 capture_loop_close_output(capture_options *capture_opts, loop_data *ld, int *err_close)
 {
@@ -2926,6 +3020,8 @@ capture_loop_close_output(capture_options *capture_opts, loop_data *ld, int *err
 
     g_log(LOG_DOMAIN_CAPTURE_CHILD, G_LOG_LEVEL_DEBUG, "capture_loop_close_output");
 
+    capture_loop_write_flow_index(capture_opts, FALSE);
+
     if (capture_opts->multi_files_on) {
         return ringbuf_libpcap_dump_close(&capture_opts->save_file, err_close);
     } else {
@@ -2943,7 +3039,7 @@ capture_loop_close_output(capture_options *capture_opts, loop_data *ld, int *err
                         isb_ifrecv = G_MAXUINT64;
                         isb_ifdrop = G_MAXUINT64;
                     }
-                    libpcap_write_interface_statistics_block(libpcap_write_to_file, ld->pdh,
+                    libpcap_write_interface_statistics_block(capture_loop_write_to_file, ld->pdh,
                                                              i,
                                                              &ld->bytes_written,
                                                              "Counters provided by dumpcap",
@@ -3320,12 +3416,16 @@ do_file_switch_or_stop(capture_options *capture_opts,
             return FALSE;
         }
 
-        /* Switch to the next ringbuffer file */
+        /* Index the file we're done with, then switch to the next
+           ringbuffer file */
+        capture_loop_write_flow_index(capture_opts, TRUE);
         if (ringbuf_switch_file(&global_ld.pdh, &capture_opts->save_file,
                                 &global_ld.save_file_fd, &global_ld.err)) {
 
             /* File switch succeeded: reset the conditions */
             global_ld.bytes_written = 0;
+            if (shm_ring != NULL)
+                shm_ring_start_file(shm_ring, fileno(global_ld.pdh));
             if (capture_opts->use_pcapng) {
                 char appname[100];
                 GString             *os_info_str;
@@ -3334,7 +3434,7 @@ do_file_switch_or_stop(capture_options *capture_opts,
                 get_os_version_info(os_info_str);
 
                 g_snprintf(appname, sizeof(appname), "Dumpcap " VERSION "%s", wireshark_svnversion);
-                successful = libpcap_write_session_header_block(libpcap_write_to_file, global_ld.pdh,
+                successful = libpcap_write_session_header_block(capture_loop_write_to_file, global_ld.pdh,
                                 NULL,                        /* Comment */
                                 NULL,                        /* HW */
                                 os_info_str->str,            /* OS */
@@ -3346,7 +3446,7 @@ do_file_switch_or_stop(capture_options *capture_opts,
                 for (i = 0; successful && (i < capture_opts->ifaces->len); i++) {
                     interface_opts = g_array_index(capture_opts->ifaces, interface_options, i);
                     pcap_opts = g_array_index(global_ld.pcaps, pcap_options *, i);
-                    successful = libpcap_write_interface_description_block(libpcap_write_to_file, global_ld.pdh,
+                    successful = libpcap_write_interface_description_block(capture_loop_write_to_file, global_ld.pdh,
                                                                            NULL,                       /* OPT_COMMENT       1 */
                                                                            interface_opts.name,        /* IDB_NAME          2 */
                                                                            interface_opts.descr,       /* IDB_DESCRIPTION   3 */
@@ -3364,7 +3464,7 @@ do_file_switch_or_stop(capture_options *capture_opts,
 
             } else {
                 pcap_opts = g_array_index(global_ld.pcaps, pcap_options *, 0);
-                successful = libpcap_write_file_header(libpcap_write_to_file, global_ld.pdh, pcap_opts->linktype, pcap_opts->snaplen,
+                successful = libpcap_write_file_header(capture_loop_write_to_file, global_ld.pdh, pcap_opts->linktype, pcap_opts->snaplen,
                                                        pcap_opts->ts_nsec, &global_ld.bytes_written, &global_ld.err);
             }
             if (!successful) {
@@ -3395,6 +3495,329 @@ do_file_switch_or_stop(capture_options *capture_opts,
     return TRUE;
 }
 
+/* Current time in microseconds, for timing how long packets are held;
+   a monotonic clock, if we have one, so setting the clock doesn't
+   release or hold back packets. */
+static gint64
+pcap_ring_now(void)
+{
+#if GLIB_CHECK_VERSION(2,28,0)
+    return g_get_monotonic_time();
+#else
+    GTimeVal now;
+
+    g_get_current_time(&now);
+    return (gint64)now.tv_sec * 1000000 + now.tv_usec;
+#endif
+}
+
+/* Allocate the ring buffer through which a capture thread queues packets.
+   Returns FALSE, with a message in errmsg, if we can't. */
+static gboolean
+pcap_ring_init(pcap_ring *ring, char *errmsg, int errmsgl)
+{
+    gsize size;
+
+    if (pcap_queue_byte_limit > 0) {
+        /* Big enough for the limit plus the largest packet and the
+           space wasted when a record doesn't fit at the end, but no
+           bigger than PCAP_RING_MAX_SIZE; with a larger limit, the
+           ring fills up before the limit is reached. */
+        size = 1;
+        while (size < PCAP_RING_MAX_SIZE &&
+               size < (gsize)pcap_queue_byte_limit + 2 * (PCAP_RING_REC_HDR_LEN + WTAP_MAX_PACKET_SIZE))
+            size <<= 1;
+    } else {
+        size = PCAP_RING_DEFAULT_SIZE;
+    }
+    ring->buf = (guint8 *)g_try_malloc(size);
+    if (ring->buf == NULL) {
+        g_snprintf(errmsg, errmsgl,
+                   "Couldn't allocate %lu bytes to queue captured packets in.",
+                   (unsigned long)size);
+        return FALSE;
+    }
+    ring->size = size;
+    ring->head = 0;
+    ring->tail = 0;
+    ring->read = 0;
+    ring->pushed = 0;
+    ring->popped = 0;
+    ring->unpublished = 0;
+    return TRUE;
+}
+
+static void
+pcap_ring_free(pcap_ring *ring)
+{
+    g_free(ring->buf);
+    ring->buf = NULL;
+}
+
+/* Add a packet to a ring; called by the capture thread only.
+   Returns FALSE if the ring is full or a queue limit has been reached. */
+static gboolean
+pcap_ring_put(pcap_ring *ring, const struct pcap_pkthdr *phdr, const u_char *pd)
+{
+    guint          head    = (guint)ring->head;
+    guint          tail    = (guint)g_atomic_int_get(&ring->tail);
+    gsize          used    = (guint)(head - tail);
+    gsize          rec_len = PCAP_RING_ALIGN(PCAP_RING_REC_HDR_LEN + phdr->caplen);
+    gsize          offset  = head & (ring->size - 1);
+    gsize          contig  = ring->size - offset;
+    gsize          needed;
+    pcap_ring_rec *rec;
+
+    if ((pcap_queue_byte_limit > 0) && (used >= (gsize)pcap_queue_byte_limit))
+        return FALSE;
+    if ((pcap_queue_packet_limit > 0) &&
+        ((gint64)(ring->pushed - (guint)g_atomic_int_get(&ring->popped)) >= pcap_queue_packet_limit))
+        return FALSE;
+
+    /* A record doesn't wrap, so we may have to skip the end of the buffer. */
+    needed = (rec_len > contig) ? contig + rec_len : rec_len;
+    if (needed > ring->size - used)
+        return FALSE;
+    if (rec_len > contig) {
+        if (contig >= PCAP_RING_REC_HDR_LEN)
+            ((pcap_ring_rec *)(ring->buf + offset))->rec_len = 0;
+        head += (guint)contig;
+        offset = 0;
+    }
+
+    rec = (pcap_ring_rec *)(ring->buf + offset);
+    rec->phdr = *phdr;
+    rec->rec_len = (guint32)rec_len;
+    /* Only the order window (-O) looks at when a packet was queued. */
+    if (pcap_order_window > 0)
+        rec->queued = pcap_ring_now();
+    memcpy(ring->buf + offset + PCAP_RING_REC_HDR_LEN, pd, phdr->caplen);
+    ring->pushed++;
+
+    /* Publish the record; this is a full memory barrier. */
+    g_atomic_int_set(&ring->head, (gint)(head + rec_len));
+    return TRUE;
+}
+
+/* Return the next packet in a ring without removing it, or NULL if the
+   ring is empty; called by the writer only. */
+static pcap_ring_rec *
+pcap_ring_peek(pcap_ring *ring)
+{
+    guint          head = (guint)g_atomic_int_get(&ring->head);
+    gsize          offset, contig;
+    pcap_ring_rec *rec;
+
+    while (ring->read != head) {
+        offset = ring->read & (ring->size - 1);
+        contig = ring->size - offset;
+        rec = (pcap_ring_rec *)(ring->buf + offset);
+        if (contig >= PCAP_RING_REC_HDR_LEN && rec->rec_len != 0)
+            return rec;
+        /* Skip to the start of the buffer */
+        ring->read += (guint)contig;
+    }
+    return NULL;
+}
+
+/* Write out the packet returned by pcap_ring_peek() and remove it */
+static void
+pcap_ring_write_packet(pcap_options *pcap_opts, pcap_ring_rec *rec)
+{
+    pcap_ring *ring = &pcap_opts->ring;
+
+    capture_loop_write_packet_cb((u_char *)pcap_opts, &rec->phdr,
+                                 (guint8 *)rec + PCAP_RING_REC_HDR_LEN);
+    ring->read += rec->rec_len;
+    ring->unpublished++;
+}
+
+/* Give the space used by the packets written so far back to the producer */
+static void
+pcap_ring_publish(pcap_options *pcap_opts)
+{
+    pcap_ring *ring = &pcap_opts->ring;
+
+    if (ring->unpublished > 0) {
+        g_log(LOG_DOMAIN_CAPTURE_CHILD, G_LOG_LEVEL_INFO,
+              "Dequeued %d packets captured on interface %u.",
+              ring->unpublished, pcap_opts->interface_id);
+        g_atomic_int_add(&ring->popped, ring->unpublished);
+        ring->unpublished = 0;
+    }
+    g_atomic_int_set(&ring->tail, (gint)ring->read);
+}
+
+/* Timestamp of a queued packet, in nanoseconds */
+static guint64
+pcap_ring_rec_ts(const pcap_options *pcap_opts, const pcap_ring_rec *rec)
+{
+    guint64 frac = (guint64)rec->phdr.ts.tv_usec;
+
+    return (guint64)rec->phdr.ts.tv_sec * 1000000000 +
+           (pcap_opts->ts_nsec ? frac : frac * 1000);
+}
+
+/*
+ * Find the queued packet with the earliest timestamp.  Sets *any_empty
+ * if some interface has no packet queued, in which case it might yet
+ * deliver an earlier one.  Returns NULL if nothing is queued.
+ */
+static pcap_ring_rec *
+capture_loop_earliest_packet(pcap_options **pcap_optsp, gboolean *any_empty)
+{
+    guint          i;
+    pcap_options  *pcap_opts;
+    pcap_ring_rec *rec, *earliest = NULL;
+    guint64        ts, earliest_ts = 0;
+
+    *any_empty = FALSE;
+    for (i = 0; i < global_ld.pcaps->len; i++) {
+        pcap_opts = g_array_index(global_ld.pcaps, pcap_options *, i);
+        rec = pcap_ring_peek(&pcap_opts->ring);
+        if (rec == NULL) {
+            *any_empty = TRUE;
+            continue;
+        }
+        ts = pcap_ring_rec_ts(pcap_opts, rec);
+        if (earliest == NULL || ts < earliest_ts) {
+            earliest = rec;
+            earliest_ts = ts;
+            *pcap_optsp = pcap_opts;
+        }
+    }
+    return earliest;
+}
+
+/* Are we writing packets from several interfaces in timestamp order? */
+static gboolean
+capture_loop_ordered(void)
+{
+    return pcap_order_window > 0 && global_ld.pcaps->len > 1;
+}
+
+/*
+ * Write out queued packets in timestamp order.  A packet is held back
+ * while some other interface has nothing queued, as that interface may
+ * still deliver an earlier packet, but for no longer than the order
+ * window; if flush is TRUE, nothing is held back.
+ * Returns the number of packets written.
+ */
+static int
+capture_loop_write_ordered_packets(gboolean flush)
+{
+    guint          i;
+    int            inpkts = 0;
+    int            max_packets = PCAP_RING_BATCH * global_ld.pcaps->len;
+    gint64         hold_until = pcap_ring_now() - (gint64)pcap_order_window * 1000;
+    gboolean       any_empty;
+    pcap_options  *pcap_opts = NULL;
+    pcap_ring_rec *rec;
+
+    while (inpkts < max_packets) {
+        rec = capture_loop_earliest_packet(&pcap_opts, &any_empty);
+        if (rec == NULL)
+            break;
+        if (any_empty && !flush && rec->queued > hold_until)
+            break;
+        pcap_ring_write_packet(pcap_opts, rec);
+        inpkts++;
+    }
+    for (i = 0; i < global_ld.pcaps->len; i++) {
+        pcap_opts = g_array_index(global_ld.pcaps, pcap_options *, i);
+        pcap_ring_publish(pcap_opts);
+    }
+    return inpkts;
+}
+
+/* Write out a batch of queued packets from each interface in turn, or in
+   timestamp order if requested.  Returns the number of packets written. */
+static int
+capture_loop_write_queued_packets(gboolean flush)
+{
+    guint          i;
+    int            n, inpkts = 0;
+    pcap_options  *pcap_opts;
+    pcap_ring_rec *rec;
+
+    if (capture_loop_ordered())
+        return capture_loop_write_ordered_packets(flush);
+
+    for (i = 0; i < global_ld.pcaps->len; i++) {
+        pcap_opts = g_array_index(global_ld.pcaps, pcap_options *, i);
+        for (n = 0; n < PCAP_RING_BATCH; n++) {
+            rec = pcap_ring_peek(&pcap_opts->ring);
+            if (rec == NULL)
+                break;
+            pcap_ring_write_packet(pcap_opts, rec);
+        }
+        pcap_ring_publish(pcap_opts);
+        inpkts += n;
+    }
+    return inpkts;
+}
+
+/* How long the writer can sleep before it has something to write, in
+   usecs; 0 if it has something to write now. */
+static gulong
+capture_loop_queued_wait_time(void)
+{
+    guint          i;
+    gboolean       any_empty;
+    gint64         held;
+    pcap_options  *pcap_opts = NULL;
+    pcap_ring_rec *rec;
+
+    if (!capture_loop_ordered()) {
+        for (i = 0; i < global_ld.pcaps->len; i++) {
+            pcap_opts = g_array_index(global_ld.pcaps, pcap_options *, i);
+            if (pcap_ring_peek(&pcap_opts->ring) != NULL)
+                return 0;
+        }
+        return WRITER_THREAD_TIMEOUT;
+    }
+
+    rec = capture_loop_earliest_packet(&pcap_opts, &any_empty);
+    if (rec == NULL)
+        return WRITER_THREAD_TIMEOUT;
+    if (!any_empty)
+        return 0;
+    held = pcap_ring_now() - rec->queued;
+    if (held >= (gint64)pcap_order_window * 1000)
+        return 0;
+    return (gulong)MIN((gint64)pcap_order_window * 1000 - held, WRITER_THREAD_TIMEOUT);
+}
+
+/* Wait until a capture thread queues a packet, or until a held packet
+   is due to be written, or for WRITER_THREAD_TIMEOUT, whichever comes first. */
+static void
+capture_loop_wait_for_packets(void)
+{
+    gulong        wait_time;
+#if !GLIB_CHECK_VERSION(2,31,18)
+    GTimeVal      write_thread_time;
+#endif
+
+    /* Tell the capture threads we're going to sleep, then check again
+       whether there's anything to write, so that we can't miss a packet
+       that was queued in between. */
+    g_atomic_int_set(&pcap_writer_idle, 1);
+    wait_time = capture_loop_queued_wait_time();
+    if (wait_time == 0) {
+        g_atomic_int_set(&pcap_writer_idle, 0);
+        return;
+    }
+
+#if GLIB_CHECK_VERSION(2,31,18)
+    g_async_queue_timeout_pop(pcap_writer_wakeup, wait_time);
+#else
+    g_get_current_time(&write_thread_time);
+    g_time_val_add(&write_thread_time, wait_time);
+    g_async_queue_timed_pop(pcap_writer_wakeup, &write_thread_time);
+#endif
+    g_atomic_int_set(&pcap_writer_idle, 0);
+}
+
 static void *
 pcap_read_handler(void* arg)
 {
@@ -3501,9 +3924,34 @@ capture_loop_start(capture_options *capture_opts, gboolean *stats_known, struct
         }
     }
 
+    /* Allocate the queues the capture threads hand packets over in */
+    if (use_threads) {
+        for (i = 0; i < global_ld.pcaps->len; i++) {
+            pcap_opts = g_array_index(global_ld.pcaps, pcap_options *, i);
+            if (!pcap_ring_init(&pcap_opts->ring, errmsg, sizeof(errmsg))) {
+                g_snprintf(secondary_errmsg, sizeof(secondary_errmsg),
+                           "Try a smaller byte limit with -C.");
+                goto error;
+            }
+        }
+    }
+
     /* If we're supposed to write to a capture file, open it for output
        (temporary/specified name/ringbuffer) */
     if (capture_opts->saving_to_file) {
+        /* Open the shared memory ring now that we've given up our special
+           privileges.  If we can't, our parent just reads the file. */
+        if (shm_ring_name != NULL && !capture_opts->output_to_pipe) {
+            int shm_err;
+
+            shm_ring = shm_ring_open(shm_ring_name, &shm_err);
+            if (shm_ring == NULL) {
+                g_log(LOG_DOMAIN_CAPTURE_CHILD, G_LOG_LEVEL_WARNING,
+                      "Couldn't open the shared memory ring \"%s\": %s",
+                      shm_ring_name, g_strerror(shm_err));
+            }
+        }
+
         if (!capture_loop_open_output(capture_opts, &global_ld.save_file_fd,
                                       errmsg, sizeof(errmsg))) {
             goto error;
@@ -3515,6 +3963,11 @@ capture_loop_start(capture_options *capture_opts, gboolean *stats_known, struct
             goto error;
         }
 
+        /* start indexing the first file; there's nowhere to put an
+           index for a pipe */
+        if (write_flow_index && !capture_opts->output_to_pipe)
+            flow_index = flowindex_builder_new();
+
         /* XXX - capture SIGTERM and close the capture, in case we're on a
            Linux 2.0[.x] system and you have to explicitly close the capture
            stream in order to turn promiscuous mode off?  We need to do that
@@ -3564,9 +4017,8 @@ capture_loop_start(capture_options *capture_opts, gboolean *stats_known, struct
     /* WOW, everything is prepared! */
     /* please fasten your seat belts, we will enter now the actual capture loop */
     if (use_threads) {
-        pcap_queue = g_async_queue_new();
-        pcap_queue_bytes = 0;
-        pcap_queue_packets = 0;
+        pcap_writer_wakeup = g_async_queue_new();
+        pcap_writer_idle = 0;
         for (i = 0; i < global_ld.pcaps->len; i++) {
             pcap_opts = g_array_index(global_ld.pcaps, pcap_options *, i);
 #if GLIB_CHECK_VERSION(2,31,0)
@@ -3580,37 +4032,10 @@ capture_loop_start(capture_options *capture_opts, gboolean *stats_known, struct
     while (global_ld.go) {
         /* dispatch incoming packets */
         if (use_threads) {
-            pcap_queue_element *queue_element;
-#if GLIB_CHECK_VERSION(2,31,18)
-
-            g_async_queue_lock(pcap_queue);
-            queue_element = (pcap_queue_element *)g_async_queue_timeout_pop_unlocked(pcap_queue, WRITER_THREAD_TIMEOUT);
-#else
-            GTimeVal write_thread_time;
-
-            g_get_current_time(&write_thread_time);
-            g_time_val_add(&write_thread_time, WRITER_THREAD_TIMEOUT);
-            g_async_queue_lock(pcap_queue);
-            queue_element = (pcap_queue_element *)g_async_queue_timed_pop_unlocked(pcap_queue, &write_thread_time);
-#endif
-            if (queue_element) {
-                pcap_queue_bytes -= queue_element->phdr.caplen;
-                pcap_queue_packets -= 1;
-            }
-            g_async_queue_unlock(pcap_queue);
-            if (queue_element) {
-                g_log(LOG_DOMAIN_CAPTURE_CHILD, G_LOG_LEVEL_INFO,
-                      "Dequeued a packet of length %d captured on interface %d.",
-                      queue_element->phdr.caplen, queue_element->pcap_opts->interface_id);
-
-                capture_loop_write_packet_cb((u_char *) queue_element->pcap_opts,
-                                             &queue_element->phdr,
-                                             queue_element->pd);
-                g_free(queue_element->pd);
-                g_free(queue_element);
-                inpkts = 1;
-            } else {
-                inpkts = 0;
+            inpkts = capture_loop_write_queued_packets(FALSE);
+            if (inpkts == 0) {
+                capture_loop_wait_for_packets();
+                inpkts = capture_loop_write_queued_packets(FALSE);
             }
         } else {
             pcap_opts = g_array_index(global_ld.pcaps, pcap_options *, 0);
@@ -3703,8 +4128,6 @@ capture_loop_start(capture_options *capture_opts, gboolean *stats_known, struct
 
     g_log(LOG_DOMAIN_CAPTURE_CHILD, G_LOG_LEVEL_INFO, "Capture loop stopping ...");
     if (use_threads) {
-        pcap_queue_element *queue_element;
-
         for (i = 0; i < global_ld.pcaps->len; i++) {
             pcap_opts = g_array_index(global_ld.pcaps, pcap_options *, i);
             g_log(LOG_DOMAIN_CAPTURE_CHILD, G_LOG_LEVEL_INFO, "Waiting for thread of interface %u...",
@@ -3713,30 +4136,18 @@ capture_loop_start(capture_options *capture_opts, gboolean *stats_known, struct
             g_log(LOG_DOMAIN_CAPTURE_CHILD, G_LOG_LEVEL_INFO, "Thread of interface %u terminated.",
                   pcap_opts->interface_id);
         }
-        while (1) {
-            g_async_queue_lock(pcap_queue);
-            queue_element = (pcap_queue_element *)g_async_queue_try_pop_unlocked(pcap_queue);
-            if (queue_element) {
-                pcap_queue_bytes -= queue_element->phdr.caplen;
-                pcap_queue_packets -= 1;
-            }
-            g_async_queue_unlock(pcap_queue);
-            if (queue_element == NULL) {
-                break;
-            }
-            g_log(LOG_DOMAIN_CAPTURE_CHILD, G_LOG_LEVEL_INFO,
-                  "Dequeued a packet of length %d captured on interface %d.",
-                  queue_element->phdr.caplen, queue_element->pcap_opts->interface_id);
-            capture_loop_write_packet_cb((u_char *)queue_element->pcap_opts,
-                                         &queue_element->phdr,
-                                         queue_element->pd);
-            g_free(queue_element->pd);
-            g_free(queue_element);
-            global_ld.inpkts_to_sync_pipe += 1;
+        while ((inpkts = capture_loop_write_queued_packets(TRUE)) > 0) {
+            global_ld.inpkts_to_sync_pipe += inpkts;
             if (capture_opts->output_to_pipe) {
                 fflush(global_ld.pdh);
             }
         }
+        for (i = 0; i < global_ld.pcaps->len; i++) {
+            pcap_opts = g_array_index(global_ld.pcaps, pcap_options *, i);
+            pcap_ring_free(&pcap_opts->ring);
+        }
+        g_async_queue_unref(pcap_writer_wakeup);
+        pcap_writer_wakeup = NULL;
     }
 
 
@@ -3812,6 +4223,10 @@ capture_loop_start(capture_options *capture_opts, gboolean *stats_known, struct
             report_packet_count(global_ld.inpkts_to_sync_pipe);
         global_ld.inpkts_to_sync_pipe = 0;
     }
+    if (shm_ring != NULL) {
+        shm_ring_unref(shm_ring);
+        shm_ring = NULL;
+    }
 
     /* If we've displayed a message about a write error, there's no point
        in displaying another message about an error on close. */
@@ -3889,6 +4304,12 @@ error:
     else
         report_capture_error(errmsg, secondary_errmsg);
 
+    /* free any queues we allocated; no capture thread has been started */
+    for (i = 0; i < global_ld.pcaps->len; i++) {
+        pcap_opts = g_array_index(global_ld.pcaps, pcap_options *, i);
+        pcap_ring_free(&pcap_opts->ring);
+    }
+
     /* close the input file (pcap or cap_pipe) */
     capture_loop_close_input(&global_ld);
 
@@ -3984,7 +4405,7 @@ capture_loop_write_packet_cb(u_char *pcap_opts_p, const struct pcap_pkthdr *phdr
            If this fails, set "ld->go" to FALSE, to stop the capture, and set
            "ld->err" to the error. */
         if (global_capture_opts.use_pcapng) {
-            successful = libpcap_write_enhanced_packet_block(libpcap_write_to_file, global_ld.pdh,
+            successful = libpcap_write_enhanced_packet_block(capture_loop_write_to_file, global_ld.pdh,
                                                              NULL,
                                                              phdr->ts.tv_sec, (gint32)phdr->ts.tv_usec,
                                                              phdr->caplen, phdr->len,
@@ -3993,7 +4414,7 @@ capture_loop_write_packet_cb(u_char *pcap_opts_p, const struct pcap_pkthdr *phdr
                                                              pd, 0,
                                                              &global_ld.bytes_written, &err);
         } else {
-            successful = libpcap_write_packet(libpcap_write_to_file, global_ld.pdh,
+            successful = libpcap_write_packet(capture_loop_write_to_file, global_ld.pdh,
                                               phdr->ts.tv_sec, (gint32)phdr->ts.tv_usec,
                                               phdr->caplen, phdr->len,
                                               pd,
@@ -4009,6 +4430,12 @@ capture_loop_write_packet_cb(u_char *pcap_opts_p, const struct pcap_pkthdr *phdr
                    phdr->caplen, pcap_opts->interface_id);
             global_ld.packet_count++;
             pcap_opts->received++;
+            if (flow_index != NULL) {
+                flowindex_builder_add(flow_index, pcap_opts->linktype,
+                                      phdr->ts.tv_sec,
+                                      pcap_opts->ts_nsec ? (guint32)phdr->ts.tv_usec : (guint32)phdr->ts.tv_usec * 1000,
+                                      phdr->caplen, phdr->len, pd);
+            }
             /* if the user told us to stop after x packets, do we already have enough? */
             if ((global_ld.packet_max > 0) && (global_ld.packet_count >= global_ld.packet_max)) {
                 global_ld.go = FALSE;
@@ -4022,9 +4449,7 @@ static void
 capture_loop_queue_packet_cb(u_char *pcap_opts_p, const struct pcap_pkthdr *phdr,
                              const u_char *pd)
 {
-    pcap_options       *pcap_opts = (pcap_options *) (void *) pcap_opts_p;
-    pcap_queue_element *queue_element;
-    gboolean            limit_reached;
+    pcap_options *pcap_opts = (pcap_options *) (void *) pcap_opts_p;
 
     /* We may be called multiple times from pcap_dispatch(); if we've set
        the "stop capturing" flag, ignore this packet, as we're not
@@ -4034,49 +4459,23 @@ capture_loop_queue_packet_cb(u_char *pcap_opts_p, const struct pcap_pkthdr *phdr
         return;
     }
 
-    queue_element = (pcap_queue_element *)g_malloc(sizeof(pcap_queue_element));
-    if (queue_element == NULL) {
-       pcap_opts->dropped++;
-       return;
-    }
-    queue_element->pcap_opts = pcap_opts;
-    queue_element->phdr = *phdr;
-    queue_element->pd = (u_char *)g_malloc(phdr->caplen);
-    if (queue_element->pd == NULL) {
-        pcap_opts->dropped++;
-        g_free(queue_element);
-        return;
-    }
-    memcpy(queue_element->pd, pd, phdr->caplen);
-    g_async_queue_lock(pcap_queue);
-    if (((pcap_queue_byte_limit == 0) || (pcap_queue_bytes < pcap_queue_byte_limit)) &&
-        ((pcap_queue_packet_limit == 0) || (pcap_queue_packets < pcap_queue_packet_limit))) {
-        limit_reached = FALSE;
-        g_async_queue_push_unlocked(pcap_queue, queue_element);
-        pcap_queue_bytes += phdr->caplen;
-        pcap_queue_packets += 1;
-    } else {
-        limit_reached = TRUE;
-    }
-    g_async_queue_unlock(pcap_queue);
-    if (limit_reached) {
+    if (!pcap_ring_put(&pcap_opts->ring, phdr, pd)) {
         pcap_opts->dropped++;
-        g_free(queue_element->pd);
-        g_free(queue_element);
         g_log(LOG_DOMAIN_CAPTURE_CHILD, G_LOG_LEVEL_INFO,
               "Dropped a packet of length %d captured on interface %u.",
               phdr->caplen, pcap_opts->interface_id);
-    } else {
-        pcap_opts->received++;
-        g_log(LOG_DOMAIN_CAPTURE_CHILD, G_LOG_LEVEL_INFO,
-              "Queued a packet of length %d captured on interface %u.",
-              phdr->caplen, pcap_opts->interface_id);
+        return;
     }
-    /* I don't want to hold the mutex over the debug output. So the
-       output may be wrong */
+    pcap_opts->received++;
     g_log(LOG_DOMAIN_CAPTURE_CHILD, G_LOG_LEVEL_INFO,
-          "Queue size is now %" G_GINT64_MODIFIER "d bytes (%" G_GINT64_MODIFIER "d packets)",
-          pcap_queue_bytes, pcap_queue_packets);
+          "Queued a packet of length %d captured on interface %u.",
+          phdr->caplen, pcap_opts->interface_id);
+
+    /* If the writer has run out of packets, wake it up. */
+    if (g_atomic_int_get(&pcap_writer_idle) &&
+        g_atomic_int_compare_and_exchange(&pcap_writer_idle, 1, 0)) {
+        g_async_queue_push(pcap_writer_wakeup, pcap_opts); /* Any non-NULL value will do */
+    }
 }
 
 static int
@@ -4132,6 +4531,7 @@ main(int argc, char *argv[])
     int               opt;
     struct option     long_options[] = {
         {(char *)"capture-comment", required_argument, NULL, LONGOPT_NUM_CAP_COMMENT },
+        {(char *)"shm-ring", required_argument, NULL, LONGOPT_NUM_SHM_RING },
         {0, 0, 0, 0 }
     };
 
@@ -4225,7 +4625,7 @@ main(int argc, char *argv[])
 #define OPTSTRING_d ""
 #endif
 
-#define OPTSTRING "a:" OPTSTRING_A "b:" OPTSTRING_B "C:c:" OPTSTRING_d "Df:ghi:" OPTSTRING_I "k:L" OPTSTRING_m "MN:npPq" OPTSTRING_r "Ss:t" OPTSTRING_u "vw:y:Z:"
+#define OPTSTRING "a:" OPTSTRING_A "b:" OPTSTRING_B "C:c:" OPTSTRING_d "Df:ghi:" OPTSTRING_I "k:L" OPTSTRING_m "MN:nO:pPq" OPTSTRING_r "Ss:t" OPTSTRING_u "vw:xy:Z:"
 
 #ifdef DEBUG_CHILD_DUMPCAP
     if ((debug_log = ws_fopen("dumpcap_debug_log.tmp","w")) == NULL) {
@@ -4590,6 +4990,16 @@ main(int argc, char *argv[])
         case 'N':
             pcap_queue_packet_limit = get_positive_int(optarg, "packet_limit");
             break;
+        case 'O':
+            pcap_order_window = get_natural_int(optarg, "order window");
+            break;
+        case 'x':        /* Write a flow index for each output file */
+            write_flow_index = TRUE;
+            break;
+        case LONGOPT_NUM_SHM_RING: /* Copy the capture data to a shared memory ring */
+            g_free(shm_ring_name);
+            shm_ring_name = g_strdup(optarg);
+            break;
         default:
             cmdarg_err("Invalid Option: %s", argv[optind-1]);
             /* FALLTHROUGH */
@@ -4951,6 +5361,10 @@ report_packet_count(unsigned int packet_count)
     char tmp[SP_DECISIZE+1+1];
     static unsigned int count = 0;
 
+    /* Our parent may read the packets as soon as it hears about them */
+    if (shm_ring != NULL)
+        shm_ring_flush(shm_ring);
+
     if (capture_child) {
         g_snprintf(tmp, sizeof(tmp), "%u", packet_count);
         g_log(LOG_DOMAIN_CAPTURE_CHILD, G_LOG_LEVEL_DEBUG, "Packets: %s", tmp);
@@ -4966,6 +5380,9 @@ report_packet_count(unsigned int packet_count)
 static void
 report_new_capture_file(const char *filename)
 {
+    if (shm_ring != NULL)
+        shm_ring_flush(shm_ring);
+
     if (capture_child) {
         g_log(LOG_DOMAIN_CAPTURE_CHILD, G_LOG_LEVEL_DEBUG, "File: %s", filename);
         pipe_write_block(2, SP_FILE, filename);
@@ -78,7 +78,9 @@
 #include <wsutil/privileges.h>
 #include <wsutil/report_err.h>
 #include <wsutil/strnatcmp.h>
-#include <wsutil/md5.h>
+#include <wsutil/murmur3.h>
+#include <wsutil/pktdedup.h>
+#include <wsutil/pktindex.h>
 
 /*
  * The symbols declared in the below are exported from libwireshark,
@@ -110,20 +112,24 @@ struct select_item {
 
 
 /*
- * Duplicate frame detection
+ * Duplicate frame detection: the digest of the packet being checked is
+ * looked up in a window of those of the packets before it.
  */
 typedef struct _fd_hash_t {
-  md5_byte_t digest[16];
+  guint8 digest[MURMUR3_128_LEN];
   guint32 len;
   nstime_t time;
 } fd_hash_t;
 
 #define DEFAULT_DUP_DEPTH 5     /* Used with -d */
-#define MAX_DUP_DEPTH 1000000   /* the maximum window (and actual size of fd_hash[]) for de-duplication */
+#define MAX_DUP_DEPTH 1000000   /* the maximum window (and size of the ring) for de-duplication */
 
-fd_hash_t fd_hash[MAX_DUP_DEPTH];
+static fd_hash_t cur_hash;      /* the packet being checked */
+static pktdedup_t *dup_pkts;    /* the packets before it in the window */
 int dup_window = DEFAULT_DUP_DEPTH;
-int cur_dup_entry = 0;
+static gboolean dup_mask_volatile = FALSE;  /* mask IP TTL/checksum when hashing */
+static guint8 *dup_mask_buf = NULL;
+static guint32 dup_mask_buf_len = 0;
 
 #define ONE_MILLION 1000000
 #define ONE_BILLION 1000000000
@@ -167,6 +173,18 @@ static gboolean check_startstop = FALSE;
 static gboolean dup_detect = FALSE;
 static gboolean dup_detect_by_time = FALSE;
 
+static guint32 index_stride = 0;             /* no packet index written */
+
+#define MAX_FLOW_FILES 1024
+/*
+ * Write-behind gives each output file a writer thread and two large
+ * buffers; only use it when splitting into a few files.
+ */
+#define MAX_WRITE_BEHIND_FLOW_FILES 8
+static guint flow_files = 0;                 /* don't split by flow */
+static wtap_dumper **flow_pdh = NULL;        /* one dumper per flow file */
+static gchar **flow_filenames = NULL;
+
 static int do_strict_time_adjustment = FALSE;
 static struct time_adjustment strict_time_adj = {{0, 0}, 0}; /* strict time adjustment */
 static nstime_t previous_time = {0, 0}; /* previous time */
@@ -321,6 +339,64 @@ selected(int recno)
 
 }
 
+/* The lowest and highest packet numbers a selection can match */
+static int
+first_selected(void)
+{
+  int i, first = 0;
+
+  for (i = 0; i <= max_selected; i++) {
+    if (first == 0 || selectfrm[i].first < first)
+      first = selectfrm[i].first;
+  }
+  return first;
+}
+
+static int
+last_selected(void)
+{
+  int i, last = 0;
+
+  for (i = 0; i <= max_selected; i++) {
+    if (selectfrm[i].inclusive) {
+      if (selectfrm[i].second > last)
+        last = selectfrm[i].second;
+    } else {
+      if (selectfrm[i].first > last)
+        last = selectfrm[i].first;
+    }
+  }
+  return last;
+}
+
+/*
+ * Set up a newly opened output file: buffer its writes, if asked to, and
+ * start writing a packet index for it if asked to
+ */
+static void
+setup_dumper(wtap_dumper *pdh, const char *filename, gboolean write_behind)
+{
+  int err;
+  gchar *index_filename;
+
+  if (write_behind && !wtap_dump_set_write_behind(pdh, &err)) {
+    fprintf(stderr, "editcap: Can't write to %s: %s\n",
+            filename, wtap_strerror(err));
+    exit(2);
+  }
+
+  if (index_stride == 0)
+    return;
+
+  index_filename = pktindex_filename(filename);
+  if (!wtap_dump_set_packet_index(pdh, index_filename, index_stride, &err)) {
+    fprintf(stderr, "editcap: Can't create packet index %s: %s\n",
+            index_filename, wtap_strerror(err));
+    exit(2);
+  }
+  g_free(index_filename);
+}
+
 /* is the packet in the selected timeframe */
 static gboolean
 check_timestamp(wtap *wth)
@@ -546,140 +622,352 @@ set_rel_time(char *optarg_str_p)
   relative_time_window.nsecs = (int)val;
 }
 
-static gboolean
-is_duplicate(guint8* fd, guint32 len) {
-  int i;
-  md5_state_t ms;
+/*
+ * Find the offset of the IP header in a packet, for the link-layer types
+ * where that's easy to do without dissecting it.  Returns -1 if there's
+ * no IPv4 or IPv6 header we can find.
+ */
+static int
+find_ip_header(int encap, const guint8 *pd, guint32 caplen)
+{
+  guint32 off;
+  guint16 etype;
+  guint32 af;
+
+  switch (encap) {
+
+  case WTAP_ENCAP_ETHERNET:
+    off = 12;
+    for (;;) {
+      if (caplen < off + 2)
+        return -1;
+      etype = (pd[off] << 8) | pd[off + 1];
+      if (etype != 0x8100 && etype != 0x88a8 && etype != 0x9100)
+        break;
+      off += 4;     /* skip the VLAN tag */
+    }
+    off += 2;
+    if (etype != 0x0800 && etype != 0x86dd)
+      return -1;
+    break;
+
+  case WTAP_ENCAP_SLL:
+    if (caplen < 16)
+      return -1;
+    etype = (pd[14] << 8) | pd[15];
+    if (etype != 0x0800 && etype != 0x86dd)
+      return -1;
+    off = 16;
+    break;
+
+  case WTAP_ENCAP_NULL:
+    /* Address family, in the byte order of the capturing host */
+    if (caplen < 4)
+      return -1;
+    af = pd[0] | (pd[1] << 8) | (pd[2] << 16) | ((guint32)pd[3] << 24);
+    if (af > 0xFFFF)
+      af = GUINT32_SWAP_LE_BE(af);
+    if (af != 2 && af != 24 && af != 28 && af != 30)
+      return -1;    /* AF_INET, or one of the BSDs' AF_INET6 values */
+    off = 4;
+    break;
+
+  case WTAP_ENCAP_RAW_IP:
+  case WTAP_ENCAP_RAW_IP4:
+  case WTAP_ENCAP_RAW_IP6:
+    off = 0;
+    break;
+
+  default:
+    return -1;
+  }
 
-  cur_dup_entry++;
-  if (cur_dup_entry >= dup_window)
-    cur_dup_entry = 0;
+  if (caplen <= off)
+    return -1;
+  switch (pd[off] >> 4) {
 
-  /* Calculate our digest */
-  md5_init(&ms);
-  md5_append(&ms, fd, len);
-  md5_finish(&ms, fd_hash[cur_dup_entry].digest);
+  case 4:
+    if (caplen < off + 20)
+      return -1;
+    break;
 
-  fd_hash[cur_dup_entry].len = len;
+  case 6:
+    if (caplen < off + 40)
+      return -1;
+    break;
 
-  /* Look for duplicates */
-  for (i = 0; i < dup_window; i++) {
-    if (i == cur_dup_entry)
-      continue;
+  default:
+    return -1;
+  }
+  return (int)off;
+}
+
+/*
+ * Fragmented datagrams: the fragments other than the first have no
+ * transport header, so the first fragment of a datagram seen decides the
+ * file all of them go to.  It's remembered, under the datagram's
+ * addresses, protocol and IP ID, until the fragments add up to the whole
+ * datagram or the slot is wanted for another one.
+ */
+#define FLOW_FRAG_SLOTS 4096
+#define FLOW_FRAG_KEY_LEN (1 + 2 * 16 + 4)
+typedef struct {
+  guint8 key[FLOW_FRAG_KEY_LEN];
+  guint32 key_len;      /* 0 if the slot is free */
+  guint32 hash;         /* what all the datagram's fragments hash to */
+  guint32 received;     /* fragment data seen so far */
+  guint32 total;        /* datagram length, once the last fragment is seen */
+} flow_frag_t;
+static flow_frag_t flow_frags[FLOW_FRAG_SLOTS];
+
+static guint32
+flow_digest(const guint8 *data, guint32 len)
+{
+  guint8 digest[MURMUR3_128_LEN];
+
+  murmur3_128(data, len, 0, digest);
+  return digest[0] | (digest[1] << 8) | (digest[2] << 16) | ((guint32)digest[3] << 24);
+}
+
+/*
+ * Return the hash for a fragment: that of the datagram's first fragment
+ * seen, which is "hash" (the flow's) if that's the fragment at offset 0,
+ * or the hash of the key otherwise.
+ */
+static guint32
+flow_frag_hash(const guint8 *key, guint32 key_len, guint32 hash,
+               guint32 frag_off, guint32 frag_len, gboolean more_frags)
+{
+  guint32 key_hash;
+  flow_frag_t *frag;
+
+  key_hash = flow_digest(key, key_len);
+  frag = &flow_frags[key_hash % FLOW_FRAG_SLOTS];
+  if (frag->key_len != key_len || memcmp(frag->key, key, key_len) != 0) {
+    memcpy(frag->key, key, key_len);
+    frag->key_len = key_len;
+    frag->hash = frag_off == 0 ? hash : key_hash;
+    frag->received = 0;
+    frag->total = 0;
+  }
+  hash = frag->hash;
+
+  frag->received += frag_len;
+  if (!more_frags)
+    frag->total = frag_off + frag_len;
+  if (frag->total != 0 && frag->received >= frag->total)
+    frag->key_len = 0;      /* all of it seen */
+  return hash;
+}
 
-    if (fd_hash[i].len == fd_hash[cur_dup_entry].len &&
-        memcmp(fd_hash[i].digest, fd_hash[cur_dup_entry].digest, 16) == 0) {
-      return TRUE;
+/*
+ * Hash a packet's flow: IP protocol and addresses, and, for TCP and UDP,
+ * ports.  Both directions of a flow hash to the same value, and all the
+ * fragments of a datagram go with the first one seen (see flow_frag_hash()).
+ * Packets we can't find an IP header in all hash to 0.
+ */
+static guint32
+flow_hash(int encap, const guint8 *pd, guint32 caplen)
+{
+  int ip_off;
+  guint32 off, addr_len, next_off, hdr_len, data_len;
+  guint32 frag_off = 0, frag_len = 0, frag_id = 0;
+  gboolean fragmented = FALSE, more_frags = FALSE, have_ports;
+  const guint8 *src, *dst, *sport, *dport;
+  guint8 proto, frag_proto = 0;
+  guint8 tuple[1 + 2 * 16 + 2 * 2];
+  guint8 key[FLOW_FRAG_KEY_LEN];
+  guint32 tuple_len, hash;
+  int order;
+
+  ip_off = find_ip_header(encap, pd, caplen);
+  if (ip_off == -1)
+    return 0;
+  off = (guint32)ip_off;
+
+  if ((pd[off] >> 4) == 4) {
+    addr_len = 4;
+    proto = pd[off + 9];
+    src = pd + off + 12;
+    dst = pd + off + 16;
+    frag_proto = proto;
+    hdr_len = (pd[off] & 0x0F) * 4;
+    next_off = off + hdr_len;
+    frag_off = (((pd[off + 6] << 8) | pd[off + 7]) & 0x1FFF) * 8;
+    more_frags = (pd[off + 6] & 0x20) != 0;
+    if (frag_off != 0 || more_frags) {
+      fragmented = TRUE;
+      frag_id = (pd[off + 4] << 8) | pd[off + 5];
+      data_len = (pd[off + 2] << 8) | pd[off + 3];
+      frag_len = data_len > hdr_len ? data_len - hdr_len : 0;
+    }
+  } else {
+    addr_len = 16;
+    proto = pd[off + 6];
+    src = pd + off + 8;
+    dst = pd + off + 24;
+    next_off = off + 40;
+    /*
+     * Skip the extension headers, so that unfragmented packets and
+     * first fragments get the upper-layer protocol; past the fragment
+     * header of a later fragment there's only data.
+     */
+    for (;;) {
+      if (proto == 0 || proto == 43 || proto == 60) {
+        /* Hop-by-hop options, routing, destination options */
+        if (caplen < next_off + 2)
+          break;
+        proto = pd[next_off];
+        next_off += (pd[next_off + 1] + 1) * 8;
+      } else if (proto == 44 && !fragmented) {
+        /* Fragment */
+        if (caplen < next_off + 8)
+          break;
+        proto = pd[next_off];
+        frag_proto = proto;
+        frag_off = ((pd[next_off + 2] << 8) | pd[next_off + 3]) & 0xFFF8;
+        more_frags = (pd[next_off + 3] & 0x01) != 0;
+        frag_id = ((guint32)pd[next_off + 4] << 24) | (pd[next_off + 5] << 16) |
+                  (pd[next_off + 6] << 8) | pd[next_off + 7];
+        next_off += 8;
+        if (frag_off != 0 || more_frags) {
+          fragmented = TRUE;
+          data_len = 40 + ((pd[off + 4] << 8) | pd[off + 5]);
+          frag_len = data_len > next_off - off ? data_len - (next_off - off) : 0;
+          if (frag_off != 0)
+            break;
+        }
+      } else
+        break;
+    }
+  }
+  /* Put the lower address (and its port) first, so both directions hash
+     the same */
+  have_ports = (proto == 6 || proto == 17) && frag_off == 0 &&
+               caplen >= next_off + 4;
+  sport = pd + next_off;
+  dport = pd + next_off + 2;
+  order = memcmp(src, dst, addr_len);
+  if (order == 0 && have_ports)
+    order = memcmp(sport, dport, 2);
+  tuple[0] = proto;
+  if (order > 0) {
+    memcpy(tuple + 1, dst, addr_len);
+    memcpy(tuple + 1 + addr_len, src, addr_len);
+  } else {
+    memcpy(tuple + 1, src, addr_len);
+    memcpy(tuple + 1 + addr_len, dst, addr_len);
+  }
+  tuple_len = 1 + 2 * addr_len;
+  if (have_ports) {
+    memcpy(tuple + tuple_len, order > 0 ? dport : sport, 2);
+    memcpy(tuple + tuple_len + 2, order > 0 ? sport : dport, 2);
+    tuple_len += 4;
+  }
+  hash = flow_digest(tuple, tuple_len);
+  if (!fragmented)
+    return hash;
+
+  key[0] = frag_proto;
+  memcpy(key + 1, src, addr_len);
+  memcpy(key + 1 + addr_len, dst, addr_len);
+  key[1 + 2 * addr_len] = (guint8)(frag_id >> 24);
+  key[2 + 2 * addr_len] = (guint8)(frag_id >> 16);
+  key[3 + 2 * addr_len] = (guint8)(frag_id >> 8);
+  key[4 + 2 * addr_len] = (guint8)frag_id;
+  return flow_frag_hash(key, 1 + 2 * addr_len + 4, hash, frag_off, frag_len,
+                        more_frags);
+}
+
+/* Compute the digest of a packet into cur_hash */
+static void
+dup_digest(const guint8* fd, guint32 len, int encap)
+{
+  int ip_off;
+
+  if (dup_mask_volatile && (ip_off = find_ip_header(encap, fd, len)) != -1) {
+    /*
+     * Routers on the way can decrement the TTL (and so change the
+     * header checksum) of a packet we see twice; hash a copy with
+     * those fields zeroed.
+     */
+    if (dup_mask_buf_len < len) {
+      dup_mask_buf_len = len;
+      dup_mask_buf = (guint8 *)g_realloc(dup_mask_buf, dup_mask_buf_len);
+    }
+    memcpy(dup_mask_buf, fd, len);
+    if ((fd[ip_off] >> 4) == 4) {
+      dup_mask_buf[ip_off + 8] = 0;     /* TTL */
+      dup_mask_buf[ip_off + 10] = 0;    /* header checksum */
+      dup_mask_buf[ip_off + 11] = 0;
+    } else {
+      dup_mask_buf[ip_off + 7] = 0;     /* hop limit */
     }
+    fd = dup_mask_buf;
   }
 
-  return FALSE;
+  murmur3_128(fd, len, 0, cur_hash.digest);
+  cur_hash.len = len;
 }
 
-static gboolean
-is_duplicate_rel_time(guint8* fd, guint32 len, const nstime_t *current) {
-  int i;
-  md5_state_t ms;
+static void
+dup_init(int window)
+{
+  /* The window holds the packets before the current one. */
+  dup_pkts = pktdedup_new(window > 1 ? (guint32)(window - 1) : 0);
+}
 
-  cur_dup_entry++;
-  if (cur_dup_entry >= dup_window)
-    cur_dup_entry = 0;
+static gboolean
+is_duplicate(guint8* fd, guint32 len, int encap) {
+  gboolean found;
 
   /* Calculate our digest */
-  md5_init(&ms);
-  md5_append(&ms, fd, len);
-  md5_finish(&ms, fd_hash[cur_dup_entry].digest);
+  dup_digest(fd, len, encap);
+  nstime_set_unset(&cur_hash.time);
 
-  fd_hash[cur_dup_entry].len = len;
-  fd_hash[cur_dup_entry].time.secs = current->secs;
-  fd_hash[cur_dup_entry].time.nsecs = current->nsecs;
+  /* Look for duplicates */
+  found = pktdedup_find(dup_pkts, cur_hash.digest, cur_hash.len, NULL);
+
+  pktdedup_add(dup_pkts, cur_hash.digest, cur_hash.len, &cur_hash.time);
+  return found;
+}
+
+static gboolean
+is_duplicate_rel_time(guint8* fd, guint32 len, int encap, const nstime_t *current) {
+  nstime_t delta, latest;
+  gboolean found = FALSE;
+
+  /* Calculate our digest */
+  dup_digest(fd, len, encap);
+  cur_hash.time.secs = current->secs;
+  cur_hash.time.nsecs = current->nsecs;
 
   /*
-   * Look for relative time related duplicates.
-   * This is hopefully a reasonably efficient mechanism for
-   * finding duplicates by rel time in the fd_hash[] cache.
-   * We check starting from the most recently added hash
-   * entries and work backwards towards older packets.
-   * This approach allows the dup test to be terminated
-   * when the relative time of a cached entry is found to
-   * be beyond the dup time window.
+   * Drop the packets that are now beyond the dup time window.
    *
    * Of course this assumes that the input trace file is
    * "well-formed" in the sense that the packet timestamps are
    * in strict chronologically increasing order (which is NOT
-   * always the case!!).
-   *
-   * The fd_hash[] table was deliberatly created large (1,000,000).
-   * Looking for time related duplicates in large trace files with
-   * non-fractional dup time window values can potentially take
-   * a long time to complete.
+   * always the case!!); an out-of-order packet can keep older
+   * ones in the window a little longer.
    */
-
-  for (i = cur_dup_entry - 1;; i--) {
-    nstime_t delta;
-    int cmp;
-
-    if (i < 0) {
-      i = dup_window - 1;
-    }
-
-    if (i == cur_dup_entry) {
-      /*
-       * We've decremented back to where we started.
-       * Check no more!
-       */
-      break;
-    }
-
-    if (nstime_is_unset(&(fd_hash[i].time))) {
-      /*
-       * We've decremented to an unused fd_hash[] entry.
-       * Check no more!
-       */
-      break;
-    }
-
-    nstime_delta(&delta, current, &fd_hash[i].time);
-
-    if(delta.secs < 0 || delta.nsecs < 0)
-    {
-      /*
-       * A negative delta implies that the current packet
-       * has an absolute timestamp less than the cached packet
-       * that it is being compared to.  This is NOT a normal
-       * situation since trace files usually have packets in
-       * chronological order (oldest to newest).
-       *
-       * There are several possible ways to deal with this:
-       * 1. 'continue' dup checking with the next cached frame.
-       * 2. 'break' from looking for a duplicate of the current frame.
-       * 3. Take the absolute value of the delta and see if that
-       * falls within the specifed dup time window.
-       *
-       * Currently this code does option 1.  But it would pretty
-       * easy to add yet-another-editcap-option to select one of
-       * the other behaviors for dealing with out-of-sequence
-       * packets.
-       */
-      continue;
-    }
-
-    cmp = nstime_cmp(&delta, &relative_time_window);
-
-    if(cmp > 0) {
-      /*
-       * The delta time indicates that we are now looking at
-       * cached packets beyond the specified dup time window.
-       * Check no more!
-       */
-      break;
-    } else if (fd_hash[i].len == fd_hash[cur_dup_entry].len &&
-          memcmp(fd_hash[i].digest, fd_hash[cur_dup_entry].digest, 16) == 0) {
-      return TRUE;
-    }
+  pktdedup_expire(dup_pkts, current, &relative_time_window);
+
+  if (pktdedup_find(dup_pkts, cur_hash.digest, cur_hash.len, &latest)) {
+    /*
+     * A negative delta implies that the current packet has an
+     * absolute timestamp less than the cached packet that it is
+     * being compared to; as before, such a packet isn't considered
+     * a duplicate.
+     */
+    nstime_delta(&delta, current, &latest);
+    if (delta.secs >= 0 && delta.nsecs >= 0 &&
+        nstime_cmp(&delta, &relative_time_window) <= 0)
+      found = TRUE;
   }
 
-  return FALSE;
+  pktdedup_add(dup_pkts, cur_hash.digest, cur_hash.len, &cur_hash.time);
+  return found;
 }
 
 static void
@@ -717,11 +1005,13 @@ usage(gboolean is_error)
   fprintf(output, "  -D <dup window>        remove packet if duplicate; configurable <dup window>\n");
   fprintf(output, "                         Valid <dup window> values are 0 to %d.\n", MAX_DUP_DEPTH);
   fprintf(output, "                         NOTE: A <dup window> of 0 with -v (verbose option) is\n");
-  fprintf(output, "                         useful to print MD5 hashes.\n");
+  fprintf(output, "                         useful to print packet hashes.\n");
   fprintf(output, "  -w <dup time window>   remove packet if duplicate packet is found EQUAL TO OR\n");
   fprintf(output, "                         LESS THAN <dup time window> prior to current packet.\n");
   fprintf(output, "                         A <dup time window> is specified in relative seconds\n");
   fprintf(output, "                         (e.g. 0.000001).\n");
+  fprintf(output, "  -M                     ignore the IPv4 TTL and header checksum, and the IPv6\n");
+  fprintf(output, "                         hop limit, when comparing packets for -d, -D or -w.\n");
   fprintf(output, "\n");
   fprintf(output, "           NOTE: The use of the 'Duplicate packet removal' options with\n");
   fprintf(output, "           other editcap options except -v may not always work as expected.\n");
@@ -754,18 +1044,26 @@ usage(gboolean is_error)
   fprintf(output, "  -i <seconds per file>  split the packet output to different files based on\n");
   fprintf(output, "                         uniform time intervals with a maximum of\n");
   fprintf(output, "                         <seconds per file> each.\n");
+  fprintf(output, "  -H <flow files>        split the packet output to <flow files> files, by a\n");
+  fprintf(output, "                         hash of each packet's addresses, protocol and\n");
+  fprintf(output, "                         TCP or UDP ports, so that all packets of a flow,\n");
+  fprintf(output, "                         in both directions, go to the same file.\n");
   fprintf(output, "  -F <capture type>      set the output file type; default is pcapng. An empty\n");
   fprintf(output, "                         \"-F\" option will list the file types.\n");
   fprintf(output, "  -T <encap type>        set the output file encapsulation type; default is the\n");
   fprintf(output, "                         same as the input file. An empty \"-T\" option will\n");
   fprintf(output, "                         list the encapsulation types.\n");
+  fprintf(output, "  -I <index stride>      also write a packet index (<outfile>%s) with an\n", PKTINDEX_FILE_SUFFIX);
+  fprintf(output, "                         entry every <index stride> packets (pcap and pcapng\n");
+  fprintf(output, "                         only). When keeping selected packets with -r, the\n");
+  fprintf(output, "                         index of <infile> is used to skip to the first one.\n");
   fprintf(output, "\n");
   fprintf(output, "Miscellaneous:\n");
   fprintf(output, "  -h                     display this help and exit.\n");
   fprintf(output, "  -v                     verbose output.\n");
   fprintf(output, "                         If -v is used with any of the 'Duplicate Packet\n");
   fprintf(output, "                         Removal' options (-d, -D or -w) then Packet lengths\n");
-  fprintf(output, "                         and MD5 hashes are printed to standard-out.\n");
+  fprintf(output, "                         and hashes are printed to standard-out.\n");
   fprintf(output, "\n");
 }
 
@@ -873,11 +1171,13 @@ main(int argc, char *argv[])
   wtapng_iface_descriptions_t *idb_inf;
   guint8 *buf;
   guint32 read_count = 0;
+  guint flow_file = 0;
   int split_packet_count = 0;
   int written_count = 0;
   char *filename = NULL;
   gboolean ts_okay = TRUE;
   int secs_per_block = 0;
+  int last_frame = 0;
   int block_cnt = 0;
   nstime_t block_start;
   gchar *fprefix = NULL;
@@ -910,7 +1210,7 @@ main(int argc, char *argv[])
 #endif
 
   /* Process the options */
-  while ((opt = getopt(argc, argv, "A:B:c:C:dD:E:F:hi:Lrs:S:t:T:vw:")) !=-1) {
+  while ((opt = getopt(argc, argv, "A:B:c:C:dD:E:F:hH:i:I:LMrs:S:t:T:vw:")) !=-1) {
     switch (opt) {
     case 'A':
     {
@@ -1019,6 +1319,15 @@ main(int argc, char *argv[])
       }
       break;
 
+    case 'H':
+      flow_files = (guint)strtoul(optarg, &p, 10);
+      if (p == optarg || *p != '\0' || flow_files < 1 || flow_files > MAX_FLOW_FILES) {
+        fprintf(stderr, "editcap: \"%s\" isn't a valid number of flow files; it must be between 1 and %d\n",
+            optarg, MAX_FLOW_FILES);
+        exit(1);
+      }
+      break;
+
     case 'h':
       usage(FALSE);
       exit(1);
@@ -1032,10 +1341,23 @@ main(int argc, char *argv[])
         }
       break;
 
+    case 'I':
+      index_stride = (guint32)strtoul(optarg, &p, 10);
+      if (p == optarg || *p != '\0' || index_stride == 0) {
+        fprintf(stderr, "editcap: \"%s\" isn't a valid packet index stride\n",
+            optarg);
+        exit(1);
+      }
+      break;
+
     case 'L':
       adjlen = TRUE;
       break;
 
+    case 'M':
+      dup_mask_volatile = TRUE;
+      break;
+
     case 'r':
       keep_em = !keep_em;  /* Just invert */
       break;
@@ -1130,6 +1452,12 @@ main(int argc, char *argv[])
     exit(1);
   }
 
+  if (flow_files > 0 && (split_packet_count > 0 || secs_per_block > 0)) {
+    fprintf(stderr, "editcap: can't split by flow and by packet count or time interval\n");
+    fprintf(stderr, "editcap: at the same time\n");
+    exit(1);
+  }
+
   wth = wtap_open_offline(argv[optind], &err, &err_info, FALSE);
 
   if (!wth) {
@@ -1170,15 +1498,39 @@ main(int argc, char *argv[])
       if (add_selection(argv[i]) == FALSE)
         break;
 
-    if (dup_detect || dup_detect_by_time) {
-      for (i = 0; i < dup_window; i++) {
-        memset(&fd_hash[i].digest, 0, 16);
-        fd_hash[i].len = 0;
-        nstime_set_unset(&fd_hash[i].time);
+    if (dup_detect || dup_detect_by_time)
+      dup_init(dup_window);
+
+    /*
+     * If we're only keeping selected packets, none of the packets
+     * before the first selected one will be written, so, if there's
+     * a packet index for the input file, skip straight to the
+     * neighbourhood of that packet, and stop after the last one.
+     */
+    if (keep_em && max_selected >= 0) {
+      last_frame = last_selected();
+      if (wtap_attach_packet_index(wth, NULL, argv[optind], &err)) {
+        guint32 found_frame;
+
+        if (!wtap_seek_to_frame(wth, first_selected(), &found_frame, &err)) {
+          fprintf(stderr, "editcap: Can't seek in %s: %s\n", argv[optind],
+                  wtap_strerror(err));
+          exit(2);
+        }
+        if (verbose && found_frame > 1)
+          fprintf(stderr, "Skipped to packet %u using the packet index.\n",
+                  found_frame);
+        count = found_frame;
+        read_count = found_frame - 1;
       }
     }
 
     while (wtap_read(wth, &err, &err_info, &data_offset)) {
+      if (last_frame > 0 && count > (unsigned int)last_frame) {
+        /* Nothing more can be selected */
+        err = 0;
+        break;
+      }
       read_count++;
 
       phdr = wtap_phdr(wth);
@@ -1188,12 +1540,13 @@ main(int argc, char *argv[])
         block_start.secs = phdr->ts.secs;
         block_start.nsecs = phdr->ts.nsecs;
 
-        if (split_packet_count > 0 || secs_per_block > 0) {
+        if (split_packet_count > 0 || secs_per_block > 0 || flow_files > 0) {
           if (!fileset_extract_prefix_suffix(argv[optind+1], &fprefix, &fsuffix))
               exit(2);
-
+        }
+        if (split_packet_count > 0 || secs_per_block > 0)
           filename = fileset_get_filename_by_pattern(block_cnt++, &phdr->ts, fprefix, fsuffix);
-        } else
+        else
           filename = g_strdup(argv[optind+1]);
 
         /* If we don't have an application name add Editcap */
@@ -1202,14 +1555,36 @@ main(int argc, char *argv[])
           shb_hdr->shb_user_appl = appname;
         }
 
-        pdh = wtap_dump_open_ng(filename, out_file_type, out_frame_type,
-          snaplen ? MIN(snaplen, wtap_snapshot_length(wth)) : wtap_snapshot_length(wth),
-          FALSE /* compressed */, shb_hdr, idb_inf, &err);
+        if (flow_files > 0) {
+          /* Open all the flow files up front; packets go to them by hash */
+          flow_pdh = g_new(wtap_dumper *, flow_files);
+          flow_filenames = g_new(gchar *, flow_files);
+          for (i = 0; i < (int)flow_files; i++) {
+            flow_filenames[i] = g_strdup_printf("%s_flow%05d%s", fprefix, i,
+                                                fsuffix ? fsuffix : "");
+            flow_pdh[i] = wtap_dump_open_ng(flow_filenames[i], out_file_type, out_frame_type,
+              snaplen ? MIN(snaplen, wtap_snapshot_length(wth)) : wtap_snapshot_length(wth),
+              FALSE /* compressed */, shb_hdr, idb_inf, &err);
+            if (flow_pdh[i] == NULL) {
+              fprintf(stderr, "editcap: Can't open or create %s: %s\n", flow_filenames[i],
+                      wtap_strerror(err));
+              exit(2);
+            }
+            setup_dumper(flow_pdh[i], flow_filenames[i],
+                         flow_files <= MAX_WRITE_BEHIND_FLOW_FILES);
+          }
+          pdh = flow_pdh[0];
+        } else {
+          pdh = wtap_dump_open_ng(filename, out_file_type, out_frame_type,
+            snaplen ? MIN(snaplen, wtap_snapshot_length(wth)) : wtap_snapshot_length(wth),
+            FALSE /* compressed */, shb_hdr, idb_inf, &err);
 
-        if (pdh == NULL) {
-          fprintf(stderr, "editcap: Can't open or create %s: %s\n", filename,
-                  wtap_strerror(err));
-          exit(2);
+          if (pdh == NULL) {
+            fprintf(stderr, "editcap: Can't open or create %s: %s\n", filename,
+                    wtap_strerror(err));
+            exit(2);
+          }
+          setup_dumper(pdh, filename, TRUE);
         }
       }
 
@@ -1243,6 +1618,7 @@ main(int argc, char *argv[])
               wtap_strerror(err));
             exit(2);
           }
+          setup_dumper(pdh, filename, TRUE);
         }
       }
 
@@ -1273,6 +1649,7 @@ main(int argc, char *argv[])
                 wtap_strerror(err));
             exit(2);
           }
+          setup_dumper(pdh, filename, TRUE);
         }
       }
 
@@ -1428,11 +1805,11 @@ main(int argc, char *argv[])
 
         /* suppress duplicates by packet window */
         if (dup_detect) {
-          if (is_duplicate(buf, phdr->caplen)) {
+          if (is_duplicate(buf, phdr->caplen, phdr->pkt_encap)) {
             if (verbose) {
-              fprintf(stdout, "Skipped: %u, Len: %u, MD5 Hash: ", count, phdr->caplen);
-              for (i = 0; i < 16; i++) {
-                fprintf(stdout, "%02x", (unsigned char)fd_hash[cur_dup_entry].digest[i]);
+              fprintf(stdout, "Skipped: %u, Len: %u, Hash: ", count, phdr->caplen);
+              for (i = 0; i < MURMUR3_128_LEN; i++) {
+                fprintf(stdout, "%02x", (unsigned char)cur_hash.digest[i]);
               }
               fprintf(stdout, "\n");
             }
@@ -1441,9 +1818,9 @@ main(int argc, char *argv[])
             continue;
           } else {
             if (verbose) {
-              fprintf(stdout, "Packet: %u, Len: %u, MD5 Hash: ", count, phdr->caplen);
-              for (i = 0; i < 16; i++) {
-                fprintf(stdout, "%02x", (unsigned char)fd_hash[cur_dup_entry].digest[i]);
+              fprintf(stdout, "Packet: %u, Len: %u, Hash: ", count, phdr->caplen);
+              for (i = 0; i < MURMUR3_128_LEN; i++) {
+                fprintf(stdout, "%02x", (unsigned char)cur_hash.digest[i]);
               }
               fprintf(stdout, "\n");
             }
@@ -1457,11 +1834,11 @@ main(int argc, char *argv[])
           current.secs = phdr->ts.secs;
           current.nsecs = phdr->ts.nsecs;
 
-          if (is_duplicate_rel_time(buf, phdr->caplen, &current)) {
+          if (is_duplicate_rel_time(buf, phdr->caplen, phdr->pkt_encap, &current)) {
             if (verbose) {
-              fprintf(stdout, "Skipped: %u, Len: %u, MD5 Hash: ", count, phdr->caplen);
-              for (i = 0; i < 16; i++) {
-                fprintf(stdout, "%02x", (unsigned char)fd_hash[cur_dup_entry].digest[i]);
+              fprintf(stdout, "Skipped: %u, Len: %u, Hash: ", count, phdr->caplen);
+              for (i = 0; i < MURMUR3_128_LEN; i++) {
+                fprintf(stdout, "%02x", (unsigned char)cur_hash.digest[i]);
               }
               fprintf(stdout, "\n");
             }
@@ -1470,9 +1847,9 @@ main(int argc, char *argv[])
             continue;
           } else {
             if (verbose) {
-              fprintf(stdout, "Packet: %u, Len: %u, MD5 Hash: ", count, phdr->caplen);
-              for (i = 0; i < 16; i++) {
-                fprintf(stdout, "%02x", (unsigned char)fd_hash[cur_dup_entry].digest[i]);
+              fprintf(stdout, "Packet: %u, Len: %u, Hash: ", count, phdr->caplen);
+              for (i = 0; i < MURMUR3_128_LEN; i++) {
+                fprintf(stdout, "%02x", (unsigned char)cur_hash.digest[i]);
               }
               fprintf(stdout, "\n");
             }
@@ -1529,7 +1906,25 @@ main(int argc, char *argv[])
           }
         }
 
-        if (!wtap_dump(pdh, phdr, buf, &err)) {
+        if (flow_files > 0) {
+          flow_file = flow_hash(phdr->pkt_encap, buf, phdr->caplen) % flow_files;
+          pdh = flow_pdh[flow_file];
+        }
+
+        /*
+         * If nothing about the record was changed, and the output file
+         * can take the input file's records as they are, copy the record
+         * straight from the input file rather than re-encoding it.
+         */
+        if (phdr == wtap_phdr(wth) && buf == wtap_buf_ptr(wth) &&
+            err_prob == 0.0 && wtap_dump_can_copy_records(pdh, wth)) {
+          if (!wtap_dump_copy_record(pdh, wth, data_offset, &err)) {
+            fprintf(stderr, "editcap: Error writing to %s: %s\n",
+                    flow_files > 0 ? flow_filenames[flow_file] : filename,
+                    wtap_strerror(err));
+            exit(2);
+          }
+        } else if (!wtap_dump(pdh, phdr, buf, &err)) {
           switch (err) {
 
           case WTAP_ERR_UNSUPPORTED_ENCAP:
@@ -1543,7 +1938,8 @@ main(int argc, char *argv[])
 
           default:
             fprintf(stderr, "editcap: Error writing to %s: %s\n",
-                    filename, wtap_strerror(err));
+                    flow_files > 0 ? flow_filenames[flow_file] : filename,
+                    wtap_strerror(err));
             break;
           }
           exit(2);
@@ -1586,12 +1982,24 @@ main(int argc, char *argv[])
         wtap_strerror(err));
         exit(2);
       }
+      setup_dumper(pdh, filename, TRUE);
     }
 
     g_free(idb_inf);
     idb_inf = NULL;
 
-    if (!wtap_dump_close(pdh, &err)) {
+    if (flow_pdh != NULL) {
+      for (i = 0; i < (int)flow_files; i++) {
+        if (!wtap_dump_close(flow_pdh[i], &err)) {
+          fprintf(stderr, "editcap: Error writing to %s: %s\n", flow_filenames[i],
+              wtap_strerror(err));
+          exit(2);
+        }
+        g_free(flow_filenames[i]);
+      }
+      g_free(flow_pdh);
+      g_free(flow_filenames);
+    } else if (!wtap_dump_close(pdh, &err)) {
 
       fprintf(stderr, "editcap: Error writing to %s: %s\n", filename,
           wtap_strerror(err));
@@ -40,6 +40,7 @@ struct _dfilter_t {
 	int		*interesting_fields;
 	int		num_interesting_fields;
 	GPtrArray	*deprecated;
+	guint		refs;	/* held by callers and by the compile cache */
 };
 
 typedef struct {
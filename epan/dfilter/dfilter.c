@@ -48,6 +48,22 @@ int     df_lex(void);
 /* Holds the singular instance of our Lemon parser object */
 static void*	ParserObj = NULL;
 
+/* Filters compiled recently, most recently used first.  Compiling a
+ * filter that's already here (the filter being typed and then applied,
+ * the same filter in coloring rules, taps or filter buttons) just adds a
+ * reference to it.  They're keyed by their text after macro expansion,
+ * so that editing a macro doesn't give back a stale filter.  Only
+ * successful compiles are kept. */
+#define DFILTER_CACHE_MAX	64
+
+typedef struct {
+	gchar		*text;
+	dfilter_t	*df;
+} dfilter_cache_entry_t;
+
+static GHashTable	*dfilter_cache = NULL;	/* text -> link in dfilter_cache_lru */
+static GQueue		dfilter_cache_lru = G_QUEUE_INIT;
+
 void
 dfilter_fail(const char *format, ...)
 {
@@ -96,6 +112,8 @@ dfilter_init(void)
 void
 dfilter_cleanup(void)
 {
+	dfilter_cache_clear();
+
 	/* Free the Lemon Parser object */
 	if (ParserObj) {
 		DfilterFree(ParserObj, g_free);
@@ -113,6 +131,7 @@ dfilter_new(void)
 	df = g_new0(dfilter_t, 1);
 	df->insns = NULL;
     df->deprecated = NULL;
+	df->refs = 1;
 
 	return df;
 }
@@ -140,6 +159,10 @@ dfilter_free(dfilter_t *df)
 	if (!df)
 		return;
 
+	/* Other callers, or the compile cache, may still be using it */
+	if (--df->refs > 0)
+		return;
+
 	if (df->insns) {
 		free_insns(df->insns);
 	}
@@ -170,6 +193,75 @@ dfilter_free(dfilter_t *df)
 }
 
 
+static void
+dfilter_cache_remove_link(GList *link)
+{
+	dfilter_cache_entry_t *entry = (dfilter_cache_entry_t *)link->data;
+
+	g_hash_table_remove(dfilter_cache, entry->text);
+	g_queue_delete_link(&dfilter_cache_lru, link);
+	dfilter_free(entry->df);
+	g_free(entry->text);
+	g_free(entry);
+}
+
+/* Return a new reference to the filter compiled from the (macro-expanded)
+ * text, if it's in the cache. */
+static dfilter_t *
+dfilter_cache_lookup(const gchar *text)
+{
+	GList *link;
+	dfilter_cache_entry_t *entry;
+
+	if (!dfilter_cache)
+		return NULL;
+
+	link = (GList *)g_hash_table_lookup(dfilter_cache, text);
+	if (!link)
+		return NULL;
+
+	/* Move it to the front, as the most recently used */
+	g_queue_unlink(&dfilter_cache_lru, link);
+	g_queue_push_head_link(&dfilter_cache_lru, link);
+
+	entry = (dfilter_cache_entry_t *)link->data;
+	entry->df->refs++;
+	return entry->df;
+}
+
+static void
+dfilter_cache_add(const gchar *text, dfilter_t *df)
+{
+	dfilter_cache_entry_t *entry;
+
+	if (!dfilter_cache)
+		dfilter_cache = g_hash_table_new(g_str_hash, g_str_equal);
+
+	entry = g_new(dfilter_cache_entry_t, 1);
+	entry->text = g_strdup(text);
+	entry->df = df;
+	df->refs++;
+
+	g_queue_push_head(&dfilter_cache_lru, entry);
+	g_hash_table_insert(dfilter_cache, entry->text, dfilter_cache_lru.head);
+
+	while (dfilter_cache_lru.length > DFILTER_CACHE_MAX)
+		dfilter_cache_remove_link(dfilter_cache_lru.tail);
+}
+
+void
+dfilter_cache_clear(void)
+{
+	while (dfilter_cache_lru.tail)
+		dfilter_cache_remove_link(dfilter_cache_lru.tail);
+
+	if (dfilter_cache) {
+		g_hash_table_destroy(dfilter_cache);
+		dfilter_cache = NULL;
+	}
+}
+
+
 static dfwork_t*
 dfwork_new(void)
 {
@@ -232,6 +324,11 @@ dfilter_compile(const gchar *text, dfilter_t **dfp)
 		return FALSE;
 	}
 
+	if ((dfilter = dfilter_cache_lookup(text)) != NULL) {
+		*dfp = dfilter;
+		return TRUE;
+	}
+
 	dfw = dfwork_new();
 
 	df_scanner_text(text);
@@ -347,6 +444,9 @@ dfilter_compile(const gchar *text, dfilter_t **dfp)
 		/* Add any deprecated items */
 		dfilter->deprecated = deprecated;
 
+		/* Keep it for the next compile of the same text */
+		dfilter_cache_add(text, dfilter);
+
 		/* And give it to the user. */
 		*dfp = dfilter;
 	}
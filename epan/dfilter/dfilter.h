@@ -56,18 +56,29 @@ dfilter_cleanup(void);
  * dfilter_compile() will clear it. The dfilter*
  * will be set to NULL after a failure.
  *
+ * Recently compiled filters are cached, keyed by their text after
+ * macro expansion; compiling the same text again returns the same
+ * dfilter_t, with a new reference to it.
+ *
  * Returns TRUE on success, FALSE on failure.
  */
 WS_DLL_PUBLIC
 gboolean
 dfilter_compile(const gchar *text, dfilter_t **dfp);
 
-/* Frees all memory used by dfilter, and frees
+/* Drops a reference to a dfilter obtained from dfilter_compile();
+ * the last one frees all memory used by the dfilter, and frees
  * the dfilter itself. */
 WS_DLL_PUBLIC
 void
 dfilter_free(dfilter_t *df);
 
+/* Empties the cache of compiled filters, e.g. when the fields they
+ * refer to may have changed. Filters still in use aren't affected. */
+WS_DLL_PUBLIC
+void
+dfilter_cache_clear(void);
+
 
 /* dfilter_error_msg is NULL if there was no error during dfilter_compile,
  * otherwise it points to a displayable error message. With MSVC and a
@@ -24,6 +24,8 @@
 
 #include "config.h"
 
+#include <stddef.h>
+
 #include <glib.h>
 #include <epan/packet.h>
 #include <epan/prefs.h>
@@ -710,6 +712,11 @@ dissect_eth_withfcs(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree)
 void
 proto_register_eth(void)
 {
+    /* The addresses in the eth_hdr pushed to the tap, for the tap cache */
+    static const size_t eth_tap_addrs[] = {
+        offsetof(eth_hdr, dst), offsetof(eth_hdr, src)
+    };
+
     static hf_register_info hf[] = {
 
         { &hf_eth_dst,
@@ -860,6 +867,7 @@ proto_register_eth(void)
     register_dissector("eth_withfcs", dissect_eth_withfcs, proto_eth);
     register_dissector("eth", dissect_eth_maybefcs, proto_eth);
     eth_tap = register_tap("eth");
+    register_tap_cache(eth_tap, sizeof(eth_hdr), eth_tap_addrs, G_N_ELEMENTS(eth_tap_addrs));
 }
 
 void
@@ -839,6 +839,7 @@ proto_register_frame(void)
 	    &generate_bits_field);
 
 	frame_tap=register_tap("frame");
+	register_tap_cache(frame_tap, 0, NULL, 0);
 }
 
 void
@@ -29,6 +29,7 @@
 
 #include "config.h"
 
+#include <stddef.h>
 #include <string.h>
 #include <glib.h>
 
@@ -2526,6 +2527,11 @@ proto_register_ip(void)
 #define FRAG_OFFSET_WIDTH_MSG(WIDTH) \
   "Fragment offset (" ARG_TO_STR(WIDTH) " bits)"
 
+  /* The addresses in the ws_ip pushed to the tap, for the tap cache */
+  static const size_t ip_tap_addrs[] = {
+    offsetof(ws_ip, ip_src), offsetof(ws_ip, ip_dst)
+  };
+
   static hf_register_info hf[] = {
     { &hf_ip_version,
       { "Version", "ip.version", FT_UINT8, BASE_DEC,
@@ -3042,6 +3048,7 @@ proto_register_ip(void)
   register_dissector("ip", dissect_ip, proto_ip);
   register_init_routine(ip_defragment_init);
   ip_tap = register_tap("ip");
+  register_tap_cache(ip_tap, sizeof(ws_ip), ip_tap_addrs, G_N_ELEMENTS(ip_tap_addrs));
 }
 
 void
@@ -24,6 +24,7 @@
 
 #include "config.h"
 
+#include <stddef.h>
 #include <stdio.h>
 #include <string.h>
 #include <glib.h>
@@ -5647,12 +5648,17 @@ void
 proto_reg_handoff_tcp(void)
 {
     dissector_handle_t tcp_handle;
+    /* The addresses in the tcp_info_t pushed to the tap, for the tap cache */
+    static const size_t tcp_tap_addrs[] = {
+        offsetof(tcp_info_t, ip_src), offsetof(tcp_info_t, ip_dst)
+    };
 
     tcp_handle = find_dissector("tcp");
     dissector_add_uint("ip.proto", IP_PROTO_TCP, tcp_handle);
     data_handle = find_dissector("data");
     sport_handle = find_dissector("sport");
     tcp_tap = register_tap("tcp");
+    register_tap_cache(tcp_tap, sizeof(tcp_info_t), tcp_tap_addrs, G_N_ELEMENTS(tcp_tap_addrs));
 }
 
 /*
@@ -29,6 +29,7 @@
 
 #include "config.h"
 
+#include <stddef.h>
 #include <string.h>
 
 #include <glib.h>
@@ -775,9 +776,15 @@ proto_register_udp(void)
 void
 proto_reg_handoff_udp(void)
 {
+	/* The addresses in the e_udphdr pushed to the tap, for the tap cache */
+	static const size_t udp_tap_addrs[] = {
+		offsetof(e_udphdr, ip_src), offsetof(e_udphdr, ip_dst)
+	};
+
 	dissector_add_uint("ip.proto", IP_PROTO_UDP, udp_handle);
 	dissector_add_uint("ip.proto", IP_PROTO_UDPLITE, udplite_handle);
 	data_handle = find_dissector("data");
 	udp_tap = register_tap("udp");
+	register_tap_cache(udp_tap, sizeof(e_udphdr), udp_tap_addrs, G_N_ELEMENTS(udp_tap_addrs));
 	udp_follow_tap = register_tap("udp_follow");
 }
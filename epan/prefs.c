@@ -2108,6 +2108,13 @@ prefs_register_modules(void)
                                    10,
                                    &prefs.gui_recent_df_entries_max);
 
+    prefs_register_uint_preference(gui_module, "packet_list_cached_rows.max",
+                                   "The max. number of packet list rows whose column text is kept",
+                                   "The max. number of packet list rows whose column text is kept (0 means no limit). "
+                                   "Rows that aren't kept are dissected again when shown.",
+                                   10,
+                                   &prefs.gui_packet_list_cached_rows_max);
+
     prefs_register_directory_preference(gui_module, "fileopen.dir", "Start Directory",
         "Directory to start in when opening File Open dialog.", (const char **)&prefs.gui_fileopen_dir);
 
@@ -2304,6 +2311,10 @@ prefs_register_modules(void)
     prefs_register_bool_preference(capture_module, "real_time_update", "Update packet list in real time during capture",
         "Update packet list in real time during capture?", &prefs.capture_real_time);
 
+    prefs_register_bool_preference(capture_module, "shm_ring", "Read packets through shared memory during capture",
+        "Take newly captured packets from memory shared with dumpcap, rather than reading them back from the capture file, where possible?",
+        &prefs.capture_shm_ring);
+
     prefs_register_bool_preference(capture_module, "auto_scroll", "Scroll packet list during capture",
         "Scroll packet list during capture?", &prefs.capture_auto_scroll);
 
@@ -2362,6 +2373,15 @@ prefs_register_modules(void)
                                    10,
                                    &prefs.tap_update_interval);
 
+    prefs_register_bool_preference(stats_module, "tap_cache",
+                                   "Keep tap data for recalculating statistics",
+                                   "Keep what the ip, tcp, udp, frame and eth dissectors hand to statistics "
+                                   "when a file is read, so that statistics using only those can be "
+                                   "recalculated without dissecting the packets again.  This takes a few "
+                                   "hundred bytes of memory per packet, up to 1 GiB, past which it is given up for the file; "
+                                   "it takes effect when a file is opened.",
+                                   &prefs.tap_cache);
+
 #ifdef HAVE_LIBPORTAUDIO
     prefs_register_uint_preference(stats_module, "rtp_player_max_visible",
                                    "Max visible channels in RTP Player",
@@ -2755,6 +2775,7 @@ pre_init_prefs(void)
   prefs.gui_fileopen_style         = FO_STYLE_LAST_OPENED;
   prefs.gui_recent_df_entries_max  = 10;
   prefs.gui_recent_files_count_max = 10;
+  prefs.gui_packet_list_cached_rows_max = 10000;
   prefs.gui_fileopen_dir           = (char *) get_persdatafile_dir();
   prefs.gui_fileopen_preview       = 3;
   prefs.gui_ask_unsaved            = TRUE;
@@ -2795,6 +2816,7 @@ pre_init_prefs(void)
   prefs.capture_pcap_ng               = FALSE;
 #endif
   prefs.capture_real_time             = TRUE;
+  prefs.capture_shm_ring              = FALSE;
   prefs.capture_auto_scroll           = TRUE;
   prefs.capture_show_info             = FALSE;
 
@@ -2809,6 +2831,7 @@ pre_init_prefs(void)
 
 /* set the default values for the tap/statistics dialog box */
   prefs.tap_update_interval    = TAP_UPDATE_DEFAULT_INTERVAL;
+  prefs.tap_cache              = FALSE;
   prefs.rtp_player_max_visible = RTP_PLAYER_DEFAULT_VISIBLE;
 
   prefs.display_hidden_proto_items = FALSE;
@@ -163,6 +163,7 @@ typedef struct _e_prefs {
   console_open_e gui_console_open;
   guint        gui_recent_df_entries_max;
   guint        gui_recent_files_count_max;
+  guint        gui_packet_list_cached_rows_max;
   guint        gui_fileopen_style;
   gchar	      *gui_fileopen_dir;
   guint        gui_fileopen_preview;
@@ -193,11 +194,13 @@ typedef struct _e_prefs {
   gboolean     capture_prom_mode;
   gboolean     capture_pcap_ng;
   gboolean     capture_real_time;
+  gboolean     capture_shm_ring;
   gboolean     capture_auto_scroll;
   gboolean     capture_show_info;
   GList       *capture_columns;
   guint        rtp_player_max_visible;
   guint        tap_update_interval;
+  gboolean     tap_cache;
   gboolean     display_hidden_proto_items;
   gpointer     filter_expressions;	/* Actually points to &head */
   gboolean     gui_update_enabled;
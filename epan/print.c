@@ -28,6 +28,7 @@
 
 #include <stdio.h>
 #include <string.h>
+#include <errno.h>
 
 #include <glib.h>
 
@@ -39,11 +40,13 @@
 #include <epan/expert.h>
 
 #include <epan/packet-range.h>
+#include <epan/ipv4.h>
 #include "print.h"
 #include "isprint.h"
 #include "ps.h"
 #include "version_info.h"
 #include <wsutil/file_util.h>
+#include <wsutil/colfile.h>
 #include <epan/charsets.h>
 #include <epan/dissectors/packet-data.h>
 #include <epan/dissectors/packet-frame.h>
@@ -83,6 +86,9 @@ struct _output_fields {
     GPtrArray   *fields;
     GHashTable  *field_indicies;
     GPtrArray  **field_values;
+    int         *field_hfids;
+    GPtrArray  **field_finfos;      /* for columnar output */
+    colfile_writer_t *columnar;
     gchar        quote;
     gboolean     includes_col_fields;
 };
@@ -105,6 +111,8 @@ static void print_escaped_xml(FILE *fh, const char *unescaped_string);
 static void print_pdml_geninfo(proto_tree *tree, FILE *fh);
 
 static void proto_tree_get_node_field_values(proto_node *node, gpointer data);
+static void output_fields_prepare(output_fields_t *fields);
+static void output_fields_add_value(output_fields_t* fields, gpointer field_index, field_info *fi, epan_dissect_t *edt);
 
 static FILE *
 open_print_dest(gboolean to_file, const char *dest)
@@ -1338,6 +1346,9 @@ output_fields_t* output_fields_new(void)
     fields->fields              = NULL; /*Do lazy initialisation */
     fields->field_indicies      = NULL;
     fields->field_values        = NULL;
+    fields->field_hfids         = NULL;
+    fields->field_finfos        = NULL;
+    fields->columnar            = NULL;
     fields->quote               ='\0';
     fields->includes_col_fields = FALSE;
     return fields;
@@ -1372,6 +1383,18 @@ void output_fields_free(output_fields_t* fields)
             g_free(fields->field_values);
         }
 
+        if (NULL != fields->field_hfids) {
+            g_free(fields->field_hfids);
+        }
+
+        if (NULL != fields->field_finfos) {
+            for(i = 0; i < fields->fields->len; ++i) {
+                if (NULL != fields->field_finfos[i])
+                    g_ptr_array_free(fields->field_finfos[i], TRUE);
+            }
+            g_free(fields->field_finfos);
+        }
+
         for(i = 0; i < fields->fields->len; ++i) {
             gchar* field = (gchar *)g_ptr_array_index(fields->fields,i);
             g_free(field);
@@ -1597,6 +1620,47 @@ static void format_field_values(output_fields_t* fields, gpointer field_index, c
     g_ptr_array_add(fv_p, (gpointer)value);
 }
 
+/* Add an occurrence of an output field: its value or, for columnar output,
+ * the item itself, to take the value from. */
+static void output_fields_add_value(output_fields_t* fields, gpointer field_index, field_info *fi, epan_dissect_t *edt)
+{
+    guint      indx;
+    GPtrArray* fi_p;
+
+    if (NULL == fields->field_finfos) {
+        format_field_values(fields, field_index,
+                            get_node_field_value(fi, edt) /* static or ep_alloc'd string */
+            );
+        return;
+    }
+
+    /* Unwrap change made to disambiguiate zero / null */
+    indx = GPOINTER_TO_UINT(field_index) - 1;
+
+    /* The arrays are kept, and emptied, from one packet to the next */
+    if (fields->field_finfos[indx] == NULL) {
+        fields->field_finfos[indx] = g_ptr_array_new();
+    }
+    fi_p = fields->field_finfos[indx];
+
+    switch (fields->occurrence) {
+    case 'f':
+        if (g_ptr_array_len(fi_p) != 0)
+            return;
+        break;
+    case 'l':
+        g_ptr_array_set_size(fi_p, 0);
+        break;
+    case 'a':
+        break;
+    default:
+        g_assert_not_reached();
+        break;
+    }
+
+    g_ptr_array_add(fi_p, fi);
+}
+
 static void proto_tree_get_node_field_values(proto_node *node, gpointer data)
 {
     write_field_data_t *call_data;
@@ -1611,9 +1675,7 @@ static void proto_tree_get_node_field_values(proto_node *node, gpointer data)
 
     field_index = g_hash_table_lookup(call_data->fields->field_indicies, fi->hfinfo->abbrev);
     if (NULL != field_index) {
-        format_field_values(call_data->fields, field_index,
-                            get_node_field_value(fi, call_data->edt) /* static or ep_alloc'd string */
-            );
+        output_fields_add_value(call_data->fields, field_index, fi, call_data->edt);
     }
 
     /* Recurse here. */
@@ -1623,22 +1685,14 @@ static void proto_tree_get_node_field_values(proto_node *node, gpointer data)
     }
 }
 
-void proto_tree_write_fields(output_fields_t *fields, epan_dissect_t *edt, column_info *cinfo, FILE *fh)
+/* Set up the lookup tables used when writing the fields of a packet; done
+ * once, the first time they're needed. */
+static void output_fields_prepare(output_fields_t *fields)
 {
-    gsize     i;
-    gint      col;
-    gchar    *col_name;
-    gpointer  field_index;
-
-    write_field_data_t data;
+    gsize i;
 
     g_assert(fields);
     g_assert(fields->fields);
-    g_assert(edt);
-    g_assert(fh);
-
-    data.fields = fields;
-    data.edt = edt;
 
     if (NULL == fields->field_indicies) {
         /* Prepare a lookup table from string abbreviation for field to its index. */
@@ -1664,8 +1718,125 @@ void proto_tree_write_fields(output_fields_t *fields, epan_dissect_t *edt, colum
     if (NULL == fields->field_values)
         fields->field_values = g_new0(GPtrArray*, fields->fields->len);  /* free'd in output_fields_free() */
 
-    proto_tree_children_foreach(edt->tree, proto_tree_get_node_field_values,
-                                &data);
+    if (NULL == fields->field_hfids) {
+        /* The registered field for each output field, or -1 for columns
+         * and unknown fields.  Several fields can be registered with the
+         * same abbreviation; keep the first, the others are linked from it.
+         */
+        fields->field_hfids = g_new(int, fields->fields->len);  /* free'd in output_fields_free() */
+
+        for (i = 0; i < fields->fields->len; i++) {
+            gchar *field = (gchar *)g_ptr_array_index(fields->fields, i);
+            header_field_info *hfinfo = proto_registrar_get_byname(field);
+
+            if (NULL == hfinfo) {
+                fields->field_hfids[i] = -1;
+                continue;
+            }
+            while (hfinfo->same_name_prev_id != -1) {
+                hfinfo = proto_registrar_get_nth(hfinfo->same_name_prev_id);
+            }
+            fields->field_hfids[i] = hfinfo->id;
+        }
+    }
+}
+
+gboolean output_fields_need_labels(output_fields_t *fields)
+{
+    gsize i;
+    header_field_info *hfinfo;
+
+    output_fields_prepare(fields);
+
+    for (i = 0; i < fields->fields->len; i++) {
+        if (-1 == fields->field_hfids[i])
+            continue;
+
+        /* Protocols (other than "data") and text items are printed with
+         * their label, which isn't generated in an invisible tree. */
+        for (hfinfo = proto_registrar_get_nth(fields->field_hfids[i]);
+             hfinfo != NULL; hfinfo = hfinfo->same_name_next) {
+            if (hfinfo->id == hf_text_only)
+                return TRUE;
+            if (hfinfo->type == FT_PROTOCOL && hfinfo->id != proto_data)
+                return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+void output_fields_prime_edt(output_fields_t *fields, epan_dissect_t *edt)
+{
+    gsize i;
+    header_field_info *hfinfo;
+
+    g_assert(edt);
+
+    output_fields_prepare(fields);
+
+    for (i = 0; i < fields->fields->len; i++) {
+        if (-1 == fields->field_hfids[i])
+            continue;
+
+        for (hfinfo = proto_registrar_get_nth(fields->field_hfids[i]);
+             hfinfo != NULL; hfinfo = hfinfo->same_name_next) {
+            proto_tree_prime_hfid(edt->tree, hfinfo->id);
+        }
+    }
+}
+
+/* Pick up the values of the output fields from the items the dissection
+ * collected for the primed fields, as they were added to the tree; there's
+ * no need to walk the tree.
+ */
+static void proto_tree_get_primed_field_values(output_fields_t *fields, epan_dissect_t *edt)
+{
+    gsize i;
+    guint j;
+    header_field_info *hfinfo;
+    GPtrArray *finfos;
+
+    for (i = 0; i < fields->fields->len; i++) {
+        if (-1 == fields->field_hfids[i])
+            continue;
+
+        for (hfinfo = proto_registrar_get_nth(fields->field_hfids[i]);
+             hfinfo != NULL; hfinfo = hfinfo->same_name_next) {
+            finfos = proto_get_finfo_ptr_array(edt->tree, hfinfo->id);
+            if (NULL == finfos)
+                continue;
+
+            for (j = 0; j < g_ptr_array_len(finfos); j++) {
+                field_info *fi = (field_info *)g_ptr_array_index(finfos, j);
+
+                output_fields_add_value(fields, GUINT_TO_POINTER(i + 1), fi, edt);
+            }
+        }
+    }
+}
+
+/* Collect the values of the output fields for a packet into
+ * fields->field_values. */
+static void output_fields_collect(output_fields_t *fields, epan_dissect_t *edt, column_info *cinfo)
+{
+    gint      col;
+    gchar    *col_name;
+    gpointer  field_index;
+
+    write_field_data_t data;
+
+    data.fields = fields;
+    data.edt = edt;
+
+    output_fields_prepare(fields);
+
+    if (PTREE_DATA(edt->tree)->visible) {
+        proto_tree_children_foreach(edt->tree, proto_tree_get_node_field_values,
+                                    &data);
+    } else {
+        /* The tree was primed with output_fields_prime_edt(). */
+        proto_tree_get_primed_field_values(fields, edt);
+    }
 
     if (fields->includes_col_fields) {
         for (col = 0; col < cinfo->num_cols; col++) {
@@ -1674,10 +1845,26 @@ void proto_tree_write_fields(output_fields_t *fields, epan_dissect_t *edt, colum
             field_index = g_hash_table_lookup(fields->field_indicies, col_name);
 
             if (NULL != field_index) {
-                format_field_values(fields, field_index, cinfo->col_data[col]);
+                if (NULL != fields->columnar)
+                    colfile_add_string(fields->columnar, GPOINTER_TO_UINT(field_index) - 1,
+                                       cinfo->col_data[col]);
+                else
+                    format_field_values(fields, field_index, cinfo->col_data[col]);
             }
         }
     }
+}
+
+void proto_tree_write_fields(output_fields_t *fields, epan_dissect_t *edt, column_info *cinfo, FILE *fh)
+{
+    gsize     i;
+
+    g_assert(fields);
+    g_assert(fields->fields);
+    g_assert(edt);
+    g_assert(fh);
+
+    output_fields_collect(fields, edt, cinfo);
 
     for(i = 0; i < fields->fields->len; ++i) {
         if (0 != i) {
@@ -1709,6 +1896,500 @@ void write_fields_finale(output_fields_t* fields _U_ , FILE *fh _U_)
     /* Nothing to do */
 }
 
+/*
+ * JSON output: one object per packet, either as the elements of an array
+ * or one per line (newline-delimited JSON).  Without output fields, each
+ * top-level protocol is an object holding the values of all the fields
+ * under it; with output fields, only those fields are written.  A field
+ * that occurs once has a string as its value, one that occurs more than
+ * once an array of strings.
+ *
+ * A packet is put together in json_buf and written with a single fwrite().
+ * That buffer, and the tables used to group the occurrences of a field,
+ * are kept from one packet to the next.
+ */
+typedef struct {
+    const gchar *value;
+    guint        next;      /* index + 1 of the next item with the same abbreviation, 0 if none */
+    gboolean     first;     /* TRUE for the first item with its abbreviation */
+} json_link_t;
+
+typedef struct {
+    GPtrArray   *items;     /* proto_node * */
+    GArray      *links;     /* json_link_t, one per item */
+    GHashTable  *last;      /* abbreviation -> index + 1 of its last item */
+} json_group_t;
+
+static gboolean      json_ndjson  = FALSE;
+static guint32       json_packets = 0;
+static GString      *json_buf     = NULL;
+static json_group_t  json_layers;
+static json_group_t  json_fields;
+
+static void
+json_group_reset(json_group_t *group)
+{
+    if (NULL == group->items) {
+        group->items = g_ptr_array_new();
+        group->links = g_array_new(FALSE, FALSE, sizeof(json_link_t));
+        group->last  = g_hash_table_new(g_str_hash, g_str_equal);
+    } else {
+        g_ptr_array_set_size(group->items, 0);
+        g_array_set_size(group->links, 0);
+        g_hash_table_remove_all(group->last);
+    }
+}
+
+static void
+json_group_add(json_group_t *group, proto_node *node, const gchar *value)
+{
+    const gchar *abbrev = PNODE_FINFO(node)->hfinfo->abbrev;
+    json_link_t  link;
+    guint        last;
+
+    last = GPOINTER_TO_UINT(g_hash_table_lookup(group->last, abbrev));
+
+    link.value = value;
+    link.next  = 0;
+    link.first = (0 == last);
+    g_ptr_array_add(group->items, node);
+    g_array_append_val(group->links, link);
+
+    if (0 != last)
+        g_array_index(group->links, json_link_t, last - 1).next = group->items->len;
+    g_hash_table_insert(group->last, (gpointer)abbrev, GUINT_TO_POINTER(group->items->len));
+}
+
+/* Append a string as a JSON string.  Runs of characters that don't need
+ * escaping are copied in one go.  Bytes of a string that isn't valid UTF-8
+ * are taken as ISO 8859-1, so that the output always is. */
+static void
+json_append_string(GString *buf, const gchar *str)
+{
+    const gchar *p;
+    const gchar *run;
+    gboolean     is_utf8 = g_utf8_validate(str, -1, NULL);
+    guchar       c;
+
+    g_string_append_c(buf, '"');
+    for (p = run = str; *p != '\0'; p++) {
+        c = (guchar)*p;
+        if ((c >= 0x20) && (c != '"') && (c != '\\') && ((c < 0x80) || is_utf8))
+            continue;
+
+        g_string_append_len(buf, run, p - run);
+        run = p + 1;
+
+        switch (c) {
+        case '"':
+            g_string_append(buf, "\\\"");
+            break;
+        case '\\':
+            g_string_append(buf, "\\\\");
+            break;
+        case '\n':
+            g_string_append(buf, "\\n");
+            break;
+        case '\r':
+            g_string_append(buf, "\\r");
+            break;
+        case '\t':
+            g_string_append(buf, "\\t");
+            break;
+        default:
+            g_string_append_printf(buf, "\\u%04x", c);
+            break;
+        }
+    }
+    g_string_append_len(buf, run, p - run);
+    g_string_append_c(buf, '"');
+}
+
+/* Append the values of the item at index i and of the items after it with
+ * the same abbreviation. */
+static void
+json_append_values(GString *buf, json_group_t *group, guint i)
+{
+    json_link_t *link = &g_array_index(group->links, json_link_t, i);
+
+    if (0 == link->next) {
+        json_append_string(buf, link->value);
+        return;
+    }
+
+    g_string_append_c(buf, '[');
+    for (;;) {
+        json_append_string(buf, link->value);
+        if (0 == link->next)
+            break;
+        g_string_append_c(buf, ',');
+        link = &g_array_index(group->links, json_link_t, link->next - 1);
+    }
+    g_string_append_c(buf, ']');
+}
+
+static void
+proto_tree_get_node_json_fields(proto_node *node, gpointer data)
+{
+    epan_dissect_t *edt = (epan_dissect_t *)data;
+    field_info     *fi  = PNODE_FINFO(node);
+    const gchar    *value;
+
+    /* dissection with an invisible proto tree? */
+    g_assert(fi);
+
+    value = get_node_field_value(fi, edt); /* static or ep_alloc'd string */
+    if (NULL != value)
+        json_group_add(&json_fields, node, value);
+
+    if (node->first_child != NULL) {
+        proto_tree_children_foreach(node, proto_tree_get_node_json_fields,
+                                    data);
+    }
+}
+
+static void
+proto_tree_get_node_json_layers(proto_node *node, gpointer data _U_)
+{
+    field_info *fi = PNODE_FINFO(node);
+
+    /* dissection with an invisible proto tree? */
+    g_assert(fi);
+
+    /* If -O is specified, only write the protocols which are in the
+     * lookup table. */
+    if ((output_only_tables != NULL)
+        && (g_hash_table_lookup(output_only_tables, fi->hfinfo->abbrev) == NULL)) {
+        return;
+    }
+
+    json_group_add(&json_layers, node, NULL);
+}
+
+static void
+json_append_layers(GString *buf, epan_dissect_t *edt)
+{
+    guint        i, j, k;
+    json_link_t *layer;
+    proto_node  *node;
+    field_info  *fi;
+
+    json_group_reset(&json_layers);
+    proto_tree_children_foreach(edt->tree, proto_tree_get_node_json_layers, NULL);
+
+    g_string_append(buf, ",\"layers\":{");
+    for (i = 0; i < json_layers.items->len; i++) {
+        layer = &g_array_index(json_layers.links, json_link_t, i);
+        if (!layer->first)
+            continue;
+
+        if (0 != i)
+            g_string_append_c(buf, ',');
+        node = (proto_node *)g_ptr_array_index(json_layers.items, i);
+        json_append_string(buf, PNODE_FINFO(node)->hfinfo->abbrev);
+        g_string_append(buf, ":{");
+
+        /* A protocol that occurs more than once (tunnels, for instance)
+         * gets a single object, with the fields of all its occurrences. */
+        json_group_reset(&json_fields);
+        for (j = i + 1; 0 != j; j = g_array_index(json_layers.links, json_link_t, j - 1).next) {
+            node = (proto_node *)g_ptr_array_index(json_layers.items, j - 1);
+            fi = PNODE_FINFO(node);
+
+            /* Anything at the top level other than a protocol is a field
+             * in an object of its own. */
+            if ((fi->hfinfo->type == FT_PROTOCOL) && (fi->hfinfo->id != proto_data)) {
+                proto_tree_children_foreach(node, proto_tree_get_node_json_fields, edt);
+            } else {
+                proto_tree_get_node_json_fields(node, edt);
+            }
+        }
+
+        for (k = 0; k < json_fields.items->len; k++) {
+            if (!g_array_index(json_fields.links, json_link_t, k).first)
+                continue;
+
+            if (0 != k)
+                g_string_append_c(buf, ',');
+            node = (proto_node *)g_ptr_array_index(json_fields.items, k);
+            json_append_string(buf, PNODE_FINFO(node)->hfinfo->abbrev);
+            g_string_append_c(buf, ':');
+            json_append_values(buf, &json_fields, k);
+        }
+        g_string_append_c(buf, '}');
+    }
+    g_string_append_c(buf, '}');
+}
+
+static void
+json_append_output_fields(GString *buf, output_fields_t *fields, epan_dissect_t *edt, column_info *cinfo)
+{
+    gsize      i;
+    guint      j;
+    gboolean   first = TRUE;
+    GPtrArray *fv_p;
+
+    output_fields_collect(fields, edt, cinfo);
+
+    g_string_append(buf, ",\"fields\":{");
+    for (i = 0; i < fields->fields->len; i++) {
+        fv_p = fields->field_values[i];
+        if (NULL == fv_p)
+            continue;
+
+        if (!first)
+            g_string_append_c(buf, ',');
+        first = FALSE;
+        json_append_string(buf, (gchar *)g_ptr_array_index(fields->fields, i));
+        g_string_append_c(buf, ':');
+
+        /* With all occurrences, every other entry is the aggregator;
+         * see format_field_values(). */
+        if (g_ptr_array_len(fv_p) == 1) {
+            json_append_string(buf, (gchar *)g_ptr_array_index(fv_p, 0));
+        } else {
+            g_string_append_c(buf, '[');
+            for (j = 0; j < g_ptr_array_len(fv_p); j += 2) {
+                if (0 != j)
+                    g_string_append_c(buf, ',');
+                json_append_string(buf, (gchar *)g_ptr_array_index(fv_p, j));
+            }
+            g_string_append_c(buf, ']');
+        }
+
+        g_ptr_array_free(fv_p, TRUE);  /* get ready for the next packet */
+        fields->field_values[i] = NULL;
+    }
+    g_string_append_c(buf, '}');
+}
+
+void
+write_json_preamble(FILE *fh, gboolean ndjson)
+{
+    json_ndjson  = ndjson;
+    json_packets = 0;
+
+    if (!json_ndjson)
+        fputs("[\n", fh);
+}
+
+void
+proto_tree_write_json(output_fields_t *fields, epan_dissect_t *edt, column_info *cinfo, FILE *fh)
+{
+    frame_data *fd;
+
+    g_assert(edt);
+    g_assert(fh);
+
+    fd = edt->pi.fd;
+
+    if (NULL == json_buf)
+        json_buf = g_string_sized_new(4096);
+    else
+        g_string_truncate(json_buf, 0);
+
+    if (!json_ndjson)
+        g_string_append(json_buf, (0 == json_packets) ? "  " : ",\n  ");
+
+    g_string_append_printf(json_buf,
+                           "{\"number\":%u,\"timestamp\":%ld.%09d,\"len\":%u,\"caplen\":%u",
+                           fd->num, (long)fd->abs_ts.secs, fd->abs_ts.nsecs,
+                           fd->pkt_len, fd->cap_len);
+
+    if ((NULL != fields) && (0 != output_fields_num_fields(fields)))
+        json_append_output_fields(json_buf, fields, edt, cinfo);
+    else
+        json_append_layers(json_buf, edt);
+
+    g_string_append_c(json_buf, '}');
+    if (json_ndjson)
+        g_string_append_c(json_buf, '\n');
+
+    fwrite(json_buf->str, 1, json_buf->len, fh);
+    json_packets++;
+}
+
+void
+write_json_finale(FILE *fh)
+{
+    if (!json_ndjson)
+        fputs((0 == json_packets) ? "]\n" : "\n]\n", fh);
+}
+
+/*
+ * Columnar output: the output fields of each packet as a row of typed
+ * columns; see wsutil/colfile.h.  Numbers, addresses and times are written
+ * as binary values taken from the items; other fields, and columns, as
+ * the strings "-T fields" would print.
+ */
+static colfile_type_e
+columnar_ftype_to_type(enum ftenum ftype)
+{
+    switch (ftype) {
+    case FT_BOOLEAN:
+    case FT_UINT8:
+    case FT_UINT16:
+    case FT_UINT24:
+    case FT_UINT32:
+    case FT_FRAMENUM:
+        return COLFILE_UINT32;
+    case FT_INT8:
+    case FT_INT16:
+    case FT_INT24:
+    case FT_INT32:
+        return COLFILE_INT32;
+    case FT_UINT64:
+        return COLFILE_UINT64;
+    case FT_INT64:
+        return COLFILE_INT64;
+    case FT_FLOAT:
+    case FT_DOUBLE:
+        return COLFILE_DOUBLE;
+    case FT_IPv4:
+        return COLFILE_IPV4;
+    case FT_IPv6:
+        return COLFILE_IPV6;
+    case FT_ABSOLUTE_TIME:
+    case FT_RELATIVE_TIME:
+        return COLFILE_TIME;
+    default:
+        return COLFILE_STRING;
+    }
+}
+
+/* The type of the column for an output field.  If several fields are
+ * registered with its abbreviation, they all have to be of that type. */
+static colfile_type_e
+columnar_field_type(int hfid)
+{
+    header_field_info *hfinfo;
+    colfile_type_e     type;
+
+    if (-1 == hfid)
+        return COLFILE_STRING;
+
+    hfinfo = proto_registrar_get_nth(hfid);
+    type = columnar_ftype_to_type(hfinfo->type);
+    for (hfinfo = hfinfo->same_name_next; hfinfo != NULL; hfinfo = hfinfo->same_name_next) {
+        if (columnar_ftype_to_type(hfinfo->type) != type)
+            return COLFILE_STRING;
+    }
+    return type;
+}
+
+static void
+columnar_add_field(colfile_writer_t *writer, guint column, field_info *fi, epan_dissect_t *edt)
+{
+    const gchar *value;
+    nstime_t    *ts;
+    guint32      addr;
+
+    switch (colfile_column_type(writer, column)) {
+    case COLFILE_UINT32:
+        colfile_add_uint(writer, column, fvalue_get_uinteger(&fi->value));
+        break;
+    case COLFILE_INT32:
+        colfile_add_int(writer, column, fvalue_get_sinteger(&fi->value));
+        break;
+    case COLFILE_UINT64:
+        colfile_add_uint(writer, column, fvalue_get_integer64(&fi->value));
+        break;
+    case COLFILE_INT64:
+        colfile_add_int(writer, column, (gint64)fvalue_get_integer64(&fi->value));
+        break;
+    case COLFILE_DOUBLE:
+        colfile_add_double(writer, column, fvalue_get_floating(&fi->value));
+        break;
+    case COLFILE_IPV4:
+        addr = ipv4_get_net_order_addr((ipv4_addr *)fvalue_get(&fi->value));
+        colfile_add_addr(writer, column, (const guint8 *)&addr);
+        break;
+    case COLFILE_IPV6:
+        colfile_add_addr(writer, column, (const guint8 *)fvalue_get(&fi->value));
+        break;
+    case COLFILE_TIME:
+        ts = (nstime_t *)fvalue_get(&fi->value);
+        colfile_add_int(writer, column, (gint64)ts->secs * 1000000000 + ts->nsecs);
+        break;
+    default:
+        value = get_node_field_value(fi, edt); /* static or ep_alloc'd string */
+        if ((NULL != value) && ('\0' != *value))
+            colfile_add_string(writer, column, value);
+        break;
+    }
+}
+
+void write_columnar_preamble(output_fields_t* fields, FILE *fh)
+{
+    gsize i;
+
+    g_assert(fields);
+    g_assert(fields->fields);
+    g_assert(fh);
+
+    output_fields_prepare(fields);
+
+    fields->columnar = colfile_writer_new(fh, COLFILE_DEFAULT_CHUNK_ROWS);
+    for (i = 0; i < fields->fields->len; i++) {
+        colfile_add_column(fields->columnar,
+                           (const char *)g_ptr_array_index(fields->fields, i),
+                           columnar_field_type(fields->field_hfids[i]));
+    }
+
+    /* Collect the items, rather than their values */
+    if (NULL == fields->field_finfos)
+        fields->field_finfos = g_new0(GPtrArray*, fields->fields->len);  /* free'd in output_fields_free() */
+}
+
+gboolean proto_tree_write_columnar(output_fields_t* fields, epan_dissect_t *edt, column_info *cinfo, FILE *fh _U_)
+{
+    gsize      i;
+    guint      j;
+    GPtrArray *fi_p;
+    int        err;
+
+    g_assert(fields);
+    g_assert(fields->columnar);
+    g_assert(edt);
+
+    output_fields_collect(fields, edt, cinfo);
+
+    for (i = 0; i < fields->fields->len; i++) {
+        fi_p = fields->field_finfos[i];
+        if (NULL == fi_p)
+            continue;
+
+        for (j = 0; j < g_ptr_array_len(fi_p); j++) {
+            columnar_add_field(fields->columnar, (guint)i,
+                               (field_info *)g_ptr_array_index(fi_p, j), edt);
+        }
+        g_ptr_array_set_size(fi_p, 0);  /* get ready for the next packet */
+    }
+
+    if (!colfile_end_row(fields->columnar, &err)) {
+        errno = err;
+        return FALSE;
+    }
+    return TRUE;
+}
+
+gboolean write_columnar_finale(output_fields_t* fields, FILE *fh _U_)
+{
+    gboolean ret;
+    int      err;
+
+    g_assert(fields);
+
+    if (NULL == fields->columnar)
+        return TRUE;
+
+    ret = colfile_writer_close(fields->columnar, &err);
+    fields->columnar = NULL;
+    if (!ret)
+        errno = err;
+    return ret;
+}
+
 /* Returns an ep_alloced string or a static constant*/
 const gchar* get_node_field_value(field_info* fi, epan_dissect_t* edt)
 {
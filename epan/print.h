@@ -125,6 +125,18 @@ WS_DLL_PUBLIC gboolean output_fields_set_option(output_fields_t* info, gchar* op
 WS_DLL_PUBLIC void output_fields_list_options(FILE *fh);
 WS_DLL_PUBLIC gboolean output_fields_has_cols(output_fields_t* info);
 
+/*
+ * The values of the output fields can be picked up without building a
+ * visible protocol tree: dissect with an invisible tree, prime it with
+ * output_fields_prime_edt(), and proto_tree_write_fields() gets the values
+ * of the fields as the dissection collected them, rather than by walking
+ * the tree.  That doesn't work for fields printed with their label, i.e.
+ * protocols and text items; output_fields_need_labels() returns TRUE if
+ * any of those was asked for, in which case the tree must be visible.
+ */
+WS_DLL_PUBLIC gboolean output_fields_need_labels(output_fields_t* info);
+WS_DLL_PUBLIC void output_fields_prime_edt(output_fields_t* info, epan_dissect_t *edt);
+
 /*
  * Output only these protocols
  */
@@ -158,6 +170,25 @@ WS_DLL_PUBLIC void write_fields_preamble(output_fields_t* fields, FILE *fh);
 WS_DLL_PUBLIC void proto_tree_write_fields(output_fields_t* fields, epan_dissect_t *edt, column_info *cinfo, FILE *fh);
 WS_DLL_PUBLIC void write_fields_finale(output_fields_t* fields, FILE *fh);
 
+/*
+ * JSON, one object per packet: as an array if ndjson is FALSE, one object
+ * per line if it's TRUE.  If output fields were specified, only their
+ * values are written; otherwise those of all the fields of each protocol.
+ */
+WS_DLL_PUBLIC void write_json_preamble(FILE *fh, gboolean ndjson);
+WS_DLL_PUBLIC void proto_tree_write_json(output_fields_t* fields, epan_dissect_t *edt, column_info *cinfo, FILE *fh);
+WS_DLL_PUBLIC void write_json_finale(FILE *fh);
+
+/*
+ * Columnar binary output of the output fields, a row per packet, with
+ * typed columns; see wsutil/colfile.h for the format.  Rows are written in
+ * chunks, so proto_tree_write_columnar() only writes now and then; it and
+ * write_columnar_finale() return FALSE, with errno set, if writing fails.
+ */
+WS_DLL_PUBLIC void write_columnar_preamble(output_fields_t* fields, FILE *fh);
+WS_DLL_PUBLIC gboolean proto_tree_write_columnar(output_fields_t* fields, epan_dissect_t *edt, column_info *cinfo, FILE *fh);
+WS_DLL_PUBLIC gboolean write_columnar_finale(output_fields_t* fields, FILE *fh);
+
 WS_DLL_PUBLIC const gchar* get_node_field_value(field_info* fi, epan_dissect_t* edt);
 
 #ifdef __cplusplus
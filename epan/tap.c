@@ -36,7 +36,11 @@
 
 #include <string.h>
 #include <epan/packet_info.h>
+#include <epan/epan_dissect.h>
+#include <epan/frame_data.h>
 #include <epan/dfilter/dfilter.h>
+#include <epan/emem.h>
+#include <epan/wmem/wmem.h>
 #include <epan/tap.h>
 
 static gboolean tapping_is_active=FALSE;
@@ -77,6 +81,69 @@ typedef struct _tap_listener_t {
 } tap_listener_t;
 static volatile tap_listener_t *tap_listener_queue=NULL;
 
+/*
+ * The tap cache keeps, for each frame, what the dissection of the frame
+ * pushed to the taps registered with register_tap_cache(), so that
+ * retapping can give it to the listeners of those taps without reading
+ * and dissecting the frames again.
+ *
+ * The records are serialized, one after the other, in tap_cache_data;
+ * tap_cache_offsets has the offset of the record of frame N at index N-1.
+ * A record is a tap_cache_frame_t, the data of its addresses, and then,
+ * for each packet queued, a tap_cache_packet_t, the tap specific data and
+ * the data of the addresses in it.  Nothing is aligned, so everything is
+ * copied in and out with memcpy().
+ */
+typedef struct _tap_cache_desc_t {
+	size_t data_size;
+	const size_t *addr_offsets;
+	guint num_addrs;
+} tap_cache_desc_t;
+static GPtrArray *tap_cache_descs=NULL;
+
+typedef struct _tap_cache_address_t {
+	gint32 hf;
+	guint16 len;
+	guint8 type;
+} tap_cache_address_t;
+
+/* The members of packet_info that are kept; see tap_cache_record_frame() */
+#define TAP_CACHE_NUM_ADDRS 6
+typedef struct _tap_cache_frame_t {
+	tap_cache_address_t addrs[TAP_CACHE_NUM_ADDRS];
+	guint32 ethertype;
+	guint32 ipproto;
+	guint32 ipxptype;
+	guint32 mpls_label;
+	guint32 circuit_id;
+	guint32 srcport;
+	guint32 destport;
+	gint32 iplen;
+	gint32 iphdrlen;
+	gint32 p2p_dir;
+	guint8 ctype;
+	guint8 ptype;
+	guint8 ip_ttl;
+	guint8 fragmented;
+	guint16 num_packets;
+} tap_cache_frame_t;
+
+typedef struct _tap_cache_packet_t {
+	guint16 tap_id;
+	guint8 has_data;
+} tap_cache_packet_t;
+
+/* The most the tap cache holds; past that, it's given up for the file.
+   One frame's record is far smaller than what is left below G_MAXUINT,
+   so the guint offsets can't wrap. */
+#define TAP_CACHE_MAX_BYTES (1024*1024*1024)
+
+static gboolean tap_cache_recording=FALSE;
+static GByteArray *tap_cache_data=NULL;
+static GArray *tap_cache_offsets=NULL;
+static guint8 *tap_cache_scratch=NULL;
+static size_t tap_cache_scratch_size=0;
+
 /* **********************************************************************
  * Init routine only called from epan at application startup
  * ********************************************************************** */
@@ -187,6 +254,304 @@ tap_queue_packet(int tap_id, packet_info *pinfo, const void *tap_specific_data)
 
 
 
+/* This function lets the tap subsystem keep what a dissector pushes to
+   its tap, so that listeners can later be given it again without
+   dissecting the packets anew.  The tap specific data must be a structure
+   of data_size bytes holding no pointers, except for the data pointers of
+   the addresses at the addr_offsets given.
+*/
+void
+register_tap_cache(int tap_id, size_t data_size, const size_t *addr_offsets, guint num_addrs)
+{
+	tap_cache_desc_t *desc;
+
+	if(!tap_cache_descs){
+		tap_cache_descs=g_ptr_array_new();
+	}
+	if((guint)tap_id >= tap_cache_descs->len){
+		g_ptr_array_set_size(tap_cache_descs, tap_id+1);
+	}
+
+	desc=(tap_cache_desc_t *)g_malloc(sizeof(tap_cache_desc_t));
+	desc->data_size=data_size;
+	desc->addr_offsets=addr_offsets;
+	desc->num_addrs=num_addrs;
+	g_ptr_array_index(tap_cache_descs, tap_id)=desc;
+
+	if(data_size > tap_cache_scratch_size){
+		g_free(tap_cache_scratch);
+		tap_cache_scratch=(guint8 *)g_malloc(data_size);
+		tap_cache_scratch_size=data_size;
+	}
+}
+
+static const tap_cache_desc_t *
+tap_cache_desc(int tap_id)
+{
+	if(!tap_cache_descs || (guint)tap_id >= tap_cache_descs->len){
+		return NULL;
+	}
+	return (const tap_cache_desc_t *)g_ptr_array_index(tap_cache_descs, tap_id);
+}
+
+static void
+tap_cache_put_address(tap_cache_address_t *ca, const address *addr)
+{
+	ca->type=(guint8)addr->type;
+	ca->hf=addr->hf;
+	ca->len=(guint16)addr->len;
+	if(addr->len){
+		g_byte_array_append(tap_cache_data, (const guint8 *)addr->data, addr->len);
+	}
+}
+
+static const guint8 *
+tap_cache_get_address(address *addr, const tap_cache_address_t *ca, const guint8 *p)
+{
+	addr->type=(address_type)ca->type;
+	addr->hf=ca->hf;
+	addr->len=ca->len;
+	addr->data=ca->len ? p : NULL;
+	return p+ca->len;
+}
+
+/* Record a frame that has been dissected with taps: the members of its
+   packet_info that listeners look at, as they are at the end of the
+   dissection, and the data pushed to the cached taps.  If the cache
+   grows past TAP_CACHE_MAX_BYTES, it's discarded and recording stops.
+*/
+static void
+tap_cache_record_frame(packet_info *pinfo)
+{
+	const address *addrs[TAP_CACHE_NUM_ADDRS];
+	tap_cache_frame_t cf;
+	tap_cache_packet_t cp;
+	const tap_cache_desc_t *desc;
+	tap_packet_t *tp;
+	address addr;
+	guint offset, i, j;
+
+	offset=tap_cache_data->len;
+	g_array_append_val(tap_cache_offsets, offset);
+
+	addrs[0]=&pinfo->dl_src;
+	addrs[1]=&pinfo->dl_dst;
+	addrs[2]=&pinfo->net_src;
+	addrs[3]=&pinfo->net_dst;
+	addrs[4]=&pinfo->src;
+	addrs[5]=&pinfo->dst;
+
+	/* The addresses' data follows the frame record, so reserve room for
+	   the record first and fill it in when the address data is in. */
+	memset(&cf, 0, sizeof cf);
+	g_byte_array_set_size(tap_cache_data, offset+(guint)sizeof cf);
+	for(i=0;i<TAP_CACHE_NUM_ADDRS;i++){
+		tap_cache_put_address(&cf.addrs[i], addrs[i]);
+	}
+	cf.ethertype=pinfo->ethertype;
+	cf.ipproto=pinfo->ipproto;
+	cf.ipxptype=pinfo->ipxptype;
+	cf.mpls_label=pinfo->mpls_label;
+	cf.circuit_id=pinfo->circuit_id;
+	cf.srcport=pinfo->srcport;
+	cf.destport=pinfo->destport;
+	cf.iplen=pinfo->iplen;
+	cf.iphdrlen=pinfo->iphdrlen;
+	cf.p2p_dir=pinfo->p2p_dir;
+	cf.ctype=(guint8)pinfo->ctype;
+	cf.ptype=(guint8)pinfo->ptype;
+	cf.ip_ttl=pinfo->ip_ttl;
+	cf.fragmented=pinfo->fragmented ? 1 : 0;
+
+	for(i=0;i<tap_packet_index;i++){
+		tp=&tap_packet_array[i];
+		desc=tap_cache_desc(tp->tap_id);
+		if(!desc){
+			continue;
+		}
+		if(cf.num_packets==G_MAXUINT16){
+			tap_cache_reset(FALSE);
+			return;
+		}
+		cp.tap_id=(guint16)tp->tap_id;
+		cp.has_data=(tp->tap_specific_data && desc->data_size) ? 1 : 0;
+		g_byte_array_append(tap_cache_data, (const guint8 *)&cp, (guint)sizeof cp);
+		if(cp.has_data){
+			g_byte_array_append(tap_cache_data, (const guint8 *)tp->tap_specific_data, (guint)desc->data_size);
+			for(j=0;j<desc->num_addrs;j++){
+				memcpy(&addr, (const guint8 *)tp->tap_specific_data+desc->addr_offsets[j], sizeof addr);
+				if(addr.len){
+					g_byte_array_append(tap_cache_data, (const guint8 *)addr.data, addr.len);
+				}
+			}
+		}
+		cf.num_packets++;
+	}
+
+	memcpy(tap_cache_data->data+offset, &cf, sizeof cf);
+
+	if(tap_cache_data->len>TAP_CACHE_MAX_BYTES){
+		tap_cache_reset(FALSE);
+	}
+}
+
+/* Discard what the tap cache holds, and say whether the packets dissected
+   from now on are to be recorded in it.
+*/
+void
+tap_cache_reset(gboolean record)
+{
+	if(tap_cache_data){
+		g_byte_array_free(tap_cache_data, TRUE);
+		tap_cache_data=NULL;
+	}
+	if(tap_cache_offsets){
+		g_array_free(tap_cache_offsets, TRUE);
+		tap_cache_offsets=NULL;
+	}
+
+	tap_cache_recording=record;
+	if(record){
+		tap_cache_data=g_byte_array_new();
+		tap_cache_offsets=g_array_new(FALSE, FALSE, sizeof(guint));
+	}
+}
+
+/* Return TRUE if the first frame_count frames are in the tap cache and
+   all the tap listeners can be given them from it.
+*/
+gboolean
+tap_cache_can_replay(guint32 frame_count)
+{
+	tap_listener_t *tl;
+	gboolean have_listener=FALSE;
+
+	if(!tap_cache_recording || tap_cache_offsets->len != frame_count){
+		return FALSE;
+	}
+
+	for(tl=(tap_listener_t *)tap_listener_queue;tl;tl=tl->next){
+		if(tl->flags & TL_IS_DISSECTOR_HELPER){
+			continue;
+		}
+		if(tl->code || (tl->flags & (TL_REQUIRES_PROTO_TREE|TL_REQUIRES_COLUMNS))){
+			return FALSE;
+		}
+		if(!tap_cache_desc(tl->tap_id)){
+			return FALSE;
+		}
+		have_listener=TRUE;
+	}
+
+	return have_listener;
+}
+
+/* Give the tap listeners what was recorded for a frame, as if it had been
+   dissected with taps.
+*/
+void
+tap_cache_replay_packet(epan_t *session, frame_data *fd)
+{
+	epan_dissect_t edt;
+	struct wtap_pkthdr phdr;
+	packet_info *pinfo=&edt.pi;
+	address *addrs[TAP_CACHE_NUM_ADDRS];
+	tap_cache_frame_t cf;
+	tap_cache_packet_t cp;
+	const tap_cache_desc_t *desc;
+	tap_listener_t *tl;
+	const guint8 *p;
+	const void *data;
+	address *addr;
+	guint i, j;
+
+	if(!tap_cache_recording || fd->num == 0 || fd->num > tap_cache_offsets->len){
+		return;
+	}
+
+	wmem_enter_packet_scope();
+
+	memset(&phdr, 0, sizeof phdr);
+	phdr.ts.secs=fd->abs_ts.secs;
+	phdr.ts.nsecs=fd->abs_ts.nsecs;
+	phdr.caplen=fd->cap_len;
+	phdr.len=fd->pkt_len;
+	phdr.pkt_encap=fd->lnk_t;
+
+	/* Set up the packet_info as dissect_packet() does */
+	memset(&edt, 0, sizeof edt);
+	edt.session=session;
+	pinfo->epan=session;
+	pinfo->pool=wmem_packet_scope();
+	pinfo->current_proto="<Missing Protocol Name>";
+	pinfo->fd=fd;
+	pinfo->phdr=&phdr;
+	pinfo->pseudo_header=&phdr.pseudo_header;
+	pinfo->noreassembly_reason="";
+	pinfo->dcetransporttype=-1;
+	pinfo->annex_a_used=MTP2_ANNEX_A_USED_UNKNOWN;
+	pinfo->dcerpc_procedure_name="";
+	pinfo->link_dir=LINK_DIR_UNKNOWN;
+	frame_delta_abs_time(session, fd, fd->frame_ref_num, &pinfo->rel_ts);
+
+	p=tap_cache_data->data+g_array_index(tap_cache_offsets, guint, fd->num-1);
+	memcpy(&cf, p, sizeof cf);
+	p+=sizeof cf;
+
+	addrs[0]=&pinfo->dl_src;
+	addrs[1]=&pinfo->dl_dst;
+	addrs[2]=&pinfo->net_src;
+	addrs[3]=&pinfo->net_dst;
+	addrs[4]=&pinfo->src;
+	addrs[5]=&pinfo->dst;
+	for(i=0;i<TAP_CACHE_NUM_ADDRS;i++){
+		p=tap_cache_get_address(addrs[i], &cf.addrs[i], p);
+	}
+	pinfo->ethertype=cf.ethertype;
+	pinfo->ipproto=cf.ipproto;
+	pinfo->ipxptype=cf.ipxptype;
+	pinfo->mpls_label=cf.mpls_label;
+	pinfo->circuit_id=cf.circuit_id;
+	pinfo->srcport=cf.srcport;
+	pinfo->destport=cf.destport;
+	pinfo->iplen=cf.iplen;
+	pinfo->iphdrlen=cf.iphdrlen;
+	pinfo->p2p_dir=cf.p2p_dir;
+	pinfo->ctype=(circuit_type)cf.ctype;
+	pinfo->ptype=(port_type)cf.ptype;
+	pinfo->ip_ttl=cf.ip_ttl;
+	pinfo->fragmented=cf.fragmented;
+
+	for(i=0;i<cf.num_packets;i++){
+		memcpy(&cp, p, sizeof cp);
+		p+=sizeof cp;
+		desc=tap_cache_desc(cp.tap_id);
+
+		data=NULL;
+		if(cp.has_data){
+			/* Copy the data out, so that it's aligned, and point its
+			   addresses at their data, which follows it. */
+			memcpy(tap_cache_scratch, p, desc->data_size);
+			p+=desc->data_size;
+			for(j=0;j<desc->num_addrs;j++){
+				addr=(address *)(void *)(tap_cache_scratch+desc->addr_offsets[j]);
+				addr->data=addr->len ? p : NULL;
+				p+=addr->len;
+			}
+			data=tap_cache_scratch;
+		}
+
+		for(tl=(tap_listener_t *)tap_listener_queue;tl;tl=tl->next){
+			if(tl->tap_id==cp.tap_id && !(tl->flags & TL_IS_DISSECTOR_HELPER) && tl->packet){
+				tl->needs_redraw|=tl->packet(tl->tapdata, pinfo, &edt, data);
+			}
+		}
+	}
+
+	ep_free_all();
+	wmem_leave_packet_scope();
+}
+
 /* **********************************************************************
  * Functions used by file.c to drive the tap subsystem
  * ********************************************************************** */
@@ -217,7 +582,7 @@ void
 tap_queue_init(epan_dissect_t *edt)
 {
 	/* nothing to do, just return */
-	if(!tap_listener_queue){
+	if(!tap_listener_queue && !tap_cache_recording){
 		return;
 	}
 
@@ -245,6 +610,11 @@ tap_push_tapped_queue(epan_dissect_t *edt)
 
 	tapping_is_active=FALSE;
 
+	/* record the frame if it's the next one the tap cache is missing */
+	if(tap_cache_recording && edt->pi.fd && edt->pi.fd->num == tap_cache_offsets->len+1){
+		tap_cache_record_frame(&edt->pi);
+	}
+
 	/* nothing to do, just return */
 	if(!tap_packet_index){
 		return;
@@ -89,6 +89,20 @@ WS_DLL_PUBLIC int find_tap_id(const char *name);
  */
 WS_DLL_PUBLIC void tap_queue_packet(int tap_id, packet_info *pinfo, const void *tap_specific_data);
 
+/** This function lets the tap subsystem keep what a dissector pushes to
+ *  its tap, so that listeners can later be given it again without
+ *  dissecting the packets anew; see tap_cache_reset().
+ *
+ *  The tap specific data must be a structure of data_size bytes holding no
+ *  pointers, except for the data pointers of the "address" members at the
+ *  addr_offsets given; the addresses' data is kept along with it.  A tap
+ *  that pushes no data, such as "frame", passes a data_size of 0.
+ *
+ *  This function is only to be called once, after register_tap().
+ */
+WS_DLL_PUBLIC void register_tap_cache(int tap_id, size_t data_size,
+    const size_t *addr_offsets, guint num_addrs);
+
 /** Functions used by file.c to drive the tap subsystem */
 WS_DLL_PUBLIC void tap_build_interesting(epan_dissect_t *edt);
 
@@ -222,6 +236,35 @@ WS_DLL_PUBLIC gboolean have_filtering_tap_listeners(void);
  */
 WS_DLL_PUBLIC guint union_of_tap_listener_flags(void);
 
+/** Discard what the tap cache holds, and say whether the packets dissected
+ *  from now on are to be recorded in it.
+ *
+ *  When recording, each frame dissected with taps, in order from frame 1,
+ *  has its packet_info and the data pushed to the taps registered with
+ *  register_tap_cache() recorded.  Frames dissected again, or out of
+ *  order, aren't recorded.  The cache must be reset whenever the frames
+ *  are dissected differently, for instance after a preference change.
+ */
+WS_DLL_PUBLIC void tap_cache_reset(gboolean record);
+
+/** Return TRUE if the first frame_count frames are in the tap cache and
+ *  the tap listeners can be given them from it: all of them listen to
+ *  cached taps, and none has a filter or requires the protocol tree or
+ *  the columns.  Dissector helpers are left out; they aren't called.
+ */
+WS_DLL_PUBLIC gboolean tap_cache_can_replay(guint32 frame_count);
+
+/** Give the tap listeners what was recorded for a frame, as if it had been
+ *  dissected with taps.  Only to be called if tap_cache_can_replay()
+ *  returned TRUE.
+ *
+ *  Listeners get a packet_info rebuilt from the one recorded: its
+ *  addresses, ports and protocol numbers are those the dissection left,
+ *  but it has no column_info, no data sources and no private data, and
+ *  the edt has no tvbuff and no protocol tree.
+ */
+WS_DLL_PUBLIC void tap_cache_replay_packet(epan_t *session, frame_data *fd);
+
 /** This function can be used by a dissector to fetch any tapped data before
  * returning.
  * This can be useful if one wants to extract the data inside dissector  BEFORE
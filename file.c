@@ -114,6 +114,7 @@ static int read_packet(capture_file *cf, dfilter_t *dfcode,
     gboolean create_proto_tree, column_info *cinfo, gint64 offset);
 
 static void rescan_packets(capture_file *cf, const char *action, const char *action_item, gboolean redissect);
+static void refilter_packets(capture_file *cf);
 
 typedef enum {
   MR_NOTMATCHED,
@@ -357,6 +358,10 @@ cf_open(capture_file *cf, const char *fname, gboolean is_tempfile, int *err)
    */
   cf->epan = ws_epan_new(cf);
 
+  /* Record what the packets hand to the cached taps as we read them,
+     if asked to, so that statistics can be recalculated from that. */
+  tap_cache_reset(prefs.tap_cache);
+
   /* We're about to start reading the file. */
   cf->state = FILE_READ_IN_PROGRESS;
 
@@ -513,6 +518,7 @@ cf_reset_state(capture_file *cf)
   nstime_set_zero(&cf->elapsed_time);
 
   reset_tap_listeners();
+  tap_cache_reset(FALSE);
 
   /* We have no file open. */
   cf->state = FILE_CLOSED;
@@ -606,6 +612,9 @@ cf_read(capture_file *cf, gboolean reloading)
      XXX - do we know this at open time? */
   cf->iscompressed = wtap_iscompressed(cf->wth);
 
+  /* Decompress in the background while we dissect what's been read. */
+  wtap_set_read_ahead(cf->wth);
+
   /* The packet list window will be empty until the file is completly loaded */
   packet_list_freeze();
 
@@ -1695,21 +1704,42 @@ cf_filter_packets(capture_file *cf, gchar *dftext, gboolean force)
   cf->dfilter = dftext;
   g_get_current_time(&start_time);
 
+  /* Cleanup and release all dfilter resources */
+  dfilter_free(dfcode);
 
-  /* Now rescan the packet list, applying the new filter, but not
-     throwing away information constructed on a previous pass. */
-  if (dftext == NULL) {
-    rescan_packets(cf, "Resetting", "Filter", FALSE);
-  } else {
-    rescan_packets(cf, "Filtering", dftext, FALSE);
+  if (cf->rescanning) {
+    /* We were called from the UI while the packet list is being
+       rescanned (the progress bar runs the main loop); don't start
+       another rescan from in there.  Tell the one in progress that
+       the filter changed: a filtering pass is abandoned and started
+       over with the new filter, and a redissection is followed by a
+       filtering pass. */
+    cf->refilter = TRUE;
+    return CF_OK;
   }
 
-  /* Cleanup and release all dfilter resources */
-  dfilter_free(dfcode);
+  /* Now rescan the packet list, applying the new filter, but not
+     throwing away information constructed on a previous pass. */
+  refilter_packets(cf);
 
   return CF_OK;
 }
 
+/* Rescan the packet list, applying the current filter, until it's done
+   with a filter that didn't change while it was being applied. */
+static void
+refilter_packets(capture_file *cf)
+{
+  do {
+    cf->refilter = FALSE;
+    if (cf->dfilter == NULL) {
+      rescan_packets(cf, "Resetting", "Filter", FALSE);
+    } else {
+      rescan_packets(cf, "Filtering", cf->dfilter, FALSE);
+    }
+  } while (cf->refilter);
+}
+
 void
 cf_reftime_packets(capture_file *cf)
 {
@@ -1720,7 +1750,10 @@ void
 cf_redissect_packets(capture_file *cf)
 {
   if (cf->state != FILE_CLOSED) {
+    cf->refilter = FALSE;
     rescan_packets(cf, "Reprocessing", "all packets", TRUE);
+    if (cf->refilter)
+      refilter_packets(cf);
   }
 }
 
@@ -1795,7 +1828,12 @@ cf_read_frame(capture_file *cf, frame_data *fdata)
    "redissect" is TRUE if we need to make the dissectors reconstruct
    any state information they have (because a preference that affects
    some dissector has changed, meaning some dissector might construct
-   its state differently from the way it was constructed the last time). */
+   its state differently from the way it was constructed the last time).
+
+   When only filtering, a packet list that supports it shows the packets
+   that passed the filter as the rescan gets to them, rather than all at
+   once at the end, and the rescan stops early if the filter is changed
+   in the meantime, so that the caller can start over with the new one. */
 static void
 rescan_packets(capture_file *cf, const char *action, const char *action_item, gboolean redissect)
 {
@@ -1818,6 +1856,7 @@ rescan_packets(capture_file *cf, const char *action, const char *action_item, gb
   gboolean    create_proto_tree;
   guint       tap_flags;
   gboolean    add_to_packet_list = FALSE;
+  gboolean    streaming;
   gboolean    compiled;
   guint32     frames_count;
 
@@ -1844,9 +1883,15 @@ rescan_packets(capture_file *cf, const char *action, const char *action_item, gb
   /* Mark frame num as not found */
   selected_frame_num = -1;
 
-  /* Freeze the packet list while we redo it, so we don't get any
-     screen updates while it happens. */
-  packet_list_freeze();
+  cf->rescanning = TRUE;
+
+  /* If we're only filtering, and the packet list can show the packets
+     that passed the filter while we go, let it.  Otherwise freeze the
+     packet list while we redo it, so we don't get any screen updates
+     while it happens. */
+  streaming = !redissect && packet_list_begin_rescan();
+  if (!streaming)
+    packet_list_freeze();
 
   if (redissect) {
     /* We need to re-initialize all the state information that protocols
@@ -1862,6 +1907,9 @@ rescan_packets(capture_file *cf, const char *action, const char *action_item, gb
     epan_free(cf->epan);
     cf->epan = ws_epan_new(cf);
 
+    /* What the tap cache has may now be wrong; record it again. */
+    tap_cache_reset(prefs.tap_cache);
+
     /* We need to redissect the packets so we have to discard our old
      * packet list store. */
     packet_list_clear();
@@ -1933,6 +1981,11 @@ rescan_packets(capture_file *cf, const char *action, const char *action_item, gb
       g_assert(cf->count > 0);
       progbar_val = (gfloat) count / frames_count;
 
+      /* Show what we've filtered so far, before the progress bar
+         update runs the main loop. */
+      if (streaming)
+        packet_list_rescan_progress(framenum - 1);
+
       if (progbar != NULL) {
         g_snprintf(status_str, sizeof(status_str),
                   "%4u of %u frames", count, frames_count);
@@ -1958,6 +2011,12 @@ rescan_packets(capture_file *cf, const char *action, const char *action_item, gb
       break;
     }
 
+    if (cf->refilter && !redissect) {
+      /* The filter was changed while the progress bar was being
+         updated; there's no point in applying the old one any further. */
+      break;
+    }
+
     count++;
 
     if (redissect) {
@@ -2033,13 +2092,18 @@ rescan_packets(capture_file *cf, const char *action, const char *action_item, gb
     destroy_progress_dlg(progbar);
 
   /* Unfreeze the packet list. */
-  if (!add_to_packet_list)
+  if (streaming)
+    packet_list_end_rescan();
+  else if (!add_to_packet_list)
     packet_list_recreate_visible_rows();
 
+  cf->rescanning = FALSE;
+
   /* Compute the time it took to filter the file */
   compute_elapsed(cf, &start_time);
 
-  packet_list_thaw();
+  if (!streaming)
+    packet_list_thaw();
 
   if (selected_frame_num == -1) {
     /* The selected frame didn't pass the filter. */
@@ -2345,6 +2409,7 @@ cf_retap_packets(capture_file *cf)
   retap_callback_args_t callback_args;
   gboolean              filtering_tap_listeners;
   guint                 tap_flags;
+  guint32               framenum;
 
   /* Do we have any tap listeners with filters? */
   filtering_tap_listeners = have_filtering_tap_listeners();
@@ -2362,6 +2427,14 @@ cf_retap_packets(capture_file *cf)
   /* Reset the tap listeners. */
   reset_tap_listeners();
 
+  /* If the tap cache has what all the tap listeners need, give it to
+     them, rather than reading and dissecting all the packets again. */
+  if (tap_cache_can_replay(cf->count)) {
+    for (framenum = 1; framenum <= cf->count; framenum++)
+      tap_cache_replay_packet(cf->epan, frame_data_sequence_find(cf->frames, framenum));
+    return CF_READ_OK;
+  }
+
   /* Iterate through the list of packets, dissecting all packets and
      re-running the taps. */
   packet_range_init(&range, cf);
@@ -3174,11 +3247,159 @@ match_summary_line(capture_file *cf, frame_data *fdata, void *criterion)
   return result;
 }
 
+/*
+ * A byte string being searched for, with what's needed to search every
+ * frame for it quickly: rather than comparing byte by byte and backing up
+ * after each partial match, contiguous strings are searched for with
+ * Boyer-Moore-Horspool, and strings with gaps (UTF-16, or with NULs
+ * allowed) are searched for by jumping from one occurrence of their
+ * first character to the next.
+ */
 typedef struct {
     const guint8 *data;
     size_t        data_len;
+    guint8        fold[256];      /* What each byte is compared as; upper case
+                                     for case-insensitive searches */
+    size_t        skip[256];      /* Horspool shift for each (folded) byte */
+    int           first_byte;     /* The only byte that folds to data[0], or
+                                     -1 if there are several */
 } cbs_t;    /* "Counted byte string" */
 
+static void
+cbs_init(cbs_t *info, const guint8 *data, size_t data_len,
+         gboolean case_insensitive)
+{
+  size_t i;
+  int    c, n_first = 0;
+
+  info->data = data;
+  info->data_len = data_len;
+  info->first_byte = -1;
+
+  for (c = 0; c < 256; c++) {
+    info->fold[c] = case_insensitive ? (guint8)toupper(c) : (guint8)c;
+    info->skip[c] = data_len;
+    if (data_len != 0 && info->fold[c] == data[0]) {
+      info->first_byte = c;
+      n_first++;
+    }
+  }
+  if (n_first != 1)
+    info->first_byte = -1;
+
+  for (i = 0; i + 1 < data_len; i++)
+    info->skip[data[i]] = data_len - 1 - i;
+}
+
+/* Find the first byte at or after p that folds to the first byte of the
+   string. */
+static const guint8 *
+cbs_find_first(const cbs_t *info, const guint8 *p, const guint8 *end)
+{
+  guint8 first = info->data[0];
+
+  if (p >= end)
+    return NULL;
+  if (info->first_byte >= 0)
+    return (const guint8 *)memchr(p, info->first_byte, end - p);
+  for (; p < end; p++) {
+    if (info->fold[*p] == first)
+      return p;
+  }
+  return NULL;
+}
+
+/* Search for the string, contiguous; on success, *pos is the offset of its
+   last byte. */
+static gboolean
+cbs_search_narrow(const cbs_t *info, const guint8 *pd, guint32 buf_len,
+                  guint32 *pos)
+{
+  const guint8 *text = info->data;
+  size_t        last = info->data_len - 1;
+  size_t        i, j;
+  guint8        c;
+
+  if (info->data_len == 0 || info->data_len > buf_len)
+    return FALSE;
+
+  i = 0;
+  while (i + last < buf_len) {
+    c = info->fold[pd[i + last]];
+    if (c == text[last]) {
+      for (j = 0; j < last && info->fold[pd[i + j]] == text[j]; j++)
+        ;
+      if (j == last) {
+        *pos = (guint32)(i + last);
+        return TRUE;
+      }
+    }
+    i += info->skip[c];
+  }
+  return FALSE;
+}
+
+/* Search for the string as UTF-16, i.e. with one byte, whatever it is,
+   after each character. */
+static gboolean
+cbs_search_wide(const cbs_t *info, const guint8 *pd, guint32 buf_len,
+                guint32 *pos)
+{
+  const guint8 *end = pd + buf_len;
+  const guint8 *p;
+  size_t        textlen = info->data_len;
+  size_t        span, k;
+
+  if (textlen == 0)
+    return FALSE;
+  span = 2 * textlen - 1;
+
+  for (p = pd; (p = cbs_find_first(info, p, end)) != NULL; p++) {
+    if ((size_t)(end - p) < span)
+      break;
+    for (k = 1; k < textlen && info->fold[p[2 * k]] == info->data[k]; k++)
+      ;
+    if (k == textlen) {
+      *pos = (guint32)(p - pd + span - 1);
+      return TRUE;
+    }
+  }
+  return FALSE;
+}
+
+/* Search for the string with any number of NULs between its characters,
+   which finds it both as ASCII and as UTF-16. */
+static gboolean
+cbs_search_narrow_and_wide(const cbs_t *info, const guint8 *pd,
+                           guint32 buf_len, guint32 *pos)
+{
+  const guint8 *end = pd + buf_len;
+  const guint8 *p, *q;
+  size_t        textlen = info->data_len;
+  size_t        k;
+
+  if (textlen == 0)
+    return FALSE;
+
+  for (p = pd; (p = cbs_find_first(info, p, end)) != NULL; p++) {
+    q = p + 1;
+    for (k = 1; k < textlen && q < end; q++) {
+      if (*q == '\0')
+        continue;
+      if (info->fold[*q] != info->data[k])
+        break;
+      k++;
+    }
+    if (k == textlen) {
+      *pos = (guint32)(q - pd - 1);
+      return TRUE;
+    }
+    if (q == end)
+      break;    /* The rest is too short to hold it */
+  }
+  return FALSE;
+}
+
 
 /*
  * The current match_* routines only support ASCII case insensitivity and don't
@@ -3196,8 +3417,8 @@ cf_find_packet_data(capture_file *cf, const guint8 *string, size_t string_size,
 {
   cbs_t info;
 
-  info.data = string;
-  info.data_len = string_size;
+  /* Hex searches are always case-sensitive */
+  cbs_init(&info, string, string_size, cf->string && cf->case_type);
 
   /* String or hex search? */
   if (cf->string) {
@@ -3224,15 +3445,8 @@ cf_find_packet_data(capture_file *cf, const guint8 *string, size_t string_size,
 static match_result
 match_narrow_and_wide(capture_file *cf, frame_data *fdata, void *criterion)
 {
-  cbs_t        *info       = (cbs_t *)criterion;
-  const guint8 *ascii_text = info->data;
-  size_t        textlen    = info->data_len;
-  match_result  result;
-  guint32       buf_len;
-  guint8       *pd;
-  guint32       i;
-  guint8        c_char;
-  size_t        c_match    = 0;
+  cbs_t   *info = (cbs_t *)criterion;
+  guint32  pos;
 
   /* Load the frame's data. */
   if (!cf_read_frame(cf, fdata)) {
@@ -3240,47 +3454,19 @@ match_narrow_and_wide(capture_file *cf, frame_data *fdata, void *criterion)
     return MR_ERROR;
   }
 
-  result = MR_NOTMATCHED;
-  buf_len = fdata->cap_len;
-  pd = buffer_start_ptr(&cf->buf);
-  i = 0;
-  while (i < buf_len) {
-    c_char = pd[i];
-    if (cf->case_type)
-      c_char = toupper(c_char);
-    if (c_char != '\0') {
-      if (c_char == ascii_text[c_match]) {
-        c_match += 1;
-        if (c_match == textlen) {
-          result = MR_MATCHED;
-          cf->search_pos = i; /* Save the position of the last character
-                                 for highlighting the field. */
-          break;
-        }
-      }
-      else {
-        g_assert(i>=c_match);
-        i -= (guint32)c_match;
-        c_match = 0;
-      }
-    }
-    i += 1;
-  }
-  return result;
+  if (!cbs_search_narrow_and_wide(info, buffer_start_ptr(&cf->buf),
+                                  fdata->cap_len, &pos))
+    return MR_NOTMATCHED;
+  cf->search_pos = pos; /* Save the position of the last character
+                           for highlighting the field. */
+  return MR_MATCHED;
 }
 
 static match_result
 match_narrow(capture_file *cf, frame_data *fdata, void *criterion)
 {
-  guint8       *pd;
-  cbs_t        *info       = (cbs_t *)criterion;
-  const guint8 *ascii_text = info->data;
-  size_t        textlen    = info->data_len;
-  match_result  result;
-  guint32       buf_len;
-  guint32       i;
-  guint8        c_char;
-  size_t        c_match    = 0;
+  cbs_t   *info = (cbs_t *)criterion;
+  guint32  pos;
 
   /* Load the frame's data. */
   if (!cf_read_frame(cf, fdata)) {
@@ -3288,46 +3474,19 @@ match_narrow(capture_file *cf, frame_data *fdata, void *criterion)
     return MR_ERROR;
   }
 
-  result = MR_NOTMATCHED;
-  buf_len = fdata->cap_len;
-  pd = buffer_start_ptr(&cf->buf);
-  i = 0;
-  while (i < buf_len) {
-    c_char = pd[i];
-    if (cf->case_type)
-      c_char = toupper(c_char);
-    if (c_char == ascii_text[c_match]) {
-      c_match += 1;
-      if (c_match == textlen) {
-        result = MR_MATCHED;
-        cf->search_pos = i; /* Save the position of the last character
-                               for highlighting the field. */
-        break;
-      }
-    }
-    else {
-      g_assert(i>=c_match);
-      i -= (guint32)c_match;
-      c_match = 0;
-    }
-    i += 1;
-  }
-
-  return result;
+  if (!cbs_search_narrow(info, buffer_start_ptr(&cf->buf), fdata->cap_len,
+                         &pos))
+    return MR_NOTMATCHED;
+  cf->search_pos = pos; /* Save the position of the last character
+                           for highlighting the field. */
+  return MR_MATCHED;
 }
 
 static match_result
 match_wide(capture_file *cf, frame_data *fdata, void *criterion)
 {
-  cbs_t        *info       = (cbs_t *)criterion;
-  const guint8 *ascii_text = info->data;
-  size_t        textlen    = info->data_len;
-  match_result  result;
-  guint32       buf_len;
-  guint8       *pd;
-  guint32       i;
-  guint8        c_char;
-  size_t        c_match    = 0;
+  cbs_t   *info = (cbs_t *)criterion;
+  guint32  pos;
 
   /* Load the frame's data. */
   if (!cf_read_frame(cf, fdata)) {
@@ -3335,45 +3494,19 @@ match_wide(capture_file *cf, frame_data *fdata, void *criterion)
     return MR_ERROR;
   }
 
-  result = MR_NOTMATCHED;
-  buf_len = fdata->cap_len;
-  pd = buffer_start_ptr(&cf->buf);
-  i = 0;
-  while (i < buf_len) {
-    c_char = pd[i];
-    if (cf->case_type)
-      c_char = toupper(c_char);
-    if (c_char == ascii_text[c_match]) {
-      c_match += 1;
-      if (c_match == textlen) {
-        result = MR_MATCHED;
-        cf->search_pos = i; /* Save the position of the last character
-                               for highlighting the field. */
-        break;
-      }
-      i += 1;
-    }
-    else {
-      g_assert(i>=(c_match*2));
-      i -= (guint32)c_match*2;
-      c_match = 0;
-    }
-    i += 1;
-  }
-  return result;
+  if (!cbs_search_wide(info, buffer_start_ptr(&cf->buf), fdata->cap_len,
+                       &pos))
+    return MR_NOTMATCHED;
+  cf->search_pos = pos; /* Save the position of the last character
+                           for highlighting the field. */
+  return MR_MATCHED;
 }
 
 static match_result
 match_binary(capture_file *cf, frame_data *fdata, void *criterion)
 {
-  cbs_t        *info        = (cbs_t *)criterion;
-  const guint8 *binary_data = info->data;
-  size_t        datalen     = info->data_len;
-  match_result  result;
-  guint32       buf_len;
-  guint8       *pd;
-  guint32       i;
-  size_t        c_match     = 0;
+  cbs_t   *info = (cbs_t *)criterion;
+  guint32  pos;
 
   /* Load the frame's data. */
   if (!cf_read_frame(cf, fdata)) {
@@ -3381,28 +3514,13 @@ match_binary(capture_file *cf, frame_data *fdata, void *criterion)
     return MR_ERROR;
   }
 
-  result = MR_NOTMATCHED;
-  buf_len = fdata->cap_len;
-  pd = buffer_start_ptr(&cf->buf);
-  i = 0;
-  while (i < buf_len) {
-    if (pd[i] == binary_data[c_match]) {
-      c_match += 1;
-      if (c_match == datalen) {
-        result = MR_MATCHED;
-        cf->search_pos = i; /* Save the position of the last character
-                               for highlighting the field. */
-        break;
-      }
-    }
-    else {
-      g_assert(i>=c_match);
-      i -= (guint32)c_match;
-      c_match = 0;
-    }
-    i += 1;
-  }
-  return result;
+  /* The fold table is the identity, so this is an exact search */
+  if (!cbs_search_narrow(info, buffer_start_ptr(&cf->buf), fdata->cap_len,
+                         &pos))
+    return MR_NOTMATCHED;
+  cf->search_pos = pos; /* Save the position of the last character
+                           for highlighting the field. */
+  return MR_MATCHED;
 }
 
 gboolean
@@ -3865,6 +3983,8 @@ cf_ignore_frame(capture_file *cf, frame_data *frame)
     frame->flags.ignored = TRUE;
     if (cf->count > cf->ignored_count)
       cf->ignored_count++;
+    /* The frame won't be dissected as it was recorded. */
+    tap_cache_reset(FALSE);
   }
 }
 
@@ -3878,6 +3998,8 @@ cf_unignore_frame(capture_file *cf, frame_data *frame)
     frame->flags.ignored = FALSE;
     if (cf->ignored_count > 0)
       cf->ignored_count--;
+    /* The frame won't be dissected as it was recorded. */
+    tap_cache_reset(FALSE);
   }
 }
 
@@ -426,6 +426,13 @@ main(int argc, char *argv[])
             wtap_strerror(open_err));
     exit(1);
   }
+  if (!wtap_dump_set_write_behind(pdh, &open_err)) {
+    merge_close_in_files(in_file_count, in_files);
+    g_free(in_files);
+    fprintf(stderr, "mergecap: Can't write to %s: %s\n", out_filename,
+            wtap_strerror(open_err));
+    exit(1);
+  }
 
   /* do the merge (or append) */
   count = 1;
@@ -457,6 +464,14 @@ main(int argc, char *argv[])
       snap_phdr = *phdr;
       snap_phdr.caplen = snaplen;
       phdr = &snap_phdr;
+    } else if (wtap_dump_can_copy_records(pdh, in_file->wth)) {
+      /* Nothing to change; copy the record straight from the input file. */
+      if (!wtap_dump_copy_record(pdh, in_file->wth, in_file->data_offset,
+                                 &write_err)) {
+        got_write_error = TRUE;
+        break;
+      }
+      continue;
     }
 
     if (!wtap_dump(pdh, phdr, wtap_buf_ptr(in_file->wth), &write_err)) {
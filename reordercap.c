@@ -28,6 +28,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
 #include <glib.h>
 
 #ifdef HAVE_UNISTD_H
@@ -35,6 +36,10 @@
 #endif
 
 #include "wtap.h"
+#include "merge.h"
+
+#include <wsutil/file_util.h>
+#include <wsutil/tempfile.h>
 
 #ifndef HAVE_GETOPT
 #include "wsutil/wsgetopt.h"
@@ -55,6 +60,11 @@ static void usage(void)
     fprintf(stderr, "\n");
     fprintf(stderr, "Options:\n");
     fprintf(stderr, "  -n        don't write to output file if the input file is ordered.\n");
+    fprintf(stderr, "  -w <frames>  read the input file once, holding back at most <frames>\n");
+    fprintf(stderr, "               frames to put in order; frames out of order by more\n");
+    fprintf(stderr, "               than that are written late.\n");
+    fprintf(stderr, "  -m <frames>  read the input file once, sorting runs of <frames> frames\n");
+    fprintf(stderr, "               into temporary files, and merge those.\n");
 }
 
 /* Remember where this frame was in the file */
@@ -67,6 +77,14 @@ typedef struct FrameRecord_t {
 } FrameRecord_t;
 
 
+/* A frame read into memory, for the streaming modes */
+typedef struct StreamFrame_t {
+    struct wtap_pkthdr   phdr;
+    guint8              *data;
+    guint                num;
+} StreamFrame_t;
+
+
 /**************************************************/
 /* Debugging only                                 */
 
@@ -161,6 +179,383 @@ frames_compare(gconstpointer a, gconstpointer b)
 }
 
 
+static void
+report_read_error(const char *infile, int err, gchar *err_info)
+{
+    /* Print a message noting that the read failed somewhere along the line. */
+    fprintf(stderr,
+            "reordercap: An error occurred while reading \"%s\": %s.\n",
+            infile, wtap_strerror(err));
+    switch (err) {
+
+    case WTAP_ERR_UNSUPPORTED:
+    case WTAP_ERR_UNSUPPORTED_ENCAP:
+    case WTAP_ERR_BAD_FILE:
+        fprintf(stderr, "(%s)\n", err_info);
+        g_free(err_info);
+        break;
+    }
+}
+
+
+/********************************************************************/
+/* Streaming modes: frames are read sequentially, and copied.       */
+/********************************************************************/
+
+static StreamFrame_t *
+stream_frame_new(wtap *wth, guint num)
+{
+    StreamFrame_t *frame;
+    const struct wtap_pkthdr *phdr = wtap_phdr(wth);
+
+    frame = g_slice_new(StreamFrame_t);
+    frame->phdr = *phdr;
+    frame->phdr.opt_comment = g_strdup(phdr->opt_comment);
+    frame->data = (guint8 *)g_memdup(wtap_buf_ptr(wth), phdr->caplen);
+    frame->num = num;
+    return frame;
+}
+
+static void
+stream_frame_free(StreamFrame_t *frame)
+{
+    g_free(frame->phdr.opt_comment);
+    g_free(frame->data);
+    g_slice_free(StreamFrame_t, frame);
+}
+
+static void
+stream_frame_write(StreamFrame_t *frame, wtap_dumper *pdh)
+{
+    int err;
+
+    if (!wtap_dump(pdh, &frame->phdr, frame->data, &err)) {
+        fprintf(stderr, "reordercap: Error (%s) writing frame to outfile\n",
+                wtap_strerror(err));
+        exit(1);
+    }
+}
+
+/* Same ordering as frames_compare(), for StreamFrame_t */
+static int
+stream_frames_compare(gconstpointer a, gconstpointer b)
+{
+    const StreamFrame_t *frame1 = *(const StreamFrame_t **) a;
+    const StreamFrame_t *frame2 = *(const StreamFrame_t **) b;
+
+    const struct wtap_nstime *time1 = &frame1->phdr.ts;
+    const struct wtap_nstime *time2 = &frame2->phdr.ts;
+
+    if (time1->secs > time2->secs)
+        return 1;
+    if (time1->secs < time2->secs)
+        return -1;
+    if (time1->nsecs > time2->nsecs)
+        return 1;
+    if (time1->nsecs < time2->nsecs)
+        return -1;
+    if (frame1->num > frame2->num)
+        return 1;
+    if (frame1->num < frame2->num)
+        return -1;
+    return 0;
+}
+
+/* TRUE if t1 is strictly earlier than t2 */
+static gboolean
+ts_earlier(const struct wtap_nstime *t1, const struct wtap_nstime *t2)
+{
+    return t1->secs < t2->secs ||
+           (t1->secs == t2->secs && t1->nsecs < t2->nsecs);
+}
+
+/* Binary min-heap of StreamFrame_t pointers, earliest frame at the top */
+static void
+heap_push(GPtrArray *heap, StreamFrame_t *frame)
+{
+    guint i, parent;
+
+    g_ptr_array_add(heap, frame);
+    i = heap->len - 1;
+    while (i > 0) {
+        parent = (i - 1) / 2;
+        if (stream_frames_compare(&frame, &heap->pdata[parent]) >= 0)
+            break;
+        heap->pdata[i] = heap->pdata[parent];
+        i = parent;
+    }
+    heap->pdata[i] = frame;
+}
+
+static StreamFrame_t *
+heap_pop(GPtrArray *heap)
+{
+    StreamFrame_t *top = (StreamFrame_t *)heap->pdata[0];
+    gpointer last;
+    guint i, child;
+
+    last = g_ptr_array_remove_index_fast(heap, heap->len - 1);
+    if (heap->len == 0)
+        return top;
+
+    i = 0;
+    for (;;) {
+        child = 2 * i + 1;
+        if (child >= heap->len)
+            break;
+        if (child + 1 < heap->len &&
+            stream_frames_compare(&heap->pdata[child + 1], &heap->pdata[child]) < 0)
+            child++;
+        if (stream_frames_compare(&heap->pdata[child], &last) >= 0)
+            break;
+        heap->pdata[i] = heap->pdata[child];
+        i = child;
+    }
+    heap->pdata[i] = last;
+    return top;
+}
+
+/*
+ * Reorder within a window: hold back up to "window" frames in a heap,
+ * and once it's full, write out the earliest one for every frame read.
+ * Memory use is bounded by the window; frames that are further out of
+ * order than that can't be put in place, and are written late.
+ */
+static void
+reorder_window(wtap *wth, wtap_dumper *pdh, guint window, const char *infile,
+               guint *frame_count, guint *wrong_order_count, guint *late_count)
+{
+    GPtrArray *heap;
+    StreamFrame_t *frame;
+    struct wtap_nstime prev_ts = { 0, 0 }, last_written = { 0, 0 };
+    gboolean written_any = FALSE;
+    gint64 data_offset;
+    int err;
+    gchar *err_info;
+
+    heap = g_ptr_array_sized_new(window + 1);
+    while (wtap_read(wth, &err, &err_info, &data_offset)) {
+        frame = stream_frame_new(wth, ++*frame_count);
+        if (*frame_count > 1 && ts_earlier(&frame->phdr.ts, &prev_ts))
+            (*wrong_order_count)++;
+        prev_ts = frame->phdr.ts;
+        heap_push(heap, frame);
+
+        if (heap->len > window) {
+            frame = heap_pop(heap);
+            if (written_any && ts_earlier(&frame->phdr.ts, &last_written))
+                (*late_count)++;
+            last_written = frame->phdr.ts;
+            written_any = TRUE;
+            stream_frame_write(frame, pdh);
+            stream_frame_free(frame);
+        }
+    }
+    if (err != 0)
+        report_read_error(infile, err, err_info);
+
+    /* Flush what's left */
+    while (heap->len != 0) {
+        frame = heap_pop(heap);
+        if (written_any && ts_earlier(&frame->phdr.ts, &last_written))
+            (*late_count)++;
+        last_written = frame->phdr.ts;
+        written_any = TRUE;
+        stream_frame_write(frame, pdh);
+        stream_frame_free(frame);
+    }
+    g_ptr_array_free(heap, TRUE);
+}
+
+/* Snapshot length to write the frames of the input file with */
+static int
+output_snaplen(wtap *wth)
+{
+    int snaplen = wtap_snapshot_length(wth);
+
+    /* Snapshot length of input file not known. */
+    if (snaplen == 0)
+        snaplen = WTAP_MAX_PACKET_SIZE;
+    return snaplen;
+}
+
+/* Sort a run of frames and write it to a new temporary file */
+static gchar *
+write_run(GPtrArray *run, wtap *wth, int *err)
+{
+    wtap_dumper *run_pdh;
+    wtapng_section_t *shb_hdr;
+    wtapng_iface_descriptions_t *idb_inf;
+    char *tmpname;
+    gchar *run_name;
+    int fd;
+    guint i;
+
+    fd = create_tempfile(&tmpname, "reordercap");
+    if (fd < 0) {
+        *err = errno;
+        return NULL;
+    }
+    run_name = g_strdup(tmpname);
+
+    shb_hdr = wtap_file_get_shb_info(wth);
+    idb_inf = wtap_file_get_idb_info(wth);
+    run_pdh = wtap_dump_fdopen_ng(fd, wtap_file_type(wth), wtap_file_encap(wth),
+                                  output_snaplen(wth), FALSE, shb_hdr, idb_inf, err);
+    g_free(idb_inf);
+    g_free(shb_hdr);
+    if (run_pdh == NULL) {
+        ws_close(fd);
+        ws_unlink(run_name);
+        g_free(run_name);
+        return NULL;
+    }
+    if (!wtap_dump_set_write_behind(run_pdh, err)) {
+        wtap_dump_close(run_pdh, err);
+        ws_unlink(run_name);
+        g_free(run_name);
+        return NULL;
+    }
+
+    g_ptr_array_sort(run, stream_frames_compare);
+    for (i = 0; i < run->len; i++) {
+        StreamFrame_t *frame = (StreamFrame_t *)run->pdata[i];
+
+        stream_frame_write(frame, run_pdh);
+        stream_frame_free(frame);
+    }
+    g_ptr_array_set_size(run, 0);
+
+    if (!wtap_dump_close(run_pdh, err)) {
+        ws_unlink(run_name);
+        g_free(run_name);
+        return NULL;
+    }
+    return run_name;
+}
+
+/* Remove the temporary files of the runs written so far */
+static void
+remove_runs(GPtrArray *run_names)
+{
+    guint i;
+
+    for (i = 0; i < run_names->len; i++) {
+        ws_unlink((char *)run_names->pdata[i]);
+        g_free(run_names->pdata[i]);
+    }
+    g_ptr_array_free(run_names, TRUE);
+}
+
+/*
+ * External merge sort: read runs of "run_size" frames, sort each in
+ * memory and write it to a temporary file, then merge the temporary
+ * files.  Memory use is bounded by the run size, whatever the disorder.
+ */
+static void
+reorder_external(wtap *wth, wtap_dumper *pdh, guint run_size,
+                 const char *infile, guint *frame_count, guint *wrong_order_count)
+{
+    GPtrArray *run, *run_names;
+    StreamFrame_t *frame;
+    struct wtap_nstime prev_ts = { 0, 0 };
+    merge_in_file_t *in_files = NULL, *in_file;
+    gchar *run_name;
+    gint64 data_offset;
+    int err, err_fileno;
+    gchar *err_info;
+    guint i;
+
+    run = g_ptr_array_sized_new(run_size);
+    run_names = g_ptr_array_new();
+    while (wtap_read(wth, &err, &err_info, &data_offset)) {
+        frame = stream_frame_new(wth, ++*frame_count);
+        if (*frame_count > 1 && ts_earlier(&frame->phdr.ts, &prev_ts))
+            (*wrong_order_count)++;
+        prev_ts = frame->phdr.ts;
+        g_ptr_array_add(run, frame);
+
+        if (run->len == run_size) {
+            run_name = write_run(run, wth, &err);
+            if (run_name == NULL) {
+                fprintf(stderr, "reordercap: Can't write temporary file: %s\n",
+                        wtap_strerror(err));
+                remove_runs(run_names);
+                exit(1);
+            }
+            g_ptr_array_add(run_names, run_name);
+        }
+    }
+    if (err != 0)
+        report_read_error(infile, err, err_info);
+
+    if (run_names->len == 0) {
+        /* It all fitted in memory; no need for temporary files. */
+        g_ptr_array_sort(run, stream_frames_compare);
+        for (i = 0; i < run->len; i++) {
+            frame = (StreamFrame_t *)run->pdata[i];
+            stream_frame_write(frame, pdh);
+            stream_frame_free(frame);
+        }
+        g_ptr_array_free(run, TRUE);
+        g_ptr_array_free(run_names, TRUE);
+        return;
+    }
+    if (run->len != 0) {
+        run_name = write_run(run, wth, &err);
+        if (run_name == NULL) {
+            fprintf(stderr, "reordercap: Can't write temporary file: %s\n",
+                    wtap_strerror(err));
+            remove_runs(run_names);
+            exit(1);
+        }
+        g_ptr_array_add(run_names, run_name);
+    }
+    g_ptr_array_free(run, TRUE);
+
+    /*
+     * When time stamps are equal, the merge takes the packet from the
+     * file later in the list; list the runs last to first, so that
+     * frames with equal time stamps stay in input order.
+     */
+    for (i = 0; i < run_names->len / 2; i++) {
+        gpointer tmp = run_names->pdata[i];
+
+        run_names->pdata[i] = run_names->pdata[run_names->len - 1 - i];
+        run_names->pdata[run_names->len - 1 - i] = tmp;
+    }
+
+    if (!merge_open_in_files(run_names->len, (char *const *)run_names->pdata,
+                             &in_files, &err, &err_info, &err_fileno)) {
+        fprintf(stderr, "reordercap: Can't open temporary file %s: %s\n",
+                (char *)run_names->pdata[err_fileno], wtap_strerror(err));
+        remove_runs(run_names);
+        exit(1);
+    }
+    while ((in_file = merge_read_packet(run_names->len, in_files, &err,
+                                        &err_info)) != NULL) {
+        if (err != 0) {
+            report_read_error(in_file->filename, err, err_info);
+            merge_close_in_files(run_names->len, in_files);
+            remove_runs(run_names);
+            exit(1);
+        }
+        if (!wtap_dump(pdh, wtap_phdr(in_file->wth), wtap_buf_ptr(in_file->wth),
+                       &err)) {
+            fprintf(stderr, "reordercap: Error (%s) writing frame to outfile\n",
+                    wtap_strerror(err));
+            merge_close_in_files(run_names->len, in_files);
+            remove_runs(run_names);
+            exit(1);
+        }
+    }
+    merge_close_in_files(run_names->len, in_files);
+    g_free(in_files);
+
+    remove_runs(run_names);
+}
+
+
 /********************************************************************/
 /* Main function.                                                   */
 /********************************************************************/
@@ -186,13 +581,34 @@ int main(int argc, char *argv[])
     int file_count;
     char *infile;
     char *outfile;
+    char *p;
+    guint window = 0;
+    guint run_size = 0;
+    guint frame_count = 0;
+    guint late_count = 0;
 
     /* Process the options first */
-    while ((opt = getopt(argc, argv, "n")) != -1) {
+    while ((opt = getopt(argc, argv, "m:nw:")) != -1) {
         switch (opt) {
+            case 'm':
+                run_size = (guint)strtoul(optarg, &p, 10);
+                if (p == optarg || *p != '\0' || run_size == 0) {
+                    fprintf(stderr, "reordercap: \"%s\" isn't a valid run size\n",
+                            optarg);
+                    exit(1);
+                }
+                break;
             case 'n':
                 write_output_regardless = FALSE;
                 break;
+            case 'w':
+                window = (guint)strtoul(optarg, &p, 10);
+                if (p == optarg || *p != '\0' || window == 0) {
+                    fprintf(stderr, "reordercap: \"%s\" isn't a valid window size\n",
+                            optarg);
+                    exit(1);
+                }
+                break;
             case '?':
                 usage();
                 exit(1);
@@ -210,8 +626,19 @@ int main(int argc, char *argv[])
         exit(1);
     }
 
-    /* Open infile */
-    wth = wtap_open_offline(infile, &err, &err_info, TRUE);
+    if (window != 0 && run_size != 0) {
+        fprintf(stderr, "reordercap: -w and -m can't be used together\n");
+        exit(1);
+    }
+    if ((window != 0 || run_size != 0) && !write_output_regardless) {
+        fprintf(stderr, "reordercap: -n can't be used with -w or -m, as the output\n"
+                        "is written while the input is being read\n");
+        exit(1);
+    }
+
+    /* Open infile; the streaming modes don't need random access */
+    wth = wtap_open_offline(infile, &err, &err_info,
+                            window == 0 && run_size == 0);
     if (wth == NULL) {
         fprintf(stderr, "reordercap: Can't open %s: %s\n", infile,
                 wtap_strerror(err));
@@ -233,7 +660,7 @@ int main(int argc, char *argv[])
 
     /* Open outfile (same filetype/encap as input file) */
     pdh = wtap_dump_open_ng(outfile, wtap_file_type(wth), wtap_file_encap(wth),
-                            65535, FALSE, shb_hdr, idb_inf, &err);
+                            output_snaplen(wth), FALSE, shb_hdr, idb_inf, &err);
     g_free(idb_inf);
     if (pdh == NULL) {
         fprintf(stderr, "reordercap: Failed to open output file: (%s) - error %s\n",
@@ -241,6 +668,35 @@ int main(int argc, char *argv[])
         g_free(shb_hdr);
         exit(1);
     }
+    if (!wtap_dump_set_write_behind(pdh, &err)) {
+        fprintf(stderr, "reordercap: Failed to write output file: (%s) - error %s\n",
+                outfile, wtap_strerror(err));
+        g_free(shb_hdr);
+        exit(1);
+    }
+
+    if (window != 0 || run_size != 0) {
+        if (window != 0)
+            reorder_window(wth, pdh, window, infile, &frame_count,
+                           &wrong_order_count, &late_count);
+        else
+            reorder_external(wth, pdh, run_size, infile, &frame_count,
+                             &wrong_order_count);
+        printf("%u frames, %u out of order\n", frame_count, wrong_order_count);
+        if (late_count != 0)
+            printf("%u frames were out of order by more than the window, and were written late\n",
+                   late_count);
+
+        if (!wtap_dump_close(pdh, &err)) {
+            fprintf(stderr, "reordercap: Error closing %s: %s\n", outfile,
+                    wtap_strerror(err));
+            g_free(shb_hdr);
+            exit(1);
+        }
+        g_free(shb_hdr);
+        wtap_close(wth);
+        return 0;
+    }
 
     /* Allocate the array of frame pointers. */
     frames = g_ptr_array_new();
@@ -40,6 +40,13 @@
  * the files at switch and not the capture stop, and by closing them which
  * makes possible their move or deletion after a switch).
  *
+ * To keep a switch from stalling the capture, closing the finished file
+ * and removing the file it replaces are done by a background thread, which
+ * also creates the next file ahead of time (under a temporary name, as
+ * its final name includes the time of the switch), and writes the flow
+ * index of the finished file, if there is one.  Errors from the
+ * background thread are reported at the next switch, or when the last
+ * file is closed.
  */
 
 #include "config.h"
@@ -64,6 +71,7 @@
 #include <glib.h>
 
 #include "ringbuffer.h"
+#include "log.h"
 #include <wsutil/file_util.h>
 
 
@@ -72,6 +80,32 @@ typedef struct _rb_file {
   gchar		*name;
 } rb_file;
 
+/*
+ * Create the next file ahead of time; this relies on being able to rename
+ * a file that's open, which we can't do on Windows.
+ */
+#ifndef _WIN32
+#define RB_PREOPEN
+#endif
+
+/* Work for the background thread */
+typedef enum {
+  RB_JOB_CLOSE,     /* close a finished file */
+  RB_JOB_REMOVE,    /* remove a file that has been replaced */
+  RB_JOB_CREATE,    /* create the next file */
+  RB_JOB_INDEX,     /* write the flow index of a finished file */
+  RB_JOB_EXIT
+} rb_job_type;
+
+typedef struct _rb_job {
+  rb_job_type   type;
+  FILE         *pdh;        /* RB_JOB_CLOSE */
+  gchar        *name;       /* RB_JOB_REMOVE, RB_JOB_CREATE, RB_JOB_INDEX */
+  int           fd;         /* RB_JOB_CREATE: the new file, or -1 */
+  int           err;        /* RB_JOB_CREATE: errno if the file couldn't be created */
+  flowindex_builder_t *flow_index; /* RB_JOB_INDEX */
+} rb_job;
+
 /* Ringbuffer data structure */
 typedef struct _ringbuf_data {
   rb_file      *files;
@@ -84,27 +118,219 @@ typedef struct _ringbuf_data {
   int           fd;		     /* Current ringbuffer file descriptor */
   FILE         *pdh;
   gboolean      group_read_access;   /* TRUE if files need to be opened with group read access */
+
+  GThread      *worker;              /* Background thread, or NULL */
+  GAsyncQueue  *jobs;                /* Work for the background thread */
+  GAsyncQueue  *created;             /* Files created by the background thread */
+  gboolean      create_pending;      /* TRUE if a file has been or is being created */
+  volatile gint worker_err;          /* First error seen by the background thread and not yet reported */
 } ringbuf_data;
 
 static ringbuf_data rb_data;
 
 
 /*
- * create the next filename and open a new binary file with that name
+ * Remove a ringbuffer file, and its flow index if it has one
  */
-static int ringbuf_open_file(rb_file *rfile, int *err)
+static void
+ringbuf_unlink(const gchar *name)
 {
-  char    filenum[5+1];
-  char    timestr[14+1];
-  time_t  current_time;
+  gchar *index_name;
 
-  if (rfile->name != NULL) {
-    if (rb_data.unlimited == FALSE) {
-      /* remove old file (if any, so ignore error) */
-      ws_unlink(rfile->name);
+  ws_unlink(name);
+  index_name = flowindex_filename(name);
+  ws_unlink(index_name);
+  g_free(index_name);
+}
+
+/*
+ * Write the flow index of a file, and free it.  The file itself is fine
+ * without one, so we just complain if we can't.
+ */
+static void
+ringbuf_do_write_flow_index(flowindex_builder_t *builder, const gchar *name)
+{
+  gchar *index_name;
+  int    err;
+
+  index_name = flowindex_filename(name);
+  if (!flowindex_builder_write(builder, index_name, &err)) {
+    g_log(LOG_DOMAIN_CAPTURE_CHILD, G_LOG_LEVEL_WARNING,
+          "Couldn't write the flow index \"%s\": %s",
+          index_name, g_strerror(err));
+  }
+  g_free(index_name);
+  flowindex_builder_free(builder);
+}
+
+static gpointer
+ringbuf_worker(gpointer data _U_)
+{
+  rb_job *job;
+
+  for (;;) {
+    job = (rb_job *)g_async_queue_pop(rb_data.jobs);
+    switch (job->type) {
+
+    case RB_JOB_CLOSE:
+      if (fclose(job->pdh) == EOF)
+        g_atomic_int_compare_and_exchange(&rb_data.worker_err, 0, errno);
+      g_free(job);
+      break;
+
+    case RB_JOB_REMOVE:
+      /* ignore errors, as ringbuf_open_file() always did */
+      ringbuf_unlink(job->name);
+      g_free(job->name);
+      g_free(job);
+      break;
+
+    case RB_JOB_CREATE:
+      job->fd = ws_open(job->name, O_RDWR|O_BINARY|O_TRUNC|O_CREAT,
+                        rb_data.group_read_access ? 0640 : 0600);
+      job->err = (job->fd == -1) ? errno : 0;
+      g_async_queue_push(rb_data.created, job);
+      break;
+
+    case RB_JOB_INDEX:
+      ringbuf_do_write_flow_index(job->flow_index, job->name);
+      g_free(job->name);
+      g_free(job);
+      break;
+
+    case RB_JOB_EXIT:
+      g_free(job);
+      return NULL;
     }
-    g_free(rfile->name);
   }
+}
+
+/*
+ * Start the background thread; if we can't, everything is done in the
+ * capture thread, as before.
+ */
+static void
+ringbuf_start_worker(void)
+{
+  rb_data.jobs = g_async_queue_new();
+  rb_data.created = g_async_queue_new();
+  rb_data.create_pending = FALSE;
+  rb_data.worker_err = 0;
+#if GLIB_CHECK_VERSION(2,31,18)
+  rb_data.worker = g_thread_new("Ringbuffer files", ringbuf_worker, NULL);
+#else
+  rb_data.worker = g_thread_create(ringbuf_worker, NULL, TRUE, NULL);
+#endif
+}
+
+/*
+ * Wait for the background thread to finish what it's been given, and
+ * discard the file it created ahead of time, if any.
+ */
+static void
+ringbuf_stop_worker(void)
+{
+  rb_job *job;
+
+  if (rb_data.worker != NULL) {
+    job = g_new0(rb_job, 1);
+    job->type = RB_JOB_EXIT;
+    g_async_queue_push(rb_data.jobs, job);
+    g_thread_join(rb_data.worker);
+    rb_data.worker = NULL;
+  }
+  if (rb_data.create_pending) {
+    job = (rb_job *)g_async_queue_pop(rb_data.created);
+    if (job->fd != -1) {
+      ws_close(job->fd);
+      ws_unlink(job->name);
+    }
+    g_free(job->name);
+    g_free(job);
+    rb_data.create_pending = FALSE;
+  }
+  if (rb_data.jobs != NULL) {
+    g_async_queue_unref(rb_data.jobs);
+    rb_data.jobs = NULL;
+  }
+  if (rb_data.created != NULL) {
+    g_async_queue_unref(rb_data.created);
+    rb_data.created = NULL;
+  }
+}
+
+/*
+ * Return the first error seen by the background thread since the last
+ * call, or 0, and forget about it
+ */
+static int
+ringbuf_worker_error(void)
+{
+  int err;
+
+  /* The worker only ever sets the error when it's 0 */
+  do {
+    err = g_atomic_int_get(&rb_data.worker_err);
+  } while (err != 0 &&
+           !g_atomic_int_compare_and_exchange(&rb_data.worker_err, err, 0));
+  return err;
+}
+
+/*
+ * Close a finished file, in the background if possible
+ */
+static int
+ringbuf_close_file(FILE *pdh)
+{
+  rb_job *job;
+
+  if (rb_data.worker == NULL)
+    return (fclose(pdh) == EOF) ? errno : 0;
+
+  job = g_new0(rb_job, 1);
+  job->type = RB_JOB_CLOSE;
+  job->pdh = pdh;
+  g_async_queue_push(rb_data.jobs, job);
+  return 0;
+}
+
+/*
+ * Remove the file held by a ringbuffer slot which is about to be reused,
+ * in the background if possible
+ */
+static void
+ringbuf_remove_file(rb_file *rfile)
+{
+  rb_job *job;
+
+  if (rfile->name == NULL)
+    return;
+
+  if (rb_data.unlimited == FALSE) {
+    /* remove old file (if any, so ignore error) */
+    if (rb_data.worker != NULL) {
+      job = g_new0(rb_job, 1);
+      job->type = RB_JOB_REMOVE;
+      job->name = rfile->name;
+      g_async_queue_push(rb_data.jobs, job);
+      rfile->name = NULL;
+      return;
+    }
+    ringbuf_unlink(rfile->name);
+  }
+  g_free(rfile->name);
+  rfile->name = NULL;
+}
+
+/*
+ * Create the name of the current file
+ */
+static gchar *
+ringbuf_file_name(void)
+{
+  char    filenum[5+1];
+  char    timestr[14+1];
+  time_t  current_time;
 
 #ifdef _WIN32
   _tzset();
@@ -113,16 +339,25 @@ static int ringbuf_open_file(rb_file *rfile, int *err)
 
   g_snprintf(filenum, sizeof(filenum), "%05u", (rb_data.curr_file_num + 1) % RINGBUFFER_MAX_NUM_FILES);
   strftime(timestr, sizeof(timestr), "%Y%m%d%H%M%S", localtime(&current_time));
-  rfile->name = g_strconcat(rb_data.fprefix, "_", filenum, "_", timestr,
-			    rb_data.fsuffix, NULL);
+  return g_strconcat(rb_data.fprefix, "_", filenum, "_", timestr,
+                     rb_data.fsuffix, NULL);
+}
 
+/*
+ * create the next filename and open a new binary file with that name
+ */
+static int ringbuf_open_file(rb_file *rfile, int *err)
+{
+  ringbuf_remove_file(rfile);
+
+  rfile->name = ringbuf_file_name();
   if (rfile->name == NULL) {
     if (err != NULL)
       *err = ENOMEM;
     return -1;
   }
 
-  rb_data.fd = ws_open(rfile->name, O_RDWR|O_BINARY|O_TRUNC|O_CREAT, 
+  rb_data.fd = ws_open(rfile->name, O_RDWR|O_BINARY|O_TRUNC|O_CREAT,
                             rb_data.group_read_access ? 0640 : 0600);
 
   if (rb_data.fd == -1 && err != NULL) {
@@ -132,6 +367,76 @@ static int ringbuf_open_file(rb_file *rfile, int *err)
   return rb_data.fd;
 }
 
+#ifdef RB_PREOPEN
+/*
+ * Have the background thread create the file that will follow the
+ * current one, under a temporary name.  That's a dot file, so that it
+ * doesn't show up as one of the ringbuffer files to anyone looking for
+ * them with "<prefix>_*" until it's renamed.
+ */
+static void
+ringbuf_create_next_file(void)
+{
+  char    filenum[5+1];
+  gchar  *dir, *base, *tmp_name;
+  rb_job *job;
+
+  if (rb_data.worker == NULL)
+    return;
+
+  /* With a single limited file, the next file replaces the current one. */
+  if (rb_data.unlimited == FALSE && rb_data.num_files < 2)
+    return;
+
+  g_snprintf(filenum, sizeof(filenum), "%05u", (rb_data.curr_file_num + 2) % RINGBUFFER_MAX_NUM_FILES);
+  dir = g_path_get_dirname(rb_data.fprefix);
+  base = g_path_get_basename(rb_data.fprefix);
+  tmp_name = g_strconcat(".", base, "_", filenum, "_next", rb_data.fsuffix, NULL);
+  job = g_new0(rb_job, 1);
+  job->type = RB_JOB_CREATE;
+  job->name = g_build_filename(dir, tmp_name, NULL);
+  g_free(tmp_name);
+  g_free(base);
+  g_free(dir);
+  g_async_queue_push(rb_data.jobs, job);
+  rb_data.create_pending = TRUE;
+}
+
+/*
+ * Make the file created ahead of time the current file, giving it its
+ * final name.  Returns the file descriptor, or -1 if there's no such
+ * file, in which case the caller should create one itself.
+ */
+static int
+ringbuf_use_next_file(rb_file *rfile)
+{
+  rb_job *job;
+  gchar  *name;
+  int     fd = -1;
+
+  if (!rb_data.create_pending)
+    return -1;
+
+  job = (rb_job *)g_async_queue_pop(rb_data.created);
+  rb_data.create_pending = FALSE;
+  if (job->fd != -1) {
+    name = ringbuf_file_name();
+    if (ws_rename(job->name, name) == 0) {
+      ringbuf_remove_file(rfile);
+      rfile->name = name;
+      fd = job->fd;
+    } else {
+      ws_close(job->fd);
+      ws_unlink(job->name);
+      g_free(name);
+    }
+  }
+  g_free(job->name);
+  g_free(job);
+  return fd;
+}
+#endif /* RB_PREOPEN */
+
 /*
  * Initialize the ringbuffer data structures
  */
@@ -150,6 +455,10 @@ ringbuf_init(const char *capfile_name, guint num_files, gboolean group_read_acce
   rb_data.fd = -1;
   rb_data.pdh = NULL;
   rb_data.group_read_access = group_read_access;
+  rb_data.worker = NULL;
+  rb_data.jobs = NULL;
+  rb_data.created = NULL;
+  rb_data.create_pending = FALSE;
 
   /* just to be sure ... */
   if (num_files <= RINGBUFFER_MAX_NUM_FILES) {
@@ -216,6 +525,11 @@ ringbuf_init(const char *capfile_name, guint num_files, gboolean group_read_acce
     return -1;
   }
 
+  ringbuf_start_worker();
+#ifdef RB_PREOPEN
+  ringbuf_create_next_file();
+#endif
+
   return rb_data.fd;
 }
 
@@ -248,29 +562,32 @@ ringbuf_switch_file(FILE **pdh, gchar **save_file, int *save_file_fd, int *err)
 {
   int     next_file_index;
   rb_file *next_rfile = NULL;
+  int     close_err;
 
-  /* close current file */
+  /* close current file, in the background if we can */
 
-  if (fclose(rb_data.pdh) == EOF) {
+  close_err = ringbuf_close_file(rb_data.pdh);
+  rb_data.pdh = NULL;
+  rb_data.fd  = -1;
+  if (close_err == 0)
+    close_err = ringbuf_worker_error();
+  if (close_err != 0) {
     if (err != NULL) {
-      *err = errno;
+      *err = close_err;
     }
-    ws_close(rb_data.fd);	/* XXX - the above should have closed this already */
-    rb_data.pdh = NULL;	/* it's still closed, we just got an error while closing */
-    rb_data.fd = -1;
     return FALSE;
   }
 
-  rb_data.pdh = NULL;
-  rb_data.fd  = -1;
-
   /* get the next file number and open it */
 
   rb_data.curr_file_num++ /* = next_file_num*/;
   next_file_index = (rb_data.curr_file_num) % rb_data.num_files;
   next_rfile = &rb_data.files[next_file_index];
 
-  if (ringbuf_open_file(next_rfile, err) == -1) {
+#ifdef RB_PREOPEN
+  rb_data.fd = ringbuf_use_next_file(next_rfile);
+#endif
+  if (rb_data.fd == -1 && ringbuf_open_file(next_rfile, err) == -1) {
     return FALSE;
   }
 
@@ -278,6 +595,10 @@ ringbuf_switch_file(FILE **pdh, gchar **save_file, int *save_file_fd, int *err)
     return FALSE;
   }
 
+#ifdef RB_PREOPEN
+  ringbuf_create_next_file();
+#endif
+
   /* switch to the new file */
   *save_file = next_rfile->name;
   *save_file_fd = rb_data.fd;
@@ -286,6 +607,36 @@ ringbuf_switch_file(FILE **pdh, gchar **save_file, int *save_file_fd, int *err)
   return TRUE;
 }
 
+/*
+ * Writes the flow index of the current ringbuffer file, in the background
+ * if possible; call this before switching files or closing the last one.
+ * The builder is freed once the index has been written, or at once if
+ * there is no current file.
+ */
+void
+ringbuf_write_flow_index(flowindex_builder_t *builder)
+{
+  rb_job *job;
+  const gchar *name = ringbuf_current_filename();
+
+  /* no current file, e.g. after a failed switch */
+  if (name == NULL) {
+    flowindex_builder_free(builder);
+    return;
+  }
+
+  if (rb_data.worker == NULL) {
+    ringbuf_do_write_flow_index(builder, name);
+    return;
+  }
+
+  job = g_new0(rb_job, 1);
+  job->type = RB_JOB_INDEX;
+  job->name = g_strdup(name);
+  job->flow_index = builder;
+  g_async_queue_push(rb_data.jobs, job);
+}
+
 /*
  * Calls fclose() for the current ringbuffer file
  */
@@ -293,6 +644,17 @@ gboolean
 ringbuf_libpcap_dump_close(gchar **save_file, int *err)
 {
   gboolean  ret_val = TRUE;
+  int       worker_err;
+
+  /* let the background thread finish closing and removing files */
+  ringbuf_stop_worker();
+  worker_err = ringbuf_worker_error();
+  if (worker_err != 0) {
+    if (err != NULL) {
+      *err = worker_err;
+    }
+    ret_val = FALSE;
+  }
 
   /* close current file, if it's open */
   if (rb_data.pdh != NULL) {
@@ -348,6 +710,8 @@ ringbuf_error_cleanup(void)
 {
   unsigned int i;
 
+  ringbuf_stop_worker();
+
   /* try to close via wtap */
   if (rb_data.pdh != NULL) {
     if (fclose(rb_data.pdh) == 0) {
@@ -365,7 +729,7 @@ ringbuf_error_cleanup(void)
   if (rb_data.files != NULL) {
     for (i=0; i < rb_data.num_files; i++) {
       if (rb_data.files[i].name != NULL) {
-        ws_unlink(rb_data.files[i].name);
+        ringbuf_unlink(rb_data.files[i].name);
       }
     }
   }
@@ -28,6 +28,7 @@
 #include <stdio.h>
 #include "file.h"
 #include "wiretap/wtap.h"
+#include <wsutil/flowindex.h>
 
 #define RINGBUFFER_UNLIMITED_FILES 0
 /* Minimum number of ringbuffer files */
@@ -46,5 +47,6 @@ gboolean ringbuf_switch_file(FILE **pdh, gchar **save_file, int *save_file_fd,
 gboolean ringbuf_libpcap_dump_close(gchar **save_file, int *err);
 void ringbuf_free(void);
 void ringbuf_error_cleanup(void);
+void ringbuf_write_flow_index(flowindex_builder_t *builder);
 
 #endif /* ringbuffer.h */
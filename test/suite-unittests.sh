@@ -81,6 +81,42 @@ unittests_step_tvbtest() {
 	unittests_step_test
 }
 
+unittests_step_flowindex_test() {
+	DUT=../wsutil/flowindex_test
+	ARGS=
+	unittests_step_test
+}
+
+unittests_step_pktindex_test() {
+	DUT=../wsutil/pktindex_test
+	ARGS=
+	unittests_step_test
+}
+
+unittests_step_pktdedup_test() {
+	DUT=../wsutil/pktdedup_test
+	ARGS=
+	unittests_step_test
+}
+
+unittests_step_hexdump_scanner_test() {
+	DUT=../wsutil/hexdump_scanner_test
+	ARGS=
+	unittests_step_test
+}
+
+unittests_step_shm_ring_test() {
+	DUT=../wsutil/shm_ring_test
+	ARGS=
+	unittests_step_test
+}
+
+unittests_step_colfile_test() {
+	DUT=../wsutil/colfile_test
+	ARGS=
+	unittests_step_test
+}
+
 unittests_step_wmem_test() {
 	DUT=../epan/wmem/wmem_test
 	ARGS=--verbose
@@ -98,6 +134,12 @@ unittests_suite() {
 	test_step_add "reassemble_test" unittests_step_reassemble_test
 	test_step_add "tvbtest" unittests_step_tvbtest
 	test_step_add "wmem_test" unittests_step_wmem_test
+	test_step_add "flowindex_test" unittests_step_flowindex_test
+	test_step_add "pktindex_test" unittests_step_pktindex_test
+	test_step_add "pktdedup_test" unittests_step_pktdedup_test
+	test_step_add "hexdump_scanner_test" unittests_step_hexdump_scanner_test
+	test_step_add "shm_ring_test" unittests_step_shm_ring_test
+	test_step_add "colfile_test" unittests_step_colfile_test
 }
 #
 # Editor modelines  -  http://www.wireshark.org/tools/modelines.html
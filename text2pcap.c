@@ -114,6 +114,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <wsutil/file_util.h>
+#include <wsutil/hexdump_scanner.h>
 
 #include <time.h>
 #include <glib.h>
@@ -1369,6 +1370,34 @@ parse_token (token_t token, char *str)
 
 }
 
+/*----------------------------------------------------------------------
+ * Callbacks for the hex dump scanner.  A run of data bytes has the same
+ * effect as passing each of them to parse_token() as a T_BYTE, but
+ * without parsing each byte's text again.
+ */
+static void
+scan_token (hexdump_token_t token, char *str)
+{
+    parse_token((token_t)token, str);
+}
+
+static void
+scan_bytes (const guint8 *bytes, guint count)
+{
+    guint i;
+
+    if (state != READ_OFFSET && state != READ_BYTE)
+        return;     /* T_BYTE is ignored in the other states */
+
+    state = READ_BYTE;
+    for (i = 0; i < count; i++) {
+        packet_buf[curr_offset] = bytes[i];
+        curr_offset ++;
+        if (curr_offset - header_length >= max_offset) /* packet full */
+            start_new_packet(TRUE);
+    }
+}
+
 /*----------------------------------------------------------------------
  * Print usage string and exit
  */
@@ -1794,6 +1823,8 @@ parse_options (int argc, char *argv[])
 int
 main(int argc, char *argv[])
 {
+    int err;
+
     parse_options(argc, argv);
 
     assert(input_file != NULL);
@@ -1826,8 +1857,15 @@ main(int argc, char *argv[])
     }
     curr_offset = header_length;
 
-    yyin = input_file;
-    yylex();
+    if (debug >= 2) {
+        /* The flex scanner passes every byte through parse_token(),
+           which traces it. */
+        yyin = input_file;
+        yylex();
+    } else if (!hexdump_scan(input_file, scan_token, scan_bytes, &err)) {
+        fprintf(stderr, "Error reading file [%s]: %s\n", input_filename,
+                g_strerror(err));
+    }
 
     write_current_packet(FALSE);
     write_file_trailer();
@@ -0,0 +1,187 @@
+#!/usr/bin/env python
+#
+# Read the columnar files written by "tshark -T columnar", and print their
+# schema or their contents as CSV.  See wsutil/colfile.c for the file
+# format; the ColumnarFile class can be used on its own, to load columns
+# straight into an analysis tool.
+#
+# $Id$
+#
+# Wireshark - Network traffic analyzer
+# By Gerald Combs <gerald@wireshark.org>
+# Copyright 1998 Gerald Combs
+#
+# This program is free software; you can redistribute it and/or
+# modify it under the terms of the GNU General Public License
+# as published by the Free Software Foundation; either version 2
+# of the License, or (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+#
+
+from optparse import OptionParser
+import csv
+import socket
+import struct
+import sys
+
+FILE_MAGIC = b"WSCF"
+CHUNK_MAGIC = b"WSCC"
+FILE_VERSION = 1
+FLAG_MINMAX = 0x01
+
+# Column type -> (name, struct format of a value)
+TYPES = {
+    0: ("string", "<I"),
+    1: ("uint32", "<I"),
+    2: ("int32", "<i"),
+    3: ("uint64", "<Q"),
+    4: ("int64", "<q"),
+    5: ("double", "<d"),
+    6: ("ipv4", "4s"),
+    7: ("ipv6", "16s"),
+    8: ("time", "<q"),
+}
+
+class ColumnarFileError(Exception):
+    pass
+
+class Column:
+    def __init__(self, name, type):
+        if type not in TYPES:
+            raise ColumnarFileError("column %s: unknown type %u" % (name, type))
+        self.name = name
+        self.type = type
+        self.type_name, self.format = TYPES[type]
+        self.width = struct.calcsize(self.format)
+
+    def format_value(self, value):
+        if self.type == 6:
+            return socket.inet_ntop(socket.AF_INET, value)
+        if self.type == 7:
+            return socket.inet_ntop(socket.AF_INET6, value)
+        if self.type == 8:
+            return "%d.%09d" % (value // 1000000000, value % 1000000000)
+        return str(value)
+
+class ColumnarFile:
+    def __init__(self, f):
+        self.f = f
+        hdr = self.read(16)
+        (magic, version, reserved, self.chunk_rows, ncolumns) = struct.unpack("<4sHHII", hdr)
+        if magic != FILE_MAGIC:
+            raise ColumnarFileError("not a columnar file")
+        if version != FILE_VERSION:
+            raise ColumnarFileError("unsupported version %u" % (version))
+        self.columns = []
+        for i in range(ncolumns):
+            (type, reserved, name_len) = struct.unpack("<BBH", self.read(4))
+            self.columns.append(Column(self.read(name_len).decode("utf-8"), type))
+
+    def read(self, n):
+        data = self.f.read(n)
+        if len(data) != n:
+            raise ColumnarFileError("file is truncated")
+        return data
+
+    def chunks(self, wanted=None):
+        """Yield (row count, {column index: list of cells}) for each chunk,
+        where a cell is a list of values; only the wanted columns (all by
+        default) are decoded, the others are skipped."""
+        while True:
+            hdr = self.f.read(12)
+            if len(hdr) == 0:
+                return
+            if len(hdr) != 12:
+                raise ColumnarFileError("file is truncated")
+            (magic, rows, ncolumns) = struct.unpack("<4sII", hdr)
+            if magic != CHUNK_MAGIC or ncolumns != len(self.columns):
+                raise ColumnarFileError("bad chunk header")
+            cells = {}
+            for i in range(ncolumns):
+                (block_len,) = struct.unpack("<I", self.read(4))
+                block = self.read(block_len)
+                if wanted is None or i in wanted:
+                    cells[i] = self.decode_block(self.columns[i], rows, block)
+            yield (rows, cells)
+
+    def decode_block(self, column, rows, block):
+        (value_count, flags) = struct.unpack("<IB", block[:5])
+        off = 8
+        counts = struct.unpack("<%dH" % (rows), block[off:off + 2 * rows])
+        off += 2 * rows
+        if flags & FLAG_MINMAX:
+            off += 2 * column.width
+        if column.type == 0:
+            (dict_count,) = struct.unpack("<I", block[off:off + 4])
+            off += 4
+            strings = []
+            for i in range(dict_count):
+                (str_len,) = struct.unpack("<I", block[off:off + 4])
+                off += 4
+                strings.append(block[off:off + str_len].decode("utf-8", "replace"))
+                off += str_len
+        values = []
+        for i in range(value_count):
+            (value,) = struct.unpack(column.format, block[off:off + column.width])
+            off += column.width
+            values.append(strings[value] if column.type == 0 else column.format_value(value))
+        cells = []
+        pos = 0
+        for count in counts:
+            cells.append(values[pos:pos + count])
+            pos += count
+        return cells
+
+def main():
+    parser = OptionParser(usage="usage: %prog [options] file")
+    parser.add_option("-s", "--schema", dest="schema", action="store_true", default=False,
+                      help="print the columns and their types, rather than the data")
+    parser.add_option("-c", "--columns", dest="columns",
+                      help="only print the columns given, comma-separated", metavar="COLUMNS")
+    parser.add_option("-a", "--aggregator", dest="aggregator", default=",",
+                      help="separator between the values of a cell with several (default ',')", metavar="CHAR")
+
+    (options, args) = parser.parse_args()
+    if len(args) != 1:
+        parser.error("one file must be specified")
+
+    f = open(args[0], "rb")
+    try:
+        cf = ColumnarFile(f)
+        if options.schema:
+            for column in cf.columns:
+                print("%s\t%s" % (column.name, column.type_name))
+            return 0
+
+        names = [column.name for column in cf.columns]
+        if options.columns:
+            wanted = []
+            for name in options.columns.split(","):
+                if name not in names:
+                    parser.error("no column %s" % (name))
+                wanted.append(names.index(name))
+        else:
+            wanted = list(range(len(names)))
+
+        out = csv.writer(sys.stdout)
+        out.writerow([names[i] for i in wanted])
+        for (rows, cells) in cf.chunks(set(wanted)):
+            for row in range(rows):
+                out.writerow([options.aggregator.join(cells[i][row]) for i in wanted])
+    except ColumnarFileError:
+        sys.stderr.write("%s: %s: %s\n" % (sys.argv[0], args[0], sys.exc_info()[1]))
+        return 1
+    finally:
+        f.close()
+    return 0
+
+if __name__ == "__main__":
+    sys.exit(main())
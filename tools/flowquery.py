@@ -0,0 +1,261 @@
+#!/usr/bin/env python
+#
+# Find the capture files written by "dumpcap -x" that contain traffic for
+# a host, port or time window, using the flow indexes (.fidx files) that
+# dumpcap writes next to them, and optionally run tshark on just those
+# files.  See wsutil/flowindex.c for the index file format.
+#
+# $Id$
+#
+# Wireshark - Network traffic analyzer
+# By Gerald Combs <gerald@wireshark.org>
+# Copyright 1998 Gerald Combs
+#
+# This program is free software; you can redistribute it and/or
+# modify it under the terms of the GNU General Public License
+# as published by the Free Software Foundation; either version 2
+# of the License, or (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+#
+
+from optparse import OptionParser
+import calendar
+import glob
+import os
+import shlex
+import socket
+import struct
+import subprocess
+import sys
+import time
+
+INDEX_SUFFIX = ".fidx"
+INDEX_MAGIC = b"WSFI"
+INDEX_VERSION = 1
+HDR_FORMAT = "<4sHHqqIIQQIIII"
+HDR_LEN = struct.calcsize(HDR_FORMAT)
+FLOW_FORMAT = "<BBHHH16s16sQQ"
+FLOW_LEN = struct.calcsize(FLOW_FORMAT)
+
+FNV_OFFSET = 0xcbf29ce484222325
+FNV_PRIME = 0x100000001b3
+MASK64 = 0xffffffffffffffff
+
+class FlowIndexError(Exception):
+    pass
+
+class FlowIndex:
+    def __init__(self, index_file):
+        self.index_file = index_file
+        self.capture_file = index_file[:-len(INDEX_SUFFIX)]
+        f = open(index_file, "rb")
+        try:
+            data = f.read()
+        finally:
+            f.close()
+        if len(data) < HDR_LEN:
+            raise FlowIndexError("%s: file is too short" % (index_file))
+        (magic, version, reserved,
+         self.first_secs, self.last_secs, self.first_nsecs, self.last_nsecs,
+         self.packets, self.bytes, bloom_size, self.bloom_hashes,
+         flow_count, self.untracked) = struct.unpack(HDR_FORMAT, data[:HDR_LEN])
+        if magic != INDEX_MAGIC:
+            raise FlowIndexError("%s: not a flow index" % (index_file))
+        if version != INDEX_VERSION:
+            raise FlowIndexError("%s: unsupported version %u" % (index_file, version))
+        if len(data) < HDR_LEN + bloom_size + flow_count * FLOW_LEN:
+            raise FlowIndexError("%s: file is truncated" % (index_file))
+        self.bloom = bytearray(data[HDR_LEN:HDR_LEN + bloom_size])
+        self.flows = []
+        off = HDR_LEN + bloom_size
+        for i in range(flow_count):
+            self.flows.append(struct.unpack(FLOW_FORMAT, data[off:off + FLOW_LEN]))
+            off += FLOW_LEN
+
+    def bloom_contains(self, key):
+        h = FNV_OFFSET
+        for b in bytearray(key):
+            h = ((h ^ b) * FNV_PRIME) & MASK64
+        h1 = h & 0xffffffff
+        h2 = (h >> 32) | 1
+        nbits = len(self.bloom) * 8
+        if nbits == 0:
+            return False
+        for i in range(self.bloom_hashes):
+            bit = (h1 + i * h2) % nbits
+            if not self.bloom[bit // 8] & (1 << (bit % 8)):
+                return False
+        return True
+
+    def may_contain_host(self, addr):
+        return self.bloom_contains(b"A" + addr)
+
+    def may_contain_port(self, port):
+        return self.bloom_contains(b"P" + struct.pack(">H", port))
+
+    def overlaps(self, start, end):
+        if self.packets == 0:
+            return False
+        first = self.first_secs + self.first_nsecs / 1e9
+        last = self.last_secs + self.last_nsecs / 1e9
+        if start is not None and last < start:
+            return False
+        if end is not None and first > end:
+            return False
+        return True
+
+    def matching_flows(self, hosts, ports):
+        for flow in self.flows:
+            (family, proto, reserved, sport, dport, src, dst, packets, nbytes) = flow
+            alen = 4 if family == 4 else 16
+            src = src[:alen]
+            dst = dst[:alen]
+            if hosts and src not in hosts and dst not in hosts:
+                continue
+            if ports and sport not in ports and dport not in ports:
+                continue
+            yield (family, proto, sport, dport, src, dst, packets, nbytes)
+
+def parse_host(host):
+    for family in (socket.AF_INET, socket.AF_INET6):
+        try:
+            return socket.inet_pton(family, host)
+        except (socket.error, ValueError):
+            pass
+    try:
+        return socket.inet_aton(socket.gethostbyname(host))
+    except socket.error:
+        raise ValueError("invalid host: %s" % (host))
+
+def format_addr(family, addr):
+    if family == 4:
+        return socket.inet_ntop(socket.AF_INET, addr)
+    return "[%s]" % (socket.inet_ntop(socket.AF_INET6, addr))
+
+def parse_time(value):
+    # Seconds since the epoch, or a UTC date and time
+    try:
+        return float(value)
+    except ValueError:
+        pass
+    for fmt in ("%Y-%m-%d %H:%M:%S", "%Y-%m-%dT%H:%M:%S", "%Y-%m-%d %H:%M", "%Y-%m-%d"):
+        try:
+            return float(calendar.timegm(time.strptime(value, fmt)))
+        except ValueError:
+            pass
+    raise ValueError("invalid time: %s" % (value))
+
+def find_index_files(paths):
+    index_files = []
+    for path in paths:
+        if os.path.isdir(path):
+            index_files.extend(sorted(glob.glob(os.path.join(path, "*" + INDEX_SUFFIX))))
+        elif path.endswith(INDEX_SUFFIX):
+            index_files.append(path)
+        else:
+            index_files.append(path + INDEX_SUFFIX)
+    return index_files
+
+def display_filter(hosts, ports):
+    clauses = []
+    if hosts:
+        terms = []
+        for host in hosts:
+            if len(host) == 4:
+                terms.append("ip.addr == %s" % (socket.inet_ntop(socket.AF_INET, host)))
+            else:
+                terms.append("ipv6.addr == %s" % (socket.inet_ntop(socket.AF_INET6, host)))
+        clauses.append("(" + " or ".join(terms) + ")")
+    if ports:
+        terms = []
+        for port in ports:
+            terms.append("tcp.port == %u or udp.port == %u or sctp.port == %u" % (port, port, port))
+        clauses.append("(" + " or ".join(terms) + ")")
+    return " and ".join(clauses)
+
+def main():
+    parser = OptionParser(usage="usage: %prog [options] index_file|capture_file|directory ...")
+    parser.add_option("-H", "--host", dest="hosts", action="append", default=[],
+                      help="select files with traffic to or from HOST; may be repeated", metavar="HOST")
+    parser.add_option("-p", "--port", dest="ports", action="append", type="int", default=[],
+                      help="select files with TCP, UDP or SCTP traffic on PORT; may be repeated", metavar="PORT")
+    parser.add_option("-s", "--start", dest="start",
+                      help="select files with packets at or after TIME (epoch seconds or UTC \"YYYY-MM-DD HH:MM:SS\")", metavar="TIME")
+    parser.add_option("-e", "--end", dest="end",
+                      help="select files with packets at or before TIME", metavar="TIME")
+    parser.add_option("-t", "--tshark", dest="tshark",
+                      help="run TSHARK on each selected file, filtered on the hosts and ports given", metavar="TSHARK")
+    parser.add_option("-a", "--tshark-args", dest="tshark_args", default="",
+                      help="additional arguments for tshark", metavar="ARGS")
+    parser.add_option("-v", "--verbose", dest="verbose", action="store_true", default=False,
+                      help="list the matching flows in each selected file")
+
+    (options, args) = parser.parse_args()
+
+    if len(args) == 0:
+        parser.error("one or more index files, capture files or directories must be specified")
+
+    try:
+        hosts = [parse_host(host) for host in options.hosts]
+        start = parse_time(options.start) if options.start is not None else None
+        end = parse_time(options.end) if options.end is not None else None
+    except ValueError:
+        parser.error(str(sys.exc_info()[1]))
+    ports = options.ports
+    for port in ports:
+        if port < 0 or port > 65535:
+            parser.error("invalid port: %d" % (port))
+
+    # Hosts are alternatives, as are ports; a file has to match one of the
+    # hosts and one of the ports given, and the time window.  The Bloom
+    # filter may report a host or port that isn't in the file, but never
+    # misses one that is, so tshark sees every packet that matches.
+    selected = []
+    for index_file in find_index_files(args):
+        try:
+            index = FlowIndex(index_file)
+        except (IOError, FlowIndexError):
+            sys.stderr.write("%s: %s\n" % (sys.argv[0], sys.exc_info()[1]))
+            continue
+        # An index whose capture file has since been removed (say, by a
+        # ring buffer that went on without us) is of no use.
+        if not os.path.exists(index.capture_file):
+            continue
+        if not index.overlaps(start, end):
+            continue
+        if hosts and not [h for h in hosts if index.may_contain_host(h)]:
+            continue
+        if ports and not [p for p in ports if index.may_contain_port(p)]:
+            continue
+        selected.append(index)
+
+    for index in selected:
+        print(index.capture_file)
+        if options.verbose:
+            for (family, proto, sport, dport, src, dst, packets, nbytes) in index.matching_flows(hosts, ports):
+                print("    proto %u %s:%u -> %s:%u %u packets %u bytes" %
+                      (proto, format_addr(family, src), sport, format_addr(family, dst), dport, packets, nbytes))
+
+    if options.tshark:
+        dfilter = display_filter(hosts, ports)
+        for index in selected:
+            cmd = [options.tshark, "-r", index.capture_file]
+            if dfilter:
+                cmd += ["-Y", dfilter]
+            cmd += shlex.split(options.tshark_args)
+            sys.stdout.flush()
+            if subprocess.call(cmd) != 0:
+                sys.stderr.write("%s: %s failed on %s\n" % (sys.argv[0], options.tshark, index.capture_file))
+
+    return 0 if selected else 1
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -128,7 +128,9 @@ static gboolean perform_two_pass_analysis;
 typedef enum {
   WRITE_TEXT,   /* summary or detail text */
   WRITE_XML,    /* PDML or PSML */
-  WRITE_FIELDS  /* User defined list of fields */
+  WRITE_FIELDS, /* User defined list of fields */
+  WRITE_JSON,   /* JSON or newline-delimited JSON */
+  WRITE_COLUMNAR /* User defined list of fields, as typed binary columns */
   /* Add CSV and the like here */
 } output_action_e;
 
@@ -145,6 +147,8 @@ static print_format_e print_format = PR_FMT_TEXT;
 static print_stream_t *print_stream;
 
 static output_fields_t* output_fields  = NULL;
+static gboolean json_ndjson = FALSE;
+static gboolean fields_from_primed_tree = FALSE;
 
 /* The line separator used between packets, changeable via the -S option */
 static const char *separator = "";
@@ -318,9 +322,10 @@ print_usage(gboolean print_ver)
   fprintf(output, "  -P                       print packet summary even when writing to a file\n");
   fprintf(output, "  -S <separator>           the line separator to print between packets\n");
   fprintf(output, "  -x                       add output of hex and ASCII dump (Packet Bytes)\n");
-  fprintf(output, "  -T pdml|ps|psml|text|fields\n");
+  fprintf(output, "  -T pdml|ps|psml|text|fields|json|ek|columnar\n");
   fprintf(output, "                           format of text output (def: text)\n");
-  fprintf(output, "  -e <field>               field to print if -Tfields selected (e.g. tcp.port, col.Info);\n");
+  fprintf(output, "  -e <field>               field to print if -Tfields, -Tjson, -Tek or\n");
+  fprintf(output, "                           -Tcolumnar selected (e.g. tcp.port, col.Info);\n");
   fprintf(output, "                           this option can be repeated to print multiple fields\n");
   fprintf(output, "  -E<fieldsoption>=<value> set options for output when -Tfields selected:\n");
   fprintf(output, "     header=y|n            switch headers on and off\n");
@@ -1450,9 +1455,23 @@ main(int argc, char *argv[])
         output_action = WRITE_FIELDS;
         print_details = TRUE;   /* Need full tree info */
         print_summary = FALSE;  /* Don't allow summary */
+      } else if (strcmp(optarg, "json") == 0) {
+        output_action = WRITE_JSON;
+        json_ndjson = FALSE;
+        print_details = TRUE;   /* Need full tree info */
+        print_summary = FALSE;  /* Don't allow summary */
+      } else if (strcmp(optarg, "ek") == 0) {
+        output_action = WRITE_JSON;
+        json_ndjson = TRUE;     /* One object per line */
+        print_details = TRUE;   /* Need full tree info */
+        print_summary = FALSE;  /* Don't allow summary */
+      } else if (strcmp(optarg, "columnar") == 0) {
+        output_action = WRITE_COLUMNAR;
+        print_details = TRUE;   /* Need full tree info */
+        print_summary = FALSE;  /* Don't allow summary */
       } else {
         cmdarg_err("Invalid -T parameter.");
-        cmdarg_err_cont("It must be \"ps\", \"text\", \"pdml\", \"psml\" or \"fields\".");
+        cmdarg_err_cont("It must be \"ps\", \"text\", \"pdml\", \"psml\", \"fields\", \"json\", \"ek\" or \"columnar\".");
         return 1;
       }
       break;
@@ -1527,17 +1546,32 @@ main(int argc, char *argv[])
   }
 
   /* If we specified output fields, but not the output field type... */
-  if (WRITE_FIELDS != output_action && 0 != output_fields_num_fields(output_fields)) {
+  if (WRITE_FIELDS != output_action && WRITE_JSON != output_action &&
+      WRITE_COLUMNAR != output_action && 0 != output_fields_num_fields(output_fields)) {
         cmdarg_err("Output fields were specified with \"-e\", "
-            "but \"-Tfields\" was not specified.");
+            "but \"-Tfields\", \"-Tjson\", \"-Tek\" or \"-Tcolumnar\" was not specified.");
         return 1;
   } else if (WRITE_FIELDS == output_action && 0 == output_fields_num_fields(output_fields)) {
         cmdarg_err("\"-Tfields\" was specified, but no fields were "
                     "specified with \"-e\".");
 
+        return 1;
+  } else if (WRITE_COLUMNAR == output_action && 0 == output_fields_num_fields(output_fields)) {
+        cmdarg_err("\"-Tcolumnar\" was specified, but no fields were "
+                    "specified with \"-e\".");
+
         return 1;
   }
 
+  /* "-Tfields" and "-Tcolumnar", and "-Tjson" or "-Tek" with "-e", only
+     need the values of the fields specified with "-e".
+     Unless one of them is printed with its label, don't build a visible
+     protocol tree with labels for every item; prime an invisible tree with
+     just those fields, and pick up their values as they're added. */
+  if (WRITE_FIELDS == output_action || WRITE_COLUMNAR == output_action ||
+      (WRITE_JSON == output_action && 0 != output_fields_num_fields(output_fields)))
+    fields_from_primed_tree = !output_fields_need_labels(output_fields);
+
   /* If no capture filter or display filter has been specified, and there are
      still command-line arguments, treat them as the tokens of a capture
      filter (if no "-r" flag was specified) or a display filter (if a "-r"
@@ -2049,6 +2083,11 @@ main(int argc, char *argv[])
     /* For now, assume libpcap gives microsecond precision. */
     timestamp_set_precision(TS_PREC_AUTO_USEC);
 
+    /* We only read back what dumpcap writes if we're dissecting it;
+       if so, let it hand us the data through shared memory, unless
+       the user turned that off. */
+    global_capture_opts.use_shm_ring = do_dissection && prefs_p->capture_shm_ring;
+
     /*
      * XXX - this returns FALSE if an error occurred, but it also
      * returns FALSE if the capture stops because a time limit
@@ -2513,6 +2552,9 @@ capture_input_new_file(capture_session *cap_session, gchar *new_file)
     /* Attempt to open the capture file and set up to read from it. */
     switch(cf_open((capture_file *)cap_session->cf, capture_opts->save_file, is_tempfile, &err)) {
     case CF_OK:
+      /* take what dumpcap writes from shared memory, where we can */
+      if (cap_session->shm_ring != NULL)
+        wtap_set_shm_ring(((capture_file *)cap_session->cf)->wth, cap_session->shm_ring);
       break;
     case CF_ERROR:
       /* Don't unlink (delete) the save file - leave it around,
@@ -3022,6 +3064,12 @@ load_cap_file(capture_file *cf, char *save_file, int out_file_type,
       }
       goto out;
     }
+    if (!wtap_dump_set_write_behind(pdh, &err)) {
+      show_capture_file_io_error(save_file, err, FALSE);
+      wtap_dump_close(pdh, &err);
+      pdh = NULL;
+      goto out;
+    }
   } else {
     if (print_packet_info) {
       if (!write_preamble(cf)) {
@@ -3314,8 +3362,10 @@ process_packet(capture_file *cf, gint64 offset, struct wtap_pkthdr *whdr,
     /* The protocol tree will be "visible", i.e., printed, only if we're
        printing packet details, which is true if we're printing stuff
        ("print_packet_info" is true) and we're in verbose mode
-       ("packet_details" is true). */
-    epan_dissect_init(&edt, cf->epan, create_proto_tree, print_packet_info && print_details);
+       ("packet_details" is true), other than fields we can get from a
+       primed tree. */
+    epan_dissect_init(&edt, cf->epan, create_proto_tree,
+                      print_packet_info && print_details && !fields_from_primed_tree);
 
     /* If we're running a filter, prime the epan_dissect_t with that
        filter. */
@@ -3324,6 +3374,10 @@ process_packet(capture_file *cf, gint64 offset, struct wtap_pkthdr *whdr,
     if (cf->dfcode)
       epan_dissect_prime_dfilter(&edt, cf->dfcode);
 
+    /* If we're printing fields from a primed tree, prime it with them. */
+    if (print_packet_info && fields_from_primed_tree)
+      output_fields_prime_edt(output_fields, &edt);
+
     col_custom_prime_edt(&edt, &cf->cinfo);
 
     /* We only need the columns if either
@@ -3429,6 +3483,14 @@ write_preamble(capture_file *cf)
     write_fields_preamble(output_fields, stdout);
     return !ferror(stdout);
 
+  case WRITE_JSON:
+    write_json_preamble(stdout, json_ndjson);
+    return !ferror(stdout);
+
+  case WRITE_COLUMNAR:
+    write_columnar_preamble(output_fields, stdout);
+    return !ferror(stdout);
+
   default:
     g_assert_not_reached();
     return FALSE;
@@ -3712,6 +3774,8 @@ print_packet(capture_file *cf, epan_dissect_t *edt)
         proto_tree_write_psml(edt, stdout);
         return !ferror(stdout);
       case WRITE_FIELDS: /*No non-verbose "fields" format */
+      case WRITE_JSON:   /*No non-verbose JSON format */
+      case WRITE_COLUMNAR: /*No non-verbose columnar format */
         g_assert_not_reached();
         break;
       }
@@ -3750,6 +3814,11 @@ print_packet(capture_file *cf, epan_dissect_t *edt)
       proto_tree_write_fields(output_fields, edt, &cf->cinfo, stdout);
       printf("\n");
       return !ferror(stdout);
+    case WRITE_JSON:
+      proto_tree_write_json(output_fields, edt, &cf->cinfo, stdout);
+      return !ferror(stdout);
+    case WRITE_COLUMNAR:
+      return proto_tree_write_columnar(output_fields, edt, &cf->cinfo, stdout);
     }
   }
   if (print_hex) {
@@ -3784,6 +3853,13 @@ write_finale(void)
     write_fields_finale(output_fields, stdout);
     return !ferror(stdout);
 
+  case WRITE_JSON:
+    write_json_finale(stdout);
+    return !ferror(stdout);
+
+  case WRITE_COLUMNAR:
+    return write_columnar_finale(output_fields, stdout);
+
   default:
     g_assert_not_reached();
     return FALSE;
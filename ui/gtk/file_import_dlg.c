@@ -45,7 +45,6 @@
 
 #include "ui/gtk/file_import_dlg.h"
 #include "ui/text_import.h"
-#include "ui/text_import_scanner.h"
 
 #include "file.h"
 #include "wsutil/file_util.h"
@@ -525,9 +524,9 @@ file_import_open(text_import_info_t *info)
 
     text_import_setup(info);
 
-    text_importin = info->import_text_file;
-
-    text_importlex();
+    if (!text_import_read(info, &err)) {
+        read_failure_alert_box(info->import_text_filename, err);
+    }
 
     text_import_cleanup();
 
@@ -843,6 +843,23 @@ packet_list_recreate_visible_rows(void)
 	packet_list_recreate_visible_rows_list(packetlist);
 }
 
+gboolean
+packet_list_begin_rescan(void)
+{
+	/* Rebuilding the visible rows of the store is only done in one go. */
+	return FALSE;
+}
+
+void
+packet_list_rescan_progress(guint32 last_framenum _U_)
+{
+}
+
+void
+packet_list_end_rescan(void)
+{
+}
+
 void packet_list_resize_column(gint col)
 {
 	GtkTreeViewColumn *column;
@@ -30,6 +30,7 @@
 
 #include "config.h"
 
+#include <stdlib.h>
 #include <string.h>
 
 #include <gtk/gtk.h>
@@ -45,6 +46,7 @@
 #include <epan/epan_dissect.h>
 #include <epan/column_info.h>
 #include <epan/column.h>
+#include <epan/prefs.h>
 
 #include "color.h"
 #include "color_filters.h"
@@ -56,10 +58,19 @@
 
 /** PacketListRecord: represents a row */
 typedef struct _PacketListRecord {
-	/** The column text for some columns */
+	/** The column text for some columns; NULL when not cached */
 	const gchar **col_text;
-	/**< The length of the column text strings in 'col_text' */
+	/**< The length of the column text strings in 'col_text'; kept when
+	 *   the text is dropped */
 	gushort *col_text_len;
+	/** Link in packet_list->cached_records, if the text is cached */
+	GList *cache_link;
+
+	/** Sort key for the text column packet_list->sort_keys_col */
+	union {
+		gdouble num;
+		const gchar *str;	/* interned */
+	} sort_key;
 
 	frame_data *fdata;
 
@@ -73,9 +84,17 @@ typedef struct _PacketListRecord {
 
 	/** Has this record been colorized? */
 	guint colorized : 1;
+	/** Has this record got a sort key? */
+	guint has_sort_key : 1;
 
 } PacketListRecord;
 
+/** An interned string: the key of packet_list->strings is 'str'. */
+typedef struct {
+	guint refs;
+	gchar str[1];
+} PacketListString;
+
 static void packet_list_init(PacketList *pkg_tree);
 static void packet_list_class_init(PacketListClass *klass);
 static void packet_list_tree_model_init(GtkTreeModelIface *iface);
@@ -130,6 +149,7 @@ static gboolean packet_list_sortable_has_default_sort_func(GtkTreeSortable
 static void packet_list_sortable_init(GtkTreeSortableIface *iface);
 static void packet_list_resort(PacketList *packet_list);
 static void packet_list_dissect_and_cache_record(PacketList *packet_list, PacketListRecord *record, gboolean dissect_color );
+static void packet_list_free_records(PacketList *packet_list);
 
 static GObjectClass *parent_class = NULL;
 
@@ -257,6 +277,11 @@ packet_list_init(PacketList *packet_list)
 	packet_list->columnized = FALSE;
 	packet_list->sort_id = 0; /* defaults to first column for now */
 	packet_list->sort_order = GTK_SORT_ASCENDING;
+	packet_list->sort_keys_col = -1;
+	packet_list->sort_keys_numeric = FALSE;
+
+	g_queue_init(&packet_list->cached_records);
+	packet_list->strings = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, g_free);
 
 	packet_list->col_to_text = g_new(int, packet_list->n_cols);
 	for (i = 0, j = 0; i < packet_list->n_cols; i++) {
@@ -278,9 +303,13 @@ packet_list_init(PacketList *packet_list)
 static void
 packet_list_finalize(GObject *object)
 {
-	/* PacketList *packet_list = PACKET_LIST(object); */
+	PacketList *packet_list = PACKET_LIST(object);
 
-	/* XXX - Free all records and free all memory used by the list */
+	packet_list_free_records(packet_list);
+	g_ptr_array_free(packet_list->physical_rows, TRUE);
+	g_ptr_array_free(packet_list->visible_rows, TRUE);
+	g_hash_table_destroy(packet_list->strings);
+	g_free(packet_list->col_to_text);
 
 	/* must chain up - finalize parent */
 	(* parent_class->finalize) (object);
@@ -367,6 +396,112 @@ packet_list_get_path(GtkTreeModel *tree_model, GtkTreeIter *iter)
 	return path;
 }
 
+/* Column text is interned: rows often share it (protocol names, the
+ * Info text of retransmissions or of repeated requests), and it's kept
+ * once however many rows hold it. */
+static const gchar *
+packet_list_string_ref(PacketList *packet_list, const gchar *str)
+{
+	PacketListString *pstr;
+	size_t len;
+
+	pstr = (PacketListString *)g_hash_table_lookup(packet_list->strings, str);
+	if (pstr == NULL) {
+		len = strlen(str);
+		pstr = (PacketListString *)g_malloc(sizeof(PacketListString) + len);
+		pstr->refs = 0;
+		memcpy(pstr->str, str, len + 1);
+		g_hash_table_insert(packet_list->strings, pstr->str, pstr);
+	}
+	pstr->refs++;
+	return pstr->str;
+}
+
+/* Drop a reference to a string; strings that weren't interned (constant
+ * strings) are left alone. */
+static void
+packet_list_string_unref(PacketList *packet_list, const gchar *str)
+{
+	PacketListString *pstr;
+
+	if (str == NULL)
+		return;
+
+	pstr = (PacketListString *)g_hash_table_lookup(packet_list->strings, str);
+	if (pstr == NULL || pstr->str != str)
+		return;
+
+	if (--pstr->refs == 0)
+		g_hash_table_remove(packet_list->strings, str);
+}
+
+/* Drop the column text of a record; it's dissected again when needed.
+ * The text lengths and the sort key are kept. */
+static void
+packet_list_uncache_record(PacketList *packet_list, PacketListRecord *record)
+{
+	gint text_col;
+
+	if (record->col_text == NULL)
+		return;
+
+	for (text_col = 0; text_col < packet_list->n_text_cols; text_col++)
+		packet_list_string_unref(packet_list, record->col_text[text_col]);
+	g_free(record->col_text);
+	record->col_text = NULL;
+
+	if (record->cache_link) {
+		g_queue_delete_link(&packet_list->cached_records, record->cache_link);
+		record->cache_link = NULL;
+	}
+}
+
+/* A record's column text was just used: make it the most recently used,
+ * and drop the text of the least recently used records over the limit. */
+static void
+packet_list_record_used(PacketList *packet_list, PacketListRecord *record)
+{
+	GQueue *cached_records = &packet_list->cached_records;
+	guint max_cached = prefs.gui_packet_list_cached_rows_max;
+
+	if (record->col_text == NULL)
+		return;
+
+	if (record->cache_link) {
+		if (record->cache_link != cached_records->head) {
+			g_queue_unlink(cached_records, record->cache_link);
+			g_queue_push_head_link(cached_records, record->cache_link);
+		}
+		return;
+	}
+
+	g_queue_push_head(cached_records, record);
+	record->cache_link = cached_records->head;
+
+	while (max_cached > 0 && cached_records->length > max_cached)
+		packet_list_uncache_record(packet_list,
+			(PacketListRecord *)g_queue_peek_tail(cached_records));
+}
+
+static void
+packet_list_free_records(PacketList *packet_list)
+{
+	PacketListRecord *record;
+	guint i;
+
+	for (i = 0; i < PACKET_LIST_RECORD_COUNT(packet_list->physical_rows); ++i) {
+		record = PACKET_LIST_RECORD_GET(packet_list->physical_rows, i);
+		/* The strings go with the table */
+		g_free(record->col_text);
+		g_free(record->col_text_len);
+		g_slice_free(PacketListRecord, record);
+	}
+
+	g_queue_clear(&packet_list->cached_records);
+	g_hash_table_remove_all(packet_list->strings);
+	packet_list->sort_keys_col = -1;
+}
+
 static void
 packet_list_get_value(GtkTreeModel *tree_model, GtkTreeIter *iter, gint column,
 			  GValue *value)
@@ -398,6 +533,7 @@ packet_list_get_value(GtkTreeModel *tree_model, GtkTreeIter *iter, gint column,
 
 		if (record->col_text == NULL || !record->colorized)
 			packet_list_dissect_and_cache_record(packet_list, record, !record->colorized);
+		packet_list_record_used(packet_list, record);
 
 		text_column = packet_list->col_to_text[column];
 		if (text_column == -1) { /* column based on frame_data */
@@ -578,6 +714,7 @@ packet_list_store_clear(PacketList *packet_list)
 	*/
 
 	/* XXX - hold on to these rows and reuse them instead */
+	packet_list_free_records(packet_list);
 	if(packet_list->physical_rows)
 		g_ptr_array_free(packet_list->physical_rows, TRUE);
 	if(packet_list->visible_rows)
@@ -603,10 +740,12 @@ packet_list_append_record(PacketList *packet_list, frame_data *fdata)
 
 	g_return_val_if_fail(PACKETLIST_IS_LIST(packet_list), -1);
 
-	newrecord = se_new(PacketListRecord);
+	newrecord = g_slice_new(PacketListRecord);
 	newrecord->colorized    = FALSE;
+	newrecord->has_sort_key = FALSE;
 	newrecord->col_text_len = NULL;
 	newrecord->col_text     = NULL;
+	newrecord->cache_link   = NULL;
 	newrecord->fdata        = fdata;
 #ifdef PACKET_PARANOID_CHECKS
 	newrecord->physical_pos = PACKET_LIST_RECORD_COUNT(packet_list->physical_rows);
@@ -653,7 +792,7 @@ packet_list_append_record(PacketList *packet_list, frame_data *fdata)
 static void
 packet_list_change_record(PacketList *packet_list, PacketListRecord *record, gint col, column_info *cinfo)
 {
-	gchar *str;
+	const gchar *str;
 	size_t col_text_len;
 	int text_col;
 
@@ -718,13 +857,11 @@ packet_list_change_record(PacketList *packet_list, PacketListRecord *record, gin
 				break;
 			}
 
-			if(!packet_list->string_pool)
-				packet_list->string_pool = g_string_chunk_new(32);
 			if (!get_column_resolved (col) && cinfo->col_expr.col_expr_val[col]) {
 				/* Use the unresolved value in col_expr_val */
-				str = g_string_chunk_insert_const (packet_list->string_pool, (const gchar *)cinfo->col_expr.col_expr_val[col]);
+				str = packet_list_string_ref(packet_list, (const gchar *)cinfo->col_expr.col_expr_val[col]);
 			} else {
-				str = g_string_chunk_insert_const (packet_list->string_pool, (const gchar *)cinfo->col_data[col]);
+				str = packet_list_string_ref(packet_list, (const gchar *)cinfo->col_data[col]);
 			}
 			record->col_text[text_col] = str;
 			break;
@@ -755,13 +892,67 @@ packet_list_sortable_get_sort_column_id(GtkTreeSortable *sortable,
 static gboolean
 packet_list_column_contains_values(PacketList *packet_list, gint sort_col_id)
 {
-	if (packet_list->columnized || col_based_on_frame_data(&cfile.cinfo, sort_col_id))
+	if (col_based_on_frame_data(&cfile.cinfo, sort_col_id))
 		return TRUE;
-	else
+	if (packet_list->columnized &&
+	    packet_list->sort_keys_col == packet_list->col_to_text[sort_col_id])
+		return TRUE;
+	return FALSE;
+}
+
+static gboolean
+packet_list_custom_column_is_numeric(gint col)
+{
+	header_field_info *hfi;
+
+	if (cfile.cinfo.col_fmt[col] != COL_CUSTOM)
 		return FALSE;
+
+	hfi = proto_registrar_get_byname(cfile.cinfo.col_custom_field[col]);
+
+	return hfi != NULL && hfi->strings == NULL &&
+	       (((IS_FT_INT(hfi->type) || IS_FT_UINT(hfi->type)) &&
+		 ((hfi->display == BASE_DEC) || (hfi->display == BASE_DEC_HEX) ||
+		  (hfi->display == BASE_OCT))) ||
+		(hfi->type == FT_DOUBLE) || (hfi->type == FT_FLOAT) ||
+		(hfi->type == FT_BOOLEAN) || (hfi->type == FT_FRAMENUM) ||
+		(hfi->type == FT_RELATIVE_TIME));
+}
+
+/* Sorting by a column not based on frame_data compares a key kept in each
+ * record rather than the column text, which may have been dropped: a
+ * number for custom columns of numeric fields, or the interned text. */
+static void
+packet_list_clear_sort_keys(PacketList *packet_list)
+{
+	PacketListRecord *record;
+	guint i;
+
+	for (i = 0; i < PACKET_LIST_RECORD_COUNT(packet_list->physical_rows); ++i) {
+		record = PACKET_LIST_RECORD_GET(packet_list->physical_rows, i);
+		if (record->has_sort_key && !packet_list->sort_keys_numeric)
+			packet_list_string_unref(packet_list, record->sort_key.str);
+		record->has_sort_key = FALSE;
+	}
+	packet_list->sort_keys_col = -1;
+}
+
+static void
+packet_list_set_sort_key(PacketList *packet_list, PacketListRecord *record)
+{
+	const gchar *text = record->col_text[packet_list->sort_keys_col];
+
+	if (packet_list->sort_keys_numeric)
+		record->sort_key.num = atof(text);
+	else
+		record->sort_key.str = packet_list_string_ref(packet_list, text);
+	record->has_sort_key = TRUE;
 }
 
 /* packet_list_dissect_and_cache_all()
+ *  Get the column text lengths of all the records, and, if sort_col_id
+ *  isn't -1 or a column based on frame_data, their sort keys for it.
+ *  The column text of records not already cached isn't kept.
  *  returns:
  *   TRUE   if columnization completed;
  *            packet_list->columnized set to TRUE;
@@ -770,9 +961,11 @@ packet_list_column_contains_values(PacketList *packet_list, gint sort_col_id)
  */
 
 static gboolean
-packet_list_dissect_and_cache_all(PacketList *packet_list)
+packet_list_dissect_and_cache_all(PacketList *packet_list, gint sort_col_id)
 {
 	PacketListRecord *record;
+	gint		text_col;
+	gboolean	was_cached;
 
 	int 		progbar_nextstep;
 	int 		progbar_quantum;
@@ -785,7 +978,15 @@ packet_list_dissect_and_cache_all(PacketList *packet_list)
 	gint		progbar_loop_var;
 	gint		progbar_updates = 100 /* 100% */;
 
-	g_assert(packet_list->columnized == FALSE);
+	text_col = (sort_col_id == -1) ? -1 : packet_list->col_to_text[sort_col_id];
+	if (text_col != -1 && text_col != packet_list->sort_keys_col) {
+		packet_list_clear_sort_keys(packet_list);
+		packet_list->sort_keys_col = text_col;
+		packet_list->sort_keys_numeric = packet_list_custom_column_is_numeric(sort_col_id);
+		packet_list->columnized = FALSE;
+	}
+	/* Keep the sort keys up to date, whatever we were called for */
+	text_col = packet_list->sort_keys_col;
 
 	progbar_loop_max = PACKET_LIST_RECORD_COUNT(packet_list->physical_rows);
 	/* Update the progress bar when it gets to this value. */
@@ -803,7 +1004,16 @@ packet_list_dissect_and_cache_all(PacketList *packet_list)
 
 	for (progbar_loop_var = 0; progbar_loop_var < progbar_loop_max; ++progbar_loop_var) {
 		record = PACKET_LIST_RECORD_GET(packet_list->physical_rows, progbar_loop_var);
-		packet_list_dissect_and_cache_record(packet_list, record, FALSE);
+		if (record->col_text_len == NULL || (text_col != -1 && !record->has_sort_key)) {
+			was_cached = (record->col_text != NULL);
+			if (!was_cached)
+				packet_list_dissect_and_cache_record(packet_list, record, FALSE);
+			if (text_col != -1 && !record->has_sort_key)
+				packet_list_set_sort_key(packet_list, record);
+			/* Don't push the rows being looked at out of the cache */
+			if (!was_cached)
+				packet_list_uncache_record(packet_list, record);
+		}
 
 		/* Create the progress bar if necessary.
 		   We check on every iteration of the loop, so that it takes no
@@ -864,7 +1074,7 @@ gboolean
 packet_list_do_packet_list_dissect_and_cache_all(PacketList *packet_list, gint sort_col_id)
 {
 	if (!packet_list_column_contains_values(packet_list, sort_col_id)) {
-		return packet_list_dissect_and_cache_all(packet_list);
+		return packet_list_dissect_and_cache_all(packet_list, sort_col_id);
 	}
 	return TRUE;
 }
@@ -928,63 +1138,37 @@ packet_list_sortable_has_default_sort_func(GtkTreeSortable *sortable _U_)
 }
 
 static gint
-packet_list_compare_custom(gint sort_id, gint text_sort_id, PacketListRecord *a, PacketListRecord *b)
+packet_list_compare_sort_keys(PacketList *packet_list, PacketListRecord *a, PacketListRecord *b)
 {
-	header_field_info *hfi;
+	/* Records appended since the keys were made are left in frame order */
+	if (!a->has_sort_key || !b->has_sort_key)
+		return 0;
 
-	hfi = proto_registrar_get_byname(cfile.cinfo.col_custom_field[sort_id]);
-
-	if (hfi == NULL) {
-		return frame_data_compare(cfile.epan, a->fdata, b->fdata, COL_NUMBER);
-	} else if ((hfi->strings == NULL) &&
-		   (((IS_FT_INT(hfi->type) || IS_FT_UINT(hfi->type)) &&
-		     ((hfi->display == BASE_DEC) || (hfi->display == BASE_DEC_HEX) ||
-		      (hfi->display == BASE_OCT))) ||
-		    (hfi->type == FT_DOUBLE) || (hfi->type == FT_FLOAT) ||
-		    (hfi->type == FT_BOOLEAN) || (hfi->type == FT_FRAMENUM) ||
-		    (hfi->type == FT_RELATIVE_TIME)))
-	  {
-		/* Attempt to convert to numbers */
-		double num_a = atof(a->col_text[text_sort_id]);
-		double num_b = atof(b->col_text[text_sort_id]);
-
-		if (num_a < num_b)
+	if (packet_list->sort_keys_numeric) {
+		if (a->sort_key.num < b->sort_key.num)
 			return -1;
-		else if (num_a > num_b)
+		else if (a->sort_key.num > b->sort_key.num)
 			return 1;
 		else
 			return 0;
-	  }
-
-	return strcmp(a->col_text[text_sort_id], b->col_text[text_sort_id]);
-}
-
-static gint
-_packet_list_compare_records(gint sort_id, gint text_sort_id, PacketListRecord *a, PacketListRecord *b)
-{
-	g_assert(a->col_text);
-	g_assert(b->col_text);
-	g_assert(a->col_text[text_sort_id]);
-	g_assert(b->col_text[text_sort_id]);
-
-	if(a->col_text[text_sort_id] == b->col_text[text_sort_id])
-		return 0; /* no need to call strcmp() */
+	}
 
-	if (cfile.cinfo.col_fmt[sort_id] == COL_CUSTOM)
-		return packet_list_compare_custom(sort_id, text_sort_id, a, b);
+	if (a->sort_key.str == b->sort_key.str)
+		return 0; /* interned; no need to call strcmp() */
 
-	return strcmp(a->col_text[text_sort_id], b->col_text[text_sort_id]);
+	return strcmp(a->sort_key.str, b->sort_key.str);
 }
 
 static gint
-packet_list_compare_records(gint sort_id, gint text_sort_id, PacketListRecord *a, PacketListRecord *b)
+packet_list_compare_records(PacketList *packet_list, gint sort_id, gint text_sort_id, PacketListRecord *a, PacketListRecord *b)
 {
-	gint ret;
+	gint ret = 0;
 
 	if (text_sort_id == -1)	/* based on frame_data ? */
 		return frame_data_compare(cfile.epan, a->fdata, b->fdata, cfile.cinfo.col_fmt[sort_id]);
 
-	ret = _packet_list_compare_records(sort_id, text_sort_id, a, b);
+	if (text_sort_id == packet_list->sort_keys_col)
+		ret = packet_list_compare_sort_keys(packet_list, a, b);
 	if (ret == 0)
 		ret = frame_data_compare(cfile.epan, a->fdata, b->fdata, COL_NUMBER);
 	return ret;
@@ -999,7 +1183,7 @@ packet_list_qsort_physical_compare_func(PacketListRecord **a, PacketListRecord *
 
 	g_assert((a) && (b) && (packet_list));
 
-	ret = packet_list_compare_records(sort_id, packet_list->col_to_text[sort_id], *a, *b);
+	ret = packet_list_compare_records(packet_list, sort_id, packet_list->col_to_text[sort_id], *a, *b);
 
 	/* Swap -1 and 1 if sort order is reverse */
 	if(ret != 0 && packet_list->sort_order == GTK_SORT_DESCENDING)
@@ -1108,8 +1292,9 @@ packet_list_dissect_and_cache_record(PacketList *packet_list, PacketListRecord *
 	if (dissect_columns) {
 		cinfo = &cfile.cinfo;
 
-		record->col_text     = (const gchar **)se_alloc0(sizeof(*record->col_text) * packet_list->n_text_cols);
-		record->col_text_len = (gushort *)se_alloc0(sizeof(*record->col_text_len) * packet_list->n_text_cols);
+		record->col_text = g_new0(const gchar *, packet_list->n_text_cols);
+		if (record->col_text_len == NULL)
+			record->col_text_len = g_new0(gushort, packet_list->n_text_cols);
 	} else
 		cinfo = NULL;
 
@@ -1234,20 +1419,28 @@ packet_list_get_widest_column_string(PacketList *packet_list, gint col)
 		PacketListRecord *record;
 		guint vis_idx;
 
-		const gchar *widest_column_str = NULL;
+		PacketListRecord *widest_record = NULL;
 		guint widest_column_len = 0;
 
 		if (!packet_list->columnized)
-			packet_list_dissect_and_cache_all(packet_list); /* XXX: need to handle case of "incomplete" ? */
+			packet_list_dissect_and_cache_all(packet_list, -1); /* XXX: need to handle case of "incomplete" ? */
 
 		for(vis_idx = 0; vis_idx < PACKET_LIST_RECORD_COUNT(packet_list->visible_rows); ++vis_idx) {
 			record = PACKET_LIST_RECORD_GET(packet_list->visible_rows, vis_idx);
-			if (record->col_text_len[text_col] > widest_column_len) {
-				widest_column_str = record->col_text[text_col];
+			if (record->col_text_len && record->col_text_len[text_col] > widest_column_len) {
+				widest_record = record;
 				widest_column_len = record->col_text_len[text_col];
 			}
 		}
 
-		return widest_column_str;
+		if (widest_record == NULL)
+			return NULL;
+
+		/* Only the lengths are kept for every record; get the text back */
+		if (widest_record->col_text == NULL)
+			packet_list_dissect_and_cache_record(packet_list, widest_record, FALSE);
+		packet_list_record_used(packet_list, widest_record);
+
+		return widest_record->col_text[text_col];
 	}
 }
@@ -75,7 +75,16 @@ struct _PacketList
 	gint sort_id;
 	GtkSortType sort_order;
 
-	GStringChunk *string_pool;
+	/** Text column whose sort keys the records hold, -1 if none. */
+	gint sort_keys_col;
+	/** Are the sort keys numbers rather than strings? */
+	gboolean sort_keys_numeric;
+
+	/** Records holding column text, most recently used first; only
+	 *  prefs.gui_packet_list_cached_rows_max of them are kept. */
+	GQueue cached_records;
+	/** Column text and string sort keys, interned and reference counted. */
+	GHashTable *strings;
 
 	/** Random integer to check whether an iter belongs to our model. */
 	gint stamp;
@@ -247,6 +247,7 @@ prefs_to_capture_opts(void)
     global_capture_opts.use_pcapng                   = prefs.capture_pcap_ng;
     global_capture_opts.show_info                    = prefs.capture_show_info;
     global_capture_opts.real_time_mode               = prefs.capture_real_time;
+    global_capture_opts.use_shm_ring                 = prefs.capture_shm_ring;
     auto_scroll_live                                 = prefs.capture_auto_scroll;
 #endif /* HAVE_LIBPCAP */
 }
@@ -35,6 +35,11 @@
 
 #include "ui/utf8_entities.h"
 
+// Filters longer than this are checked once typing pauses rather than
+// on every keystroke.
+const int max_immediate_check_len_ = 1000;
+const int check_delay_ = 250; // ms
+
 // platform
 //   osx
 //   win
@@ -157,7 +162,10 @@ DisplayFilterEdit::DisplayFilterEdit(QWidget *parent, bool plain) :
             );
     clear_button_->hide();
     connect(clear_button_, SIGNAL(clicked()), this, SLOT(clear()));
-    connect(this, SIGNAL(textChanged(const QString&)), this, SLOT(checkFilter(const QString&)));
+    check_timer_.setSingleShot(true);
+    check_timer_.setInterval(check_delay_);
+    connect(&check_timer_, SIGNAL(timeout()), this, SLOT(checkFilter()));
+    connect(this, SIGNAL(textChanged(const QString&)), this, SLOT(filterTextChanged(const QString&)));
 
     if (!plain_) {
         apply_button_ = new QToolButton(this);
@@ -255,13 +263,24 @@ void DisplayFilterEdit::resizeEvent(QResizeEvent *)
     bookmark_button_->setMaximumHeight(contentsRect().height());
 }
 
-void DisplayFilterEdit::checkFilter(const QString& text)
+void DisplayFilterEdit::filterTextChanged(const QString& text)
+{
+    clear_button_->setVisible(!text.isEmpty());
+
+    if (text.length() > max_immediate_check_len_) {
+        check_timer_.start();
+    } else {
+        check_timer_.stop();
+        checkFilter();
+    }
+}
+
+void DisplayFilterEdit::checkFilter()
 {
+    QString text = this->text();
     dfilter_t *dfp;
     guchar c;
 
-    clear_button_->setVisible(!text.isEmpty());
-
     popFilterSyntaxStatus();
 
     if (field_name_only_ && (c = proto_check_field_name(text.toUtf8().constData()))) {
@@ -309,6 +328,12 @@ void DisplayFilterEdit::bookmarkClicked()
 
 void DisplayFilterEdit::applyDisplayFilter()
 {
+    // Don't apply a filter that hasn't been checked yet.
+    if (check_timer_.isActive()) {
+        check_timer_.stop();
+        checkFilter();
+    }
+
     if (syntaxState() != Valid && syntaxState() != Empty) {
         return;
     }
@@ -24,6 +24,7 @@
 #ifndef DISPLAYFILTEREDIT_H
 #define DISPLAYFILTEREDIT_H
 
+#include <QTimer>
 #include <QToolButton>
 #include "syntax_line_edit.h"
 
@@ -44,7 +45,8 @@ public slots:
     void displayFilterSuccess(bool success);
 
 private slots:
-    void checkFilter(const QString &text);
+    void filterTextChanged(const QString &text);
+    void checkFilter();
     void bookmarkClicked();
 
 private:
@@ -54,6 +56,7 @@ private:
     QToolButton *bookmark_button_;
     QToolButton *clear_button_;
     QToolButton *apply_button_;
+    QTimer check_timer_;
 
 signals:
     void pushFilterSyntaxStatus(QString&);
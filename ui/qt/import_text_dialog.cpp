@@ -32,7 +32,6 @@
 
 #include <epan/prefs.h>
 
-#include "ui/text_import_scanner.h"
 #include "ui/last_open_dir.h"
 #include "ui/alert_box.h"
 #include "ui/help_url.h"
@@ -133,9 +132,10 @@ void ImportTextDialog::convertTextFile() {
 
     text_import_setup(&import_info_);
 
-    text_importin = import_info_.import_text_file;
-
-    text_importlex();
+    if (!text_import_read(&import_info_, &err))
+    {
+        read_failure_alert_box(import_info_.import_text_filename, err);
+    }
 
     text_import_cleanup();
 
@@ -186,6 +186,34 @@ packet_list_recreate_visible_rows(void)
     }
 }
 
+gboolean
+packet_list_begin_rescan(void)
+{
+    if (gbl_cur_packet_list && gbl_cur_packet_list->packetListModel()) {
+        gbl_cur_packet_list->packetListModel()->beginRescan();
+        return TRUE;
+    }
+    return FALSE;
+}
+
+void
+packet_list_rescan_progress(guint32 last_framenum)
+{
+    if (gbl_cur_packet_list && gbl_cur_packet_list->packetListModel()) {
+        gbl_cur_packet_list->packetListModel()->addRescannedRows(last_framenum);
+    }
+    packets_bar_update();
+}
+
+void
+packet_list_end_rescan(void)
+{
+    if (gbl_cur_packet_list && gbl_cur_packet_list->packetListModel()) {
+        gbl_cur_packet_list->packetListModel()->endRescan();
+    }
+    packets_bar_update();
+}
+
 frame_data *
 packet_list_get_row_data(gint row)
 {
@@ -240,6 +268,16 @@ PacketList::PacketList(QWidget *parent) :
     setModel(packet_list_model_);
     packet_list_model_->setColorEnabled(recent.packet_list_colorize);
 
+    // Once scrolling pauses, dissect the rows around the visible ones.
+    prefetch_timer_.setSingleShot(true);
+    prefetch_timer_.setInterval(100);
+    connect(&prefetch_timer_, SIGNAL(timeout()), this, SLOT(prefetchColumnStrings()));
+    connect(verticalScrollBar(), SIGNAL(valueChanged(int)), &prefetch_timer_, SLOT(start()));
+
+    // Name resolution and coloring preferences change the column text
+    // and colors of the rows already dissected.
+    connect(wsApp, SIGNAL(preferencesChanged()), this, SLOT(preferencesChanged()));
+
     ctx_menu_.addAction(window()->findChild<QAction *>("actionEditMarkPacket"));
     ctx_menu_.addAction(window()->findChild<QAction *>("actionEditIgnorePacket"));
     ctx_menu_.addAction(window()->findChild<QAction *>("actionEditSetTimeReference"));
@@ -470,6 +508,7 @@ void PacketList::setFrameMark(gboolean set, frame_data *fdata)
         cf_mark_frame(cap_file_, fdata);
     else
         cf_unmark_frame(cap_file_, fdata);
+    packet_list_model_->invalidateFrame(fdata);
 }
 
 void PacketList::setFrameIgnore(gboolean set, frame_data *fdata)
@@ -478,6 +517,7 @@ void PacketList::setFrameIgnore(gboolean set, frame_data *fdata)
         cf_ignore_frame(cap_file_, fdata);
     else
         cf_unignore_frame(cap_file_, fdata);
+    packet_list_model_->invalidateFrame(fdata);
 }
 
 void PacketList::setFrameReftime(gboolean set, frame_data *fdata)
@@ -491,6 +531,7 @@ void PacketList::setFrameReftime(gboolean set, frame_data *fdata)
         cap_file_->ref_time_count--;
     }
     cf_reftime_packets(cap_file_);
+    packet_list_model_->invalidateFrame(fdata);
     if (!fdata->flags.ref_time && !fdata->flags.passed_dfilter) {
         cap_file_->displayed_count--;
         packet_list_model_->recreateVisibleRows();
@@ -498,9 +539,11 @@ void PacketList::setFrameReftime(gboolean set, frame_data *fdata)
     updateAll();
 }
 
-// Redraw the packet list and detail
+// Redraw the packet list and detail. The column text of the rows is
+// kept; see resetColumns().
 void PacketList::updateAll() {
     update();
+    viewport()->update();
 
     if (!cap_file_) return;
 
@@ -511,7 +554,12 @@ void PacketList::updateAll() {
     if (cap_file_->edt && cap_file_->edt->tree) {
         proto_tree_->fillProtocolTree(cap_file_->edt->tree);
     }
+}
 
+// Forget the column text, colors and sort keys of the rows dissected so
+// far, when the columns or what's shown in them changed.
+void PacketList::resetColumns()
+{
     packet_list_model_->resetColumns();
 }
 
@@ -661,6 +709,7 @@ void PacketList::setPacketComment(QString new_comment)
     }
 
     cf_set_user_packet_comment(cap_file_, fdata, new_packet_comment);
+    packet_list_model_->invalidateFrame(fdata);
 
     updateAll();
 }
@@ -794,6 +843,7 @@ void PacketList::setTimeReference()
                 timestamp_set_type(TS_RELATIVE);
                 recent.gui_time_format  = TS_RELATIVE;
                 cf_timestamp_auto_precision(cap_file_);
+                resetColumns();
             }
         } else {
             setFrameReftime(!cap_file_->current_frame->flags.ref_time,
@@ -824,6 +874,29 @@ void PacketList::addRelatedFrame(int related_frame)
     related_packet_delegate_.addRelatedFrame(related_frame);
 }
 
+// Dissect a screenful of rows above and below the visible ones, so that
+// scrolling a little further shows cached text.
+void PacketList::prefetchColumnStrings()
+{
+    QModelIndex first = indexAt(viewport()->rect().topLeft());
+    QModelIndex last = indexAt(viewport()->rect().bottomLeft());
+
+    if (!first.isValid())
+        return;
+
+    int last_row = last.isValid() ? last.row() : packet_list_model_->rowCount() - 1;
+    int page = last_row - first.row() + 1;
+
+    packet_list_model_->prefetchColumnStrings(first.row() - page, last_row + page);
+}
+
+// Column and name resolution preferences change the text of every row.
+void PacketList::preferencesChanged()
+{
+    resetColumns();
+    updateAll();
+}
+
 /*
  * Editor modelines
  *
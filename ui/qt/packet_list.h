@@ -32,6 +32,7 @@
 #include <QTreeView>
 #include <QTreeWidget>
 #include <QMenu>
+#include <QTimer>
 
 // It might make more sense to subclass QTableView here.
 class PacketList : public QTreeView
@@ -43,6 +44,7 @@ public:
     void setProtoTree(ProtoTree *proto_tree);
     void setByteViewTab(ByteViewTab *byteViewTab);
     void updateAll();
+    void resetColumns();
     void clear();
     void writeRecent(FILE *rf);
     bool contextMenuActive();
@@ -66,6 +68,7 @@ private:
     QList<QAction *> filter_actions_;
     int ctx_column_;
     RelatedPacketDelegate related_packet_delegate_;
+    QTimer prefetch_timer_;
 
     void markFramesReady();
     void setFrameMark(gboolean set, frame_data *fdata);
@@ -91,6 +94,8 @@ public slots:
 
 private slots:
     void addRelatedFrame(int related_frame);
+    void prefetchColumnStrings();
+    void preferencesChanged();
 };
 
 #endif // PACKET_LIST_H
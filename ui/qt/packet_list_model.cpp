@@ -28,6 +28,7 @@
 #include <epan/column.h>
 #include <wsutil/nstime.h>
 #include <epan/prefs.h>
+#include <epan/proto.h>
 
 #include "ui/packet_list_utils.h"
 #include "ui/recent.h"
@@ -38,12 +39,23 @@
 
 #include "wireshark_application.h"
 #include <QColor>
+#include <QHash>
 #include <QModelIndex>
+#include <QProgressDialog>
+
+// Rows whose column text is kept; many screenfuls.
+static const int max_cached_rows_ = 5000;
 
 PacketListModel::PacketListModel(QObject *parent, capture_file *cf) :
-    QAbstractItemModel(parent)
+    QAbstractItemModel(parent),
+    rescanned_rows_(-1),
+    sort_column_(-1),
+    sort_order_(Qt::AscendingOrder),
+    sort_keys_column_(-1),
+    sort_keys_numeric_(false)
 {
     cap_file_ = cf;
+    col_text_cache_.setMaxCost(max_cached_rows_);
 }
 
 void PacketListModel::setCaptureFile(capture_file *cf)
@@ -87,26 +99,96 @@ guint PacketListModel::recreateVisibleRows()
         }
     }
     endInsertRows();
+    resort();
     return visible_rows_.count();
 }
 
+// Refiltering. Rather than hiding everything until the whole file has
+// been rescanned, empty the list and show the rows that passed the filter
+// as the rescan gets to them. Packets appended in the meantime are shown
+// when the rescan ends.
+void PacketListModel::beginRescan()
+{
+    beginResetModel();
+    visible_rows_.clear();
+    rescanned_rows_ = 0;
+    endResetModel();
+}
+
+void PacketListModel::addRescannedRows(guint32 last_framenum)
+{
+    QVector<PacketListRecord *> new_rows;
+
+    if (rescanned_rows_ < 0)
+        return;
+
+    while (rescanned_rows_ < physical_rows_.count()) {
+        PacketListRecord *record = physical_rows_[rescanned_rows_];
+        frame_data *fdata = record->getFdata();
+
+        if (fdata->num > last_framenum)
+            break;
+        if (fdata->flags.passed_dfilter || fdata->flags.ref_time) {
+            new_rows << record;
+        }
+        rescanned_rows_++;
+    }
+
+    if (new_rows.isEmpty())
+        return;
+
+    int pos = visible_rows_.count();
+    beginInsertRows(QModelIndex(), pos, pos + new_rows.count() - 1);
+    visible_rows_ += new_rows;
+    endInsertRows();
+}
+
+void PacketListModel::endRescan()
+{
+    addRescannedRows(G_MAXUINT32);
+    rescanned_rows_ = -1;
+    resort();
+}
+
 void PacketListModel::setColorEnabled(bool enable_color) {
     enable_color_ = enable_color;
+    invalidateColumnStrings();
 }
 
 void PacketListModel::clear() {
     beginResetModel();
     physical_rows_.clear();
     visible_rows_.clear();
+    if (rescanned_rows_ > 0)
+        rescanned_rows_ = 0;
+    invalidateColumnStrings();
     endResetModel();
 }
 
+// The column text of every frame may have changed, e.g. the columns
+// themselves or name resolution.
 void PacketListModel::resetColumns()
 {
     beginResetModel();
+    invalidateColumnStrings();
     endResetModel();
 }
 
+// Only the column text of one frame may have changed, e.g. it was marked
+// or commented. Its row shows the new text the next time it's drawn; its
+// sort key is made again the next time the list is sorted.
+void PacketListModel::invalidateFrame(frame_data *fdata)
+{
+    if (!fdata)
+        return;
+
+    col_text_cache_.remove(fdata->num);
+
+    int count = sort_keys_numeric_ ? sort_num_keys_.count() : sort_text_keys_.count();
+    if (sort_keys_column_ >= 0 && fdata->num <= (guint32) count)
+        stale_sort_keys_ << fdata->num;
+}
+
 int PacketListModel::rowCount(const QModelIndex &parent) const
 {
     if (!cap_file_) return 0;
@@ -197,53 +279,75 @@ QVariant PacketListModel::data(const QModelIndex &index, int role) const
     int col_num = index.column();
 //    g_log(NULL, G_LOG_LEVEL_DEBUG, "showing col %d", col_num);
 
-    if (!cap_file_ || col_num > cap_file_->cinfo.num_cols)
+    if (!cap_file_ || col_num >= cap_file_->cinfo.num_cols)
+        return QVariant();
+
+    // Dissecting the frame also colorizes it, so look up its text even for
+    // a column based on frame data.
+    const QStringList *col_text = columnStrings(fdata);
+
+    // Columns based on frame data are cheap to fill in, and they change
+    // with the time format and time references; don't cache them.
+    if (col_based_on_frame_data(&cap_file_->cinfo, col_num))
+        return record->data(col_num, &cap_file_->cinfo);
+
+    if (!col_text || col_num >= col_text->count())
         return QVariant();
 
+    return col_text->at(col_num);
+}
+
+// Return the column text of a frame, dissecting it unless it was shown
+// recently. The columns based on frame data are left empty. NULL if the
+// frame couldn't be read.
+const QStringList *PacketListModel::columnStrings(frame_data *fdata) const
+{
+    QStringList *col_text = col_text_cache_.object(fdata->num);
+
+    if (!col_text) {
+        col_text = dissectColumnStrings(fdata);
+        if (col_text)
+            col_text_cache_.insert(fdata->num, col_text);
+    }
+    return col_text;
+}
+
+// Dissect a frame and return a new list of its column text, or NULL if
+// it couldn't be read.
+QStringList *PacketListModel::dissectColumnStrings(frame_data *fdata) const
+{
     epan_dissect_t edt;
     column_info *cinfo;
     gboolean create_proto_tree;
     struct wtap_pkthdr phdr; /* Packet header */
     Buffer buf;  /* Packet data */
-    gboolean dissect_columns = TRUE; // XXX - Currently only a placeholder
+    QStringList *col_text;
+
+    if (!cap_file_)
+        return NULL;
 
-    if (dissect_columns && cap_file_)
-        cinfo = &cap_file_->cinfo;
-    else
-        cinfo = NULL;
+    cinfo = &cap_file_->cinfo;
 
     buffer_init(&buf, 1500);
-    if (!cap_file_ || !cf_read_frame_r(cap_file_, fdata, &phdr, &buf)) {
+    if (!cf_read_frame_r(cap_file_, fdata, &phdr, &buf)) {
         /*
          * Error reading the frame.
          *
          * Don't set the color filter for now (we might want
          * to colorize it in some fashion to warn that the
          * row couldn't be filled in or colorized), and
-         * set the columns to placeholder values, except
-         * for the Info column, where we'll put in an
-         * error message.
+         * don't cache anything, so that we try again the
+         * next time the row is shown.
          */
-        if (dissect_columns) {
-            col_fill_in_error(cinfo, fdata, FALSE, FALSE /* fill_fd_columns */);
-
-            //            for(gint col = 0; col < cinfo->num_cols; ++col) {
-            //                /* Skip columns based on frame_data because we already store those. */
-            //                if (!col_based_on_frame_data(cinfo, col))
-            //                    packet_list_change_record(packet_list, record->physical_pos, col, cinfo);
-            //            }
-            //            record->columnized = TRUE;
-        }
         if (enable_color_) {
             fdata->color_filter = NULL;
-            //            record->colorized = TRUE;
         }
         buffer_free(&buf);
-        return QVariant();	/* error reading the frame */
+        return NULL;	/* error reading the frame */
     }
 
     create_proto_tree = (color_filters_used() && enable_color_) ||
-                        (have_custom_cols(cinfo) && dissect_columns);
+                        have_custom_cols(cinfo);
 
     epan_dissect_init(&edt, cap_file_->epan,
                       create_proto_tree,
@@ -251,42 +355,259 @@ QVariant PacketListModel::data(const QModelIndex &index, int role) const
 
     if (enable_color_)
         color_filters_prime_edt(&edt);
-    if (dissect_columns)
-        col_custom_prime_edt(&edt, cinfo);
+    col_custom_prime_edt(&edt, cinfo);
 
     epan_dissect_run(&edt, &phdr, frame_tvbuff_new_buffer(fdata, &buf), fdata, cinfo);
 
     if (enable_color_)
         fdata->color_filter = color_filters_colorize_packet(&edt);
 
-    if (dissect_columns) {
-        /* "Stringify" non frame_data vals */
-        epan_dissect_fill_in_columns(&edt, FALSE, FALSE /* fill_fd_columns */);
+    /* "Stringify" non frame_data vals */
+    epan_dissect_fill_in_columns(&edt, FALSE, FALSE /* fill_fd_columns */);
 
-        //            for(col = 0; col < cinfo->num_cols; ++col) {
-        //                    /* Skip columns based on frame_data because we already store those. */
-        //                    if (!col_based_on_frame_data(cinfo, col))
-        //                            packet_list_change_record(packet_list, record->physical_pos, col, cinfo);
-        //            }
-//        g_log(NULL, G_LOG_LEVEL_DEBUG, "d_c %d: %s", col_num, cinfo->col_data[col_num]);
+    col_text = new QStringList();
+    for (int col = 0; col < cinfo->num_cols; col++) {
+        /* Skip columns based on frame_data; they're filled in when shown. */
+        if (col_based_on_frame_data(cinfo, col))
+            *col_text << QString();
+        else
+            *col_text << QString(cinfo->col_data[col]);
     }
 
-    //    if (dissect_columns)
-    //            record->columnized = TRUE;
-    //    if (enable_color_)
-    //            record->colorized = TRUE;
-
     epan_dissect_cleanup(&edt);
     buffer_free(&buf);
 
-    switch (role) {
-    case Qt::DisplayRole:
-        return record->data(col_num, cinfo);
-        break;
-    default:
-        break;
+    return col_text;
+}
+
+// Look up the column text of the rows around the ones shown, so that
+// scrolling a little doesn't have to dissect them.
+void PacketListModel::prefetchColumnStrings(int first_row, int last_row)
+{
+    if (!cap_file_)
+        return;
+
+    first_row = qMax(first_row, 0);
+    last_row = qMin(last_row, visible_rows_.count() - 1);
+    for (int row = first_row; row <= last_row; row++) {
+        columnStrings(visible_rows_[row]->getFdata());
     }
-    return QVariant();
+}
+
+void PacketListModel::invalidateColumnStrings()
+{
+    col_text_cache_.clear();
+    sort_keys_column_ = -1;
+    sort_num_keys_.clear();
+    sort_text_keys_.clear();
+    stale_sort_keys_.clear();
+}
+
+// Sorting. Columns based on frame data are compared directly. Others are
+// compared by a sort key kept for every frame: numbers for custom columns
+// of numeric fields, the text otherwise. The keys of a column are made
+// the first time it's sorted, and reused until the column text changes;
+// they are only made for the frames added or changed since when the list
+// is resorted.
+
+PacketListModel *PacketListModel::sort_model_ = NULL;
+
+void PacketListModel::sort(int column, Qt::SortOrder order)
+{
+    int old_column = sort_column_;
+    Qt::SortOrder old_order = sort_order_;
+
+    sort_column_ = column;
+    sort_order_ = order;
+
+    if (!cap_file_ || visible_rows_.count() < 1)
+        return;
+
+    if (column < 0 || column >= cap_file_->cinfo.num_cols)
+        return;
+
+    if (!col_based_on_frame_data(&cap_file_->cinfo, column) && !fillSortKeys(column)) {
+        // Stopped by the user; the rows keep their order.
+        sort_column_ = old_column;
+        sort_order_ = old_order;
+        return;
+    }
+
+    emit layoutAboutToBeChanged();
+
+    QModelIndexList old_indexes = persistentIndexList();
+
+    sort_model_ = this;
+    qStableSort(visible_rows_.begin(), visible_rows_.end(), recordLessThan);
+    sort_model_ = NULL;
+
+    // The view's selection and current row follow their records.
+    if (!old_indexes.isEmpty()) {
+        QHash<PacketListRecord *, int> rows;
+        QModelIndexList new_indexes;
+
+        for (int row = 0; row < visible_rows_.count(); row++) {
+            rows.insert(visible_rows_[row], row);
+        }
+        foreach (QModelIndex old_index, old_indexes) {
+            PacketListRecord *record = static_cast<PacketListRecord*>(old_index.internalPointer());
+            int row = rows.value(record, -1);
+            new_indexes << (row < 0 ? QModelIndex() : createIndex(row, old_index.column(), record));
+        }
+        changePersistentIndexList(old_indexes, new_indexes);
+    }
+
+    emit layoutChanged();
+}
+
+// Sort the visible rows again after they were rebuilt in frame order.
+void PacketListModel::resort()
+{
+    if (!cap_file_ || sort_column_ < 0 || sort_column_ >= cap_file_->cinfo.num_cols)
+        return;
+
+    if (cap_file_->cinfo.col_fmt[sort_column_] == COL_NUMBER && sort_order_ == Qt::AscendingOrder)
+        return;
+
+    sort(sort_column_, sort_order_);
+}
+
+bool PacketListModel::customColumnIsNumeric(int column) const
+{
+    header_field_info *hfi;
+
+    if (cap_file_->cinfo.col_fmt[column] != COL_CUSTOM)
+        return false;
+
+    hfi = proto_registrar_get_byname(cap_file_->cinfo.col_custom_field[column]);
+    if (!hfi || hfi->strings)
+        return false;
+
+    return ((IS_FT_INT(hfi->type) || IS_FT_UINT(hfi->type)) &&
+            (hfi->display == BASE_DEC || hfi->display == BASE_DEC_HEX ||
+             hfi->display == BASE_OCT)) ||
+           hfi->type == FT_DOUBLE || hfi->type == FT_FLOAT ||
+           hfi->type == FT_BOOLEAN || hfi->type == FT_FRAMENUM ||
+           hfi->type == FT_RELATIVE_TIME;
+}
+
+// Make the sort keys of a column for the frames that don't have them yet,
+// indexed by frame number - 1, i.e. by position in physical_rows_, and
+// make those that are out of date again. That dissects every frame the
+// first time, so show how far we've got and let the user stop, as the
+// GTK+ packet list does. Returns false if stopped; the keys made so far
+// are kept.
+bool PacketListModel::fillSortKeys(int column)
+{
+    if (sort_keys_column_ != column) {
+        sort_keys_column_ = column;
+        sort_keys_numeric_ = customColumnIsNumeric(column);
+        sort_num_keys_.clear();
+        sort_text_keys_.clear();
+        stale_sort_keys_.clear();
+    }
+
+    int first_new = sort_keys_numeric_ ? sort_num_keys_.count() : sort_text_keys_.count();
+    int todo = stale_sort_keys_.count() + physical_rows_.count() - first_new;
+    if (todo <= 0)
+        return true;
+
+    // Modal, so that nothing else can change the list while it's up.
+    QProgressDialog progress(tr("Sorting packets"), tr("Stop"), 0,
+                             todo, qobject_cast<QWidget *>(QObject::parent()));
+    progress.setWindowModality(Qt::WindowModal);
+    progress.setMinimumDuration(500);
+    int quantum = qMax(todo / 100, 1);
+    int done = 0;
+
+    while (!stale_sort_keys_.isEmpty()) {
+        if (done % quantum == 0) {
+            progress.setValue(done);
+            if (progress.wasCanceled())
+                return false;
+        }
+
+        QSet<guint32>::iterator it = stale_sort_keys_.begin();
+        setSortKey((int) *it - 1, column);
+        stale_sort_keys_.erase(it);
+        done++;
+    }
+
+    for (int row = first_new; row < physical_rows_.count(); row++) {
+        if (done % quantum == 0) {
+            progress.setValue(done);
+            if (progress.wasCanceled())
+                return false;
+        }
+
+        setSortKey(row, column);
+        done++;
+    }
+    progress.setValue(todo);
+    return true;
+}
+
+// Make the sort key of a column for the frame in a physical row, which is
+// either the next one without a key or one that has one already.
+void PacketListModel::setSortKey(int row, int column)
+{
+    frame_data *fdata = physical_rows_[row]->getFdata();
+    QStringList *col_text = col_text_cache_.object(fdata->num);
+    QString text;
+
+    // Don't push the rows being viewed out of the cache.
+    if (col_text) {
+        text = col_text->at(column);
+    } else {
+        col_text = dissectColumnStrings(fdata);
+        if (col_text) {
+            text = col_text->at(column);
+            delete col_text;
+        }
+    }
+
+    if (sort_keys_numeric_) {
+        double key = atof(text.toUtf8().constData());
+        if (row < sort_num_keys_.count())
+            sort_num_keys_[row] = key;
+        else
+            sort_num_keys_ << key;
+    } else {
+        if (row < sort_text_keys_.count())
+            sort_text_keys_[row] = text.toUtf8();
+        else
+            sort_text_keys_ << text.toUtf8();
+    }
+}
+
+bool PacketListModel::recordLessThan(PacketListRecord *r1, PacketListRecord *r2)
+{
+    PacketListModel *model = sort_model_;
+    frame_data *fdata1 = r1->getFdata();
+    frame_data *fdata2 = r2->getFdata();
+    int column = model->sort_column_;
+    gint ret = 0;
+
+    if (model->sort_keys_column_ != column) {
+        ret = frame_data_compare(model->cap_file_->epan, fdata1, fdata2, model->cap_file_->cinfo.col_fmt[column]);
+    } else if (model->sort_keys_numeric_) {
+        int count = model->sort_num_keys_.count();
+        if (fdata1->num <= (guint32) count && fdata2->num <= (guint32) count) {
+            double key1 = model->sort_num_keys_[fdata1->num - 1];
+            double key2 = model->sort_num_keys_[fdata2->num - 1];
+            ret = key1 < key2 ? -1 : (key1 > key2 ? 1 : 0);
+        }
+    } else {
+        int count = model->sort_text_keys_.count();
+        if (fdata1->num <= (guint32) count && fdata2->num <= (guint32) count) {
+            ret = qstrcmp(model->sort_text_keys_[fdata1->num - 1], model->sort_text_keys_[fdata2->num - 1]);
+        }
+    }
+
+    if (ret == 0)
+        ret = frame_data_compare(model->cap_file_->epan, fdata1, fdata2, COL_NUMBER);
+
+    return model->sort_order_ == Qt::AscendingOrder ? ret < 0 : ret > 0;
 }
 
 QVariant PacketListModel::headerData(int section, Qt::Orientation orientation,
@@ -313,7 +634,10 @@ gint PacketListModel::appendPacket(frame_data *fdata)
 
     physical_rows_ << record;
 
-    if (fdata->flags.passed_dfilter || fdata->flags.ref_time) {
+    if (rescanned_rows_ >= 0) {
+        // Rescanning; shown at the latest when the rescan ends.
+        pos = -1;
+    } else if (fdata->flags.passed_dfilter || fdata->flags.ref_time) {
         beginInsertRows(QModelIndex(), pos, pos);
         visible_rows_ << record;
         endInsertRows();
@@ -33,7 +33,11 @@
 #include <epan/packet.h>
 
 #include <QAbstractItemModel>
+#include <QByteArray>
+#include <QCache>
 #include <QFont>
+#include <QSet>
+#include <QStringList>
 #include <QVector>
 
 #include "packet_list_record.h"
@@ -50,6 +54,11 @@ public:
                       const QModelIndex &parent = QModelIndex()) const;
     QModelIndex parent(const QModelIndex &index) const;
     guint recreateVisibleRows();
+    void beginRescan();
+    void addRescannedRows(guint32 last_framenum);
+    void endRescan();
+    void sort(int column, Qt::SortOrder order = Qt::AscendingOrder);
+    void prefetchColumnStrings(int first_row, int last_row);
     void setColorEnabled(bool enable_color);
     void clear();
 
@@ -63,6 +72,7 @@ public:
     frame_data *getRowFdata(int row);
     int visibleIndexOf(frame_data *fdata) const;
     void resetColumns();
+    void invalidateFrame(frame_data *fdata);
 
 signals:
 
@@ -73,10 +83,36 @@ private:
     QList<QString> col_names_;
     QVector<PacketListRecord *> visible_rows_;
     QVector<PacketListRecord *> physical_rows_;
+    // While rescanning, the number of physical rows whose visibility
+    // is known, or -1 when not rescanning.
+    int rescanned_rows_;
+
+    // Column text of the rows most recently shown, by frame number.
+    mutable QCache<guint32, QStringList> col_text_cache_;
+
+    int sort_column_;
+    Qt::SortOrder sort_order_;
+    // Sort keys of a column not based on frame data, by frame number - 1.
+    int sort_keys_column_;
+    bool sort_keys_numeric_;
+    QVector<double> sort_num_keys_;
+    QVector<QByteArray> sort_text_keys_;
+    // Frames whose sort key is out of date, by frame number.
+    QSet<guint32> stale_sort_keys_;
+    static PacketListModel *sort_model_;
     QFont pl_font_;
 
     int header_height_;
     bool enable_color_;
+
+    const QStringList *columnStrings(frame_data *fdata) const;
+    QStringList *dissectColumnStrings(frame_data *fdata) const;
+    void invalidateColumnStrings();
+    void resort();
+    bool customColumnIsNumeric(int column) const;
+    bool fillSortKeys(int column);
+    void setSortKey(int row, int column);
+    static bool recordLessThan(PacketListRecord *r1, PacketListRecord *r2);
 };
 
 #endif // PACKET_LIST_MODEL_H
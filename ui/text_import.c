@@ -112,6 +112,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <wsutil/file_util.h>
+#include <wsutil/hexdump_scanner.h>
 
 #include <time.h>
 #include <glib.h>
@@ -887,6 +888,53 @@ parse_token (token_t token, char *str)
 
 }
 
+/*----------------------------------------------------------------------
+ * Callbacks for the hex dump scanner.  A run of data bytes has the same
+ * effect as passing each of them to parse_token() as a T_BYTE.
+ */
+static void
+scan_token (hexdump_token_t token, char *str)
+{
+    parse_token((token_t)token, str);
+}
+
+static void
+scan_bytes (const guint8 *bytes, guint count)
+{
+    guint i;
+
+    if (state != READ_OFFSET && state != READ_BYTE)
+        return;     /* T_BYTE is ignored in the other states */
+
+    state = READ_BYTE;
+    for (i = 0; i < count; i++) {
+        packet_buf[curr_offset] = bytes[i];
+        curr_offset ++;
+        if (curr_offset >= max_offset) /* packet full */
+            start_new_packet();
+    }
+}
+
+/*----------------------------------------------------------------------
+ * Read the whole text file, after text_import_setup()
+ */
+gboolean
+text_import_read(text_import_info_t *info, int *err)
+{
+    if (debug >= 2) {
+        /* The flex scanner passes every byte through parse_token(),
+           which traces it; it writes the last packet itself. */
+        text_importin = info->import_text_file;
+        text_importlex();
+        return TRUE;
+    }
+
+    if (!hexdump_scan(info->import_text_file, scan_token, scan_bytes, err))
+        return FALSE;
+    write_current_packet();
+    return TRUE;
+}
+
 /*----------------------------------------------------------------------
  * take in the import config information
  */
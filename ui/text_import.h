@@ -88,6 +88,7 @@ typedef struct
 } text_import_info_t;
 
 void text_import_setup(text_import_info_t *info);
+gboolean text_import_read(text_import_info_t *info, int *err);
 void text_import_cleanup(void);
 
 #ifdef __cplusplus
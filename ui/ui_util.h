@@ -67,6 +67,14 @@ void packet_list_clear(void);
 void packet_list_freeze(void);
 void packet_list_recreate_visible_rows(void);
 void packet_list_thaw(void);
+/* Rescanning a capture file without freezing the packet list: returns
+   TRUE if the packet list empties itself, and shows the frames that
+   passed the filter as packet_list_rescan_progress() reports them
+   rescanned, and the rest at packet_list_end_rescan(); FALSE if it
+   doesn't, and should be frozen instead. */
+gboolean packet_list_begin_rescan(void);
+void packet_list_rescan_progress(guint32 last_framenum);
+void packet_list_end_rescan(void);
 void packet_list_next(void);
 void packet_list_prev(void);
 guint packet_list_append(column_info *cinfo, frame_data *fdata, packet_info *pinfo);
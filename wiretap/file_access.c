@@ -181,10 +181,73 @@ static wtap_open_routine_t open_routines_base[] = {
 
 #define	N_FILE_TYPES	(sizeof open_routines_base / sizeof open_routines_base[0])
 
+/*
+ * Signatures of the file types that have magic bytes in fixed locations.
+ *
+ * Before running through all the open routines, we read the beginning
+ * of the file once and look it up here; if it matches a signature, the
+ * open routine for that file type is tried first, so that a file with a
+ * recognized signature never goes through the heuristics for the text
+ * formats.  If that open routine rejects the file, we fall back on trying
+ * all of them, as before.
+ *
+ * Open routines registered at run time can add their signatures with
+ * wtap_register_open_magic(); those are looked up before the built-in
+ * ones.  Routines registered as having magic bytes but without a
+ * signature are tried before the lookup, as they come before all the
+ * built-in routines in the chain.
+ *
+ * All the magic numbers must be within the first MAGIC_PREFIX_LEN bytes
+ * of the file.
+ */
+#define MAGIC_PREFIX_LEN	32
+
+struct open_magic {
+	guint			offset;
+	guint			len;
+	const char		*magic;
+	wtap_open_routine_t	open_routine;
+};
+
+static const struct open_magic open_magic_base[] = {
+	{ 0,  4, "\xa1\xb2\xc3\xd4",		libpcap_open },
+	{ 0,  4, "\xd4\xc3\xb2\xa1",		libpcap_open },
+	{ 0,  4, "\xa1\xb2\xcd\x34",		libpcap_open },
+	{ 0,  4, "\x34\xcd\xb2\xa1",		libpcap_open },
+	{ 0,  4, "\xa1\xb2\x3c\x4d",		libpcap_open },
+	{ 0,  4, "\x4d\x3c\xb2\xa1",		libpcap_open },
+	{ 0,  4, "\x0a\x0d\x0d\x0a",		pcapng_open },
+	{ 0, 17, "TRSNIFF data    \x1a",	ngsniffer_open },
+	{ 0,  8, "snoop\0\0\0",		snoop_open },
+	{ 0, 11, "iptrace 1.0",		iptrace_open },
+	{ 0, 11, "iptrace 2.0",		iptrace_open },
+	{ 0,  4, "RTSS",			netmon_open },
+	{ 0,  4, "GMBU",			netmon_open },
+	{ 0,  4, "VL\0\0",			netxray_open },
+	{ 0,  4, "XCP\0",			netxray_open },
+	{ 0,  4, "\x05VNF",			visual_open },
+	{ 0,  4, "\xaa\xaa\xaa\xaa",		_5views_open },
+	{ 0, 25, "ObserverPktBufferVersion=",	network_instruments_open },
+	{ 0,  4, "\x7fver",			peektagged_open },
+	{ 0,  8, "\x00\x00\x02\x00\x12\x05\x00\x10", k12_open },
+	{ 0, 18, "Session Transcript",	catapult_dct2000_open },
+	{ 0,  5, "V0208",			aethra_open },
+	{ 0,  8, "btsnoop\0",		btsnoop_open },
+	{ 0,  4, "\x78\x9f\x3e\x22",		tnef_open }
+};
+
+#define	N_OPEN_MAGIC	(sizeof open_magic_base / sizeof open_magic_base[0])
+
 static wtap_open_routine_t* open_routines = NULL;
 
 static GArray* open_routines_arr = NULL;
 
+/* Number of routines prepended by wtap_register_open_routine() */
+static guint n_registered_magic_routines = 0;
+
+/* Signatures registered with wtap_register_open_magic() */
+static GArray* open_magic_arr = NULL;
+
 
 /* initialize the open routines array if it has not been initialized yet */
 static void init_open_routines(void) {
@@ -201,14 +264,111 @@ static void init_open_routines(void) {
 void wtap_register_open_routine(wtap_open_routine_t open_routine, gboolean has_magic) {
 	init_open_routines();
 
-	if (has_magic)
+	if (has_magic) {
 		g_array_prepend_val(open_routines_arr,open_routine);
-	else
+		n_registered_magic_routines++;
+	} else
 		g_array_append_val(open_routines_arr,open_routine);
 
 	open_routines = (wtap_open_routine_t*)(void *)open_routines_arr->data;
 }
 
+gboolean wtap_register_open_magic(guint offset, guint len, const char *magic,
+    wtap_open_routine_t open_routine) {
+	struct open_magic m;
+
+	if (len == 0 || offset + len > MAGIC_PREFIX_LEN)
+		return FALSE;
+
+	if (!open_magic_arr)
+		open_magic_arr = g_array_new(FALSE,FALSE,sizeof(struct open_magic));
+
+	m.offset = offset;
+	m.len = len;
+	m.magic = (const char *)g_memdup(magic, len);
+	m.open_routine = open_routine;
+	/* Later registrations take precedence, as with open routines. */
+	g_array_prepend_val(open_magic_arr,m);
+	return TRUE;
+}
+
+static gboolean
+open_magic_matches(const struct open_magic *m, const guint8 *prefix,
+    guint prefix_len)
+{
+	return m->offset + m->len <= prefix_len &&
+	    memcmp(prefix + m->offset, m->magic, m->len) == 0;
+}
+
+/*
+ * Look up the beginning of a file in the signature tables.  Returns the
+ * open routine for the file type, or NULL if no signature matches.
+ */
+static wtap_open_routine_t
+open_routine_from_magic(const guint8 *prefix, guint prefix_len)
+{
+	const struct open_magic *m;
+	unsigned int i;
+
+	if (open_magic_arr) {
+		for (i = 0; i < open_magic_arr->len; i++) {
+			m = &g_array_index(open_magic_arr, struct open_magic, i);
+			if (open_magic_matches(m, prefix, prefix_len))
+				return m->open_routine;
+		}
+	}
+	for (i = 0; i < N_OPEN_MAGIC; i++) {
+		m = &open_magic_base[i];
+		if (open_magic_matches(m, prefix, prefix_len))
+			return m->open_routine;
+	}
+	return NULL;
+}
+
+/*
+ * Is open_routines[i] a routine registered at run time as having magic
+ * bytes, but without a signature?  Those are tried before the signature
+ * lookup.
+ */
+static gboolean
+open_routine_is_unsigned_magic(guint i)
+{
+	guint j;
+
+	if (i >= n_registered_magic_routines)
+		return FALSE;
+	if (open_magic_arr) {
+		for (j = 0; j < open_magic_arr->len; j++) {
+			if (g_array_index(open_magic_arr, struct open_magic, j).open_routine == open_routines[i])
+				return FALSE;
+		}
+	}
+	for (j = 0; j < N_OPEN_MAGIC; j++) {
+		if (open_magic_base[j].open_routine == open_routines[i])
+			return FALSE;
+	}
+	return TRUE;
+}
+
+/*
+ * Try an open routine on the file, from its beginning.  Returns what the
+ * routine returns: -1 on an I/O error, 0 if the file isn't of that type,
+ * 1 if it is.
+ */
+static int
+try_open_routine(wtap *wth, wtap_open_routine_t open_routine, int *err,
+    gchar **err_info)
+{
+	/* Seek back to the beginning of the file; the open routine
+	   for the previous file type may have left the file
+	   position somewhere other than the beginning, and the
+	   open routine for this file type will probably want
+	   to start reading at the beginning. */
+	if (file_seek(wth->fh, 0, SEEK_SET, err) == -1)
+		return -1;
+	return (*open_routine)(wth, err, err_info);
+}
+
 /*
  * Visual C++ on Win32 systems doesn't define these.  (Old UNIX systems don't
  * define them either.)
@@ -243,6 +403,9 @@ wtap* wtap_open_offline(const char *filename, int *err, char **err_info,
 	wtap	*wth;
 	unsigned int	i;
 	gboolean use_stdin = FALSE;
+	guint8	prefix[MAGIC_PREFIX_LEN];
+	int	prefix_len;
+	wtap_open_routine_t magic_routine;
 
 	/* open standard input if filename is '-' */
 	if (strcmp(filename, "-") == 0)
@@ -366,22 +529,72 @@ wtap* wtap_open_offline(const char *filename, int *err, char **err_info,
 		file_set_random_access(wth->random_fh, TRUE, wth->fast_seek);
 	}
 
-	/* Try all file types */
-	for (i = 0; i < open_routines_arr->len; i++) {
-		/* Seek back to the beginning of the file; the open routine
-		   for the previous file type may have left the file
-		   position somewhere other than the beginning, and the
-		   open routine for this file type will probably want
-		   to start reading at the beginning.
-
-		   Initialize the data offset while we're at it. */
-		if (file_seek(wth->fh, 0, SEEK_SET, err) == -1) {
+	/*
+	 * Read the beginning of the file once, and, if it has a known
+	 * signature, try the open routine for that file type first.
+	 */
+	prefix_len = file_read(prefix, sizeof prefix, wth->fh);
+	if (prefix_len < 0) {
+		*err = file_error(wth->fh, err_info);
+		wtap_close(wth);
+		return NULL;
+	}
+
+	/*
+	 * Routines registered at run time as having magic bytes come
+	 * first in the chain; those that didn't give us a signature
+	 * must still be tried before any that a signature picks.
+	 */
+	for (i = 0; i < n_registered_magic_routines; i++) {
+		if (!open_routine_is_unsigned_magic(i))
+			continue;
+		switch (try_open_routine(wth, open_routines[i], err, err_info)) {
+
+		case -1:
 			/* I/O error - give up */
 			wtap_close(wth);
 			return NULL;
+
+		case 0:
+			/* No I/O error, but not that type of file */
+			break;
+
+		case 1:
+			/* We found the file type */
+			goto success;
+		}
+	}
+
+	magic_routine = open_routine_from_magic(prefix, (guint)prefix_len);
+	if (magic_routine != NULL) {
+		switch (try_open_routine(wth, magic_routine, err, err_info)) {
+
+		case -1:
+			/* I/O error - give up */
+			wtap_close(wth);
+			return NULL;
+
+		case 0:
+			/*
+			 * It has the signature but isn't a valid file
+			 * of that type; try all the file types.
+			 */
+			break;
+
+		case 1:
+			/* We found the file type */
+			goto success;
 		}
+	}
+
+	/* Try all file types */
+	for (i = 0; i < open_routines_arr->len; i++) {
+		/* Don't try the ones already tried again. */
+		if (open_routines[i] == magic_routine ||
+		    open_routine_is_unsigned_magic(i))
+			continue;
 
-		switch ((*open_routines[i])(wth, err, err_info)) {
+		switch (try_open_routine(wth, open_routines[i], err, err_info)) {
 
 		case -1:
 			/* I/O error - give up */
@@ -497,6 +710,23 @@ wtap_fdreopen(wtap *wth, const char *filename, int *err)
 	return TRUE;
 }
 
+/*
+ * Given the pathname of a file whose descriptors we closed with
+ * wtap_fdclose() in the middle of reading it sequentially, reopen
+ * the sequential stream, positioned where we left off.  Used when
+ * merging more files than we can keep open at once.
+ */
+gboolean
+wtap_sequential_fdreopen(wtap *wth, const char *filename, int *err)
+{
+	errno = WTAP_ERR_CANT_OPEN;
+	if (!file_fdreopen(wth->fh, filename)) {
+		*err = errno;
+		return FALSE;
+	}
+	return TRUE;
+}
+
 /* Table of the file types we know about.
    Entries must be sorted by WTAP_FILE_xxx values in ascending order */
 static const struct file_type_info dump_open_table_base[] = {
@@ -1269,6 +1499,9 @@ static gboolean wtap_dump_open_finish(wtap_dumper *wdh, int filetype, gboolean c
 static WFILE_T wtap_dump_file_open(wtap_dumper *wdh, const char *filename);
 static WFILE_T wtap_dump_file_fdopen(wtap_dumper *wdh, int fd);
 static int wtap_dump_file_close(wtap_dumper *wdh);
+static gboolean wtap_write_behind_drain(wtap_dumper *wdh, int *err);
+static gboolean wtap_write_behind_finish(wtap_dumper *wdh, int *err);
+static gboolean wtap_copy_run_flush(wtap_dumper *wdh, int *err);
 
 wtap_dumper* wtap_dump_open(const char *filename, int filetype, int encap,
 				int snaplen, gboolean compressed, int *err)
@@ -1511,14 +1744,156 @@ static gboolean wtap_dump_open_finish(wtap_dumper *wdh, int filetype, gboolean c
 	return TRUE;	/* success! */
 }
 
+static gboolean wtap_dump_record(wtap_dumper *wdh,
+    const struct wtap_pkthdr *phdr, const guint8 *pd, int *err)
+{
+	/*
+	 * bytes_dumped is where this record (or any blocks the
+	 * format writes ahead of it) will start.
+	 */
+	if (wdh->pkt_index != NULL &&
+	    !pktindex_writer_add(wdh->pkt_index, wdh->bytes_dumped,
+	        phdr->ts.secs, phdr->ts.nsecs, err))
+		return FALSE;
+	return (wdh->subtype_write)(wdh, phdr, pd, err);
+}
+
 gboolean wtap_dump(wtap_dumper *wdh, const struct wtap_pkthdr *phdr,
 		   const guint8 *pd, int *err)
 {
-	return (wdh->subtype_write)(wdh, phdr, pd, err);
+	if (!wtap_copy_run_flush(wdh, err))
+		return FALSE;
+	/* This record breaks any streak of records being copied. */
+	wdh->copy_wth = NULL;
+	return wtap_dump_record(wdh, phdr, pd, err);
+}
+
+/*
+ * Copying a run of records with file_copy_raw() means draining and
+ * flushing everything we've buffered, and resyncing the stream
+ * afterwards; that only pays off for long runs.  Records are written
+ * through the buffers until this many bytes of contiguous records from
+ * one input file have gone by, and only after that are they copied.
+ */
+#define WTAP_COPY_RUN_MIN_BYTES	(1024*1024)
+
+/*
+ * A run of records that are contiguous in one input file and are to be
+ * copied to the output file as-is.  We hold our own descriptor for the
+ * input file, so the run can still be written after the input file has
+ * been closed.
+ */
+struct wtap_copy_run {
+	wtap	*wth;		/* file the records were read from */
+	int	fd;		/* our descriptor for that file */
+	gint64	start;		/* offset of the first record of the run */
+	gint64	end;		/* offset just past the last record of the run */
+};
+
+gboolean wtap_dump_can_copy_records(wtap_dumper *wdh, wtap *wth)
+{
+	if (wdh->compressed || file_iscompressed(wth->fh))
+		return FALSE;
+	if (wdh->file_type != wth->file_type)
+		return FALSE;
+	if (wdh->file_type != WTAP_FILE_PCAP &&
+	    wdh->file_type != WTAP_FILE_PCAP_NSEC)
+		return FALSE;
+	if (wdh->encap != wth->file_encap)
+		return FALSE;
+	return libpcap_can_copy_records(wth);
+}
+
+static gboolean wtap_copy_run_flush(wtap_dumper *wdh, int *err)
+{
+	struct wtap_copy_run *run = wdh->copy_run;
+	gboolean ret = TRUE;
+
+	if (run == NULL)
+		return TRUE;
+	wdh->copy_run = NULL;
+
+	/* Everything before the run has to be in the file first. */
+	if (!wtap_write_behind_drain(wdh, err)) {
+		ret = FALSE;
+	} else if (fflush((FILE *)wdh->fh) == EOF) {
+		*err = errno;
+		ret = FALSE;
+	} else if (!file_copy_raw(run->fd, run->start, run->end - run->start,
+	    fileno((FILE *)wdh->fh), err)) {
+		ret = FALSE;
+	} else {
+		/*
+		 * The descriptor has moved past what the stream thinks
+		 * it's written; resync the stream.  That fails if we're
+		 * writing to a pipe, but there's nothing to resync then.
+		 */
+		fseek((FILE *)wdh->fh, 0, SEEK_END);
+	}
+	ws_close(run->fd);
+	g_free(run);
+	return ret;
+}
+
+gboolean wtap_dump_copy_record(wtap_dumper *wdh, wtap *wth, gint64 data_offset,
+    int *err)
+{
+	struct wtap_copy_run *run = wdh->copy_run;
+	struct wtap_pkthdr *phdr = wtap_phdr(wth);
+	gint64 end;
+
+	/* The sequential reader is just past the record we want. */
+	end = file_tell(wth->fh);
+
+	if (wdh->copy_wth == wth && wdh->copy_next == data_offset) {
+		wdh->copy_streak += end - data_offset;
+	} else {
+		if (!wtap_copy_run_flush(wdh, err))
+			return FALSE;
+		run = NULL;
+		wdh->copy_wth = wth;
+		wdh->copy_streak = end - data_offset;
+	}
+	wdh->copy_next = end;
+
+	/*
+	 * Until the streak is long enough, it's cheaper to write the
+	 * record as we would any other.
+	 */
+	if (run == NULL && wdh->copy_streak < WTAP_COPY_RUN_MIN_BYTES)
+		return wtap_dump_record(wdh, phdr, wtap_buf_ptr(wth), err);
+
+	if (wdh->pkt_index != NULL &&
+	    !pktindex_writer_add(wdh->pkt_index, wdh->bytes_dumped,
+	        phdr->ts.secs, phdr->ts.nsecs, err))
+		return FALSE;
+	if (run == NULL) {
+		run = g_new(struct wtap_copy_run, 1);
+		run->fd = file_dup_fd(wth->fh);
+		if (run->fd == -1) {
+			*err = errno;
+			g_free(run);
+			return FALSE;
+		}
+		run->wth = wth;
+		run->start = data_offset;
+		wdh->copy_run = run;
+	}
+	run->end = end;
+	wdh->bytes_dumped += end - data_offset;
+	return TRUE;
 }
 
 void wtap_dump_flush(wtap_dumper *wdh)
 {
+	int err;
+
+	/*
+	 * There's no way to report an error here; the writer keeps it,
+	 * and it's reported by the next write or the close.
+	 */
+	wtap_copy_run_flush(wdh, &err);
+	wtap_write_behind_drain(wdh, &err);
 #ifdef HAVE_LIBZ
 	if(wdh->compressed) {
 		gzwfile_flush((GZWFILE_T)wdh->fh);
@@ -1532,12 +1907,26 @@ void wtap_dump_flush(wtap_dumper *wdh)
 gboolean wtap_dump_close(wtap_dumper *wdh, int *err)
 {
 	gboolean ret = TRUE;
+	int index_err;	/* error from the write-behind buffer or the packet index */
 
+	if (!wtap_copy_run_flush(wdh, &index_err)) {
+		if (err != NULL)
+			*err = index_err;
+		ret = FALSE;
+	}
 	if (wdh->subtype_close != NULL) {
 		/* There's a close routine for this dump stream. */
 		if (!(wdh->subtype_close)(wdh, err))
 			ret = FALSE;
 	}
+	if (wdh->write_behind != NULL) {
+		/* Get everything that's still buffered out to the file. */
+		if (!wtap_write_behind_finish(wdh, &index_err) && ret) {
+			if (err != NULL)
+				*err = index_err;
+			ret = FALSE;
+		}
+	}
 	errno = WTAP_ERR_CANT_CLOSE;
 	/* Don't close stdout */
 	if (wdh->fh != stdout) {
@@ -1555,6 +1944,14 @@ gboolean wtap_dump_close(wtap_dumper *wdh, int *err)
 		/* as we don't close stdout, at least try to flush it */
 		wtap_dump_flush(wdh);
 	}
+	if (wdh->pkt_index != NULL) {
+		if (!pktindex_writer_close(wdh->pkt_index, wdh->bytes_dumped,
+		    &index_err) && ret) {
+			if (err != NULL)
+				*err = index_err;
+			ret = FALSE;
+		}
+	}
 	if (wdh->priv != NULL)
 		g_free(wdh->priv);
 	g_free(wdh);
@@ -1580,6 +1977,45 @@ gboolean wtap_dump_set_addrinfo_list(wtap_dumper *wdh, struct addrinfo *addrinfo
 	return TRUE;
 }
 
+gboolean wtap_packet_index_supported(int filetype)
+{
+	switch (filetype) {
+
+	case WTAP_FILE_PCAP:
+	case WTAP_FILE_PCAP_NSEC:
+	case WTAP_FILE_PCAP_AIX:
+	case WTAP_FILE_PCAP_SS991029:
+	case WTAP_FILE_PCAP_NOKIA:
+	case WTAP_FILE_PCAP_SS990417:
+	case WTAP_FILE_PCAP_SS990915:
+	case WTAP_FILE_PCAPNG:
+		/*
+		 * These keep bytes_dumped up to date when writing, and
+		 * their sequential readers can resume at any record
+		 * boundary.
+		 */
+		return TRUE;
+
+	default:
+		return FALSE;
+	}
+}
+
+gboolean wtap_dump_set_packet_index(wtap_dumper *wdh, const char *index_filename,
+    guint32 stride, int *err)
+{
+	if (!wtap_packet_index_supported(wdh->file_type)) {
+		*err = WTAP_ERR_UNSUPPORTED_FILE_TYPE;
+		return FALSE;
+	}
+	if (wdh->pkt_index != NULL) {
+		*err = WTAP_ERR_INTERNAL;
+		return FALSE;
+	}
+	wdh->pkt_index = pktindex_writer_open(index_filename, stride, err);
+	return wdh->pkt_index != NULL;
+}
+
 /* internally open a file for writing (compressed or not) */
 #ifdef HAVE_LIBZ
 static WFILE_T wtap_dump_file_open(wtap_dumper *wdh, const char *filename)
@@ -1614,11 +2050,237 @@ static WFILE_T wtap_dump_file_fdopen(wtap_dumper *wdh _U_, int fd)
 }
 #endif
 
+/*
+ * Write-behind buffering.
+ *
+ * Most formats write each record with several small writes (a record
+ * header, the data, padding, options...).  When write-behind is enabled,
+ * those writes are appended to a large buffer instead; when the buffer
+ * is full it's handed to a background thread that writes it to the file
+ * while the other buffer is being filled.
+ *
+ * Only the writer thread touches the file while write-behind is active;
+ * seeks, tells, flushes and the close first wait for it to finish.
+ */
+#define WTAP_WRITE_BEHIND_BUFSIZE	(1024*1024)
+
+#if GLIB_CHECK_VERSION(2,31,18)
+#define WTAP_WRITE_BEHIND_THREAD
+#endif
+
+struct wtap_write_behind {
+	guint8		*buf[2];
+	size_t		len[2];
+	int		cur;		/* buffer being filled */
+	int		err;		/* first error seen writing the file */
+#ifdef WTAP_WRITE_BEHIND_THREAD
+	GThread		*thread;
+	GMutex		mtx;
+	GCond		cond;
+	int		pending;	/* buffer being written, or -1 */
+	gboolean	stop;
+#endif
+};
+
+/* Write a whole buffer to the underlying (uncompressed) file */
+static int
+wtap_write_behind_write(FILE *fh, const guint8 *buf, size_t len)
+{
+	if (len == 0)
+		return 0;
+	if (fwrite(buf, 1, len, fh) != len) {
+		if (ferror(fh))
+			return errno;
+		return WTAP_ERR_SHORT_WRITE;
+	}
+	return 0;
+}
+
+#ifdef WTAP_WRITE_BEHIND_THREAD
+static gpointer
+wtap_write_behind_thread(gpointer data)
+{
+	wtap_dumper *wdh = (wtap_dumper *)data;
+	struct wtap_write_behind *wb = wdh->write_behind;
+	int idx, write_err;
+	gboolean failed;
+
+	g_mutex_lock(&wb->mtx);
+	for (;;) {
+		while (wb->pending == -1 && !wb->stop)
+			g_cond_wait(&wb->cond, &wb->mtx);
+		if (wb->pending == -1)
+			break;	/* asked to stop, and nothing left to write */
+		idx = wb->pending;
+		failed = wb->err != 0;
+		g_mutex_unlock(&wb->mtx);
+
+		/* Once a write has failed, don't write anything else. */
+		write_err = 0;
+		if (!failed)
+			write_err = wtap_write_behind_write((FILE *)wdh->fh,
+			    wb->buf[idx], wb->len[idx]);
+
+		g_mutex_lock(&wb->mtx);
+		if (write_err != 0 && wb->err == 0)
+			wb->err = write_err;
+		wb->len[idx] = 0;
+		wb->pending = -1;
+		g_cond_broadcast(&wb->cond);
+	}
+	g_mutex_unlock(&wb->mtx);
+	return NULL;
+}
+
+/* Wait for the writer thread to finish the buffer it's writing */
+static void
+wtap_write_behind_wait(struct wtap_write_behind *wb)
+{
+	g_mutex_lock(&wb->mtx);
+	while (wb->pending != -1)
+		g_cond_wait(&wb->cond, &wb->mtx);
+	g_mutex_unlock(&wb->mtx);
+}
+#endif
+
+/* Get the first error seen writing the file; the writer thread sets it */
+static int
+wtap_write_behind_error(struct wtap_write_behind *wb)
+{
+	int err;
+
+#ifdef WTAP_WRITE_BEHIND_THREAD
+	g_mutex_lock(&wb->mtx);
+	err = wb->err;
+	g_mutex_unlock(&wb->mtx);
+#else
+	err = wb->err;
+#endif
+	return err;
+}
+
+/*
+ * Hand the buffer being filled to the writer, and switch to the other
+ * one.  Without a writer thread, just write it out.
+ */
+static void
+wtap_write_behind_submit(wtap_dumper *wdh)
+{
+	struct wtap_write_behind *wb = wdh->write_behind;
+
+	if (wb->len[wb->cur] == 0)
+		return;
+#ifdef WTAP_WRITE_BEHIND_THREAD
+	/* The other buffer must be free before we can start filling it. */
+	wtap_write_behind_wait(wb);
+	g_mutex_lock(&wb->mtx);
+	wb->pending = wb->cur;
+	wb->cur = !wb->cur;
+	g_cond_broadcast(&wb->cond);
+	g_mutex_unlock(&wb->mtx);
+#else
+	if (wb->err == 0)
+		wb->err = wtap_write_behind_write((FILE *)wdh->fh,
+		    wb->buf[wb->cur], wb->len[wb->cur]);
+	wb->len[wb->cur] = 0;
+#endif
+}
+
+/* Get everything buffered so far out to the file */
+static gboolean
+wtap_write_behind_drain(wtap_dumper *wdh, int *err)
+{
+	struct wtap_write_behind *wb = wdh->write_behind;
+
+	if (wb == NULL)
+		return TRUE;
+	wtap_write_behind_submit(wdh);
+#ifdef WTAP_WRITE_BEHIND_THREAD
+	wtap_write_behind_wait(wb);
+#endif
+	*err = wtap_write_behind_error(wb);
+	return *err == 0;
+}
+
+/* Drain the buffers, stop the writer thread, and go back to direct writes */
+static gboolean
+wtap_write_behind_finish(wtap_dumper *wdh, int *err)
+{
+	struct wtap_write_behind *wb = wdh->write_behind;
+	gboolean ret;
+
+	ret = wtap_write_behind_drain(wdh, err);
+#ifdef WTAP_WRITE_BEHIND_THREAD
+	g_mutex_lock(&wb->mtx);
+	wb->stop = TRUE;
+	g_cond_broadcast(&wb->cond);
+	g_mutex_unlock(&wb->mtx);
+	g_thread_join(wb->thread);
+	g_mutex_clear(&wb->mtx);
+	g_cond_clear(&wb->cond);
+#endif
+	g_free(wb->buf[0]);
+	g_free(wb->buf[1]);
+	g_free(wb);
+	wdh->write_behind = NULL;
+	return ret;
+}
+
+gboolean wtap_dump_set_write_behind(wtap_dumper *wdh, int *err)
+{
+	struct wtap_write_behind *wb;
+
+	if (wdh->write_behind != NULL)
+		return TRUE;
+	if (wdh->compressed)
+		return TRUE;	/* zlib already buffers, and isn't ours to share */
+
+	/* Get whatever the format has written so far out first. */
+	if (fflush((FILE *)wdh->fh) == EOF) {
+		*err = errno;
+		return FALSE;
+	}
+
+	wb = g_new0(struct wtap_write_behind, 1);
+	wb->buf[0] = (guint8 *)g_malloc(WTAP_WRITE_BEHIND_BUFSIZE);
+	wb->buf[1] = (guint8 *)g_malloc(WTAP_WRITE_BEHIND_BUFSIZE);
+	wdh->write_behind = wb;
+#ifdef WTAP_WRITE_BEHIND_THREAD
+	wb->pending = -1;
+	g_mutex_init(&wb->mtx);
+	g_cond_init(&wb->cond);
+	wb->thread = g_thread_new("Capture file writer", wtap_write_behind_thread, wdh);
+#endif
+	return TRUE;
+}
+
 /* internally writing raw bytes (compressed or not) */
 gboolean wtap_dump_file_write(wtap_dumper *wdh, const void *buf, size_t bufsize,
 		     int *err)
 {
 	size_t nwritten;
+	struct wtap_write_behind *wb = wdh->write_behind;
+
+	if (wb != NULL) {
+		*err = wtap_write_behind_error(wb);
+		if (*err != 0) {
+			/* An earlier buffer couldn't be written. */
+			return FALSE;
+		}
+		if (wb->len[wb->cur] + bufsize > WTAP_WRITE_BEHIND_BUFSIZE)
+			wtap_write_behind_submit(wdh);
+		if (bufsize <= WTAP_WRITE_BEHIND_BUFSIZE) {
+			memcpy(wb->buf[wb->cur] + wb->len[wb->cur], buf, bufsize);
+			wb->len[wb->cur] += bufsize;
+			return TRUE;
+		}
+		/*
+		 * Too big to buffer; once everything before it is out,
+		 * write it directly.
+		 */
+		if (!wtap_write_behind_drain(wdh, err))
+			return FALSE;
+	}
 
 #ifdef HAVE_LIBZ
 	if (wdh->compressed) {
@@ -1664,6 +2326,9 @@ static int wtap_dump_file_close(wtap_dumper *wdh)
 
 gint64 wtap_dump_file_seek(wtap_dumper *wdh, gint64 offset, int whence, int *err)
 {
+	if (!wtap_copy_run_flush(wdh, err) ||
+	    !wtap_write_behind_drain(wdh, err))
+		return -1;
 #ifdef HAVE_LIBZ
 	if(wdh->compressed) {
 		*err = WTAP_ERR_CANT_SEEK_COMPRESSED;
@@ -1683,6 +2348,10 @@ gint64 wtap_dump_file_seek(wtap_dumper *wdh, gint64 offset, int whence, int *err
 gint64 wtap_dump_file_tell(wtap_dumper *wdh, int *err)
 {
 	gint64 rval;
+
+	if (!wtap_copy_run_flush(wdh, err) ||
+	    !wtap_write_behind_drain(wdh, err))
+		return -1;
 #ifdef HAVE_LIBZ
 	if(wdh->compressed) {
 		*err = WTAP_ERR_CANT_SEEK_COMPRESSED;
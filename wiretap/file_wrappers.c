@@ -41,6 +41,12 @@
  *  3. This notice may not be removed or altered from any source distribution.
 */
 
+/*
+ * Otherwise copy_file_range() won't be declared on Linux.  It has to
+ * come before anything that might include a system header.
+ */
+#define _GNU_SOURCE
+
 #include "config.h"
 
 #ifdef HAVE_UNISTD_H
@@ -56,6 +62,7 @@
 #include "wtap-int.h"
 #include "file_wrappers.h"
 #include <wsutil/file_util.h>
+#include <wsutil/shm_ring.h>
 
 #ifdef HAVE_LIBZ
 #include <zlib.h>
@@ -105,6 +112,12 @@ wtap_get_compressed_file_extensions(void)
 /* #define GZBUFSIZE 8192 */
 #define GZBUFSIZE 4096
 
+#if GLIB_CHECK_VERSION(2,31,18)
+#define FILE_READ_AHEAD
+#endif
+
+struct read_ahead;
+
 /* values for wtap_reader compression */
 typedef enum {
 	UNKNOWN,	/* unknown - look for a gzip header */
@@ -147,14 +160,98 @@ struct wtap_reader {
 	/* fast seeking */
 	GPtrArray *fast_seek;
 	void *fast_seek_cur;
+	/* data written by a capture process, if it hands it to us */
+	shm_ring_t *shm_ring;      /* ring holding recently written data, or NULL */
+	shm_ring_file_t shm_file;  /* identity of the file, for the ring */
+	gboolean fd_behind;        /* TRUE if fd isn't at raw_pos, as we read from the ring */
+	/* data read and decompressed ahead by a background thread */
+	struct read_ahead *read_ahead; /* what we take our data from, or NULL */
+};
+
+#ifdef FILE_READ_AHEAD
+/*
+ * Read-ahead for a compressed file being read sequentially.  Reading and
+ * decompressing the file is done by a background thread, a few blocks
+ * ahead of where the stream is, so that it overlaps with whatever is done
+ * with the data - dissecting it, for the initial read of a capture file.
+ *
+ * The thread reads through a stream of its own, which takes over the
+ * file, the buffered data and the decompression state of the stream
+ * being read ahead; that stream then reads the uncompressed data out of
+ * the blocks the thread fills, as if it were reading an uncompressed
+ * file.  Seeking outside what's been read ahead waits for the thread to
+ * be idle, and seeks the thread's stream.
+ *
+ * The fast seek points are added by the thread while the random access
+ * stream may be looking them up, so they're protected by a lock.
+ */
+#define READ_AHEAD_BLOCKS	8
+#define READ_AHEAD_BLOCKSIZE	(256*1024)
+
+struct read_ahead_block {
+	unsigned char *data;
+	guint len;                 /* amount of data in the block */
+	guint used;                /* amount of it already consumed */
+	gint64 pos;                /* uncompressed offset of data[0] */
+	gint64 raw_end;            /* file offset just after the data */
 };
 
+struct read_ahead {
+	FILE_T src;                /* stream the thread reads */
+	GThread *thread;
+	GMutex mtx;
+	GCond cond;
+	struct read_ahead_block blocks[READ_AHEAD_BLOCKS];
+	guint first;               /* oldest block not completely consumed */
+	guint count;               /* number of blocks filled */
+	gboolean busy;             /* TRUE while the thread reads src */
+	gboolean paused;           /* TRUE while somebody else uses src */
+	gboolean done;             /* TRUE once src is at its end or failed */
+	gboolean stop;             /* TRUE to make the thread exit */
+	gint64 raw_pos;            /* file offset of the data consumed so far */
+};
+
+static GMutex fast_seek_mtx;
+
+#define FAST_SEEK_LOCK()	g_mutex_lock(&fast_seek_mtx)
+#define FAST_SEEK_UNLOCK()	g_mutex_unlock(&fast_seek_mtx)
+
+static int read_ahead_read(FILE_T state, unsigned char *buf, unsigned int count, guint *have);
+static int read_ahead_seek(FILE_T state, gint64 pos, int *err);
+#else
+#define FAST_SEEK_LOCK()
+#define FAST_SEEK_UNLOCK()
+#endif
+
 static int	/* gz_load */
 raw_read(FILE_T state, unsigned char *buf, unsigned int count, guint *have)
 {
 	ssize_t ret;
 
+#ifdef FILE_READ_AHEAD
+	if (state->read_ahead != NULL)
+		return read_ahead_read(state, buf, count, have);
+#endif
 	*have = 0;
+	if (state->shm_ring != NULL) {
+		/* If the data's still in the capture process's ring, take it
+		   from there, rather than reading back what it just wrote */
+		*have = shm_ring_read(state->shm_ring, &state->shm_file,
+		    state->raw_pos, buf, count);
+		if (*have != 0) {
+			state->raw_pos += *have;
+			state->fd_behind = TRUE;
+			return 0;
+		}
+		if (state->fd_behind) {
+			if (ws_lseek64(state->fd, state->raw_pos, SEEK_SET) == -1) {
+				state->err = errno;
+				state->err_info = NULL;
+				return -1;
+			}
+			state->fd_behind = FALSE;
+		}
+	}
 	do {
 		ret = read(state->fd, buf + *have, count - *have);
 		if (ret <= 0)
@@ -223,6 +320,7 @@ fast_seek_find(FILE_T file, gint64 pos)
 	if (!file->fast_seek)
 		return NULL;
 
+	FAST_SEEK_LOCK();
 	for (low = 0, max = file->fast_seek->len; low < max; ) {
 		i = (low + max) / 2;
 		item = (struct fast_seek_point *)file->fast_seek->pdata[i];
@@ -233,9 +331,11 @@ fast_seek_find(FILE_T file, gint64 pos)
 			smallest = item;
 			low = i + 1;
 		} else {
-			return item;
+			smallest = item;
+			break;
 		}
 	}
+	FAST_SEEK_UNLOCK();
 	return smallest;
 }
 
@@ -245,6 +345,7 @@ fast_seek_header(FILE_T file, gint64 in_pos, gint64 out_pos,
 {
 	struct fast_seek_point *item = NULL;
 
+	FAST_SEEK_LOCK();
 	if (file->fast_seek->len != 0)
 		item = (struct fast_seek_point *)file->fast_seek->pdata[file->fast_seek->len - 1];
 
@@ -256,6 +357,7 @@ fast_seek_header(FILE_T file, gint64 in_pos, gint64 out_pos,
 
 		g_ptr_array_add(file->fast_seek, val);
 	}
+	FAST_SEEK_UNLOCK();
 }
 
 static void
@@ -402,14 +504,18 @@ gz_skipzstr(FILE_T state)
 static void
 zlib_fast_seek_add(FILE_T file, struct zlib_cur_seek_point *point, int bits, gint64 in_pos, gint64 out_pos)
 {
-	/* it's for sure after gzip header, so file->fast_seek->len != 0 */
-	struct fast_seek_point *item = (struct fast_seek_point *)file->fast_seek->pdata[file->fast_seek->len - 1];
+	struct fast_seek_point *item;
 
 #ifndef HAVE_INFLATEPRIME
 	if (bits)
 		return;
 #endif
 
+	/* it's for sure after gzip header, so file->fast_seek->len != 0 */
+	FAST_SEEK_LOCK();
+	item = (struct fast_seek_point *)file->fast_seek->pdata[file->fast_seek->len - 1];
+	FAST_SEEK_UNLOCK();
+
 	/* Glib has got Balanced Binary Trees (GTree) but I couldn't find a way to do quick search for nearest (and smaller) value to seek (It's what fast_seek_find() do)
 	 *      Inserting value in middle of sorted array is expensive, so we want to add only in the end.
 	 *      It's not big deal, cause first-read don't usually invoke seeking
@@ -445,7 +551,9 @@ zlib_fast_seek_add(FILE_T file, struct zlib_cur_seek_point *point, int bits, gin
 		 */
 		val->data.zlib.adler = (guint32) file->strm.adler;
 		val->data.zlib.total_out = (guint32) file->strm.total_out;
+		FAST_SEEK_LOCK();
 		g_ptr_array_add(file->fast_seek, val);
+		FAST_SEEK_UNLOCK();
 	}
 }
 
@@ -798,6 +906,9 @@ file_fdopen(int fd)
 
 	state->fast_seek_cur = NULL;
 	state->fast_seek = NULL;
+	state->shm_ring = NULL;
+	state->fd_behind = FALSE;
+	state->read_ahead = NULL;
 
 	/* open the file with the appropriate mode (or just use fd) */
 	state->fd = fd;
@@ -996,10 +1107,12 @@ file_seek(FILE_T file, gint64 offset, int whence, int *err)
 			*err = errno;
 			return -1;
 		}
+		file->fd_behind = FALSE;
 		fast_seek_reset(file);
 
 		file->raw_pos = off;
 		file->have = 0;
+		file->next = file->out;    /* what's buffered is no longer before pos */
 		file->eof = FALSE;
 		file->seek_pending = FALSE;
 		file->err = 0;
@@ -1056,12 +1169,22 @@ file_seek(FILE_T file, gint64 offset, int whence, int *err)
 	if (file->compression == UNCOMPRESSED && file->pos + offset >= file->raw
 			&& (offset < 0 || offset >= file->have) /* seek only when we don't have that offset in buffer */)
 	{
-		if (ws_lseek64(file->fd, offset - file->have, SEEK_CUR) == -1) {
-			*err = errno;
-			return -1;
+#ifdef FILE_READ_AHEAD
+		if (file->read_ahead != NULL) {
+			if (read_ahead_seek(file, file->raw_pos + (offset - file->have), err) == -1)
+				return -1;
+		} else
+#endif
+		{
+			if (ws_lseek64(file->fd, file->raw_pos + (offset - file->have), SEEK_SET) == -1) {
+				*err = errno;
+				return -1;
+			}
+			file->fd_behind = FALSE;
 		}
 		file->raw_pos += (offset - file->have);
 		file->have = 0;
+		file->next = file->out;
 		file->eof = FALSE;
 		file->seek_pending = FALSE;
 		file->err = 0;
@@ -1085,9 +1208,11 @@ file_seek(FILE_T file, gint64 offset, int whence, int *err)
 			*err = errno;
 			return -1;
 		}
+		file->fd_behind = FALSE;
 		fast_seek_reset(file);
 		file->raw_pos = file->start;
 		gz_reset(file);
+		file->next = file->out;
 	}
 
 	/* skip what's in output buffer (one less gzgetc() check) */
@@ -1130,12 +1255,21 @@ file_tell(FILE_T stream)
 gint64
 file_tell_raw(FILE_T stream)
 {
+#ifdef FILE_READ_AHEAD
+	if (stream->read_ahead != NULL)
+		return stream->read_ahead->raw_pos;
+#endif
 	return stream->raw_pos;
 }
 
 int
 file_fstat(FILE_T stream, ws_statb64 *statb, int *err)
 {
+#ifdef FILE_READ_AHEAD
+	/* The thread's stream has the file; fstat() doesn't disturb it. */
+	if (stream->read_ahead != NULL)
+		stream = stream->read_ahead->src;
+#endif
 	if (ws_fstat64(stream->fd, statb) == -1) {
 		if (err != NULL)
 			*err = errno;
@@ -1150,20 +1284,100 @@ file_iscompressed(FILE_T stream)
 	return stream->is_compressed;
 }
 
+/*
+ * Return a new descriptor for the file underneath an uncompressed stream,
+ * for copying bytes straight out of it, or -1 if it's compressed.
+ */
 int
-file_read(void *buf, unsigned int len, FILE_T file)
+file_dup_fd(FILE_T stream)
 {
-	guint got, n;
+	if (stream->is_compressed || stream->fd == -1)
+		return -1;
+	return ws_dup(stream->fd);
+}
 
-	/* if len is zero, avoid unnecessary operations */
+/*
+ * Copy len bytes at offset in_off of one file to the current position of
+ * another, without going through our buffers.  Where the OS can copy
+ * between files itself, let it; otherwise read and write in chunks.
+ *
+ * The input descriptor may share its file position with a stream that's
+ * being read sequentially, so that position is left as we found it.
+ */
+gboolean
+file_copy_raw(int in_fd, gint64 in_off, gint64 len, int out_fd, int *err)
+{
+	guint8 buf[65536];
+	gint64 saved_pos;
+	ssize_t nread, nwritten, n;
+
+#ifdef HAVE_COPY_FILE_RANGE
+	loff_t off = in_off;
+
+	while (len > 0) {
+		n = copy_file_range(in_fd, &off, out_fd, NULL, (size_t)len, 0);
+		if (n < 0) {
+			if (errno == ENOSYS || errno == EXDEV || errno == EINVAL ||
+			    errno == EOPNOTSUPP || errno == EBADF)
+				break;	/* not supported for these files; copy it ourselves */
+			*err = errno;
+			return FALSE;
+		}
+		if (n == 0) {
+			*err = WTAP_ERR_SHORT_READ;
+			return FALSE;
+		}
+		len -= n;
+	}
+	in_off = off;
 	if (len == 0)
-		return 0;
+		return TRUE;
+#endif
+
+	saved_pos = ws_lseek64(in_fd, 0, SEEK_CUR);
+	if (saved_pos == -1 || ws_lseek64(in_fd, in_off, SEEK_SET) == -1) {
+		*err = errno;
+		return FALSE;
+	}
+	while (len > 0) {
+		nread = ws_read(in_fd, buf, (unsigned int)(len < (gint64)sizeof buf ? len : (gint64)sizeof buf));
+		if (nread <= 0) {
+			*err = nread < 0 ? errno : WTAP_ERR_SHORT_READ;
+			ws_lseek64(in_fd, saved_pos, SEEK_SET);
+			return FALSE;
+		}
+		for (nwritten = 0; nwritten < nread; nwritten += n) {
+			n = ws_write(out_fd, buf + nwritten, (unsigned int)(nread - nwritten));
+			if (n <= 0) {
+				*err = n < 0 ? errno : WTAP_ERR_SHORT_WRITE;
+				ws_lseek64(in_fd, saved_pos, SEEK_SET);
+				return FALSE;
+			}
+		}
+		len -= nread;
+	}
+	if (ws_lseek64(in_fd, saved_pos, SEEK_SET) == -1) {
+		*err = errno;
+		return FALSE;
+	}
+	return TRUE;
+}
+
+/*
+ * Read up to len bytes; return the number of bytes read, which is less
+ * than len only at the end of the file or on an error, in which case
+ * file->err is set.
+ */
+static guint
+gz_read(FILE_T file, void *buf, unsigned int len)
+{
+	guint got, n;
 
 	/* process a skip request */
 	if (file->seek_pending) {
 		file->seek_pending = FALSE;
 		if (gz_skip(file, file->skip) == -1)
-			return -1;
+			return 0;
 	}
 
 	/* get len bytes to buf, or less than len if at the end */
@@ -1181,8 +1395,8 @@ file_read(void *buf, unsigned int len, FILE_T file)
 			   we have an error that may not have been
 			   reported yet; that means we can't generate
 			   any more data into the output buffer, so
-			   return an error indication. */
-			return -1;
+			   stop with what we've gotten so far. */
+			break;
 		} else if (file->eof && file->avail_in == 0) {
 			/* We have nothing in the output buffer, and
 			   we're at the end of the input; just return
@@ -1195,7 +1409,7 @@ file_read(void *buf, unsigned int len, FILE_T file)
 			   keep looping to process the new stuff
 			   in the output buffer. */
 			if (fill_out_buffer(file) == -1)
-				return -1;
+				break;
 			continue;       /* no progress yet -- go back to memcpy() above */
 		}
 		/* update progress */
@@ -1205,9 +1419,275 @@ file_read(void *buf, unsigned int len, FILE_T file)
 		file->pos += n;
 	} while (len);
 
+	return got;
+}
+
+int
+file_read(void *buf, unsigned int len, FILE_T file)
+{
+	guint got;
+
+	/* if len is zero, avoid unnecessary operations */
+	if (len == 0)
+		return 0;
+
+	got = gz_read(file, buf, len);
+
+	/* if we stopped short because of an error, report it */
+	if (got < len && file->err)
+		return -1;
 	return (int)got;
 }
 
+#ifdef FILE_READ_AHEAD
+static gpointer
+read_ahead_thread(gpointer data)
+{
+	struct read_ahead *ra = (struct read_ahead *)data;
+	struct read_ahead_block *block;
+
+	g_mutex_lock(&ra->mtx);
+	for (;;) {
+		while (!ra->stop &&
+		    (ra->paused || ra->done || ra->count == READ_AHEAD_BLOCKS))
+			g_cond_wait(&ra->cond, &ra->mtx);
+		if (ra->stop)
+			break;
+
+		/* Fill the next free block, outside the lock; nobody
+		   else touches it or src while we're busy. */
+		block = &ra->blocks[(ra->first + ra->count) % READ_AHEAD_BLOCKS];
+		ra->busy = TRUE;
+		g_mutex_unlock(&ra->mtx);
+
+		block->pos = file_tell(ra->src);
+		block->len = gz_read(ra->src, block->data, READ_AHEAD_BLOCKSIZE);
+		block->used = 0;
+		block->raw_end = ra->src->raw_pos;
+
+		g_mutex_lock(&ra->mtx);
+		ra->busy = FALSE;
+		if (block->len != 0)
+			ra->count++;
+		if (block->len < READ_AHEAD_BLOCKSIZE)
+			ra->done = TRUE;	/* end of file, or an error */
+		g_cond_broadcast(&ra->cond);
+	}
+	g_mutex_unlock(&ra->mtx);
+	return NULL;
+}
+
+/* Called with the lock held; wait until the thread leaves src alone. */
+static void
+read_ahead_pause(struct read_ahead *ra)
+{
+	ra->paused = TRUE;
+	while (ra->busy)
+		g_cond_wait(&ra->cond, &ra->mtx);
+}
+
+/* Called with the lock held. */
+static void
+read_ahead_resume(struct read_ahead *ra)
+{
+	ra->paused = FALSE;
+	g_cond_broadcast(&ra->cond);
+}
+
+/* raw_read() for a stream that's read ahead: copy what the thread has
+   read, waiting for it if it's not there yet. */
+static int
+read_ahead_read(FILE_T state, unsigned char *buf, unsigned int count, guint *have)
+{
+	struct read_ahead *ra = state->read_ahead;
+	struct read_ahead_block *block;
+	guint n;
+
+	*have = 0;
+	g_mutex_lock(&ra->mtx);
+	while (ra->count == 0 && !ra->done)
+		g_cond_wait(&ra->cond, &ra->mtx);
+	while (ra->count != 0 && *have < count) {
+		block = &ra->blocks[ra->first];
+		n = block->len - block->used;
+		if (n > count - *have)
+			n = count - *have;
+		memcpy(buf + *have, block->data + block->used, n);
+		block->used += n;
+		*have += n;
+		ra->raw_pos = block->raw_end;
+		if (block->used == block->len) {
+			ra->first = (ra->first + 1) % READ_AHEAD_BLOCKS;
+			ra->count--;
+			g_cond_broadcast(&ra->cond);
+		}
+	}
+	if (*have == 0) {
+		/* The thread is done, and everything it read has been
+		   consumed; pass on its error, if it stopped on one. */
+		if (ra->src->err) {
+			state->err = ra->src->err;
+			state->err_info = ra->src->err_info;
+			g_mutex_unlock(&ra->mtx);
+			return -1;
+		}
+		state->eof = TRUE;
+	}
+	g_mutex_unlock(&ra->mtx);
+	state->raw_pos += *have;
+	return 0;
+}
+
+/* Find the uncompressed offset pos in the blocks read ahead, and drop
+   the blocks before it.  Called with the lock held. */
+static gboolean
+read_ahead_find(struct read_ahead *ra, gint64 pos)
+{
+	struct read_ahead_block *block;
+	guint i;
+
+	for (i = 0; i < ra->count; i++) {
+		block = &ra->blocks[(ra->first + i) % READ_AHEAD_BLOCKS];
+		if (pos >= block->pos + block->used && pos < block->pos + block->len) {
+			/* Dropping the blocks before it leaves the
+			   block being filled, if any, where it was. */
+			ra->first = (ra->first + i) % READ_AHEAD_BLOCKS;
+			ra->count -= i;
+			block->used = (guint)(pos - block->pos);
+			ra->raw_pos = block->raw_end;
+			g_cond_broadcast(&ra->cond);
+			return TRUE;
+		}
+	}
+	return FALSE;
+}
+
+/* Make the uncompressed offset pos the next data read_ahead_read()
+   returns. */
+static int
+read_ahead_seek(FILE_T state, gint64 pos, int *err)
+{
+	struct read_ahead *ra = state->read_ahead;
+	gint64 ret = 0;
+
+	g_mutex_lock(&ra->mtx);
+	if (!read_ahead_find(ra, pos)) {
+		read_ahead_pause(ra);
+		if (!read_ahead_find(ra, pos)) {
+			/* Not read yet, or already consumed; start over
+			   from there. */
+			ra->count = 0;
+			ra->done = FALSE;
+			g_mutex_unlock(&ra->mtx);
+			ret = file_seek(ra->src, pos, SEEK_SET, err);
+			g_mutex_lock(&ra->mtx);
+			if (ret == -1)
+				ra->done = TRUE;
+			else
+				ra->raw_pos = file_tell_raw(ra->src);
+		}
+		read_ahead_resume(ra);
+	}
+	g_mutex_unlock(&ra->mtx);
+	return ret == -1 ? -1 : 0;
+}
+
+static void
+read_ahead_free(struct read_ahead *ra)
+{
+	int i;
+
+	g_mutex_lock(&ra->mtx);
+	ra->stop = TRUE;
+	g_cond_broadcast(&ra->cond);
+	g_mutex_unlock(&ra->mtx);
+	g_thread_join(ra->thread);
+	g_mutex_clear(&ra->mtx);
+	g_cond_clear(&ra->cond);
+
+	file_close(ra->src);
+	for (i = 0; i < READ_AHEAD_BLOCKS; i++)
+		g_free(ra->blocks[i].data);
+	g_free(ra);
+}
+#endif
+
+gboolean
+file_set_read_ahead(FILE_T file)
+{
+#ifdef FILE_READ_AHEAD
+	struct read_ahead *ra;
+	FILE_T src;
+	unsigned char *in, *out;
+	gint64 pos;
+	int i;
+
+	if (file->read_ahead != NULL)
+		return TRUE;
+	/* Reading an uncompressed file is cheap, and the OS reads ahead. */
+	if (!file->is_compressed || file->err != 0)
+		return FALSE;
+
+	src = (FILE_T)g_try_malloc(sizeof *src);
+	in = (unsigned char *)g_try_malloc(file->size);
+	out = (unsigned char *)g_try_malloc(file->size << 1);
+	if (src == NULL || in == NULL || out == NULL) {
+		g_free(out);
+		g_free(in);
+		g_free(src);
+		return FALSE;
+	}
+
+	/* The thread's stream takes over the file, the buffered data, any
+	   pending skip and the decompression state. */
+	*src = *file;
+#ifdef HAVE_LIBZ
+	if (inflateCopy(&src->strm, &file->strm) != Z_OK) {
+		g_free(out);
+		g_free(in);
+		g_free(src);
+		return FALSE;
+	}
+#endif
+
+	/* This stream now just copies the data the thread reads, as if
+	   the file were uncompressed. */
+	pos = file_tell(file);
+	file->in = in;
+	file->out = out;
+	file->next = out;
+	file->have = 0;
+	file->avail_in = 0;
+	file->next_in = in;
+	file->eof = FALSE;
+	file->seek_pending = FALSE;
+	file->compression = UNCOMPRESSED;
+	file->start = 0;
+	file->raw = 0;
+	file->pos = pos;
+	file->raw_pos = pos;
+	file->fd = -1;
+	file->fd_behind = FALSE;
+	file->fast_seek = NULL;
+	file->fast_seek_cur = NULL;
+	file->shm_ring = NULL;
+
+	ra = g_new0(struct read_ahead, 1);
+	ra->src = src;
+	ra->raw_pos = src->raw_pos;
+	for (i = 0; i < READ_AHEAD_BLOCKS; i++)
+		ra->blocks[i].data = (unsigned char *)g_malloc(READ_AHEAD_BLOCKSIZE);
+	g_mutex_init(&ra->mtx);
+	g_cond_init(&ra->cond);
+	file->read_ahead = ra;
+	ra->thread = g_thread_new("Capture file reader", read_ahead_thread, ra);
+	return TRUE;
+#else
+	(void)file;
+	return FALSE;
+#endif
+}
+
 /*
  * XXX - this gets a byte, not a character.
  */
@@ -1325,6 +1805,19 @@ file_error(FILE_T fh, gchar **err_info)
 void
 file_clearerr(FILE_T stream)
 {
+#ifdef FILE_READ_AHEAD
+	struct read_ahead *ra = stream->read_ahead;
+
+	if (ra != NULL) {
+		/* Have the thread try again from where it stopped */
+		g_mutex_lock(&ra->mtx);
+		read_ahead_pause(ra);
+		file_clearerr(ra->src);
+		ra->done = FALSE;
+		read_ahead_resume(ra);
+		g_mutex_unlock(&ra->mtx);
+	}
+#endif
 	/* clear error and end-of-file */
 	stream->err = 0;
 	stream->err_info = NULL;
@@ -1334,6 +1827,19 @@ file_clearerr(FILE_T stream)
 void
 file_fdclose(FILE_T file)
 {
+#ifdef FILE_READ_AHEAD
+	struct read_ahead *ra = file->read_ahead;
+
+	if (ra != NULL) {
+		g_mutex_lock(&ra->mtx);
+		read_ahead_pause(ra);
+		file_fdclose(ra->src);
+		ra->paused = FALSE;	/* nothing to read until it's reopened */
+		ra->done = TRUE;
+		g_mutex_unlock(&ra->mtx);
+		return;
+	}
+#endif
 	ws_close(file->fd);
 	file->fd = -1;
 }
@@ -1343,16 +1849,61 @@ file_fdreopen(FILE_T file, const char *path)
 {
 	int fd;
 
+#ifdef FILE_READ_AHEAD
+	struct read_ahead *ra = file->read_ahead;
+
+	if (ra != NULL) {
+		gboolean ret;
+
+		g_mutex_lock(&ra->mtx);
+		read_ahead_pause(ra);
+		ret = file_fdreopen(ra->src, path);
+		if (ret)
+			ra->done = FALSE;
+		read_ahead_resume(ra);
+		g_mutex_unlock(&ra->mtx);
+		return ret;
+	}
+#endif
 	if ((fd = ws_open(path, O_RDONLY|O_BINARY, 0000)) == -1)
 		return FALSE;
+	/*
+	 * Carry on reading from where the old descriptor left off, in
+	 * case we're in the middle of a sequential read.
+	 */
+	if (file->raw_pos != 0 && ws_lseek64(fd, file->raw_pos, SEEK_SET) == -1) {
+		ws_close(fd);
+		return FALSE;
+	}
 	file->fd = fd;
+	file->fd_behind = FALSE;
 	return TRUE;
 }
 
+void
+file_set_shm_ring(FILE_T file, shm_ring_t *ring)
+{
+	if (file->shm_ring != NULL) {
+		shm_ring_unref(file->shm_ring);
+		file->shm_ring = NULL;
+	}
+	if (ring == NULL || file->fd == -1 ||
+	    !shm_ring_file_identify(file->fd, &file->shm_file))
+		return;
+	file->shm_ring = shm_ring_ref(ring);
+}
+
 void
 file_close(FILE_T file)
 {
-	int fd = file->fd;
+	int fd;
+
+#ifdef FILE_READ_AHEAD
+	/* stop the thread; it has the file */
+	if (file->read_ahead != NULL)
+		read_ahead_free(file->read_ahead);
+#endif
+	fd = file->fd;
 
 	/* free memory and close file */
 	if (file->size) {
@@ -1363,6 +1914,8 @@ file_close(FILE_T file)
 		g_free(file->in);
 	}
 	g_free(file->fast_seek_cur);
+	if (file->shm_ring != NULL)
+		shm_ring_unref(file->shm_ring);
 	file->err = 0;
 	file->err_info = NULL;
 	g_free(file);
@@ -26,6 +26,7 @@
 #include <glib.h>
 #include <wtap.h>
 #include <wsutil/file_util.h>
+#include <wsutil/shm_ring.h>
 #include "ws_symbol_export.h"
 
 extern FILE_T file_open(const char *path);
@@ -37,6 +38,8 @@ WS_DLL_PUBLIC gint64 file_tell(FILE_T stream);
 extern gint64 file_tell_raw(FILE_T stream);
 extern int file_fstat(FILE_T stream, ws_statb64 *statb, int *err);
 extern gboolean file_iscompressed(FILE_T stream);
+extern int file_dup_fd(FILE_T stream);
+extern gboolean file_copy_raw(int in_fd, gint64 in_off, gint64 len, int out_fd, int *err);
 WS_DLL_PUBLIC int file_read(void *buf, unsigned int count, FILE_T file);
 WS_DLL_PUBLIC int file_getc(FILE_T stream);
 WS_DLL_PUBLIC char *file_gets(char *buf, int len, FILE_T stream);
@@ -45,6 +48,8 @@ WS_DLL_PUBLIC int file_error(FILE_T fh, gchar **err_info);
 extern void file_clearerr(FILE_T stream);
 extern void file_fdclose(FILE_T file);
 extern int file_fdreopen(FILE_T file, const char *path);
+extern void file_set_shm_ring(FILE_T file, shm_ring_t *ring);
+extern gboolean file_set_read_ahead(FILE_T file);
 extern void file_close(FILE_T file);
 
 #ifdef HAVE_LIBZ
@@ -504,6 +504,21 @@ done:
 	return 1;
 }
 
+/*
+ * Return TRUE if the records of this file can be copied to a libpcap file
+ * of the same type as-is, i.e. they're in our byte order and reading them
+ * doesn't change anything in the record header or packet data.
+ */
+gboolean libpcap_can_copy_records(wtap *wth)
+{
+	libpcap_t *libpcap = (libpcap_t *)wth->priv;
+
+	if (wth->subtype_read != libpcap_read)
+		return FALSE;
+	return !libpcap->byte_swapped &&
+	    libpcap->lengths_swapped == NOT_SWAPPED;
+}
+
 /* Try to read the first two records of the capture file. */
 static libpcap_try_t libpcap_try(wtap *wth, int *err)
 {
@@ -599,7 +614,7 @@ static gboolean libpcap_read(wtap *wth, int *err, gchar **err_info,
 	*data_offset = file_tell(wth->fh);
 
 	return libpcap_read_packet(wth, wth->fh, &wth->phdr,
-	    wth->frame_buffer, err, err_info);
+	    wth->metadata_only ? NULL : wth->frame_buffer, err, err_info);
 }
 
 static gboolean
@@ -689,6 +704,12 @@ libpcap_read_packet(wtap *wth, FILE_T fh, struct wtap_pkthdr *phdr,
 	phdr->caplen = packet_size;
 	phdr->len = orig_size;
 
+	/*
+	 * If our caller only wants the metadata, skip the packet data.
+	 */
+	if (buf == NULL)
+		return file_skip(fh, packet_size, err);
+
 	/*
 	 * Read the packet data.
 	 */
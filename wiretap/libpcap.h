@@ -105,5 +105,6 @@ struct pcaprec_nokia_hdr {
 int libpcap_open(wtap *wth, int *err, gchar **err_info);
 gboolean libpcap_dump_open(wtap_dumper *wdh, int *err);
 int libpcap_dump_can_write_encap(int encap);
+gboolean libpcap_can_copy_records(wtap *wth);
 
 #endif
@@ -44,6 +44,56 @@
 #include <string.h>
 #include "merge.h"
 
+/*
+ * State shared by all the files being merged.
+ *
+ * For a chronological merge, the files that have a packet available are
+ * kept in a binary min-heap ordered by the time stamp of that packet, so
+ * that finding the next packet to write is O(log N) in the number of
+ * files rather than O(N).
+ */
+typedef struct merge_state_s {
+  merge_in_file_t **heap;         /* files with a packet available */
+  guint             heap_len;
+  gboolean          primed;       /* have we read the first packet of every file? */
+  merge_in_file_t  *last;         /* file whose packet we returned last */
+  gboolean          limit_open;   /* are we limiting the number of open files? */
+  guint             open_count;   /* number of files with an open descriptor */
+  merge_in_file_t  *lru_head;     /* open file read from least recently */
+  merge_in_file_t  *lru_tail;     /* open file read from most recently */
+} merge_state_t;
+
+/*
+ * When the number of open files is limited, the open files are kept in a
+ * list, least recently read first, so that picking the one to close when
+ * another must be reopened is O(1).
+ */
+static void
+lru_unlink(merge_state_t *state, merge_in_file_t *f)
+{
+  if (f->lru_prev != NULL)
+    f->lru_prev->lru_next = f->lru_next;
+  else
+    state->lru_head = f->lru_next;
+  if (f->lru_next != NULL)
+    f->lru_next->lru_prev = f->lru_prev;
+  else
+    state->lru_tail = f->lru_prev;
+  f->lru_prev = f->lru_next = NULL;
+}
+
+static void
+lru_append(merge_state_t *state, merge_in_file_t *f)
+{
+  f->lru_prev = state->lru_tail;
+  f->lru_next = NULL;
+  if (state->lru_tail != NULL)
+    state->lru_tail->lru_next = f;
+  else
+    state->lru_head = f;
+  state->lru_tail = f;
+}
+
 /*
  * Scan through the arguments and open the input files
  */
@@ -55,21 +105,32 @@ merge_open_in_files(int in_file_count, char *const *in_file_names,
   int i, j;
   size_t files_size = in_file_count * sizeof(merge_in_file_t);
   merge_in_file_t *files;
+  merge_state_t *state;
   gint64 size;
 
   files = (merge_in_file_t *)g_malloc(files_size);
   *in_files = files;
 
+  state = g_new0(merge_state_t, 1);
+  state->heap = g_new(merge_in_file_t *, in_file_count);
+  state->limit_open = in_file_count > MERGE_MAX_OPEN_FILES;
+
   for (i = 0; i < in_file_count; i++) {
     files[i].filename    = in_file_names[i];
     files[i].wth         = wtap_open_offline(in_file_names[i], err, err_info, FALSE);
     files[i].data_offset = 0;
     files[i].state       = PACKET_NOT_PRESENT;
     files[i].packet_num  = 0;
+    files[i].merge_state = state;
+    files[i].fd_closed   = FALSE;
+    files[i].lru_prev    = NULL;
+    files[i].lru_next    = NULL;
     if (!files[i].wth) {
       /* Close the files we've already opened. */
       for (j = 0; j < i; j++)
         wtap_close(files[j].wth);
+      g_free(state->heap);
+      g_free(state);
       *err_fileno = i;
       return FALSE;
     }
@@ -77,10 +138,22 @@ merge_open_in_files(int in_file_count, char *const *in_file_names,
     if (size == -1) {
       for (j = 0; j <= i; j++)
         wtap_close(files[j].wth);
+      g_free(state->heap);
+      g_free(state);
       *err_fileno = i;
       return FALSE;
     }
     files[i].size = size;
+
+    /*
+     * If there are too many files to keep them all open, close the
+     * descriptor until we actually read from the file; we've read
+     * everything the caller needs to set up the merge.
+     */
+    if (state->limit_open) {
+      wtap_fdclose(files[i].wth);
+      files[i].fd_closed = TRUE;
+    }
   }
   return TRUE;
 }
@@ -92,11 +165,62 @@ void
 merge_close_in_files(int count, merge_in_file_t in_files[])
 {
   int i;
+  merge_state_t *state;
+
+  if (count > 0) {
+    state = in_files[0].merge_state;
+    g_free(state->heap);
+    g_free(state);
+  }
   for (i = 0; i < count; i++) {
     wtap_close(in_files[i].wth);
   }
 }
 
+/*
+ * Read the next packet from one input file, reopening the file first if
+ * we'd closed it, and closing it once we reach its end.  If that would
+ * leave too many files open, close the one we read from least recently.
+ */
+static gboolean
+merge_read_one(merge_in_file_t *in_file, int *err, gchar **err_info)
+{
+  merge_state_t *state = in_file->merge_state;
+  merge_in_file_t *victim;
+
+  if (in_file->fd_closed) {
+    if (state->open_count >= MERGE_MAX_OPEN_FILES &&
+        (victim = state->lru_head) != NULL) {
+      lru_unlink(state, victim);
+      wtap_fdclose(victim->wth);
+      victim->fd_closed = TRUE;
+      state->open_count--;
+    }
+    if (!wtap_sequential_fdreopen(in_file->wth, in_file->filename, err)) {
+      *err_info = NULL;
+      return FALSE;
+    }
+    in_file->fd_closed = FALSE;
+    state->open_count++;
+    lru_append(state, in_file);
+  } else if (state->limit_open && state->lru_tail != in_file) {
+    /* Now the most recently read */
+    lru_unlink(state, in_file);
+    lru_append(state, in_file);
+  }
+
+  if (wtap_read(in_file->wth, err, err_info, &in_file->data_offset))
+    return TRUE;
+  if (*err == 0 && state->limit_open) {
+    /* At EOF; we won't read from this file again. */
+    lru_unlink(state, in_file);
+    wtap_fdclose(in_file->wth);
+    in_file->fd_closed = TRUE;
+    state->open_count--;
+  }
+  return FALSE;
+}
+
 /*
  * Select an output frame type based on the input files
  * From Guy: If all files have the same frame type, then use that.
@@ -164,6 +288,59 @@ is_earlier(struct wtap_nstime *l, struct wtap_nstime *r) {
   return TRUE;
 }
 
+/*
+ * Heap ordering: the file with the earlier packet comes first; for
+ * packets with the same time stamp, the file later on the command line
+ * comes first, as it always has.
+ */
+static gboolean
+heap_before(merge_in_file_t *l, merge_in_file_t *r)
+{
+  struct wtap_nstime *lts = &wtap_phdr(l->wth)->ts;
+  struct wtap_nstime *rts = &wtap_phdr(r->wth)->ts;
+
+  if (lts->secs != rts->secs || lts->nsecs != rts->nsecs)
+    return is_earlier(lts, rts);
+  return l > r;
+}
+
+static void
+heap_sift_up(merge_state_t *state, guint i)
+{
+  merge_in_file_t *f = state->heap[i];
+  guint parent;
+
+  while (i > 0) {
+    parent = (i - 1) / 2;
+    if (!heap_before(f, state->heap[parent]))
+      break;
+    state->heap[i] = state->heap[parent];
+    i = parent;
+  }
+  state->heap[i] = f;
+}
+
+static void
+heap_sift_down(merge_state_t *state, guint i)
+{
+  merge_in_file_t *f = state->heap[i];
+  guint child;
+
+  for (;;) {
+    child = 2 * i + 1;
+    if (child >= state->heap_len)
+      break;
+    if (child + 1 < state->heap_len &&
+        heap_before(state->heap[child + 1], state->heap[child]))
+      child++;
+    if (!heap_before(state->heap[child], f))
+      break;
+    state->heap[i] = state->heap[child];
+    i = child;
+  }
+  state->heap[i] = f;
+}
+
 /*
  * Read the next packet, in chronological order, from the set of files
  * to be merged.
@@ -182,58 +359,80 @@ merge_read_packet(int in_file_count, merge_in_file_t in_files[],
                   int *err, gchar **err_info)
 {
   int i;
-  int ei = -1;
-  struct wtap_nstime tv = { sizeof(time_t) > sizeof(int) ? LONG_MAX : INT_MAX, INT_MAX };
-  struct wtap_pkthdr *phdr;
+  merge_state_t *state;
+  merge_in_file_t *in_file;
 
-  /*
-   * Make sure we have a packet available from each file, if there are any
-   * packets left in the file in question, and search for the packet
-   * with the earliest time stamp.
-   */
-  for (i = 0; i < in_file_count; i++) {
-    if (in_files[i].state == PACKET_NOT_PRESENT) {
-      /*
-       * No packet available, and we haven't seen an error or EOF yet,
-       * so try to read the next packet.
-       */
-      if (!wtap_read(in_files[i].wth, err, err_info, &in_files[i].data_offset)) {
+  if (in_file_count == 0) {
+    *err = 0;
+    return NULL;
+  }
+  state = in_files[0].merge_state;
+
+  if (!state->primed) {
+    /*
+     * Read the first packet from each file, and put the files that
+     * have one into the heap.
+     */
+    for (i = 0; i < in_file_count; i++) {
+      if (in_files[i].state != PACKET_NOT_PRESENT)
+        continue;
+      if (!merge_read_one(&in_files[i], err, err_info)) {
         if (*err != 0) {
           in_files[i].state = GOT_ERROR;
           return &in_files[i];
         }
         in_files[i].state = AT_EOF;
-      } else
-        in_files[i].state = PACKET_PRESENT;
+        continue;
+      }
+      in_files[i].state = PACKET_PRESENT;
+      state->heap[state->heap_len] = &in_files[i];
+      heap_sift_up(state, state->heap_len);
+      state->heap_len++;
     }
-
-    if (in_files[i].state == PACKET_PRESENT) {
-      phdr = wtap_phdr(in_files[i].wth);
-      if (is_earlier(&phdr->ts, &tv)) {
-        tv = phdr->ts;
-        ei = i;
+    state->primed = TRUE;
+  } else if (state->last != NULL) {
+    /*
+     * The file we returned last is still at the top of the heap; get
+     * its next packet and move it to where that packet belongs, or
+     * take it out of the heap if it has no more packets.
+     */
+    in_file = state->last;
+    state->last = NULL;
+    if (!merge_read_one(in_file, err, err_info)) {
+      if (*err != 0) {
+        in_file->state = GOT_ERROR;
+        return in_file;
       }
+      in_file->state = AT_EOF;
+      state->heap[0] = state->heap[--state->heap_len];
+      if (state->heap_len != 0)
+        heap_sift_down(state, 0);
+    } else {
+      in_file->state = PACKET_PRESENT;
+      heap_sift_down(state, 0);
     }
   }
 
-  if (ei == -1) {
+  if (state->heap_len == 0) {
     /* All the streams are at EOF.  Return an EOF indication. */
     *err = 0;
     return NULL;
   }
 
   /* We'll need to read another packet from this file. */
-  in_files[ei].state = PACKET_NOT_PRESENT;
+  in_file = state->heap[0];
+  in_file->state = PACKET_NOT_PRESENT;
+  state->last = in_file;
 
   /* Count this packet. */
-  in_files[ei].packet_num++;
+  in_file->packet_num++;
 
   /*
    * Return a pointer to the merge_in_file_t of the file from which the
    * packet was read.
    */
   *err = 0;
-  return &in_files[ei];
+  return in_file;
 }
 
 /*
@@ -261,7 +460,7 @@ merge_append_read_packet(int in_file_count, merge_in_file_t in_files[],
   for (i = 0; i < in_file_count; i++) {
     if (in_files[i].state == AT_EOF)
       continue; /* This file is already at EOF */
-    if (wtap_read(in_files[i].wth, err, err_info, &in_files[i].data_offset))
+    if (merge_read_one(&in_files[i], err, err_info))
       break; /* We have a packet */
     if (*err != 0) {
       /* Read error - quit immediately. */
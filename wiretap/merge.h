@@ -50,8 +50,20 @@ typedef struct merge_in_file_s {
   gint64          size;		      /* file size */
   guint32         interface_id;   /* identifier of the interface.
 								   * Used for fake interfaces when writing WTAP_ENCAP_PER_PACKET */
+  struct merge_state_s *merge_state; /* state shared by all the input files */
+  gboolean        fd_closed;      /* descriptor closed to stay under the open file limit */
+  struct merge_in_file_s *lru_prev; /* open files, least recently read first, */
+  struct merge_in_file_s *lru_next; /* for picking one to close */
 } merge_in_file_t;
 
+/**
+ * Maximum number of input files we keep open at once.  When merging more
+ * files than this, input files are opened lazily and the least recently
+ * read ones are closed again, so that large merges don't run out of
+ * file descriptors.
+ */
+#define MERGE_MAX_OPEN_FILES 256
+
 /** Open a number of input files to merge.
  *
  * @param in_file_count number of entries in in_file_names and in_files
@@ -1176,9 +1176,12 @@ pcapng_read_packet_block(FILE_T fh, pcapng_block_header_t *bh, pcapng_t *pn, wta
         wblock->packet_header->ts.secs = (time_t)(ts / int_data.time_units_per_second);
         wblock->packet_header->ts.nsecs = (int)(((ts % int_data.time_units_per_second) * 1000000000) / int_data.time_units_per_second);
 
-        /* "(Enhanced) Packet Block" read capture data */
+        /* "(Enhanced) Packet Block" read capture data, unless only the metadata is wanted */
         errno = WTAP_ERR_CANT_READ;
-	if (!wtap_read_packet_bytes(fh, wblock->frame_buffer,
+        if (wblock->frame_buffer == NULL) {
+                if (!file_skip(fh, wblock->data.packet.cap_len - pseudo_header_len, err))
+                        return FALSE;
+        } else if (!wtap_read_packet_bytes(fh, wblock->frame_buffer,
 	    wblock->data.packet.cap_len - pseudo_header_len, err, err_info))
 		return FALSE;
         block_read += wblock->data.packet.cap_len - pseudo_header_len;
@@ -1295,11 +1298,12 @@ pcapng_read_packet_block(FILE_T fh, pcapng_block_header_t *bh, pcapng_t *pn, wta
 
         g_free(option_content);
 
-        pcap_read_post_process(WTAP_FILE_PCAPNG, int_data.wtap_encap,
-            (union wtap_pseudo_header *)&wblock->packet_header->pseudo_header,
-            buffer_start_ptr(wblock->frame_buffer),
-            (int) (wblock->data.packet.cap_len - pseudo_header_len),
-            pn->byte_swapped, fcslen);
+        if (wblock->frame_buffer != NULL)
+                pcap_read_post_process(WTAP_FILE_PCAPNG, int_data.wtap_encap,
+                    (union wtap_pseudo_header *)&wblock->packet_header->pseudo_header,
+                    buffer_start_ptr(wblock->frame_buffer),
+                    (int) (wblock->data.packet.cap_len - pseudo_header_len),
+                    pn->byte_swapped, fcslen);
         return block_read;
 }
 
@@ -1415,9 +1419,12 @@ pcapng_read_simple_packet_block(FILE_T fh, pcapng_block_header_t *bh, pcapng_t *
 
         memset((void *)&wblock->packet_header->pseudo_header, 0, sizeof(union wtap_pseudo_header));
 
-        /* "Simple Packet Block" read capture data */
+        /* "Simple Packet Block" read capture data, unless only the metadata is wanted */
         errno = WTAP_ERR_CANT_READ;
-	if (!wtap_read_packet_bytes(fh, wblock->frame_buffer,
+        if (wblock->frame_buffer == NULL) {
+                if (!file_skip(fh, wblock->data.simple_packet.cap_len, err))
+                        return FALSE;
+        } else if (!wtap_read_packet_bytes(fh, wblock->frame_buffer,
 	    wblock->data.simple_packet.cap_len, err, err_info))
 		return FALSE;
         block_read += wblock->data.simple_packet.cap_len;
@@ -1433,11 +1440,12 @@ pcapng_read_simple_packet_block(FILE_T fh, pcapng_block_header_t *bh, pcapng_t *
                 block_read += 4 - (wblock->data.simple_packet.cap_len % 4);
         }
 
-        pcap_read_post_process(WTAP_FILE_PCAPNG, int_data.wtap_encap,
-            (union wtap_pseudo_header *)&wblock->packet_header->pseudo_header,
-            buffer_start_ptr(wblock->frame_buffer),
-            (int) wblock->data.simple_packet.cap_len,
-            pn->byte_swapped, pn->if_fcslen);
+        if (wblock->frame_buffer != NULL)
+                pcap_read_post_process(WTAP_FILE_PCAPNG, int_data.wtap_encap,
+                    (union wtap_pseudo_header *)&wblock->packet_header->pseudo_header,
+                    buffer_start_ptr(wblock->frame_buffer),
+                    (int) wblock->data.simple_packet.cap_len,
+                    pn->byte_swapped, pn->if_fcslen);
         return block_read;
 }
 
@@ -2271,7 +2279,7 @@ pcapng_read(wtap *wth, int *err, gchar **err_info, gint64 *data_offset)
         *data_offset = file_tell(wth->fh);
         pcapng_debug1("pcapng_read: data_offset is initially %" G_GINT64_MODIFIER "d", *data_offset);
 
-        wblock.frame_buffer  = wth->frame_buffer;
+        wblock.frame_buffer  = wth->metadata_only ? NULL : wth->frame_buffer;
         wblock.packet_header = &wth->phdr;
         wblock.file_encap    = &wth->file_encap;
 
@@ -36,6 +36,7 @@
 #endif
 
 #include <wsutil/file_util.h>
+#include <wsutil/pktindex.h>
 
 #include "wtap.h"
 
@@ -77,6 +78,8 @@ struct wtap {
     wtap_new_ipv4_callback_t    add_new_ipv4;
     wtap_new_ipv6_callback_t    add_new_ipv6;
     GPtrArray                   *fast_seek;
+    pktindex_t                  *pkt_index;    /**< packet index sidecar, NULL if none attached */
+    gboolean                    metadata_only; /**< sequential reads skip the packet data */
 };
 
 struct wtap_dumper;
@@ -111,6 +114,12 @@ struct wtap_dumper {
     struct wtapng_section_s *shb_hdr;
     guint                   number_of_interfaces;   /**< The number of interfaces a capture was made on, number of IDB:s in a pcapng file or equivalent(?)*/
     GArray                  *interface_data;        /**< An array holding the interface data from pcapng IDB:s or equivalent(?) NULL if not present.*/
+    pktindex_writer_t       *pkt_index;             /**< packet index sidecar being written, NULL if none */
+    struct wtap_write_behind *write_behind;         /**< coalescing writer, NULL if writes go straight to fh */
+    struct wtap_copy_run    *copy_run;              /**< records copied from an input file but not yet written, NULL if none */
+    wtap                    *copy_wth;              /**< file the last record passed to wtap_dump_copy_record() came from, NULL if none */
+    gint64                  copy_next;              /**< offset in copy_wth just past that record */
+    gint64                  copy_streak;            /**< bytes of contiguous records from copy_wth so far */
 };
 
 gboolean wtap_dump_file_write(wtap_dumper *wdh, const void *buf,
@@ -118,6 +127,9 @@ gboolean wtap_dump_file_write(wtap_dumper *wdh, const void *buf,
 gint64 wtap_dump_file_seek(wtap_dumper *wdh, gint64 offset, int whence, int *err);
 gint64 wtap_dump_file_tell(wtap_dumper *wdh, int *err);
 
+/* Can records in files of this type be located with a packet index? */
+gboolean wtap_packet_index_supported(int filetype);
+
 
 extern gint wtap_num_file_types;
 
@@ -807,6 +807,8 @@ wtap_close(wtap *wth)
 		g_ptr_array_foreach(wth->fast_seek, g_fast_seek_item_free, NULL);
 		g_ptr_array_free(wth->fast_seek, TRUE);
 	}
+	if (wth->pkt_index != NULL)
+		pktindex_free(wth->pkt_index);
 	for(i = 0; i < (gint)wth->number_of_interfaces; i++) {
 		wtapng_if_descr = &g_array_index(wth->interface_data, wtapng_if_descr_t, i);
 		if(wtapng_if_descr->opt_comment != NULL){
@@ -859,6 +861,64 @@ void wtap_set_cb_new_ipv6(wtap *wth, wtap_new_ipv6_callback_t add_new_ipv6) {
 		wth->add_new_ipv6 = add_new_ipv6;
 }
 
+void wtap_set_shm_ring(wtap *wth, struct shm_ring *ring) {
+	if (wth && wth->fh)
+		file_set_shm_ring(wth->fh, ring);
+}
+
+gboolean
+wtap_set_read_ahead(wtap *wth)
+{
+	if (wth == NULL || wth->fh == NULL)
+		return FALSE;
+	return file_set_read_ahead(wth->fh);
+}
+
+gboolean
+wtap_set_metadata_only(wtap *wth)
+{
+	/*
+	 * Skipping is done by seeking, which, for a compressed file,
+	 * means decompressing the data anyway.
+	 */
+	if (file_iscompressed(wth->fh))
+		return FALSE;
+
+	switch (wth->file_type) {
+
+	case WTAP_FILE_PCAP:
+	case WTAP_FILE_PCAP_NSEC:
+	case WTAP_FILE_PCAP_AIX:
+	case WTAP_FILE_PCAP_SS991029:
+	case WTAP_FILE_PCAP_NOKIA:
+	case WTAP_FILE_PCAP_SS990417:
+	case WTAP_FILE_PCAP_SS990915:
+	case WTAP_FILE_PCAPNG:
+		wth->metadata_only = TRUE;
+		return TRUE;
+
+	default:
+		return FALSE;
+	}
+}
+
+/*
+ * When the packet data is skipped rather than read, a truncated last
+ * record doesn't cause a short read; it leaves us positioned past the
+ * end of the file instead.  Report that as the short read it is.
+ */
+static void
+wtap_check_skipped_to_eof(wtap *wth, int *err)
+{
+	gint64 size;
+
+	size = wtap_file_size(wth, err);
+	if (size == -1)
+		return;
+	if (file_tell(wth->fh) > size)
+		*err = WTAP_ERR_SHORT_READ;
+}
+
 gboolean
 wtap_read(wtap *wth, int *err, gchar **err_info, gint64 *data_offset)
 {
@@ -884,6 +944,8 @@ wtap_read(wtap *wth, int *err, gchar **err_info, gint64 *data_offset)
 		 */
 		if (*err == 0)
 			*err = file_error(wth->fh, err_info);
+		if (*err == 0 && wth->metadata_only)
+			wtap_check_skipped_to_eof(wth, err);
 		return FALSE;	/* failure */
 	}
 
@@ -963,3 +1025,82 @@ wtap_seek_read(wtap *wth, gint64 seek_off,
 	return wth->subtype_seek_read(wth, seek_off, phdr, buf, len,
 		err, err_info);
 }
+
+gboolean
+wtap_attach_packet_index(wtap *wth, const char *index_filename,
+	const char *capture_filename, int *err)
+{
+	pktindex_t *idx;
+	gchar *default_filename = NULL;
+	gint64 file_size;
+
+	if (!wtap_packet_index_supported(wth->file_type)) {
+		*err = WTAP_ERR_UNSUPPORTED_FILE_TYPE;
+		return FALSE;
+	}
+
+	if (index_filename == NULL) {
+		default_filename = pktindex_filename(capture_filename);
+		index_filename = default_filename;
+	}
+	idx = pktindex_read(index_filename, err);
+	g_free(default_filename);
+	if (idx == NULL) {
+		if (*err == EINVAL)
+			*err = WTAP_ERR_BAD_FILE;
+		return FALSE;
+	}
+
+	/*
+	 * The offsets are uncompressed offsets, so we can only check
+	 * the size of an uncompressed file; if it differs, the capture
+	 * file has been rewritten since the index was made.
+	 */
+	if (!wtap_iscompressed(wth)) {
+		file_size = wtap_file_size(wth, err);
+		if (file_size == -1) {
+			pktindex_free(idx);
+			return FALSE;
+		}
+		if ((guint64)file_size != idx->data_size) {
+			pktindex_free(idx);
+			*err = WTAP_ERR_BAD_FILE;
+			return FALSE;
+		}
+	}
+
+	if (wth->pkt_index != NULL)
+		pktindex_free(wth->pkt_index);
+	wth->pkt_index = idx;
+	return TRUE;
+}
+
+guint32
+wtap_packet_index_frame_count(wtap *wth)
+{
+	if (wth->pkt_index == NULL)
+		return 0;
+	return wth->pkt_index->frame_count;
+}
+
+gboolean
+wtap_seek_to_frame(wtap *wth, guint32 frame_num, guint32 *found_frame_num,
+	int *err)
+{
+	const pktindex_entry_t *entry;
+
+	*found_frame_num = 1;
+	if (wth->pkt_index == NULL) {
+		*err = WTAP_ERR_INTERNAL;
+		return FALSE;
+	}
+
+	entry = pktindex_lookup_frame(wth->pkt_index, frame_num);
+	if (entry == NULL || entry->frame_num == 1)
+		return TRUE;	/* nothing to skip */
+
+	if (file_seek(wth->fh, (gint64)entry->offset, SEEK_SET, err) == -1)
+		return FALSE;
+	*found_frame_num = entry->frame_num;
+	return TRUE;
+}
@@ -1185,6 +1185,29 @@ typedef void (*wtap_new_ipv6_callback_t) (const void *addrp, const gchar *name);
 WS_DLL_PUBLIC
 void wtap_set_cb_new_ipv6(wtap *wth, wtap_new_ipv6_callback_t add_new_ipv6);
 
+/**
+ * Read data for sequential reads from a shared memory ring that the
+ * process writing the file copies it to, when it's still there, rather
+ * than from the file (see wsutil/shm_ring.h).  Pass NULL to stop.
+ */
+struct shm_ring;
+WS_DLL_PUBLIC
+void wtap_set_shm_ring(wtap *wth, struct shm_ring *ring);
+
+/**
+ * Read and decompress a compressed file on a background thread, a few
+ * blocks ahead of wtap_read(), so that decompression overlaps with what
+ * the caller does with each record.  Uncompressed files, which are cheap
+ * to read and which the OS reads ahead anyway, are left alone, as they
+ * are where threads aren't available.
+ *
+ * @param wth The wiretap session.
+ * @return TRUE if the file is now read ahead, FALSE if not (which is
+ * harmless, just slower).
+ */
+WS_DLL_PUBLIC
+gboolean wtap_set_read_ahead(wtap *wth);
+
 /** Returns TRUE if read was successful. FALSE if failure. data_offset is
  * set to the offset in the file where the data for the read packet is
  * located. */
@@ -1197,6 +1220,64 @@ gboolean wtap_seek_read (wtap *wth, gint64 seek_off,
 	struct wtap_pkthdr *phdr, Buffer *buf, int len,
 	int *err, gchar **err_info);
 
+/**
+ * Attach a packet index sidecar file (see wsutil/pktindex.h) to an open
+ * capture file, so that wtap_seek_to_frame() can be used.
+ *
+ * Only pcap and pcap-ng files can be indexed.  The index is rejected if
+ * it wasn't finished, or if it was written for a file of a different size.
+ *
+ * @param wth The open capture file.
+ * @param index_filename The index file; NULL means the default name
+ * for the capture file, as returned by pktindex_filename().
+ * @param capture_filename The name of the capture file.
+ * @param err On failure, a positive "errno" value or a WTAP_ERR_ value.
+ * @return TRUE if the index was attached, FALSE otherwise.
+ */
+WS_DLL_PUBLIC
+gboolean wtap_attach_packet_index(wtap *wth, const char *index_filename,
+	const char *capture_filename, int *err);
+
+/**
+ * Return the number of records in the file according to its attached
+ * packet index, or 0 if no index is attached.
+ */
+WS_DLL_PUBLIC
+guint32 wtap_packet_index_frame_count(wtap *wth);
+
+/**
+ * Position the sequential stream so that the next wtap_read() returns the
+ * closest indexed record at or before a given frame.
+ *
+ * This must be done before any record has been read with wtap_read(),
+ * or the frame numbers won't line up with the caller's.
+ *
+ * @param wth The capture file, with a packet index attached.
+ * @param frame_num The 1-based number of the wanted frame.
+ * @param found_frame_num Set to the number of the record the next
+ * wtap_read() will return; that's 1, and nothing is done, if there's
+ * no index entry at or before frame_num.
+ * @param err On failure, a positive "errno" value or a WTAP_ERR_ value.
+ * @return TRUE on success, FALSE on failure.
+ */
+WS_DLL_PUBLIC
+gboolean wtap_seek_to_frame(wtap *wth, guint32 frame_num,
+	guint32 *found_frame_num, int *err);
+
+/**
+ * Have wtap_read() fill in only the record's metadata - time stamp,
+ * lengths, encapsulation - and skip over the packet data rather than
+ * reading it, for callers that never look at the data.  After this,
+ * wtap_buf_ptr() doesn't point to the data of the record just read.
+ * Random access reads aren't affected.
+ *
+ * @param wth The wiretap session.
+ * @return TRUE if the file's reader can skip the data, FALSE if it will
+ * keep reading it (which is harmless, just slower).
+ */
+WS_DLL_PUBLIC
+gboolean wtap_set_metadata_only(wtap *wth);
+
 /*** get various information snippets about the current packet ***/
 WS_DLL_PUBLIC
 struct wtap_pkthdr *wtap_phdr(wtap *wth);
@@ -1236,6 +1317,10 @@ void wtap_fdclose(wtap *wth);
 WS_DLL_PUBLIC
 gboolean wtap_fdreopen(wtap *wth, const char *filename, int *err);
 
+/*** reopen the sequential file descriptor for the current file ***/
+WS_DLL_PUBLIC
+gboolean wtap_sequential_fdreopen(wtap *wth, const char *filename, int *err);
+
 /*** close the current file ***/
 WS_DLL_PUBLIC
 void wtap_sequential_close(wtap *wth);
@@ -1291,6 +1376,23 @@ wtap_dumper* wtap_dump_fdopen_ng(int fd, int filetype, int encap, int snaplen,
                 gboolean compressed, wtapng_section_t *shb_hdr, wtapng_iface_descriptions_t *idb_inf, int *err);
 
 
+/**
+ * Coalesce the small writes the file format makes for each record into
+ * large buffers, and, where threads are available, hand full buffers to
+ * a background thread so that writing overlaps with producing the next
+ * records.  Only uncompressed output is coalesced; for compressed output
+ * this is a no-op.
+ *
+ * Write errors may be reported by a later wtap_dump() than the one whose
+ * data failed to be written, and at the latest by wtap_dump_close().
+ *
+ * @param wdh The dumper.
+ * @param err On failure, a positive "errno" value or a WTAP_ERR_ value.
+ * @return TRUE on success, FALSE on failure.
+ */
+WS_DLL_PUBLIC
+gboolean wtap_dump_set_write_behind(wtap_dumper *wdh, int *err);
+
 WS_DLL_PUBLIC
 gboolean wtap_dump(wtap_dumper *, const struct wtap_pkthdr *, const guint8 *, int *err);
 WS_DLL_PUBLIC
@@ -1302,6 +1404,51 @@ void wtap_set_bytes_dumped(wtap_dumper *wdh, gint64 bytes_dumped);
 struct addrinfo;
 WS_DLL_PUBLIC
 gboolean wtap_dump_set_addrinfo_list(wtap_dumper *wdh, struct addrinfo *addrinfo_list);
+/**
+ * Write a packet index sidecar file (see wsutil/pktindex.h) alongside the
+ * capture file, with an entry every "stride" records.  The index is
+ * finished when the dumper is closed.  Must be called before the first
+ * record is dumped.  Only pcap and pcap-ng output can be indexed.
+ *
+ * @param wdh The dumper.
+ * @param index_filename The index file to create.
+ * @param stride Records between two entries, 0 for the default.
+ * @param err On failure, a positive "errno" value or a WTAP_ERR_ value.
+ * @return TRUE on success, FALSE on failure.
+ */
+WS_DLL_PUBLIC
+gboolean wtap_dump_set_packet_index(wtap_dumper *wdh, const char *index_filename,
+    guint32 stride, int *err);
+
+/**
+ * Return TRUE if records read from wth can be written to wdh by copying
+ * their bytes with wtap_dump_copy_record(), rather than by wtap_dump().
+ * That's the case if both files are uncompressed files of the same type
+ * whose records don't need any conversion, currently only pcap files in
+ * our byte order with the same link-layer type.
+ */
+WS_DLL_PUBLIC
+gboolean wtap_dump_can_copy_records(wtap_dumper *wdh, wtap *wth);
+
+/**
+ * Write the record most recently read from wth, by copying it from the
+ * input file as-is.  Only valid if wtap_dump_can_copy_records() returned
+ * TRUE for the pair.  Records are written as by wtap_dump() until a long
+ * enough run of records that follow each other in the input file has been
+ * seen; the rest of that run is written as one copy when a different
+ * record is dumped, the output is flushed, or the dumper is closed, and
+ * the input file may be closed before that.  Interleaved or sparse
+ * records, as in a chronological merge, thus stay on the buffered path.
+ *
+ * @param wdh The dumper.
+ * @param wth The file the record was read from.
+ * @param data_offset The offset of the record, as returned by wtap_read().
+ * @param err On failure, a positive "errno" value or a WTAP_ERR_ value.
+ * @return TRUE on success, FALSE on failure.
+ */
+WS_DLL_PUBLIC
+gboolean wtap_dump_copy_record(wtap_dumper *wdh, wtap *wth, gint64 data_offset,
+    int *err);
 WS_DLL_PUBLIC
 gboolean wtap_dump_close(wtap_dumper *, int *);
 
@@ -1356,6 +1503,20 @@ int wtap_get_num_file_types(void);
 /*** dynamically register new file types and encapsulations ***/
 WS_DLL_PUBLIC
 void wtap_register_open_routine(wtap_open_routine_t, gboolean has_magic);
+/**
+ * Register the signature of a file type opened by an open routine
+ * registered with wtap_register_open_routine(), so that files starting
+ * with it are given to that routine before any heuristics are run.
+ *
+ * @param offset Offset of the magic bytes in the file.
+ * @param len Number of magic bytes; offset + len must be at most 32.
+ * @param magic The magic bytes; they're copied.
+ * @param open_routine The open routine for the file type.
+ * @return TRUE if the signature was registered, FALSE if it's out of range.
+ */
+WS_DLL_PUBLIC
+gboolean wtap_register_open_magic(guint offset, guint len, const char *magic,
+    wtap_open_routine_t open_routine);
 WS_DLL_PUBLIC
 int wtap_register_file_type(const struct file_type_info* fi);
 WS_DLL_PUBLIC
@@ -0,0 +1,524 @@
+/* colfile.c
+ * Routines for writing columnar field export files
+ *
+ * $Id$
+ *
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 1998 Gerald Combs
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+
+#include <glib.h>
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+#include "colfile.h"
+
+/*
+ * On-disk layout.
+ *
+ * File header:
+ *    0  magic "WSCF"
+ *    4  version (16 bits)
+ *    6  reserved (16 bits)
+ *    8  maximum number of rows in a chunk (32 bits)
+ *   12  column count (32 bits)
+ *   16  for each column:
+ *         type, a colfile_type_e (8 bits)
+ *         reserved (8 bits)
+ *         name length (16 bits)
+ *         name, UTF-8, not NUL-terminated
+ *
+ * Chunks follow, up to the end of the file.  Chunk header (12 bytes):
+ *    0  magic "WSCC"
+ *    4  row count (32 bits)
+ *    8  column count (32 bits)
+ *
+ * followed by a block for each column, in order:
+ *    0  length of the rest of the block (32 bits), so it can be skipped
+ *    4  value count (32 bits)
+ *    8  flags (8 bits); bit 0 set if the minimum and maximum are present
+ *    9  reserved (24 bits)
+ *   12  for each row, the number of values in its cell (16 bits)
+ *       the minimum and maximum values of the chunk, if present
+ *       for string columns, the dictionary: its entry count (32 bits),
+ *         then for each entry its length (32 bits) and bytes
+ *       the values, in row order
+ *
+ * Values are 4 bytes for COLFILE_UINT32 and COLFILE_INT32, 8 bytes for
+ * COLFILE_UINT64, COLFILE_INT64, COLFILE_DOUBLE and COLFILE_TIME, 4 or 16
+ * bytes for addresses, and for strings the 32-bit index of the string in
+ * the chunk's dictionary.  Strings have no minimum and maximum.
+ */
+static const guint8 colfile_magic[4] = { 'W', 'S', 'C', 'F' };
+static const guint8 colfile_chunk_magic[4] = { 'W', 'S', 'C', 'C' };
+
+#define COLFILE_VERSION         1
+#define COLFILE_CHUNK_HDR_LEN   12
+#define COLFILE_BLOCK_HDR_LEN   12
+#define COLFILE_FLAG_MINMAX     0x01
+#define COLFILE_MAX_CELL_VALUES G_MAXUINT16
+
+typedef union {
+    guint64 u;
+    gint64  i;
+    gdouble d;
+    guint8  addr[16];
+} colfile_value_t;
+
+typedef struct {
+    gchar          *name;
+    colfile_type_e  type;
+    guint           width;          /* bytes per value */
+    GByteArray     *values;
+    GByteArray     *counts;         /* 16 bits per row */
+    guint           cell_count;     /* values in the cell of the current row */
+    guint32         value_count;
+    colfile_value_t min;
+    colfile_value_t max;
+    GHashTable     *dict;           /* string -> index + 1 */
+    GPtrArray      *dict_strings;
+    guint32         dict_bytes;
+} colfile_column_t;
+
+struct colfile_writer {
+    FILE       *fh;
+    guint       chunk_rows;
+    guint       rows;
+    gboolean    header_written;
+    GPtrArray  *columns;            /* colfile_column_t * */
+};
+
+static void
+put_le16(guint8 *p, guint16 v)
+{
+    p[0] = (guint8)(v >> 0);
+    p[1] = (guint8)(v >> 8);
+}
+
+static void
+put_le32(guint8 *p, guint32 v)
+{
+    p[0] = (guint8)(v >> 0);
+    p[1] = (guint8)(v >> 8);
+    p[2] = (guint8)(v >> 16);
+    p[3] = (guint8)(v >> 24);
+}
+
+static void
+put_le64(guint8 *p, guint64 v)
+{
+    put_le32(p, (guint32)v);
+    put_le32(p + 4, (guint32)(v >> 32));
+}
+
+static guint
+colfile_type_width(colfile_type_e type)
+{
+    switch (type) {
+    case COLFILE_UINT64:
+    case COLFILE_INT64:
+    case COLFILE_DOUBLE:
+    case COLFILE_TIME:
+        return 8;
+    case COLFILE_IPV6:
+        return 16;
+    default:
+        return 4;
+    }
+}
+
+colfile_writer_t *
+colfile_writer_new(FILE *fh, guint chunk_rows)
+{
+    colfile_writer_t *writer = g_new0(colfile_writer_t, 1);
+
+    writer->fh = fh;
+    writer->chunk_rows = chunk_rows ? chunk_rows : COLFILE_DEFAULT_CHUNK_ROWS;
+    writer->columns = g_ptr_array_new();
+    return writer;
+}
+
+guint
+colfile_add_column(colfile_writer_t *writer, const char *name,
+                   colfile_type_e type)
+{
+    colfile_column_t *column;
+
+    g_assert(!writer->header_written && writer->rows == 0);
+
+    column = g_new0(colfile_column_t, 1);
+    column->name = g_strdup(name);
+    column->type = type;
+    column->width = colfile_type_width(type);
+    column->values = g_byte_array_new();
+    column->counts = g_byte_array_new();
+    if (type == COLFILE_STRING) {
+        column->dict = g_hash_table_new(g_str_hash, g_str_equal);
+        column->dict_strings = g_ptr_array_new();
+    }
+    g_ptr_array_add(writer->columns, column);
+    return writer->columns->len - 1;
+}
+
+colfile_type_e
+colfile_column_type(colfile_writer_t *writer, guint column)
+{
+    return ((colfile_column_t *)g_ptr_array_index(writer->columns, column))->type;
+}
+
+/* Get a column of one of the types given, with room in the current cell;
+ * NULL if there's no room, or the type doesn't match. */
+static colfile_column_t *
+colfile_cell(colfile_writer_t *writer, guint column, colfile_type_e type1,
+             colfile_type_e type2, colfile_type_e type3)
+{
+    colfile_column_t *col;
+
+    g_assert(column < writer->columns->len);
+    col = (colfile_column_t *)g_ptr_array_index(writer->columns, column);
+    if (col->type != type1 && col->type != type2 && col->type != type3)
+        return NULL;
+    if (col->cell_count == COLFILE_MAX_CELL_VALUES)
+        return NULL;
+    col->cell_count++;
+    return col;
+}
+
+void
+colfile_add_uint(colfile_writer_t *writer, guint column, guint64 value)
+{
+    colfile_column_t *col;
+    guint8 buf[8];
+
+    col = colfile_cell(writer, column, COLFILE_UINT32, COLFILE_UINT64, COLFILE_UINT64);
+    if (col == NULL)
+        return;
+
+    if (col->value_count == 0 || value < col->min.u)
+        col->min.u = value;
+    if (col->value_count == 0 || value > col->max.u)
+        col->max.u = value;
+    col->value_count++;
+
+    put_le64(buf, value);
+    g_byte_array_append(col->values, buf, col->width);
+}
+
+void
+colfile_add_int(colfile_writer_t *writer, guint column, gint64 value)
+{
+    colfile_column_t *col;
+    guint8 buf[8];
+
+    col = colfile_cell(writer, column, COLFILE_INT32, COLFILE_INT64, COLFILE_TIME);
+    if (col == NULL)
+        return;
+
+    if (col->value_count == 0 || value < col->min.i)
+        col->min.i = value;
+    if (col->value_count == 0 || value > col->max.i)
+        col->max.i = value;
+    col->value_count++;
+
+    /* The low 4 bytes of a little-endian 64-bit value are the 32-bit value */
+    put_le64(buf, (guint64)value);
+    g_byte_array_append(col->values, buf, col->width);
+}
+
+void
+colfile_add_double(colfile_writer_t *writer, guint column, gdouble value)
+{
+    colfile_column_t *col;
+    guint8 buf[8];
+    guint64 bits;
+
+    col = colfile_cell(writer, column, COLFILE_DOUBLE, COLFILE_DOUBLE, COLFILE_DOUBLE);
+    if (col == NULL)
+        return;
+
+    if (col->value_count == 0 || value < col->min.d)
+        col->min.d = value;
+    if (col->value_count == 0 || value > col->max.d)
+        col->max.d = value;
+    col->value_count++;
+
+    memcpy(&bits, &value, sizeof bits);
+    put_le64(buf, bits);
+    g_byte_array_append(col->values, buf, 8);
+}
+
+void
+colfile_add_addr(colfile_writer_t *writer, guint column, const guint8 *addr)
+{
+    colfile_column_t *col;
+
+    col = colfile_cell(writer, column, COLFILE_IPV4, COLFILE_IPV6, COLFILE_IPV6);
+    if (col == NULL)
+        return;
+
+    /* Addresses are in network byte order, so they sort as bytes */
+    if (col->value_count == 0 || memcmp(addr, col->min.addr, col->width) < 0)
+        memcpy(col->min.addr, addr, col->width);
+    if (col->value_count == 0 || memcmp(addr, col->max.addr, col->width) > 0)
+        memcpy(col->max.addr, addr, col->width);
+    col->value_count++;
+
+    g_byte_array_append(col->values, addr, col->width);
+}
+
+void
+colfile_add_string(colfile_writer_t *writer, guint column, const char *value)
+{
+    colfile_column_t *col;
+    guint entry;
+    gchar *copy;
+    guint8 buf[4];
+
+    col = colfile_cell(writer, column, COLFILE_STRING, COLFILE_STRING, COLFILE_STRING);
+    if (col == NULL)
+        return;
+
+    entry = GPOINTER_TO_UINT(g_hash_table_lookup(col->dict, value));
+    if (entry == 0) {
+        copy = g_strdup(value);
+        g_ptr_array_add(col->dict_strings, copy);
+        g_hash_table_insert(col->dict, copy, GUINT_TO_POINTER(col->dict_strings->len));
+        col->dict_bytes += 4 + (guint32)strlen(copy);
+        entry = col->dict_strings->len;
+    }
+    col->value_count++;
+
+    put_le32(buf, entry - 1);
+    g_byte_array_append(col->values, buf, 4);
+}
+
+static gboolean
+colfile_write(colfile_writer_t *writer, const void *data, gsize len, int *err)
+{
+    if (len != 0 && fwrite(data, 1, len, writer->fh) != len) {
+        *err = errno;
+        return FALSE;
+    }
+    return TRUE;
+}
+
+static gboolean
+colfile_write_header(colfile_writer_t *writer, int *err)
+{
+    guint8 hdr[16];
+    guint8 entry[4];
+    colfile_column_t *col;
+    gsize name_len;
+    guint i;
+
+    memcpy(hdr, colfile_magic, sizeof colfile_magic);
+    put_le16(hdr + 4, COLFILE_VERSION);
+    put_le16(hdr + 6, 0);
+    put_le32(hdr + 8, writer->chunk_rows);
+    put_le32(hdr + 12, writer->columns->len);
+    if (!colfile_write(writer, hdr, sizeof hdr, err))
+        return FALSE;
+
+    for (i = 0; i < writer->columns->len; i++) {
+        col = (colfile_column_t *)g_ptr_array_index(writer->columns, i);
+        name_len = MIN(strlen(col->name), G_MAXUINT16);
+        entry[0] = (guint8)col->type;
+        entry[1] = 0;
+        put_le16(entry + 2, (guint16)name_len);
+        if (!colfile_write(writer, entry, sizeof entry, err) ||
+            !colfile_write(writer, col->name, name_len, err))
+            return FALSE;
+    }
+    writer->header_written = TRUE;
+    return TRUE;
+}
+
+static void
+colfile_put_value(colfile_column_t *col, const colfile_value_t *value, guint8 *p)
+{
+    switch (col->type) {
+    case COLFILE_IPV4:
+    case COLFILE_IPV6:
+        memcpy(p, value->addr, col->width);
+        break;
+    default:
+        /* The same bits for unsigned, signed and floating point values */
+        if (col->width == 4)
+            put_le32(p, (guint32)value->u);
+        else
+            put_le64(p, value->u);
+        break;
+    }
+}
+
+static void
+colfile_column_reset(colfile_column_t *col)
+{
+    guint i;
+
+    g_byte_array_set_size(col->values, 0);
+    g_byte_array_set_size(col->counts, 0);
+    col->cell_count = 0;
+    col->value_count = 0;
+    if (col->type == COLFILE_STRING) {
+        g_hash_table_remove_all(col->dict);
+        for (i = 0; i < col->dict_strings->len; i++)
+            g_free(g_ptr_array_index(col->dict_strings, i));
+        g_ptr_array_set_size(col->dict_strings, 0);
+        col->dict_bytes = 0;
+    }
+}
+
+static gboolean
+colfile_write_chunk(colfile_writer_t *writer, int *err)
+{
+    guint8 hdr[COLFILE_CHUNK_HDR_LEN];
+    guint8 block_hdr[COLFILE_BLOCK_HDR_LEN];
+    guint8 minmax[32];
+    guint8 buf[4];
+    colfile_column_t *col;
+    gboolean has_minmax;
+    guint32 block_len;
+    const gchar *str;
+    guint i, j;
+
+    if (!writer->header_written && !colfile_write_header(writer, err))
+        return FALSE;
+    if (writer->rows == 0)
+        return TRUE;
+
+    memcpy(hdr, colfile_chunk_magic, sizeof colfile_chunk_magic);
+    put_le32(hdr + 4, writer->rows);
+    put_le32(hdr + 8, writer->columns->len);
+    if (!colfile_write(writer, hdr, sizeof hdr, err))
+        return FALSE;
+
+    for (i = 0; i < writer->columns->len; i++) {
+        col = (colfile_column_t *)g_ptr_array_index(writer->columns, i);
+        has_minmax = (col->type != COLFILE_STRING && col->value_count != 0);
+
+        block_len = COLFILE_BLOCK_HDR_LEN - 4 + col->counts->len + col->values->len;
+        if (has_minmax)
+            block_len += 2 * col->width;
+        if (col->type == COLFILE_STRING)
+            block_len += 4 + col->dict_bytes;
+
+        put_le32(block_hdr, block_len);
+        put_le32(block_hdr + 4, col->value_count);
+        block_hdr[8] = has_minmax ? COLFILE_FLAG_MINMAX : 0;
+        block_hdr[9] = block_hdr[10] = block_hdr[11] = 0;
+        if (!colfile_write(writer, block_hdr, sizeof block_hdr, err) ||
+            !colfile_write(writer, col->counts->data, col->counts->len, err))
+            return FALSE;
+
+        if (has_minmax) {
+            colfile_put_value(col, &col->min, minmax);
+            colfile_put_value(col, &col->max, minmax + col->width);
+            if (!colfile_write(writer, minmax, 2 * col->width, err))
+                return FALSE;
+        }
+
+        if (col->type == COLFILE_STRING) {
+            put_le32(buf, col->dict_strings->len);
+            if (!colfile_write(writer, buf, 4, err))
+                return FALSE;
+            for (j = 0; j < col->dict_strings->len; j++) {
+                str = (const gchar *)g_ptr_array_index(col->dict_strings, j);
+                put_le32(buf, (guint32)strlen(str));
+                if (!colfile_write(writer, buf, 4, err) ||
+                    !colfile_write(writer, str, strlen(str), err))
+                    return FALSE;
+            }
+        }
+
+        if (!colfile_write(writer, col->values->data, col->values->len, err))
+            return FALSE;
+
+        colfile_column_reset(col);
+    }
+
+    writer->rows = 0;
+    return TRUE;
+}
+
+gboolean
+colfile_end_row(colfile_writer_t *writer, int *err)
+{
+    colfile_column_t *col;
+    guint8 buf[2];
+    guint i;
+
+    for (i = 0; i < writer->columns->len; i++) {
+        col = (colfile_column_t *)g_ptr_array_index(writer->columns, i);
+        put_le16(buf, (guint16)col->cell_count);
+        g_byte_array_append(col->counts, buf, 2);
+        col->cell_count = 0;
+    }
+
+    writer->rows++;
+    if (writer->rows < writer->chunk_rows)
+        return TRUE;
+    return colfile_write_chunk(writer, err);
+}
+
+gboolean
+colfile_writer_close(colfile_writer_t *writer, int *err)
+{
+    colfile_column_t *col;
+    gboolean ret;
+    guint i;
+
+    ret = colfile_write_chunk(writer, err);
+    if (ret && fflush(writer->fh) == EOF) {
+        *err = errno;
+        ret = FALSE;
+    }
+
+    for (i = 0; i < writer->columns->len; i++) {
+        col = (colfile_column_t *)g_ptr_array_index(writer->columns, i);
+        colfile_column_reset(col);
+        g_byte_array_free(col->values, TRUE);
+        g_byte_array_free(col->counts, TRUE);
+        if (col->type == COLFILE_STRING) {
+            g_hash_table_destroy(col->dict);
+            g_ptr_array_free(col->dict_strings, TRUE);
+        }
+        g_free(col->name);
+        g_free(col);
+    }
+    g_ptr_array_free(writer->columns, TRUE);
+    g_free(writer);
+    return ret;
+}
+
+/*
+ * Editor modelines  -  http://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 4
+ * tab-width: 8
+ * indent-tabs-mode: nil
+ * End:
+ *
+ * vi: set shiftwidth=4 tabstop=8 expandtab:
+ * :indentSize=4:tabSize=8:noTabs=true:
+ */
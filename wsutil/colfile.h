@@ -0,0 +1,128 @@
+/* colfile.h
+ * Definitions for writing columnar field export files
+ *
+ * $Id$
+ *
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 1998 Gerald Combs
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef __COLFILE_H__
+#define __COLFILE_H__
+
+#include <stdio.h>
+
+#include <glib.h>
+
+#include "ws_symbol_export.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/** @file
+ * A columnar file holds a table, one row per packet, with a typed column
+ * for each field exported.  It's self-describing: a header gives the name
+ * and type of each column.  The rows follow in chunks; within a chunk,
+ * the values of each column are stored together, as fixed-size binary
+ * values, with the minimum and maximum values of the chunk, so that a
+ * reader can skip chunks and columns it has no use for.  Strings are
+ * dictionary-encoded in each chunk.
+ *
+ * A cell can hold any number of values, for fields that occur more than
+ * once in a packet, or none.
+ *
+ * All values are little-endian except addresses, which are in network
+ * byte order; the layout is described in colfile.c.
+ */
+
+/** Types of columns; the values are those written to the file. */
+typedef enum {
+    COLFILE_STRING = 0,     /**< UTF-8 string */
+    COLFILE_UINT32 = 1,     /**< Unsigned 32-bit integer */
+    COLFILE_INT32  = 2,     /**< Signed 32-bit integer */
+    COLFILE_UINT64 = 3,     /**< Unsigned 64-bit integer */
+    COLFILE_INT64  = 4,     /**< Signed 64-bit integer */
+    COLFILE_DOUBLE = 5,     /**< IEEE 754 double */
+    COLFILE_IPV4   = 6,     /**< 4-byte IPv4 address */
+    COLFILE_IPV6   = 7,     /**< 16-byte IPv6 address */
+    COLFILE_TIME   = 8      /**< Nanoseconds, signed 64 bits (since the epoch, for absolute times) */
+} colfile_type_e;
+
+/** Default number of rows in a chunk. */
+#define COLFILE_DEFAULT_CHUNK_ROWS  65536
+
+typedef struct colfile_writer colfile_writer_t;
+
+/**
+ * Create a writer.  Add the columns with colfile_add_column() before
+ * adding the first row.
+ *
+ * @param fh Where to write the file; the writer doesn't close it.
+ * @param chunk_rows The number of rows in a chunk.
+ * @return The writer; free it with colfile_writer_close().
+ */
+WS_DLL_PUBLIC colfile_writer_t *colfile_writer_new(FILE *fh, guint chunk_rows);
+
+/**
+ * Add a column.
+ *
+ * @return The index of the column.
+ */
+WS_DLL_PUBLIC guint colfile_add_column(colfile_writer_t *writer, const char *name,
+    colfile_type_e type);
+
+/** Return the type of a column. */
+WS_DLL_PUBLIC colfile_type_e colfile_column_type(colfile_writer_t *writer, guint column);
+
+/*
+ * Add a value to a cell of the current row.  Each function is for the
+ * column types given; the value is ignored for a column of another type.
+ */
+/** For COLFILE_UINT32 and COLFILE_UINT64 columns. */
+WS_DLL_PUBLIC void colfile_add_uint(colfile_writer_t *writer, guint column, guint64 value);
+/** For COLFILE_INT32, COLFILE_INT64 and COLFILE_TIME columns. */
+WS_DLL_PUBLIC void colfile_add_int(colfile_writer_t *writer, guint column, gint64 value);
+/** For COLFILE_DOUBLE columns. */
+WS_DLL_PUBLIC void colfile_add_double(colfile_writer_t *writer, guint column, gdouble value);
+/** For COLFILE_IPV4 (4 bytes) and COLFILE_IPV6 (16 bytes) columns. */
+WS_DLL_PUBLIC void colfile_add_addr(colfile_writer_t *writer, guint column, const guint8 *addr);
+/** For COLFILE_STRING columns. */
+WS_DLL_PUBLIC void colfile_add_string(colfile_writer_t *writer, guint column, const char *value);
+
+/**
+ * End the current row; when a chunk is full, it's written out.
+ *
+ * @param err Receives an errno value on failure.
+ * @return TRUE on success, FALSE if writing failed.
+ */
+WS_DLL_PUBLIC gboolean colfile_end_row(colfile_writer_t *writer, int *err);
+
+/**
+ * Write out the rows not yet written, and free the writer.
+ *
+ * @param err Receives an errno value on failure.
+ * @return TRUE on success, FALSE if writing failed.
+ */
+WS_DLL_PUBLIC gboolean colfile_writer_close(colfile_writer_t *writer, int *err);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* __COLFILE_H__ */
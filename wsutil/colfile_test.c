@@ -0,0 +1,523 @@
+/* Standalone program to test writing columnar files, by reading them back.
+ *
+ * $Id$
+ *
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 1998 Gerald Combs
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+#include <glib.h>
+
+#include "colfile.h"
+#include <wsutil/file_util.h>
+
+#define TEST_ROWS           10
+#define TEST_CHUNK_ROWS     4
+
+static gboolean failed = FALSE;
+
+#define CHECK(test, cond, what) \
+    do { \
+        if (!(cond)) { \
+            printf("%s: %s\n", test, what); \
+            failed = TRUE; \
+        } \
+    } while (0)
+
+static const struct {
+    const char     *name;
+    colfile_type_e  type;
+} test_columns[] = {
+    { "frame.number",           COLFILE_UINT32 },
+    { "ip.src",                 COLFILE_IPV4 },
+    { "tcp.analysis.flags",     COLFILE_STRING },
+    { "frame.time_delta",       COLFILE_TIME },
+    { "ip.ttl.delta",           COLFILE_INT32 },
+    { "frame.time_relative",    COLFILE_DOUBLE },
+    { "ipv6.src",               COLFILE_IPV6 },
+    { "tcp.seq",                COLFILE_UINT64 }
+};
+
+/*
+ * The table written, as read back: for each chunk, the values of each
+ * column, with the chunk's minimum and maximum or its dictionary, then
+ * the cells of the column separated by '/', "-" for an empty one.
+ * Note that the dictionary starts afresh in each chunk, that a column
+ * with no values in a chunk has no minimum and maximum, and that the
+ * large tcp.seq values are larger, not negative.
+ */
+static const char test_table[] =
+    "columns 8, chunk rows 4\n"
+    "column frame.number type 1\n"
+    "column ip.src type 6\n"
+    "column tcp.analysis.flags type 0\n"
+    "column frame.time_delta type 8\n"
+    "column ip.ttl.delta type 2\n"
+    "column frame.time_relative type 5\n"
+    "column ipv6.src type 7\n"
+    "column tcp.seq type 3\n"
+    "chunk of 4 rows\n"
+    "frame.number: 4 values, min 1, max 4: 1 / 2 / 3 / 4\n"
+    "ip.src: 4 values, min 10.0.0.0, max 10.0.2.154: 10.0.0.0 / 10.0.1.77 / 10.0.2.154 / 10.0.0.231\n"
+    "tcp.analysis.flags: 3 values, dictionary ack,dup ack: - / ack / dup ack,ack / -\n"
+    "frame.time_delta: 4 values, min -1000000000, max -250000000: -1000000000 / -750000000 / -500000000 / -250000000\n"
+    "ip.ttl.delta: 4 values, min 1, max 10: 10 / 9 / 6 / 1\n"
+    "frame.time_relative: 4 values, min -1, max -0.25: -1 / -0.75 / -0.5 / -0.25\n"
+    "ipv6.src: 0 values: - / - / - / -\n"
+    "tcp.seq: 4 values, min 1, max 9223372036854775814: 9223372036854775808 / 1 / 9223372036854775814 / 3\n"
+    "chunk of 4 rows\n"
+    "frame.number: 4 values, min 5, max 8: 5 / 6 / 7 / 8\n"
+    "ip.src: 4 values, min 10.0.0.206, max 10.0.2.129: 10.0.1.52 / 10.0.2.129 / 10.0.0.206 / 10.0.1.27\n"
+    "tcp.analysis.flags: 4 values, dictionary ack,dup ack: ack / dup ack,ack / - / ack\n"
+    "frame.time_delta: 4 values, min 0, max 750000000: 0 / 250000000 / 500000000 / 750000000\n"
+    "ip.ttl.delta: 4 values, min -39, max -6: -6 / -15 / -26 / -39\n"
+    "frame.time_relative: 4 values, min 0, max 0.75: 0 / 0.25 / 0.5 / 0.75\n"
+    "ipv6.src: 0 values: - / - / - / -\n"
+    "tcp.seq: 4 values, min 5, max 9223372036854775826: 9223372036854775820 / 5 / 9223372036854775826 / 7\n"
+    "chunk of 2 rows\n"
+    "frame.number: 2 values, min 9, max 10: 9 / 10\n"
+    "ip.src: 2 values, min 10.0.0.181, max 10.0.2.104: 10.0.2.104 / 10.0.0.181\n"
+    "tcp.analysis.flags: 2 values, dictionary dup ack,ack: dup ack,ack / -\n"
+    "frame.time_delta: 2 values, min 1000000000, max 1250000000: 1000000000 / 1250000000\n"
+    "ip.ttl.delta: 2 values, min -71, max -54: -54 / -71\n"
+    "frame.time_relative: 2 values, min 1, max 1.25: 1 / 1.25\n"
+    "ipv6.src: 1 values, min 20010db8000000000000000000000009, max 20010db8000000000000000000000009: - / 20010db8000000000000000000000009\n"
+    "tcp.seq: 2 values, min 9, max 9223372036854775832: 9223372036854775832 / 9\n"
+    ;
+
+/* Add row r of the test table */
+static void
+add_row(colfile_writer_t *writer, guint r)
+{
+    guint8 ipv4[4] = { 10, 0, 0, 0 };
+    guint8 ipv6[16] = { 0x20, 0x01, 0x0d, 0xb8 };
+
+    colfile_add_uint(writer, 0, r + 1);
+
+    ipv4[2] = r % 3;
+    ipv4[3] = (r * 77) % 256;
+    colfile_add_addr(writer, 1, ipv4);
+
+    /* Several values in a cell, or none, and the same strings over and
+       over */
+    if (r % 3 == 2)
+        colfile_add_string(writer, 2, "dup ack");
+    if (r % 3 != 0)
+        colfile_add_string(writer, 2, "ack");
+
+    colfile_add_int(writer, 3, ((gint64)r - 4) * 250000000);
+    colfile_add_int(writer, 4, 10 - (gint64)(r * r));
+    colfile_add_double(writer, 5, r * 0.25 - 1.0);
+
+    /* Only in the last row */
+    if (r == TEST_ROWS - 1) {
+        ipv6[15] = r;
+        colfile_add_addr(writer, 6, ipv6);
+    }
+
+    if (r % 2 == 0)
+        colfile_add_uint(writer, 7, (G_GUINT64_CONSTANT(1) << 63) + r * 3);
+    else
+        colfile_add_uint(writer, 7, r);
+
+    /* Ignored: the wrong type for the column */
+    colfile_add_string(writer, 0, "not a number");
+    colfile_add_uint(writer, 2, 42);
+}
+
+/*
+ * A reader for the layout described in colfile.c, which describes the
+ * file in the form of test_table.
+ */
+typedef struct {
+    const guint8 *p;
+    gsize         left;
+} cursor_t;
+
+/* Take the next len bytes; NULL if there aren't that many left */
+static const guint8 *
+take(cursor_t *c, gsize len)
+{
+    const guint8 *p = c->p;
+
+    if (len > c->left)
+        return NULL;
+    c->p += len;
+    c->left -= len;
+    return p;
+}
+
+static guint16
+get_le16(const guint8 *p)
+{
+    return (guint16)(p[0] | (p[1] << 8));
+}
+
+static guint32
+get_le32(const guint8 *p)
+{
+    return (guint32)p[0] | ((guint32)p[1] << 8) | ((guint32)p[2] << 16) |
+           ((guint32)p[3] << 24);
+}
+
+static guint64
+get_le64(const guint8 *p)
+{
+    return (guint64)get_le32(p) | ((guint64)get_le32(p + 4) << 32);
+}
+
+static guint
+value_width(colfile_type_e type)
+{
+    switch (type) {
+    case COLFILE_UINT64:
+    case COLFILE_INT64:
+    case COLFILE_DOUBLE:
+    case COLFILE_TIME:
+        return 8;
+    case COLFILE_IPV6:
+        return 16;
+    default:
+        return 4;
+    }
+}
+
+static void
+log_value(GString *log, colfile_type_e type, const guint8 *p,
+          const GPtrArray *dict)
+{
+    guint64 bits;
+    gdouble d;
+    guint   i;
+
+    switch (type) {
+    case COLFILE_STRING:
+        if (get_le32(p) < dict->len)
+            g_string_append(log, (const char *)g_ptr_array_index(dict, get_le32(p)));
+        else
+            g_string_append(log, "(bad index)");
+        break;
+    case COLFILE_UINT32:
+        g_string_append_printf(log, "%u", get_le32(p));
+        break;
+    case COLFILE_INT32:
+        g_string_append_printf(log, "%d", (gint32)get_le32(p));
+        break;
+    case COLFILE_UINT64:
+        g_string_append_printf(log, "%" G_GINT64_MODIFIER "u", get_le64(p));
+        break;
+    case COLFILE_INT64:
+    case COLFILE_TIME:
+        g_string_append_printf(log, "%" G_GINT64_MODIFIER "d", (gint64)get_le64(p));
+        break;
+    case COLFILE_DOUBLE:
+        bits = get_le64(p);
+        memcpy(&d, &bits, sizeof d);
+        g_string_append_printf(log, "%g", d);
+        break;
+    case COLFILE_IPV4:
+        g_string_append_printf(log, "%u.%u.%u.%u", p[0], p[1], p[2], p[3]);
+        break;
+    case COLFILE_IPV6:
+        for (i = 0; i < 16; i++)
+            g_string_append_printf(log, "%02x", p[i]);
+        break;
+    }
+}
+
+/* Describe a column's block of a chunk of rows rows; FALSE if it's bad */
+static gboolean
+read_block(GString *log, const char *name, colfile_type_e type, guint32 rows,
+           cursor_t *block)
+{
+    const guint8 *hdr, *counts, *minmax = NULL, *values, *p;
+    GPtrArray *dict;
+    guint32 value_count, dict_count, len, total, row, i, j;
+    guint   width = value_width(type);
+
+    hdr = take(block, 8);
+    counts = take(block, 2 * (gsize)rows);
+    if (hdr == NULL || counts == NULL)
+        return FALSE;
+    value_count = get_le32(hdr);
+    if (hdr[4] & 0x01) {
+        minmax = take(block, 2 * width);
+        if (minmax == NULL)
+            return FALSE;
+    }
+
+    dict = g_ptr_array_new_with_free_func(g_free);
+    if (type == COLFILE_STRING) {
+        if ((p = take(block, 4)) == NULL)
+            goto bad;
+        dict_count = get_le32(p);
+        for (i = 0; i < dict_count; i++) {
+            if ((p = take(block, 4)) == NULL)
+                goto bad;
+            len = get_le32(p);
+            if ((p = take(block, len)) == NULL)
+                goto bad;
+            g_ptr_array_add(dict, g_strndup((const gchar *)p, len));
+        }
+    }
+    values = take(block, (gsize)value_count * width);
+    if (values == NULL || block->left != 0)
+        goto bad;
+
+    g_string_append_printf(log, "%s: %u values", name, value_count);
+    if (type == COLFILE_STRING) {
+        g_string_append(log, ", dictionary ");
+        for (i = 0; i < dict->len; i++) {
+            if (i != 0)
+                g_string_append_c(log, ',');
+            g_string_append(log, (const char *)g_ptr_array_index(dict, i));
+        }
+    }
+    if (minmax != NULL) {
+        g_string_append(log, ", min ");
+        log_value(log, type, minmax, dict);
+        g_string_append(log, ", max ");
+        log_value(log, type, minmax + width, dict);
+    }
+    g_string_append(log, ": ");
+
+    total = 0;
+    for (row = 0; row < rows; row++) {
+        if (row != 0)
+            g_string_append(log, " / ");
+        if (get_le16(counts + 2 * row) == 0)
+            g_string_append_c(log, '-');
+        for (j = 0; j < get_le16(counts + 2 * row); j++, total++) {
+            if (total == value_count)
+                goto bad;
+            if (j != 0)
+                g_string_append_c(log, ',');
+            log_value(log, type, values + total * width, dict);
+        }
+    }
+    g_string_append_c(log, '\n');
+    g_ptr_array_free(dict, TRUE);
+    return total == value_count;
+
+bad:
+    g_ptr_array_free(dict, TRUE);
+    return FALSE;
+}
+
+/* Describe a file; FALSE if it's bad */
+static gboolean
+read_file(const char *test, const char *filename, GString *log)
+{
+    gchar    *contents;
+    gsize     length;
+    cursor_t  file, block;
+    const guint8 *p;
+    GPtrArray *names;
+    GArray   *types;
+    colfile_type_e type;
+    guint32   columns, rows, i;
+    gboolean  ok = FALSE;
+
+    if (!g_file_get_contents(filename, &contents, &length, NULL)) {
+        printf("%s: can't read %s\n", test, filename);
+        failed = TRUE;
+        return FALSE;
+    }
+    file.p = (const guint8 *)contents;
+    file.left = length;
+    names = g_ptr_array_new_with_free_func(g_free);
+    types = g_array_new(FALSE, FALSE, sizeof (colfile_type_e));
+
+    p = take(&file, 16);
+    if (p == NULL || memcmp(p, "WSCF", 4) != 0 || get_le16(p + 4) != 1)
+        goto done;
+    columns = get_le32(p + 12);
+    g_string_append_printf(log, "columns %u, chunk rows %u\n", columns,
+                           get_le32(p + 8));
+    for (i = 0; i < columns; i++) {
+        if ((p = take(&file, 4)) == NULL)
+            goto done;
+        type = (colfile_type_e)p[0];
+        g_array_append_val(types, type);
+        if ((p = take(&file, get_le16(p + 2))) == NULL)
+            goto done;
+        g_ptr_array_add(names, g_strndup((const gchar *)p, get_le16(p - 2)));
+        g_string_append_printf(log, "column %s type %u\n",
+                               (const char *)g_ptr_array_index(names, i), type);
+    }
+
+    while (file.left != 0) {
+        p = take(&file, 12);
+        if (p == NULL || memcmp(p, "WSCC", 4) != 0 || get_le32(p + 8) != columns)
+            goto done;
+        rows = get_le32(p + 4);
+        g_string_append_printf(log, "chunk of %u rows\n", rows);
+        for (i = 0; i < columns; i++) {
+            if ((p = take(&file, 4)) == NULL)
+                goto done;
+            block.left = get_le32(p);
+            if ((block.p = take(&file, block.left)) == NULL)
+                goto done;
+            if (!read_block(log, (const char *)g_ptr_array_index(names, i),
+                            g_array_index(types, colfile_type_e, i), rows, &block))
+                goto done;
+        }
+    }
+    ok = TRUE;
+
+done:
+    if (!ok) {
+        printf("%s: bad file, after:\n%s", test, log->str);
+        failed = TRUE;
+    }
+    g_ptr_array_free(names, TRUE);
+    g_array_free(types, TRUE);
+    g_free(contents);
+    return ok;
+}
+
+/* Write the first rows rows of the test table */
+static gboolean
+write_file(const char *test, const char *filename, guint chunk_rows, guint rows)
+{
+    colfile_writer_t *writer;
+    FILE *fh;
+    guint i;
+    int   err;
+
+    fh = ws_fopen(filename, "wb");
+    if (fh == NULL) {
+        printf("%s: can't create %s\n", test, filename);
+        failed = TRUE;
+        return FALSE;
+    }
+    writer = colfile_writer_new(fh, chunk_rows);
+    for (i = 0; i < G_N_ELEMENTS(test_columns); i++)
+        colfile_add_column(writer, test_columns[i].name, test_columns[i].type);
+    for (i = 0; i < rows; i++) {
+        add_row(writer, i);
+        if (!colfile_end_row(writer, &err)) {
+            printf("%s: can't write %s: %s\n", test, filename, g_strerror(err));
+            failed = TRUE;
+            colfile_writer_close(writer, &err);
+            fclose(fh);
+            return FALSE;
+        }
+    }
+    if (!colfile_writer_close(writer, &err)) {
+        printf("%s: can't write %s: %s\n", test, filename, g_strerror(err));
+        failed = TRUE;
+        fclose(fh);
+        return FALSE;
+    }
+    fclose(fh);
+    return TRUE;
+}
+
+static void
+run_tests(const char *filename)
+{
+    GString *log, *expected;
+    guint    i;
+
+    log = g_string_new("");
+    expected = g_string_new("");
+
+    /* 01: write the test table in chunks, and read it back */
+    if (write_file("01", filename, TEST_CHUNK_ROWS, TEST_ROWS) &&
+        read_file("01", filename, log) &&
+        strcmp(log->str, test_table) != 0) {
+        printf("01: got\n%s01: expected\n%s", log->str, test_table);
+        failed = TRUE;
+    }
+
+    /* 02: with no rows, there's only the header; with no chunk size
+       given, the default is used */
+    g_string_printf(expected, "columns %u, chunk rows %u\n",
+                    (guint)G_N_ELEMENTS(test_columns), COLFILE_DEFAULT_CHUNK_ROWS);
+    for (i = 0; i < G_N_ELEMENTS(test_columns); i++)
+        g_string_append_printf(expected, "column %s type %u\n",
+                               test_columns[i].name, test_columns[i].type);
+    g_string_truncate(log, 0);
+    if (write_file("02", filename, 0, 0) &&
+        read_file("02", filename, log) &&
+        strcmp(log->str, expected->str) != 0) {
+        printf("02: got\n%s02: expected\n%s", log->str, expected->str);
+        failed = TRUE;
+    }
+
+    /* 03: all the rows in one chunk, whose minimum and maximum are
+       those of the whole table */
+    g_string_truncate(log, 0);
+    if (write_file("03", filename, 0, TEST_ROWS) &&
+        read_file("03", filename, log)) {
+        CHECK("03", strstr(log->str, "chunk of 10 rows\n") != NULL &&
+              strstr(log->str, "chunk of 4 rows") == NULL, "wrong chunks");
+        CHECK("03", strstr(log->str, "\nip.ttl.delta: 10 values, min -71, max 10: ") != NULL,
+              "wrong minimum or maximum");
+        CHECK("03", strstr(log->str, "\ntcp.analysis.flags: 9 values, dictionary ack,dup ack: ") != NULL,
+              "wrong dictionary");
+    }
+
+    g_string_free(expected, TRUE);
+    g_string_free(log, TRUE);
+}
+
+int
+main(void)
+{
+    gchar  *filename;
+    GError *error = NULL;
+    int     fd;
+
+    fd = g_file_open_tmp("colfile_testXXXXXX", &filename, &error);
+    if (fd == -1) {
+        printf("Can't create a temporary file: %s\n", error->message);
+        g_error_free(error);
+        return 1;
+    }
+    ws_close(fd);
+
+    run_tests(filename);
+
+    ws_unlink(filename);
+    g_free(filename);
+    return failed ? 1 : 0;
+}
+
+/*
+ * Editor modelines  -  http://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 4
+ * tab-width: 8
+ * indent-tabs-mode: nil
+ * End:
+ *
+ * vi: set shiftwidth=4 tabstop=8 expandtab:
+ * :indentSize=4:tabSize=8:noTabs=true:
+ */
@@ -0,0 +1,522 @@
+/* flowindex.c
+ * Routines for writing flow index sidecar files
+ *
+ * $Id$
+ *
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 1998 Gerald Combs
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+
+#include <glib.h>
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+#include "flowindex.h"
+#include <wsutil/file_util.h>
+
+/*
+ * On-disk layout.
+ *
+ * Header (64 bytes):
+ *    0  magic "WSFI"
+ *    4  version (16 bits)
+ *    6  reserved (16 bits)
+ *    8  first timestamp, seconds (64 bits)
+ *   16  last timestamp, seconds (64 bits)
+ *   24  first timestamp, nanoseconds (32 bits)
+ *   28  last timestamp, nanoseconds (32 bits)
+ *   32  packet count (64 bits)
+ *   40  byte count, on the wire (64 bits)
+ *   48  Bloom filter size in bytes (32 bits)
+ *   52  Bloom filter hash count (32 bits)
+ *   56  flow count (32 bits)
+ *   60  packets not counted in any flow (32 bits)
+ *
+ * The Bloom filter follows the header.  Its keys are an address, as
+ * 'A' followed by the 4 or 16 address bytes, or a port, as 'P' followed
+ * by the port in network byte order.  For hash i (counting from 0), the
+ * bit set is (h1 + i * h2) modulo the number of bits, where h1 and h2 are
+ * the low and high 32 bits of the 64-bit FNV-1a hash of the key, with
+ * the low bit of h2 set.  Bit n is bit (n % 8) of byte (n / 8).
+ *
+ * Flow entries (56 bytes) follow the Bloom filter:
+ *    0  address family, 4 or 6 (8 bits)
+ *    1  IP protocol (8 bits)
+ *    2  reserved (16 bits)
+ *    4  source port (16 bits), 0 if none
+ *    6  destination port (16 bits), 0 if none
+ *    8  source address (16 bytes; IPv4 addresses use the first 4)
+ *   24  destination address (16 bytes)
+ *   40  packet count (64 bits)
+ *   48  byte count, on the wire (64 bits)
+ */
+static const guint8 flowindex_magic[4] = { 'W', 'S', 'F', 'I' };
+
+#define FLOWINDEX_VERSION       1
+#define FLOWINDEX_HDR_LEN       64
+#define FLOWINDEX_FLOW_LEN      56
+#define FLOWINDEX_BLOOM_SIZE    (64 * 1024)     /* bytes; good for ~50,000 keys */
+#define FLOWINDEX_BLOOM_HASHES  4
+#define FLOWINDEX_MAX_FLOWS     (1024 * 1024)   /* bound the memory used per file */
+
+/* LINKTYPE_ values we can find an IP header in */
+#define LINKTYPE_NULL           0
+#define LINKTYPE_ETHERNET       1
+#define LINKTYPE_RAW            101
+#define LINKTYPE_LOOP           108
+#define LINKTYPE_LINUX_SLL      113
+#define LINKTYPE_IPV4           228
+#define LINKTYPE_IPV6           229
+#define DLT_RAW_12              12      /* DLT_RAW on most platforms */
+#define DLT_RAW_14              14      /* DLT_RAW on OpenBSD */
+
+typedef struct {
+    guint8  family;
+    guint8  proto;
+    guint16 src_port;
+    guint16 dst_port;
+    guint8  src_addr[16];
+    guint8  dst_addr[16];
+} flow_key_t;
+
+typedef struct {
+    flow_key_t key;
+    guint64    packets;
+    guint64    bytes;
+} flow_t;
+
+struct flowindex_builder {
+    gint64      first_secs;
+    guint32     first_nsecs;
+    gint64      last_secs;
+    guint32     last_nsecs;
+    guint64     packets;
+    guint64     bytes;
+    guint32     untracked;
+    guint8     *bloom;
+    GHashTable *flows;          /* flow_t, keyed by its flow_key_t */
+};
+
+static void
+put_le16(guint8 *p, guint16 v)
+{
+    p[0] = (guint8)(v >> 0);
+    p[1] = (guint8)(v >> 8);
+}
+
+static void
+put_le32(guint8 *p, guint32 v)
+{
+    p[0] = (guint8)(v >> 0);
+    p[1] = (guint8)(v >> 8);
+    p[2] = (guint8)(v >> 16);
+    p[3] = (guint8)(v >> 24);
+}
+
+static void
+put_le64(guint8 *p, guint64 v)
+{
+    put_le32(p, (guint32)v);
+    put_le32(p + 4, (guint32)(v >> 32));
+}
+
+static guint64
+fnv1a_64(const guint8 *p, gsize len)
+{
+    guint64 h = G_GINT64_CONSTANT(0xcbf29ce484222325U);
+
+    while (len-- != 0) {
+        h ^= *p++;
+        h *= G_GINT64_CONSTANT(0x100000001b3U);
+    }
+    return h;
+}
+
+static guint
+flow_key_hash(gconstpointer key)
+{
+    return (guint)fnv1a_64((const guint8 *)key, sizeof(flow_key_t));
+}
+
+static gboolean
+flow_key_equal(gconstpointer a, gconstpointer b)
+{
+    return memcmp(a, b, sizeof(flow_key_t)) == 0;
+}
+
+static void
+bloom_add(guint8 *bloom, const guint8 *key, gsize len)
+{
+    guint64 h = fnv1a_64(key, len);
+    guint32 h1 = (guint32)h;
+    guint32 h2 = (guint32)(h >> 32) | 1;
+    guint32 nbits = FLOWINDEX_BLOOM_SIZE * 8;
+    guint32 bit;
+    int i;
+
+    for (i = 0; i < FLOWINDEX_BLOOM_HASHES; i++) {
+        bit = (guint32)((h1 + (guint64)i * h2) % nbits);
+        bloom[bit / 8] |= (guint8)(1 << (bit % 8));
+    }
+}
+
+static void
+bloom_add_addr(guint8 *bloom, const guint8 *addr, gsize len)
+{
+    guint8 key[1 + 16];
+
+    key[0] = 'A';
+    memcpy(key + 1, addr, len);
+    bloom_add(bloom, key, 1 + len);
+}
+
+static void
+bloom_add_port(guint8 *bloom, guint16 port)
+{
+    guint8 key[3];
+
+    key[0] = 'P';
+    key[1] = (guint8)(port >> 8);
+    key[2] = (guint8)port;
+    bloom_add(bloom, key, sizeof key);
+}
+
+/*
+ * Find the IP header in a packet; returns its offset and sets *ethertype
+ * to 0x0800 or 0x86DD, or returns -1 if there isn't one we understand.
+ */
+static int
+find_ip_header(int linktype, const guint8 *pd, guint32 caplen, guint16 *ethertype)
+{
+    guint32 off, family;
+    guint16 type;
+
+    switch (linktype) {
+
+    case LINKTYPE_ETHERNET:
+        if (caplen < 14)
+            return -1;
+        type = (pd[12] << 8) | pd[13];
+        off = 14;
+        /* Skip up to two VLAN tags */
+        while ((type == 0x8100 || type == 0x88A8 || type == 0x9100) &&
+               off < 14 + 2 * 4 && caplen >= off + 4) {
+            type = (pd[off + 2] << 8) | pd[off + 3];
+            off += 4;
+        }
+        break;
+
+    case LINKTYPE_LINUX_SLL:
+        if (caplen < 16)
+            return -1;
+        type = (pd[14] << 8) | pd[15];
+        off = 16;
+        break;
+
+    case LINKTYPE_NULL:
+    case LINKTYPE_LOOP:
+        /* The AF_ value, in host byte order for NULL; try both orders */
+        if (caplen < 4)
+            return -1;
+        family = pd[0] | (pd[1] << 8) | (pd[2] << 16) | ((guint32)pd[3] << 24);
+        if (family > 0xFFFF)
+            family = GUINT32_SWAP_LE_BE(family);
+        if (family == 2)
+            type = 0x0800;
+        else if (family == 10 || family == 24 || family == 28 || family == 30)
+            type = 0x86DD;
+        else
+            return -1;
+        off = 4;
+        break;
+
+    case LINKTYPE_RAW:
+    case DLT_RAW_12:
+    case DLT_RAW_14:
+    case LINKTYPE_IPV4:
+    case LINKTYPE_IPV6:
+        if (caplen < 1)
+            return -1;
+        type = ((pd[0] >> 4) == 6) ? 0x86DD : 0x0800;
+        off = 0;
+        break;
+
+    default:
+        return -1;
+    }
+
+    if (type != 0x0800 && type != 0x86DD)
+        return -1;
+    *ethertype = type;
+    return (int)off;
+}
+
+/*
+ * Fill in the addresses and protocol of a flow key from an IP header;
+ * returns the offset of the transport header, or -1 if there's no
+ * usable one (as for a non-first fragment).
+ */
+static int
+parse_ip(const guint8 *pd, guint32 caplen, guint32 off, guint16 ethertype,
+         flow_key_t *key)
+{
+    guint32 hlen;
+    guint8  next;
+
+    if (ethertype == 0x0800) {
+        if (caplen < off + 20 || (pd[off] >> 4) != 4)
+            return -2;
+        hlen = (pd[off] & 0x0F) * 4;
+        key->family = 4;
+        key->proto = pd[off + 9];
+        memcpy(key->src_addr, pd + off + 12, 4);
+        memcpy(key->dst_addr, pd + off + 16, 4);
+        if (hlen < 20 || (((pd[off + 6] & 0x1F) << 8) | pd[off + 7]) != 0)
+            return -1;  /* bad header, or not the first fragment */
+        return (int)(off + hlen);
+    }
+
+    if (caplen < off + 40 || (pd[off] >> 4) != 6)
+        return -2;
+    key->family = 6;
+    memcpy(key->src_addr, pd + off + 8, 16);
+    memcpy(key->dst_addr, pd + off + 24, 16);
+    next = pd[off + 6];
+    off += 40;
+    /* Skip extension headers */
+    for (;;) {
+        switch (next) {
+
+        case 0:     /* Hop-by-hop options */
+        case 43:    /* Routing */
+        case 60:    /* Destination options */
+            if (caplen < off + 8) {
+                key->proto = next;
+                return -1;
+            }
+            next = pd[off];
+            off += (pd[off + 1] + 1) * 8;
+            continue;
+
+        case 44:    /* Fragment */
+            if (caplen < off + 8) {
+                key->proto = next;
+                return -1;
+            }
+            key->proto = pd[off];
+            if ((((pd[off + 2] << 8) | pd[off + 3]) & 0xFFF8) != 0)
+                return -1;  /* not the first fragment */
+            next = pd[off];
+            off += 8;
+            continue;
+
+        default:
+            key->proto = next;
+            return (int)off;
+        }
+    }
+}
+
+gchar *
+flowindex_filename(const char *capture_filename)
+{
+    return g_strconcat(capture_filename, FLOWINDEX_FILE_SUFFIX, NULL);
+}
+
+flowindex_builder_t *
+flowindex_builder_new(void)
+{
+    flowindex_builder_t *builder;
+
+    builder = g_new0(flowindex_builder_t, 1);
+    builder->bloom = (guint8 *)g_malloc0(FLOWINDEX_BLOOM_SIZE);
+    builder->flows = g_hash_table_new_full(flow_key_hash, flow_key_equal,
+                                           NULL, g_free);
+    return builder;
+}
+
+void
+flowindex_builder_add(flowindex_builder_t *builder, int linktype, gint64 secs,
+                      guint32 nsecs, guint32 caplen, guint32 len,
+                      const guint8 *pd)
+{
+    flow_key_t key;
+    flow_t    *flow;
+    guint16    ethertype;
+    int        off;
+
+    if (builder->packets == 0 ||
+        secs < builder->first_secs ||
+        (secs == builder->first_secs && nsecs < builder->first_nsecs)) {
+        builder->first_secs = secs;
+        builder->first_nsecs = nsecs;
+    }
+    if (builder->packets == 0 ||
+        secs > builder->last_secs ||
+        (secs == builder->last_secs && nsecs > builder->last_nsecs)) {
+        builder->last_secs = secs;
+        builder->last_nsecs = nsecs;
+    }
+    builder->packets++;
+    builder->bytes += len;
+
+    off = find_ip_header(linktype, pd, caplen, &ethertype);
+    if (off < 0) {
+        builder->untracked++;
+        return;
+    }
+
+    memset(&key, 0, sizeof key);
+    off = parse_ip(pd, caplen, (guint32)off, ethertype, &key);
+    if (off == -2) {
+        builder->untracked++;
+        return;
+    }
+    bloom_add_addr(builder->bloom, key.src_addr, key.family == 4 ? 4 : 16);
+    bloom_add_addr(builder->bloom, key.dst_addr, key.family == 4 ? 4 : 16);
+
+    if (off >= 0 && (guint32)off + 4 <= caplen &&
+        (key.proto == 6 || key.proto == 17 || key.proto == 132)) {
+        key.src_port = (pd[off] << 8) | pd[off + 1];
+        key.dst_port = (pd[off + 2] << 8) | pd[off + 3];
+        bloom_add_port(builder->bloom, key.src_port);
+        bloom_add_port(builder->bloom, key.dst_port);
+    }
+
+    flow = (flow_t *)g_hash_table_lookup(builder->flows, &key);
+    if (flow == NULL) {
+        if (g_hash_table_size(builder->flows) >= FLOWINDEX_MAX_FLOWS) {
+            builder->untracked++;
+            return;
+        }
+        flow = g_new0(flow_t, 1);
+        flow->key = key;
+        g_hash_table_insert(builder->flows, &flow->key, flow);
+    }
+    flow->packets++;
+    flow->bytes += len;
+}
+
+gboolean
+flowindex_builder_write(flowindex_builder_t *builder, const char *filename,
+                        int *err)
+{
+    guint8 hdr[FLOWINDEX_HDR_LEN];
+    guint8 entry[FLOWINDEX_FLOW_LEN];
+    GHashTableIter iter;
+    gpointer value;
+    flow_t *flow;
+    FILE *fh;
+
+    fh = ws_fopen(filename, "wb");
+    if (fh == NULL) {
+        *err = errno;
+        return FALSE;
+    }
+
+    memset(hdr, 0, sizeof hdr);
+    memcpy(hdr, flowindex_magic, sizeof flowindex_magic);
+    put_le16(hdr + 4, FLOWINDEX_VERSION);
+    put_le64(hdr + 8, (guint64)builder->first_secs);
+    put_le64(hdr + 16, (guint64)builder->last_secs);
+    put_le32(hdr + 24, builder->first_nsecs);
+    put_le32(hdr + 28, builder->last_nsecs);
+    put_le64(hdr + 32, builder->packets);
+    put_le64(hdr + 40, builder->bytes);
+    put_le32(hdr + 48, FLOWINDEX_BLOOM_SIZE);
+    put_le32(hdr + 52, FLOWINDEX_BLOOM_HASHES);
+    put_le32(hdr + 56, g_hash_table_size(builder->flows));
+    put_le32(hdr + 60, builder->untracked);
+    if (fwrite(hdr, 1, sizeof hdr, fh) != sizeof hdr ||
+        fwrite(builder->bloom, 1, FLOWINDEX_BLOOM_SIZE, fh) != FLOWINDEX_BLOOM_SIZE)
+        goto write_error;
+
+    g_hash_table_iter_init(&iter, builder->flows);
+    while (g_hash_table_iter_next(&iter, NULL, &value)) {
+        flow = (flow_t *)value;
+        memset(entry, 0, sizeof entry);
+        entry[0] = flow->key.family;
+        entry[1] = flow->key.proto;
+        put_le16(entry + 4, flow->key.src_port);
+        put_le16(entry + 6, flow->key.dst_port);
+        memcpy(entry + 8, flow->key.src_addr, 16);
+        memcpy(entry + 24, flow->key.dst_addr, 16);
+        put_le64(entry + 40, flow->packets);
+        put_le64(entry + 48, flow->bytes);
+        if (fwrite(entry, 1, sizeof entry, fh) != sizeof entry)
+            goto write_error;
+    }
+
+    if (fclose(fh) == EOF) {
+        *err = errno;
+        ws_unlink(filename);
+        return FALSE;
+    }
+    return TRUE;
+
+write_error:
+    *err = errno;
+    fclose(fh);
+    ws_unlink(filename);
+    return FALSE;
+}
+
+void
+flowindex_builder_reset(flowindex_builder_t *builder)
+{
+    builder->first_secs = 0;
+    builder->first_nsecs = 0;
+    builder->last_secs = 0;
+    builder->last_nsecs = 0;
+    builder->packets = 0;
+    builder->bytes = 0;
+    builder->untracked = 0;
+    memset(builder->bloom, 0, FLOWINDEX_BLOOM_SIZE);
+    g_hash_table_remove_all(builder->flows);
+}
+
+void
+flowindex_builder_free(flowindex_builder_t *builder)
+{
+    if (builder == NULL)
+        return;
+    g_hash_table_destroy(builder->flows);
+    g_free(builder->bloom);
+    g_free(builder);
+}
+
+/*
+ * Editor modelines  -  http://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 4
+ * tab-width: 8
+ * indent-tabs-mode: nil
+ * End:
+ *
+ * vi: set shiftwidth=4 tabstop=8 expandtab:
+ * :indentSize=4:tabSize=8:noTabs=true:
+ */
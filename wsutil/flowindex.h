@@ -0,0 +1,108 @@
+/* flowindex.h
+ * Definitions for flow index sidecar files
+ *
+ * $Id$
+ *
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 1998 Gerald Combs
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef __FLOWINDEX_H__
+#define __FLOWINDEX_H__
+
+#include <glib.h>
+
+#include "ws_symbol_export.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/** @file
+ * A flow index is a small sidecar file written next to a capture file
+ * while it's being captured.  It summarizes the file, so that a search
+ * for a host, port or time window can skip files that can't match
+ * without reading them:
+ *
+ * - the time range of the packets in the file;
+ * - a Bloom filter of the IP addresses and TCP/UDP/SCTP ports seen;
+ * - packet and byte counts for each (unidirectional) 5-tuple.
+ *
+ * All values are little-endian; tools/flowquery.py reads these files,
+ * and the layout and hashing are described in flowindex.c.
+ */
+
+/** Suffix appended to the capture file name to get the index file name. */
+#define FLOWINDEX_FILE_SUFFIX   ".fidx"
+
+typedef struct flowindex_builder flowindex_builder_t;
+
+/**
+ * Return the name of the flow index file for a capture file.
+ *
+ * @param capture_filename The name of the capture file.
+ * @return A newly allocated string which must be freed with g_free().
+ */
+WS_DLL_PUBLIC gchar *flowindex_filename(const char *capture_filename);
+
+/**
+ * Create an empty index.
+ *
+ * @return The index builder; free it with flowindex_builder_free().
+ */
+WS_DLL_PUBLIC flowindex_builder_t *flowindex_builder_new(void);
+
+/**
+ * Account for one packet.  Packets that aren't IPv4 or IPv6, or whose
+ * link-layer type isn't understood, only count towards the time range
+ * and totals.
+ *
+ * @param builder The index builder.
+ * @param linktype The LINKTYPE_ value of the packet's link-layer header.
+ * @param secs Timestamp of the packet, seconds.
+ * @param nsecs Timestamp of the packet, nanoseconds.
+ * @param caplen Number of bytes of packet data captured.
+ * @param len Length of the packet on the wire.
+ * @param pd The packet data.
+ */
+WS_DLL_PUBLIC void flowindex_builder_add(flowindex_builder_t *builder,
+    int linktype, gint64 secs, guint32 nsecs, guint32 caplen, guint32 len,
+    const guint8 *pd);
+
+/**
+ * Write the index to a file.
+ *
+ * @param builder The index builder.
+ * @param filename The name of the index file.
+ * @param err Receives an errno value on failure.
+ * @return TRUE on success, FALSE on failure.
+ */
+WS_DLL_PUBLIC gboolean flowindex_builder_write(flowindex_builder_t *builder,
+    const char *filename, int *err);
+
+/** Empty the index, to start on the next capture file. */
+WS_DLL_PUBLIC void flowindex_builder_reset(flowindex_builder_t *builder);
+
+/** Free an index builder. */
+WS_DLL_PUBLIC void flowindex_builder_free(flowindex_builder_t *builder);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* __FLOWINDEX_H__ */
@@ -0,0 +1,309 @@
+/* Standalone program to test writing flow index files.
+ *
+ * $Id$
+ *
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 1998 Gerald Combs
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+#include <glib.h>
+
+#include "flowindex.h"
+#include <wsutil/file_util.h>
+
+/*
+ * The index is read back here as tools/flowquery.py reads it, following
+ * the layout described in flowindex.c.
+ */
+#define HDR_LEN         64
+#define FLOW_LEN        56
+
+#define LINKTYPE_ETHERNET   1
+#define LINKTYPE_RAW        101
+
+static gboolean failed = FALSE;
+
+#define CHECK(test, cond, what) \
+    do { \
+        if (!(cond)) { \
+            printf("%s: %s\n", test, what); \
+            failed = TRUE; \
+        } \
+    } while (0)
+
+static guint16
+get_le16(const guint8 *p)
+{
+    return (guint16)(p[0] | (p[1] << 8));
+}
+
+static guint32
+get_le32(const guint8 *p)
+{
+    return (guint32)p[0] | ((guint32)p[1] << 8) |
+           ((guint32)p[2] << 16) | ((guint32)p[3] << 24);
+}
+
+static guint64
+get_le64(const guint8 *p)
+{
+    return (guint64)get_le32(p) | ((guint64)get_le32(p + 4) << 32);
+}
+
+static gboolean
+bloom_test(const guint8 *bloom, guint32 size, guint32 hashes,
+           const guint8 *key, gsize len)
+{
+    guint64 h = G_GINT64_CONSTANT(0xcbf29ce484222325U);
+    guint32 h1, h2, bit, i;
+    gsize   n;
+
+    for (n = 0; n < len; n++) {
+        h ^= key[n];
+        h *= G_GINT64_CONSTANT(0x100000001b3U);
+    }
+    h1 = (guint32)h;
+    h2 = (guint32)(h >> 32) | 1;
+    for (i = 0; i < hashes; i++) {
+        bit = (guint32)((h1 + (guint64)i * h2) % (size * 8));
+        if (!(bloom[bit / 8] & (1 << (bit % 8))))
+            return FALSE;
+    }
+    return TRUE;
+}
+
+static gboolean
+bloom_has_addr(const guint8 *bloom, guint32 size, guint32 hashes,
+               const guint8 *addr)
+{
+    guint8 key[1 + 4];
+
+    key[0] = 'A';
+    memcpy(key + 1, addr, 4);
+    return bloom_test(bloom, size, hashes, key, sizeof key);
+}
+
+static gboolean
+bloom_has_port(const guint8 *bloom, guint32 size, guint32 hashes,
+               guint16 port)
+{
+    guint8 key[3];
+
+    key[0] = 'P';
+    key[1] = (guint8)(port >> 8);
+    key[2] = (guint8)port;
+    return bloom_test(bloom, size, hashes, key, sizeof key);
+}
+
+/* Make a raw IPv4 UDP packet */
+static guint32
+make_udp_packet(guint8 *pd, const guint8 *src, const guint8 *dst,
+                guint16 sport, guint16 dport)
+{
+    memset(pd, 0, 28);
+    pd[0] = 0x45;               /* version 4, 20-byte header */
+    pd[3] = 28;                 /* total length */
+    pd[8] = 64;                 /* TTL */
+    pd[9] = 17;                 /* UDP */
+    memcpy(pd + 12, src, 4);
+    memcpy(pd + 16, dst, 4);
+    pd[20] = (guint8)(sport >> 8);
+    pd[21] = (guint8)sport;
+    pd[22] = (guint8)(dport >> 8);
+    pd[23] = (guint8)dport;
+    pd[25] = 8;                 /* UDP length */
+    return 28;
+}
+
+/* Read an index file; returns its contents, or NULL */
+static guint8 *
+read_index(const char *test, const char *filename, gsize *len)
+{
+    gchar  *contents;
+    GError *error = NULL;
+
+    if (!g_file_get_contents(filename, &contents, len, &error)) {
+        printf("%s: can't read %s: %s\n", test, filename, error->message);
+        g_error_free(error);
+        failed = TRUE;
+        return NULL;
+    }
+    return (guint8 *)contents;
+}
+
+static void
+run_tests(const char *filename)
+{
+    static const guint8 host_a[4] = { 192, 0, 2, 1 };
+    static const guint8 host_b[4] = { 192, 0, 2, 2 };
+    static const guint8 host_c[4] = { 198, 51, 100, 7 };
+    static const guint8 arp[14 + 28] = {
+        0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0, 1, 2, 3, 4, 5, 0x08, 0x06
+    };
+    flowindex_builder_t *builder;
+    guint8   pd[64];
+    guint32  caplen;
+    guint8  *index, *bloom, *entry;
+    gsize    len;
+    guint32  bloom_size, hashes, nflows, i;
+    gboolean seen_ab = FALSE, seen_ba = FALSE;
+    int      err;
+    gchar   *name;
+
+    /* 01: the index file name */
+    name = flowindex_filename("ring_00001_20130101000000.pcap");
+    CHECK("01", strcmp(name, "ring_00001_20130101000000.pcap" FLOWINDEX_FILE_SUFFIX) == 0,
+          "wrong index file name");
+    g_free(name);
+
+    /* 02: build and write an index; two packets from A to B, one back,
+       and one that isn't IP, given out of time order */
+    builder = flowindex_builder_new();
+    caplen = make_udp_packet(pd, host_a, host_b, 5353, 53);
+    flowindex_builder_add(builder, LINKTYPE_RAW, 1000, 500, caplen, 100, pd);
+    flowindex_builder_add(builder, LINKTYPE_RAW, 1002, 0, caplen, 100, pd);
+    caplen = make_udp_packet(pd, host_b, host_a, 53, 5353);
+    flowindex_builder_add(builder, LINKTYPE_RAW, 999, 250, caplen, 200, pd);
+    flowindex_builder_add(builder, LINKTYPE_ETHERNET, 1001, 0, sizeof arp, 60, arp);
+
+    if (!flowindex_builder_write(builder, filename, &err)) {
+        printf("02: can't write %s: %s\n", filename, g_strerror(err));
+        failed = TRUE;
+        flowindex_builder_free(builder);
+        return;
+    }
+
+    /* 03: read it back */
+    index = read_index("03", filename, &len);
+    if (index == NULL) {
+        flowindex_builder_free(builder);
+        return;
+    }
+    CHECK("03", len >= HDR_LEN, "index shorter than its header");
+    if (len >= HDR_LEN) {
+        CHECK("03", memcmp(index, "WSFI", 4) == 0, "bad magic");
+        CHECK("03", get_le16(index + 4) == 1, "bad version");
+        CHECK("03", get_le64(index + 8) == 999 && get_le32(index + 24) == 250,
+              "wrong first timestamp");
+        CHECK("03", get_le64(index + 16) == 1002 && get_le32(index + 28) == 0,
+              "wrong last timestamp");
+        CHECK("03", get_le64(index + 32) == 4, "wrong packet count");
+        CHECK("03", get_le64(index + 40) == 460, "wrong byte count");
+        CHECK("03", get_le32(index + 60) == 1, "wrong untracked packet count");
+
+        bloom_size = get_le32(index + 48);
+        hashes = get_le32(index + 52);
+        nflows = get_le32(index + 56);
+        CHECK("03", nflows == 2, "wrong flow count");
+        CHECK("03", len == HDR_LEN + bloom_size + (gsize)nflows * FLOW_LEN,
+              "wrong index length");
+
+        if (len == HDR_LEN + bloom_size + (gsize)nflows * FLOW_LEN) {
+            /* 04: the Bloom filter has the hosts and ports seen; a
+               false positive on the others is possible, but all but
+               impossible with so few keys */
+            bloom = index + HDR_LEN;
+            CHECK("04", bloom_has_addr(bloom, bloom_size, hashes, host_a), "host A missing");
+            CHECK("04", bloom_has_addr(bloom, bloom_size, hashes, host_b), "host B missing");
+            CHECK("04", !bloom_has_addr(bloom, bloom_size, hashes, host_c), "host C present");
+            CHECK("04", bloom_has_port(bloom, bloom_size, hashes, 53), "port 53 missing");
+            CHECK("04", bloom_has_port(bloom, bloom_size, hashes, 5353), "port 5353 missing");
+            CHECK("04", !bloom_has_port(bloom, bloom_size, hashes, 80), "port 80 present");
+
+            /* 05: the flows, in either order */
+            for (i = 0; i < nflows; i++) {
+                entry = index + HDR_LEN + bloom_size + i * FLOW_LEN;
+                CHECK("05", entry[0] == 4 && entry[1] == 17, "wrong family or protocol");
+                if (memcmp(entry + 8, host_a, 4) == 0) {
+                    seen_ab = TRUE;
+                    CHECK("05", memcmp(entry + 24, host_b, 4) == 0, "A->B: wrong destination");
+                    CHECK("05", get_le16(entry + 4) == 5353 && get_le16(entry + 6) == 53,
+                          "A->B: wrong ports");
+                    CHECK("05", get_le64(entry + 40) == 2 && get_le64(entry + 48) == 200,
+                          "A->B: wrong counts");
+                } else if (memcmp(entry + 8, host_b, 4) == 0) {
+                    seen_ba = TRUE;
+                    CHECK("05", memcmp(entry + 24, host_a, 4) == 0, "B->A: wrong destination");
+                    CHECK("05", get_le16(entry + 4) == 53 && get_le16(entry + 6) == 5353,
+                          "B->A: wrong ports");
+                    CHECK("05", get_le64(entry + 40) == 1 && get_le64(entry + 48) == 200,
+                          "B->A: wrong counts");
+                }
+            }
+            CHECK("05", seen_ab && seen_ba, "flow missing");
+        }
+    }
+    g_free(index);
+
+    /* 06: after a reset, the index is empty */
+    flowindex_builder_reset(builder);
+    if (!flowindex_builder_write(builder, filename, &err)) {
+        printf("06: can't write %s: %s\n", filename, g_strerror(err));
+        failed = TRUE;
+    } else if ((index = read_index("06", filename, &len)) != NULL) {
+        CHECK("06", len == HDR_LEN + get_le32(index + 48), "index not empty");
+        CHECK("06", get_le64(index + 32) == 0 && get_le32(index + 56) == 0,
+              "counts not reset");
+        g_free(index);
+    }
+    flowindex_builder_free(builder);
+}
+
+int
+main(void)
+{
+    gchar  *filename;
+    GError *error = NULL;
+    int     fd;
+
+    fd = g_file_open_tmp("flowindex_testXXXXXX", &filename, &error);
+    if (fd == -1) {
+        printf("Can't create a temporary file: %s\n", error->message);
+        g_error_free(error);
+        return 1;
+    }
+    ws_close(fd);
+
+    run_tests(filename);
+
+    ws_unlink(filename);
+    g_free(filename);
+    return failed ? 1 : 0;
+}
+
+/*
+ * Editor modelines  -  http://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 4
+ * tab-width: 8
+ * indent-tabs-mode: nil
+ * End:
+ *
+ * vi: set shiftwidth=4 tabstop=8 expandtab:
+ * :indentSize=4:tabSize=8:noTabs=true:
+ */
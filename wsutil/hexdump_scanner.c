@@ -0,0 +1,383 @@
+/* hexdump_scanner.c
+ * Tokenizer for the hex dumps read by text2pcap and "Import from Hex Dump"
+ *
+ * $Id$
+ *
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 1998 Gerald Combs
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+
+#include <glib.h>
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+#include "hexdump_scanner.h"
+
+/*
+ * The flex rules we have to match, in order of precedence when two of
+ * them match the same length of input (otherwise the longest match wins):
+ *
+ *    directive    #TEXT2PCAP.*
+ *    comment      #[^W].*                   (ignored)
+ *    byte         {hexdigit}{2}[ \t]
+ *    byte_eol     {hexdigit}{2}\r?\n        (byte, then end of line)
+ *    offset       {hexdigit}+[: \t]
+ *    offset_eol   {hexdigit}+\r?\n          (offset, then end of line)
+ *    mailfwd      >{hexdigit}+[: \t]        (offset without the '>')
+ *    eol          \r?\n\r?
+ *    white space  [ \t]                     (ignored)
+ *    text         [^ \n\t]+
+ *
+ * Note that [^W] also matches a newline, so a '#' at the end of a line
+ * makes the next line part of the comment.
+ */
+
+#define HEXDUMP_BUF_SIZE    (256 * 1024)
+#define HEXDUMP_BATCH_MAX   4096
+
+/* Value of each hex digit, 0xff for anything else */
+static const guint8 hex_val[256] = {
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff
+};
+
+#define IS_HEX(c)       (hex_val[(guchar)(c)] != 0xff)
+#define IS_BLANK(c)     ((c) == ' ' || (c) == '\t')
+#define IS_TEXT(c)      ((c) != ' ' && (c) != '\t' && (c) != '\n')
+
+typedef struct {
+    FILE               *fh;
+    char               *buf;
+    gsize               buf_size;   /* allocated, less one for a NUL */
+    gsize               buf_len;    /* bytes in buf */
+    gsize               pos;        /* next byte to scan */
+    gboolean            eof;
+    hexdump_token_func  token_func;
+    hexdump_bytes_func  bytes_func;
+    guint8              batch[HEXDUMP_BATCH_MAX];
+    guint               batch_len;
+} hexdump_scanner_t;
+
+/* Hand the data bytes collected so far to the caller */
+static void
+flush_bytes(hexdump_scanner_t *s)
+{
+    if (s->batch_len != 0) {
+        s->bytes_func(s->batch, s->batch_len);
+        s->batch_len = 0;
+    }
+}
+
+/*
+ * Deliver a token whose text is len bytes at p.  Like flex, we
+ * NUL-terminate the text in place for the duration of the call.
+ */
+static void
+emit(hexdump_scanner_t *s, hexdump_token_t token, char *p, gsize len)
+{
+    char saved;
+
+    if (s->bytes_func != NULL) {
+        if (token == HEXDUMP_T_BYTE) {
+            if (s->batch_len == HEXDUMP_BATCH_MAX)
+                flush_bytes(s);
+            s->batch[s->batch_len++] =
+                (guint8)(hex_val[(guchar)p[0]] << 4 | hex_val[(guchar)p[1]]);
+            return;
+        }
+        flush_bytes(s);
+    }
+
+    if (token == HEXDUMP_T_EOL) {
+        s->token_func(token, NULL);
+        return;
+    }
+    saved = p[len];
+    p[len] = '\0';
+    s->token_func(token, p);
+    p[len] = saved;
+}
+
+/* Length of the run of characters of a class, starting at p */
+static gsize
+hex_run(const char *p, const char *end)
+{
+    const char *q = p;
+
+    while (q < end && IS_HEX(*q))
+        q++;
+    return q - p;
+}
+
+static gsize
+text_run(const char *p, const char *end)
+{
+    const char *q = p;
+
+    while (q < end && IS_TEXT(*q))
+        q++;
+    return q - p;
+}
+
+static gsize
+line_run(const char *p, const char *end)
+{
+    const char *q;
+
+    q = (const char *)memchr(p, '\n', end - p);
+    return (q != NULL ? q : end) - p;
+}
+
+/*
+ * Scan one token, or a run of data bytes, at s->pos.  Returns the number
+ * of bytes consumed, or 0 if we can't tell where the token ends without
+ * more input.
+ */
+static gsize
+scan_token(hexdump_scanner_t *s)
+{
+    char *p = s->buf + s->pos;
+    char *end = s->buf + s->buf_len;
+    gsize avail = end - p;
+    gsize h, t, len;
+    char *q;
+
+    /*
+     * A run of data bytes, in the usual "xx xx xx ..." layout.  Decode
+     * them all here rather than going round the loop for each one.
+     */
+    if (s->bytes_func != NULL && avail >= 3 &&
+        IS_HEX(p[0]) && IS_HEX(p[1]) && IS_BLANK(p[2])) {
+        q = p;
+        do {
+            emit(s, HEXDUMP_T_BYTE, q, 3);
+            q += 3;
+            while (q < end && IS_BLANK(*q))
+                q++;
+        } while (end - q >= 3 && IS_HEX(q[0]) && IS_HEX(q[1]) && IS_BLANK(q[2]));
+        return q - p;
+    }
+
+    switch (*p) {
+
+    case ' ':
+    case '\t':
+        return 1;
+
+    case '\n':
+        if (avail < 2 && !s->eof)
+            return 0;
+        len = (avail >= 2 && p[1] == '\r') ? 2 : 1;
+        emit(s, HEXDUMP_T_EOL, p, len);
+        return len;
+
+    case '\r':
+        if (avail < 3 && !s->eof)
+            return 0;
+        if (avail >= 2 && p[1] == '\n') {
+            len = (avail >= 3 && p[2] == '\r') ? 3 : 2;
+            emit(s, HEXDUMP_T_EOL, p, len);
+            return len;
+        }
+        break;  /* text */
+
+    case '#':
+        if (avail < 10 && !s->eof)
+            return 0;
+        if (avail >= 10 && strncmp(p, "#TEXT2PCAP", 10) == 0) {
+            len = 10 + line_run(p + 10, end);
+            if (p + len == end && !s->eof)
+                return 0;
+            emit(s, HEXDUMP_T_DIRECTIVE, p, len);
+            return len;
+        }
+        if (avail >= 2 && p[1] != 'W') {
+            /* A comment, ignored */
+            len = 2 + line_run(p + 2, end);
+            if (p + len == end && !s->eof)
+                return 0;
+            return len;
+        }
+        break;  /* text */
+
+    case '>':
+        h = hex_run(p + 1, end);
+        t = text_run(p, end);
+        if ((p + 1 + h == end || p + t == end) && !s->eof)
+            return 0;
+        if (h != 0 && p + 1 + h != end &&
+            (IS_BLANK(p[1 + h]) || p[1 + h] == ':') && t <= 2 + h) {
+            emit(s, HEXDUMP_T_OFFSET, p + 1, 1 + h);
+            return 2 + h;
+        }
+        break;  /* text */
+
+    default:
+        if (!IS_HEX(*p))
+            break;  /* text */
+        h = hex_run(p, end);
+        if (avail < h + 2 && !s->eof)
+            return 0;
+        if (h == avail)
+            break;  /* text, at the end of the file */
+        switch (p[h]) {
+
+        case ' ':
+        case '\t':
+            emit(s, h == 2 ? HEXDUMP_T_BYTE : HEXDUMP_T_OFFSET, p, h + 1);
+            return h + 1;
+
+        case ':':
+            t = text_run(p, end);
+            if (p + t == end && !s->eof)
+                return 0;
+            if (t == h + 1) {
+                emit(s, HEXDUMP_T_OFFSET, p, h + 1);
+                return h + 1;
+            }
+            break;  /* text */
+
+        case '\n':
+            emit(s, h == 2 ? HEXDUMP_T_BYTE : HEXDUMP_T_OFFSET, p, h + 1);
+            emit(s, HEXDUMP_T_EOL, p + h, 1);
+            return h + 1;
+
+        case '\r':
+            if (h + 1 < avail && p[h + 1] == '\n') {
+                emit(s, h == 2 ? HEXDUMP_T_BYTE : HEXDUMP_T_OFFSET, p, h + 2);
+                emit(s, HEXDUMP_T_EOL, p + h, 2);
+                return h + 2;
+            }
+            break;  /* text */
+        }
+        break;  /* text */
+    }
+
+    t = text_run(p, end);
+    if (p + t == end && !s->eof)
+        return 0;
+    emit(s, HEXDUMP_T_TEXT, p, t);
+    return t;
+}
+
+/* Move what's left to the start of the buffer, and read some more */
+static gboolean
+refill(hexdump_scanner_t *s, int *err)
+{
+    size_t nread;
+
+    if (s->pos != 0) {
+        memmove(s->buf, s->buf + s->pos, s->buf_len - s->pos);
+        s->buf_len -= s->pos;
+        s->pos = 0;
+    }
+    if (s->buf_len == s->buf_size) {
+        /* One token fills the whole buffer; make room for more. */
+        s->buf_size *= 2;
+        s->buf = (char *)g_realloc(s->buf, s->buf_size + 1);
+    }
+    nread = fread(s->buf + s->buf_len, 1, s->buf_size - s->buf_len, s->fh);
+    s->buf_len += nread;
+    if (nread == 0) {
+        if (ferror(s->fh)) {
+            *err = errno;
+            return FALSE;
+        }
+        s->eof = TRUE;
+    }
+    return TRUE;
+}
+
+gboolean
+hexdump_scan(FILE *fh, hexdump_token_func token_func,
+             hexdump_bytes_func bytes_func, int *err)
+{
+    hexdump_scanner_t *s;
+    gboolean ret = TRUE;
+    gsize len;
+
+    s = g_new(hexdump_scanner_t, 1);
+    s->fh = fh;
+    s->buf_size = HEXDUMP_BUF_SIZE;
+    s->buf = (char *)g_malloc(s->buf_size + 1);
+    s->buf_len = 0;
+    s->pos = 0;
+    s->eof = FALSE;
+    s->token_func = token_func;
+    s->bytes_func = bytes_func;
+    s->batch_len = 0;
+
+    for (;;) {
+        if (s->pos == s->buf_len) {
+            if (s->eof)
+                break;
+            if (!refill(s, err)) {
+                ret = FALSE;
+                break;
+            }
+            continue;
+        }
+        len = scan_token(s);
+        if (len == 0) {
+            /* The token runs past what we've read so far. */
+            if (!refill(s, err)) {
+                ret = FALSE;
+                break;
+            }
+            continue;
+        }
+        s->pos += len;
+    }
+    if (s->bytes_func != NULL)
+        flush_bytes(s);
+
+    g_free(s->buf);
+    g_free(s);
+    return ret;
+}
+
+/*
+ * Editor modelines  -  http://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 4
+ * tab-width: 8
+ * indent-tabs-mode: nil
+ * End:
+ *
+ * vi: set shiftwidth=4 tabstop=8 expandtab:
+ * :indentSize=4:tabSize=8:noTabs=true:
+ */
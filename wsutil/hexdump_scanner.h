@@ -0,0 +1,85 @@
+/* hexdump_scanner.h
+ * Tokenizer for the hex dumps read by text2pcap and "Import from Hex Dump"
+ *
+ * $Id$
+ *
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 1998 Gerald Combs
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef __HEXDUMP_SCANNER_H__
+#define __HEXDUMP_SCANNER_H__
+
+#include <stdio.h>
+
+#include <glib.h>
+
+#include "ws_symbol_export.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/** @file
+ * A hand-written replacement for the flex scanners text2pcap-scanner.l
+ * and ui/text_import_scanner.l.  It splits the input into exactly the
+ * same tokens as those scanners do, but without the per-token overhead,
+ * and it can hand runs of data bytes to the caller already decoded,
+ * rather than one token at a time.
+ */
+
+/** Token types; these have the same values as the scanners' token_t. */
+typedef enum {
+    HEXDUMP_T_BYTE = 1,     /**< two hex digits followed by white space */
+    HEXDUMP_T_OFFSET,       /**< hex digits followed by ':' or white space */
+    HEXDUMP_T_DIRECTIVE,    /**< a "#TEXT2PCAP" line */
+    HEXDUMP_T_TEXT,         /**< anything else not containing white space */
+    HEXDUMP_T_EOL           /**< end of line */
+} hexdump_token_t;
+
+/**
+ * Called for each token.  str is the text of the token, NUL-terminated,
+ * which the callee may modify; it's NULL for HEXDUMP_T_EOL.
+ */
+typedef void (*hexdump_token_func)(hexdump_token_t token, char *str);
+
+/**
+ * Called for a run of consecutive HEXDUMP_T_BYTE tokens, with the values
+ * of the bytes.  Delivering a run this way must be equivalent to
+ * delivering its bytes as separate tokens.
+ */
+typedef void (*hexdump_bytes_func)(const guint8 *bytes, guint count);
+
+/**
+ * Read a hex dump to the end, calling token_func for each token.
+ *
+ * @param fh The file to read.
+ * @param token_func Called for each token.
+ * @param bytes_func Called for runs of data bytes; if NULL, data bytes
+ *                   are delivered as HEXDUMP_T_BYTE tokens instead.
+ * @param err Receives an errno value if reading the file fails.
+ * @return TRUE at the end of the file, FALSE if reading it failed.
+ */
+WS_DLL_PUBLIC gboolean hexdump_scan(FILE *fh, hexdump_token_func token_func,
+    hexdump_bytes_func bytes_func, int *err);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* __HEXDUMP_SCANNER_H__ */
@@ -0,0 +1,329 @@
+/* Standalone program to test the hex dump scanner.
+ *
+ * $Id$
+ *
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 1998 Gerald Combs
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+#include <glib.h>
+
+#include "hexdump_scanner.h"
+#include <wsutil/file_util.h>
+
+/* The size of the scanner's buffer, HEXDUMP_BUF_SIZE in hexdump_scanner.c */
+#define SCANNER_BUF_SIZE    (256 * 1024)
+
+static gboolean failed = FALSE;
+
+#define CHECK(test, cond, what) \
+    do { \
+        if (!(cond)) { \
+            printf("%s: %s\n", test, what); \
+            failed = TRUE; \
+        } \
+    } while (0)
+
+/*
+ * text2pcap input with the cases the scanner has to get right: a
+ * directive, comments (one running on into the next line), offsets
+ * ending in ':', ' ', '\t' and a newline, mail-forwarded offsets, CR LF
+ * line ends, stray CRs, the ASCII column, things that look like hex
+ * but aren't, and a last line with no newline.
+ */
+static const char sample_dump[] =
+    "#TEXT2PCAP -t %H:%M:%S.\n"
+    "# A comment, then one that runs on\n"
+    "#\n"
+    "into the next line\n"
+    "0000  00 11 22 33 44 55 66 77  88 99 aa bb cc dd ee ff   ..3DUfw.........\n"
+    "0010: 01 02 03\r\n"
+    "0020\t0a 0B\n"
+    ">0030 de ad be ef\n"
+    "\n"
+    "0040\n"
+    "zz\n\r"
+    "000050 ff\r\n\r"
+    "zz 12: 123 1g 0x10 >zz >40: #Word #x\n"
+    "ab";
+
+/* What the flex scanner in text2pcap-scanner.l gives for sample_dump */
+static const struct {
+    hexdump_token_t token;
+    const char     *str;
+} sample_tokens[] = {
+    { HEXDUMP_T_DIRECTIVE, "#TEXT2PCAP -t %H:%M:%S." },
+    { HEXDUMP_T_EOL, NULL },
+    { HEXDUMP_T_EOL, NULL },
+    { HEXDUMP_T_EOL, NULL },
+    { HEXDUMP_T_OFFSET, "0000 " },
+    { HEXDUMP_T_BYTE, "00 " },
+    { HEXDUMP_T_BYTE, "11 " },
+    { HEXDUMP_T_BYTE, "22 " },
+    { HEXDUMP_T_BYTE, "33 " },
+    { HEXDUMP_T_BYTE, "44 " },
+    { HEXDUMP_T_BYTE, "55 " },
+    { HEXDUMP_T_BYTE, "66 " },
+    { HEXDUMP_T_BYTE, "77 " },
+    { HEXDUMP_T_BYTE, "88 " },
+    { HEXDUMP_T_BYTE, "99 " },
+    { HEXDUMP_T_BYTE, "aa " },
+    { HEXDUMP_T_BYTE, "bb " },
+    { HEXDUMP_T_BYTE, "cc " },
+    { HEXDUMP_T_BYTE, "dd " },
+    { HEXDUMP_T_BYTE, "ee " },
+    { HEXDUMP_T_BYTE, "ff " },
+    { HEXDUMP_T_TEXT, "..3DUfw........." },
+    { HEXDUMP_T_EOL, NULL },
+    { HEXDUMP_T_OFFSET, "0010:" },
+    { HEXDUMP_T_BYTE, "01 " },
+    { HEXDUMP_T_BYTE, "02 " },
+    { HEXDUMP_T_BYTE, "03\r\n" },
+    { HEXDUMP_T_EOL, NULL },
+    { HEXDUMP_T_OFFSET, "0020\t" },
+    { HEXDUMP_T_BYTE, "0a " },
+    { HEXDUMP_T_BYTE, "0B\n" },
+    { HEXDUMP_T_EOL, NULL },
+    { HEXDUMP_T_OFFSET, "0030 " },
+    { HEXDUMP_T_BYTE, "de " },
+    { HEXDUMP_T_BYTE, "ad " },
+    { HEXDUMP_T_BYTE, "be " },
+    { HEXDUMP_T_BYTE, "ef\n" },
+    { HEXDUMP_T_EOL, NULL },
+    { HEXDUMP_T_EOL, NULL },
+    { HEXDUMP_T_OFFSET, "0040\n" },
+    { HEXDUMP_T_EOL, NULL },
+    { HEXDUMP_T_TEXT, "zz" },
+    { HEXDUMP_T_EOL, NULL },
+    { HEXDUMP_T_OFFSET, "000050 " },
+    { HEXDUMP_T_BYTE, "ff\r\n" },
+    { HEXDUMP_T_EOL, NULL },
+    { HEXDUMP_T_TEXT, "\rzz" },
+    { HEXDUMP_T_OFFSET, "12:" },
+    { HEXDUMP_T_OFFSET, "123 " },
+    { HEXDUMP_T_TEXT, "1g" },
+    { HEXDUMP_T_TEXT, "0x10" },
+    { HEXDUMP_T_TEXT, ">zz" },
+    { HEXDUMP_T_OFFSET, "40:" },
+    { HEXDUMP_T_TEXT, "#Word" },
+    { HEXDUMP_T_EOL, NULL },
+    { HEXDUMP_T_TEXT, "ab" },
+};
+
+/* What we got, one line per token or data byte */
+static GString *scanned;
+
+static const char *
+token_name(hexdump_token_t token)
+{
+    switch (token) {
+    case HEXDUMP_T_BYTE:        return "BYTE";
+    case HEXDUMP_T_OFFSET:      return "OFFSET";
+    case HEXDUMP_T_DIRECTIVE:   return "DIRECTIVE";
+    case HEXDUMP_T_TEXT:        return "TEXT";
+    case HEXDUMP_T_EOL:         return "EOL";
+    }
+    return "?";
+}
+
+/* Add a token to a log; with decode_bytes, a byte is logged by value */
+static void
+log_token(GString *log, hexdump_token_t token, const char *str,
+          gboolean decode_bytes)
+{
+    gchar *escaped;
+
+    if (token == HEXDUMP_T_BYTE && decode_bytes) {
+        /* strtoul() stops at the white space after the digits */
+        g_string_append_printf(log, "byte %02lx\n", strtoul(str, NULL, 16));
+        return;
+    }
+    g_string_append(log, token_name(token));
+    if (str != NULL) {
+        escaped = g_strescape(str, NULL);
+        g_string_append_printf(log, " \"%s\"", escaped);
+        g_free(escaped);
+    }
+    g_string_append_c(log, '\n');
+}
+
+static void
+token_as_is(hexdump_token_t token, char *str)
+{
+    log_token(scanned, token, str, FALSE);
+}
+
+static void
+token_decoded(hexdump_token_t token, char *str)
+{
+    log_token(scanned, token, str, TRUE);
+}
+
+static void
+bytes_logged(const guint8 *bytes, guint count)
+{
+    guint i;
+
+    for (i = 0; i < count; i++)
+        g_string_append_printf(scanned, "byte %02x\n", bytes[i]);
+}
+
+/* Scan a file, logging to "scanned" */
+static gboolean
+scan_file(const char *test, const char *filename,
+          hexdump_token_func token_func, hexdump_bytes_func bytes_func)
+{
+    FILE    *fh;
+    int      err;
+    gboolean ok;
+
+    fh = ws_fopen(filename, "rb");
+    if (fh == NULL) {
+        printf("%s: can't open %s\n", test, filename);
+        failed = TRUE;
+        return FALSE;
+    }
+    ok = hexdump_scan(fh, token_func, bytes_func, &err);
+    fclose(fh);
+    if (!ok) {
+        printf("%s: can't read %s: %s\n", test, filename, g_strerror(err));
+        failed = TRUE;
+    }
+    return ok;
+}
+
+static void
+check_log(const char *test, const GString *expected)
+{
+    if (strcmp(scanned->str, expected->str) != 0) {
+        printf("%s: got\n%s%s: expected\n%s", test, scanned->str, test,
+               expected->str);
+        failed = TRUE;
+    }
+}
+
+static void
+run_tests(const char *filename)
+{
+    GString *tokens, *expected, *padded;
+    guint    i, j;
+
+    if (!g_file_set_contents(filename, sample_dump, sizeof sample_dump - 1, NULL)) {
+        printf("Can't write %s\n", filename);
+        failed = TRUE;
+        return;
+    }
+    scanned = g_string_new("");
+    tokens = g_string_new("");
+    expected = g_string_new("");
+
+    /* 01: token by token, the same as the flex scanner */
+    for (i = 0; i < G_N_ELEMENTS(sample_tokens); i++)
+        log_token(tokens, sample_tokens[i].token, sample_tokens[i].str, FALSE);
+    if (scan_file("01", filename, token_as_is, NULL))
+        check_log("01", tokens);
+
+    /* 02: with the data bytes handed over in runs, the same bytes in
+       the same places */
+    for (i = 0; i < G_N_ELEMENTS(sample_tokens); i++)
+        log_token(expected, sample_tokens[i].token, sample_tokens[i].str, TRUE);
+    g_string_truncate(scanned, 0);
+    if (scan_file("02", filename, token_decoded, bytes_logged))
+        check_log("02", expected);
+
+    /* 03: with each byte of the sample in turn at the end of the
+       scanner's first read, so that every token gets split across two
+       reads; the blanks in front of the sample are ignored */
+    padded = g_string_sized_new(SCANNER_BUF_SIZE + sizeof sample_dump);
+    for (i = 0; i < sizeof sample_dump - 1; i++) {
+        g_string_truncate(padded, 0);
+        for (j = 0; j < SCANNER_BUF_SIZE - 1 - i; j++)
+            g_string_append_c(padded, (j % 2) ? '\t' : ' ');
+        g_string_append_len(padded, sample_dump, sizeof sample_dump - 1);
+        if (!g_file_set_contents(filename, padded->str, padded->len, NULL)) {
+            printf("03: can't write %s\n", filename);
+            failed = TRUE;
+            break;
+        }
+        g_string_truncate(scanned, 0);
+        if (!scan_file("03", filename, token_decoded, bytes_logged))
+            break;
+        if (strcmp(scanned->str, expected->str) != 0) {
+            printf("03: wrong tokens with the read ending at byte %u\n", i);
+            failed = TRUE;
+        }
+        g_string_truncate(scanned, 0);
+        if (!scan_file("03", filename, token_as_is, NULL))
+            break;
+        if (strcmp(scanned->str, tokens->str) != 0) {
+            printf("03: wrong tokens with the read ending at byte %u, "
+                   "token by token\n", i);
+            failed = TRUE;
+        }
+    }
+    g_string_free(padded, TRUE);
+
+    g_string_free(tokens, TRUE);
+    g_string_free(expected, TRUE);
+    g_string_free(scanned, TRUE);
+}
+
+int
+main(void)
+{
+    gchar  *filename;
+    GError *error = NULL;
+    int     fd;
+
+    fd = g_file_open_tmp("hexdump_scanner_testXXXXXX", &filename, &error);
+    if (fd == -1) {
+        printf("Can't create a temporary file: %s\n", error->message);
+        g_error_free(error);
+        return 1;
+    }
+    ws_close(fd);
+
+    run_tests(filename);
+
+    ws_unlink(filename);
+    g_free(filename);
+    return failed ? 1 : 0;
+}
+
+/*
+ * Editor modelines  -  http://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 4
+ * tab-width: 8
+ * indent-tabs-mode: nil
+ * End:
+ *
+ * vi: set shiftwidth=4 tabstop=8 expandtab:
+ * :indentSize=4:tabSize=8:noTabs=true:
+ */
@@ -0,0 +1,147 @@
+/* murmur3.c
+ * MurmurHash3 128-bit hash
+ *
+ * $Id$
+ *
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 1998 Gerald Combs
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+
+#include <glib.h>
+
+#include <string.h>
+
+#include "murmur3.h"
+
+/*
+ * This is the x64 128-bit variant of MurmurHash3, "MurmurHash3_x64_128"
+ * in the reference implementation.  Blocks are read little-endian, so
+ * the digest is the same on every platform.
+ */
+
+#define ROTL64(x, r)    (((x) << (r)) | ((x) >> (64 - (r))))
+
+static guint64
+getblock64(const guint8 *p)
+{
+    guint64 v;
+
+    memcpy(&v, p, sizeof v);
+    return GUINT64_FROM_LE(v);
+}
+
+static guint64
+fmix64(guint64 k)
+{
+    k ^= k >> 33;
+    k *= G_GUINT64_CONSTANT(0xff51afd7ed558ccd);
+    k ^= k >> 33;
+    k *= G_GUINT64_CONSTANT(0xc4ceb9fe1a85ec53);
+    k ^= k >> 33;
+    return k;
+}
+
+static void
+put_le64(guint8 *p, guint64 v)
+{
+    v = GUINT64_TO_LE(v);
+    memcpy(p, &v, sizeof v);
+}
+
+void
+murmur3_128(const void *data, size_t len, guint32 seed,
+            guint8 digest[MURMUR3_128_LEN])
+{
+    const guint8 *bytes = (const guint8 *)data;
+    const guint8 *tail;
+    size_t nblocks = len / 16;
+    size_t i;
+    guint64 h1 = seed;
+    guint64 h2 = seed;
+    guint64 k1, k2;
+    const guint64 c1 = G_GUINT64_CONSTANT(0x87c37b91114253d5);
+    const guint64 c2 = G_GUINT64_CONSTANT(0x4cf5ad432745937f);
+
+    /* body */
+    for (i = 0; i < nblocks; i++) {
+        k1 = getblock64(bytes + i * 16);
+        k2 = getblock64(bytes + i * 16 + 8);
+
+        k1 *= c1; k1 = ROTL64(k1, 31); k1 *= c2; h1 ^= k1;
+        h1 = ROTL64(h1, 27); h1 += h2; h1 = h1 * 5 + 0x52dce729;
+
+        k2 *= c2; k2 = ROTL64(k2, 33); k2 *= c1; h2 ^= k2;
+        h2 = ROTL64(h2, 31); h2 += h1; h2 = h2 * 5 + 0x38495ab5;
+    }
+
+    /* tail */
+    tail = bytes + nblocks * 16;
+    k1 = 0;
+    k2 = 0;
+    switch (len & 15) {
+    case 15: k2 ^= ((guint64)tail[14]) << 48; /* FALL THROUGH */
+    case 14: k2 ^= ((guint64)tail[13]) << 40; /* FALL THROUGH */
+    case 13: k2 ^= ((guint64)tail[12]) << 32; /* FALL THROUGH */
+    case 12: k2 ^= ((guint64)tail[11]) << 24; /* FALL THROUGH */
+    case 11: k2 ^= ((guint64)tail[10]) << 16; /* FALL THROUGH */
+    case 10: k2 ^= ((guint64)tail[ 9]) << 8;  /* FALL THROUGH */
+    case  9: k2 ^= ((guint64)tail[ 8]) << 0;
+             k2 *= c2; k2 = ROTL64(k2, 33); k2 *= c1; h2 ^= k2;
+             /* FALL THROUGH */
+    case  8: k1 ^= ((guint64)tail[ 7]) << 56; /* FALL THROUGH */
+    case  7: k1 ^= ((guint64)tail[ 6]) << 48; /* FALL THROUGH */
+    case  6: k1 ^= ((guint64)tail[ 5]) << 40; /* FALL THROUGH */
+    case  5: k1 ^= ((guint64)tail[ 4]) << 32; /* FALL THROUGH */
+    case  4: k1 ^= ((guint64)tail[ 3]) << 24; /* FALL THROUGH */
+    case  3: k1 ^= ((guint64)tail[ 2]) << 16; /* FALL THROUGH */
+    case  2: k1 ^= ((guint64)tail[ 1]) << 8;  /* FALL THROUGH */
+    case  1: k1 ^= ((guint64)tail[ 0]) << 0;
+             k1 *= c1; k1 = ROTL64(k1, 31); k1 *= c2; h1 ^= k1;
+    }
+
+    /* finalization */
+    h1 ^= (guint64)len;
+    h2 ^= (guint64)len;
+
+    h1 += h2;
+    h2 += h1;
+
+    h1 = fmix64(h1);
+    h2 = fmix64(h2);
+
+    h1 += h2;
+    h2 += h1;
+
+    put_le64(digest, h1);
+    put_le64(digest + 8, h2);
+}
+
+/*
+ * Editor modelines  -  http://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 4
+ * tab-width: 8
+ * indent-tabs-mode: nil
+ * End:
+ *
+ * vi: set shiftwidth=4 tabstop=8 expandtab:
+ * :indentSize=4:tabSize=8:noTabs=true:
+ */
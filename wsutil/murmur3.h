@@ -0,0 +1,62 @@
+/* murmur3.h
+ * MurmurHash3 128-bit hash
+ *
+ * $Id$
+ *
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 1998 Gerald Combs
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef __MURMUR3_H__
+#define __MURMUR3_H__
+
+#include <glib.h>
+
+#include "ws_symbol_export.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/** @file
+ * MurmurHash3 (x64, 128-bit variant), by Austin Appleby, who placed it
+ * in the public domain.  It is a fast, well-distributed hash for looking
+ * things up; it is NOT a cryptographic hash, and must not be used where
+ * an attacker choosing the input matters.
+ */
+
+/** Length of a MurmurHash3 128-bit digest, in bytes. */
+#define MURMUR3_128_LEN 16
+
+/**
+ * Compute the 128-bit MurmurHash3 of a buffer.
+ *
+ * @param data The data to hash.
+ * @param len The length of the data.
+ * @param seed The seed; the same data with the same seed always gives
+ *             the same digest.
+ * @param digest Receives the digest.
+ */
+WS_DLL_PUBLIC void murmur3_128(const void *data, size_t len, guint32 seed,
+    guint8 digest[MURMUR3_128_LEN]);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* __MURMUR3_H__ */
@@ -0,0 +1,248 @@
+/* pktdedup.c
+ * Window of recent packet digests, for finding duplicate packets
+ *
+ * $Id$
+ *
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 1998 Gerald Combs
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+
+#include <glib.h>
+
+#include <string.h>
+
+#include "pktdedup.h"
+
+/* A packet in the window */
+typedef struct {
+    guint8   digest[MURMUR3_128_LEN];
+    guint32  len;
+    nstime_t time;
+} pktdedup_entry_t;
+
+/*
+ * Hash table slot: one per distinct digest and length in the window.
+ * A count of 0 means the slot is free.
+ */
+typedef struct {
+    guint8   digest[MURMUR3_128_LEN];
+    guint32  len;
+    guint32  count;     /* number of packets in the window with this digest */
+    nstime_t latest;    /* time of the most recent of them */
+} pktdedup_slot_t;
+
+struct pktdedup {
+    pktdedup_entry_t *ring;     /* the packets in the window */
+    guint32 size;               /* number of packets the ring can hold */
+    guint32 first;              /* oldest packet in the ring */
+    guint32 count;              /* number of packets in the ring */
+    pktdedup_slot_t *slots;     /* hash table, power-of-2 size */
+    guint32 slots_mask;
+    guint32 slots_used;
+};
+
+#define PKTDEDUP_INITIAL_SLOTS  1024
+
+/* The digest is already well mixed; use some of it as the index. */
+static guint32
+slot_home(const pktdedup_t *dedup, const guint8 *digest)
+{
+    return (digest[0] | (digest[1] << 8) | (digest[2] << 16) |
+            ((guint32)digest[3] << 24)) & dedup->slots_mask;
+}
+
+/*
+ * Find the slot for a digest and length: the slot holding it, or the
+ * free slot where it would go.
+ */
+static guint32
+slot_find(const pktdedup_t *dedup, const guint8 *digest, guint32 len)
+{
+    guint32 i;
+
+    i = slot_home(dedup, digest);
+    while (dedup->slots[i].count != 0) {
+        if (dedup->slots[i].len == len &&
+            memcmp(dedup->slots[i].digest, digest, MURMUR3_128_LEN) == 0)
+            break;
+        i = (i + 1) & dedup->slots_mask;
+    }
+    return i;
+}
+
+/* Double the size of the hash table */
+static void
+slots_grow(pktdedup_t *dedup)
+{
+    pktdedup_slot_t *old_slots = dedup->slots;
+    guint32 old_nslots = dedup->slots_mask + 1;
+    guint32 i;
+
+    dedup->slots = g_new0(pktdedup_slot_t, old_nslots * 2);
+    dedup->slots_mask = old_nslots * 2 - 1;
+    for (i = 0; i < old_nslots; i++) {
+        if (old_slots[i].count != 0)
+            dedup->slots[slot_find(dedup, old_slots[i].digest, old_slots[i].len)] = old_slots[i];
+    }
+    g_free(old_slots);
+}
+
+/* Drop one packet with this slot's digest from the hash table */
+static void
+slot_release(pktdedup_t *dedup, guint32 i)
+{
+    guint32 j, home;
+
+    if (--dedup->slots[i].count != 0)
+        return;
+    dedup->slots_used--;
+
+    /*
+     * Free the slot, moving later entries of the probe sequence back
+     * so that lookups don't stop early at the hole (linear probing
+     * deletion, no tombstones needed).
+     */
+    j = i;
+    for (;;) {
+        j = (j + 1) & dedup->slots_mask;
+        if (dedup->slots[j].count == 0)
+            break;
+        home = slot_home(dedup, dedup->slots[j].digest);
+        /* Can the entry at j move to i, i.e. is i cyclically in [home, j)? */
+        if (((j - home) & dedup->slots_mask) >= ((j - i) & dedup->slots_mask)) {
+            dedup->slots[i] = dedup->slots[j];
+            i = j;
+        }
+    }
+    dedup->slots[i].count = 0;
+}
+
+/* Drop the oldest packet in the window */
+static void
+evict_oldest(pktdedup_t *dedup)
+{
+    pktdedup_entry_t *oldest = &dedup->ring[dedup->first];
+
+    slot_release(dedup, slot_find(dedup, oldest->digest, oldest->len));
+    dedup->first = (dedup->first + 1) % dedup->size;
+    dedup->count--;
+}
+
+pktdedup_t *
+pktdedup_new(guint32 size)
+{
+    pktdedup_t *dedup;
+
+    dedup = g_new0(pktdedup_t, 1);
+    dedup->size = size;
+    dedup->ring = g_new(pktdedup_entry_t, size > 0 ? size : 1);
+
+    /* The table grows as needed; see pktdedup_add(). */
+    dedup->slots = g_new0(pktdedup_slot_t, PKTDEDUP_INITIAL_SLOTS);
+    dedup->slots_mask = PKTDEDUP_INITIAL_SLOTS - 1;
+    return dedup;
+}
+
+gboolean
+pktdedup_find(const pktdedup_t *dedup, const guint8 digest[MURMUR3_128_LEN],
+              guint32 len, nstime_t *latest)
+{
+    const pktdedup_slot_t *slot;
+
+    slot = &dedup->slots[slot_find(dedup, digest, len)];
+    if (slot->count == 0)
+        return FALSE;
+    if (latest != NULL)
+        *latest = slot->latest;
+    return TRUE;
+}
+
+void
+pktdedup_add(pktdedup_t *dedup, const guint8 digest[MURMUR3_128_LEN],
+             guint32 len, const nstime_t *time)
+{
+    pktdedup_entry_t *entry;
+    guint32 i;
+
+    if (dedup->size == 0)
+        return;
+    if (dedup->count == dedup->size)
+        evict_oldest(dedup);
+    entry = &dedup->ring[(dedup->first + dedup->count) % dedup->size];
+    memcpy(entry->digest, digest, MURMUR3_128_LEN);
+    entry->len = len;
+    entry->time = *time;
+    dedup->count++;
+
+    i = slot_find(dedup, digest, len);
+    if (dedup->slots[i].count == 0) {
+        /* Keep the table at most half full. */
+        if (++dedup->slots_used > (dedup->slots_mask + 1) / 2) {
+            slots_grow(dedup);
+            i = slot_find(dedup, digest, len);
+        }
+        memcpy(dedup->slots[i].digest, digest, MURMUR3_128_LEN);
+        dedup->slots[i].len = len;
+    }
+    dedup->slots[i].count++;
+    dedup->slots[i].latest = *time;
+}
+
+void
+pktdedup_expire(pktdedup_t *dedup, const nstime_t *now, const nstime_t *max_age)
+{
+    nstime_t delta;
+
+    while (dedup->count != 0) {
+        nstime_delta(&delta, now, &dedup->ring[dedup->first].time);
+        if (nstime_cmp(&delta, max_age) <= 0)
+            break;
+        evict_oldest(dedup);
+    }
+}
+
+guint32
+pktdedup_count(const pktdedup_t *dedup)
+{
+    return dedup->count;
+}
+
+void
+pktdedup_free(pktdedup_t *dedup)
+{
+    if (dedup == NULL)
+        return;
+    g_free(dedup->ring);
+    g_free(dedup->slots);
+    g_free(dedup);
+}
+
+/*
+ * Editor modelines  -  http://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 4
+ * tab-width: 8
+ * indent-tabs-mode: nil
+ * End:
+ *
+ * vi: set shiftwidth=4 tabstop=8 expandtab:
+ * :indentSize=4:tabSize=8:noTabs=true:
+ */
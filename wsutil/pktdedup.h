@@ -0,0 +1,101 @@
+/* pktdedup.h
+ * Window of recent packet digests, for finding duplicate packets
+ *
+ * $Id$
+ *
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 1998 Gerald Combs
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef __PKTDEDUP_H__
+#define __PKTDEDUP_H__
+
+#include <glib.h>
+
+#include "ws_symbol_export.h"
+#include "nstime.h"
+#include "murmur3.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/** @file
+ * The digests of the most recent packets, oldest first, indexed by a
+ * hash table keyed on the digest and the packet length, so that looking
+ * for a duplicate doesn't depend on the size of the window.
+ */
+
+typedef struct pktdedup pktdedup_t;
+
+/**
+ * Create a window.
+ *
+ * @param size The most packets the window holds; when it's full, adding
+ *             a packet drops the oldest one.  With 0, nothing is kept.
+ * @return The new window.
+ */
+WS_DLL_PUBLIC pktdedup_t *pktdedup_new(guint32 size);
+
+/**
+ * Look for a packet in the window.
+ *
+ * @param dedup The window.
+ * @param digest The packet's digest.
+ * @param len The packet's length.
+ * @param latest If not NULL and the packet is found, receives the time
+ *               of the most recent copy added.
+ * @return TRUE if a packet with that digest and length is in the window.
+ */
+WS_DLL_PUBLIC gboolean pktdedup_find(const pktdedup_t *dedup,
+    const guint8 digest[MURMUR3_128_LEN], guint32 len, nstime_t *latest);
+
+/**
+ * Add a packet to the window.
+ *
+ * @param dedup The window.
+ * @param digest The packet's digest.
+ * @param len The packet's length.
+ * @param time The packet's time, or an unset time.
+ */
+WS_DLL_PUBLIC void pktdedup_add(pktdedup_t *dedup,
+    const guint8 digest[MURMUR3_128_LEN], guint32 len, const nstime_t *time);
+
+/**
+ * Drop the packets from the oldest one on that are more than some
+ * time before another.  The window is assumed to be in time order;
+ * an out-of-order packet can keep older ones in it a little longer.
+ *
+ * @param dedup The window.
+ * @param now The time to compare with.
+ * @param max_age How much older than "now" a packet can be and stay.
+ */
+WS_DLL_PUBLIC void pktdedup_expire(pktdedup_t *dedup, const nstime_t *now,
+    const nstime_t *max_age);
+
+/** Number of packets in the window. */
+WS_DLL_PUBLIC guint32 pktdedup_count(const pktdedup_t *dedup);
+
+/** Free a window. */
+WS_DLL_PUBLIC void pktdedup_free(pktdedup_t *dedup);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* __PKTDEDUP_H__ */
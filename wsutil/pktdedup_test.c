@@ -0,0 +1,205 @@
+/* Standalone program to test MurmurHash3 and the duplicate packet window.
+ *
+ * $Id$
+ *
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 1998 Gerald Combs
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <glib.h>
+
+#include "murmur3.h"
+#include "pktdedup.h"
+
+static gboolean failed = FALSE;
+
+#define CHECK(test, cond, what) \
+    do { \
+        if (!(cond)) { \
+            printf("%s: %s\n", test, what); \
+            failed = TRUE; \
+        } \
+    } while (0)
+
+/* Known answers, as given by the reference MurmurHash3_x64_128() */
+static const struct {
+    const char *data;
+    size_t      len;
+    guint32     seed;
+    const char *digest;
+} murmur3_vectors[] = {
+    { "", 0, 0, "00000000000000000000000000000000" },
+    { "", 0, 1, "b55cff6ee5ab10468335f878aa2d6251" },
+    { "a", 1, 0, "897859f6655555855a890e51483ab5e6" },
+    { "hello", 5, 0, "029bbd41b3a7d8cb191dae486a901e5b" },
+    { "abcdefghijklmnopqrstuvwx", 24, 42, "f2e5f8ad080ce83865f0f4be939c6acd" },
+    { "The quick brown fox jumps over the lazy dog", 43, 0,
+      "6c1b07bc7bbc4be347939ac4a93c437a" },
+    { "\x00\x01\x02\x03\x04\x05\x06\x07\x08\x09\x0a\x0b\x0c\x0d\x0e\x0f"
+      "\x10\x11\x12\x13\x14\x15\x16\x17\x18\x19\x1a\x1b\x1c\x1d\x1e", 31,
+      0x9747b28c, "678760b094204011070d7594db137616" }
+};
+
+/* The digest of a made-up packet */
+static void
+packet_digest(guint32 packet, guint8 digest[MURMUR3_128_LEN])
+{
+    murmur3_128(&packet, sizeof packet, 0, digest);
+}
+
+static gboolean
+has_packet(const pktdedup_t *dedup, guint32 packet, guint32 len)
+{
+    guint8 digest[MURMUR3_128_LEN];
+
+    packet_digest(packet, digest);
+    return pktdedup_find(dedup, digest, len, NULL);
+}
+
+static void
+add_packet(pktdedup_t *dedup, guint32 packet, guint32 len, time_t secs, int nsecs)
+{
+    guint8   digest[MURMUR3_128_LEN];
+    nstime_t time;
+
+    packet_digest(packet, digest);
+    time.secs = secs;
+    time.nsecs = nsecs;
+    pktdedup_add(dedup, digest, len, &time);
+}
+
+static void
+run_tests(void)
+{
+    pktdedup_t *dedup;
+    guint8      digest[MURMUR3_128_LEN];
+    gchar       hex[2 * MURMUR3_128_LEN + 1];
+    nstime_t    now, max_age, latest;
+    guint32     packet;
+    guint       i, j, missing;
+
+    /* 01: MurmurHash3 known answers */
+    for (i = 0; i < G_N_ELEMENTS(murmur3_vectors); i++) {
+        murmur3_128(murmur3_vectors[i].data, murmur3_vectors[i].len,
+                    murmur3_vectors[i].seed, digest);
+        for (j = 0; j < MURMUR3_128_LEN; j++)
+            g_snprintf(hex + 2 * j, 3, "%02x", digest[j]);
+        if (strcmp(hex, murmur3_vectors[i].digest) != 0) {
+            printf("01: vector %u: got %s, expected %s\n", i, hex,
+                   murmur3_vectors[i].digest);
+            failed = TRUE;
+        }
+    }
+
+    /* 02: a window of 2 packets; a third one pushes out the first */
+    dedup = pktdedup_new(2);
+    add_packet(dedup, 1, 60, 0, 0);
+    add_packet(dedup, 2, 60, 0, 0);
+    CHECK("02", has_packet(dedup, 1, 60) && has_packet(dedup, 2, 60), "packet missed");
+    CHECK("02", !has_packet(dedup, 3, 60), "packet never added found");
+    CHECK("02", !has_packet(dedup, 1, 61), "packet of another length found");
+    add_packet(dedup, 3, 60, 0, 0);
+    CHECK("02", !has_packet(dedup, 1, 60), "oldest packet not dropped");
+    CHECK("02", has_packet(dedup, 2, 60) && has_packet(dedup, 3, 60), "packet missed");
+    CHECK("02", pktdedup_count(dedup) == 2, "wrong count");
+    pktdedup_free(dedup);
+
+    /* 03: a packet stays while any copy of it is in the window */
+    dedup = pktdedup_new(3);
+    add_packet(dedup, 1, 60, 0, 0);
+    add_packet(dedup, 1, 60, 0, 0);
+    add_packet(dedup, 2, 60, 0, 0);
+    add_packet(dedup, 3, 60, 0, 0);
+    CHECK("03", has_packet(dedup, 1, 60), "packet dropped with a copy left");
+    add_packet(dedup, 4, 60, 0, 0);
+    CHECK("03", !has_packet(dedup, 1, 60), "packet kept with no copy left");
+    pktdedup_free(dedup);
+
+    /* 04: an empty window never has anything */
+    dedup = pktdedup_new(0);
+    add_packet(dedup, 1, 60, 0, 0);
+    CHECK("04", !has_packet(dedup, 1, 60) && pktdedup_count(dedup) == 0,
+          "packet kept in an empty window");
+    pktdedup_free(dedup);
+
+    /* 05: a time window drops the packets that are too old, and gives
+       the time of the latest copy */
+    dedup = pktdedup_new(10);
+    add_packet(dedup, 1, 60, 1, 0);
+    add_packet(dedup, 2, 60, 2, 500000000);
+    add_packet(dedup, 2, 60, 2, 800000000);
+    packet_digest(2, digest);
+    CHECK("05", pktdedup_find(dedup, digest, 60, &latest) &&
+          latest.secs == 2 && latest.nsecs == 800000000, "wrong latest time");
+    now.secs = 3;
+    now.nsecs = 0;
+    max_age.secs = 1;
+    max_age.nsecs = 500000000;
+    pktdedup_expire(dedup, &now, &max_age);
+    CHECK("05", !has_packet(dedup, 1, 60), "old packet not dropped");
+    CHECK("05", has_packet(dedup, 2, 60) && pktdedup_count(dedup) == 2,
+          "recent packet dropped");
+    pktdedup_free(dedup);
+
+    /* 06: a big window, so that the table grows, then as many other
+       packets again, so that they all go */
+    dedup = pktdedup_new(5000);
+    for (packet = 0; packet < 5000; packet++)
+        add_packet(dedup, packet, 100, 0, 0);
+    missing = 0;
+    for (packet = 0; packet < 5000; packet++) {
+        if (!has_packet(dedup, packet, 100))
+            missing++;
+    }
+    CHECK("06", missing == 0, "packets missed after the table grew");
+    for (packet = 5000; packet < 10000; packet++)
+        add_packet(dedup, packet, 100, 0, 0);
+    missing = 0;
+    for (packet = 0; packet < 10000; packet++) {
+        if (has_packet(dedup, packet, 100) != (packet >= 5000))
+            missing++;
+    }
+    CHECK("06", missing == 0, "wrong packets in the window after eviction");
+    CHECK("06", pktdedup_count(dedup) == 5000, "wrong count");
+    pktdedup_free(dedup);
+}
+
+int
+main(void)
+{
+    run_tests();
+    return failed ? 1 : 0;
+}
+
+/*
+ * Editor modelines  -  http://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 4
+ * tab-width: 8
+ * indent-tabs-mode: nil
+ * End:
+ *
+ * vi: set shiftwidth=4 tabstop=8 expandtab:
+ * :indentSize=4:tabSize=8:noTabs=true:
+ */
@@ -0,0 +1,315 @@
+/* pktindex.c
+ * Routines for reading and writing packet index sidecar files
+ *
+ * $Id$
+ *
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 1998 Gerald Combs
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+
+#include <glib.h>
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+#include "pktindex.h"
+#include <wsutil/file_util.h>
+
+/*
+ * On-disk layout.
+ *
+ * Header (32 bytes):
+ *    0  magic "WSPI"
+ *    4  version (16 bits)
+ *    6  reserved (16 bits)
+ *    8  stride (32 bits)
+ *   12  frame count (32 bits), 0 until the index is finished
+ *   16  capture file size (64 bits), 0 until the index is finished
+ *   24  entry count (32 bits), 0 until the index is finished
+ *   28  reserved (32 bits)
+ *
+ * Entry (24 bytes):
+ *    0  record offset (64 bits)
+ *    8  seconds (64 bits)
+ *   16  nanoseconds (32 bits)
+ *   20  frame number (32 bits)
+ */
+static const guint8 pktindex_magic[4] = { 'W', 'S', 'P', 'I' };
+
+#define PKTINDEX_VERSION        1
+#define PKTINDEX_HDR_LEN        32
+#define PKTINDEX_ENTRY_LEN      24
+
+struct pktindex_writer {
+    FILE    *fh;
+    guint32  stride;
+    guint32  frame_count;
+    guint32  entry_count;
+};
+
+static void
+put_le16(guint8 *p, guint16 v)
+{
+    p[0] = (guint8)(v >> 0);
+    p[1] = (guint8)(v >> 8);
+}
+
+static void
+put_le32(guint8 *p, guint32 v)
+{
+    p[0] = (guint8)(v >> 0);
+    p[1] = (guint8)(v >> 8);
+    p[2] = (guint8)(v >> 16);
+    p[3] = (guint8)(v >> 24);
+}
+
+static void
+put_le64(guint8 *p, guint64 v)
+{
+    put_le32(p, (guint32)v);
+    put_le32(p + 4, (guint32)(v >> 32));
+}
+
+static guint16
+get_le16(const guint8 *p)
+{
+    return (guint16)(p[0] | (p[1] << 8));
+}
+
+static guint32
+get_le32(const guint8 *p)
+{
+    return (guint32)p[0] | ((guint32)p[1] << 8) |
+           ((guint32)p[2] << 16) | ((guint32)p[3] << 24);
+}
+
+static guint64
+get_le64(const guint8 *p)
+{
+    return (guint64)get_le32(p) | ((guint64)get_le32(p + 4) << 32);
+}
+
+static void
+pktindex_fill_header(guint8 *hdr, guint32 stride, guint32 frame_count,
+                     guint64 data_size, guint32 entry_count)
+{
+    memset(hdr, 0, PKTINDEX_HDR_LEN);
+    memcpy(hdr, pktindex_magic, sizeof pktindex_magic);
+    put_le16(hdr + 4, PKTINDEX_VERSION);
+    put_le32(hdr + 8, stride);
+    put_le32(hdr + 12, frame_count);
+    put_le64(hdr + 16, data_size);
+    put_le32(hdr + 24, entry_count);
+}
+
+gchar *
+pktindex_filename(const char *capture_filename)
+{
+    return g_strconcat(capture_filename, PKTINDEX_FILE_SUFFIX, NULL);
+}
+
+pktindex_writer_t *
+pktindex_writer_open(const char *filename, guint32 stride, int *err)
+{
+    pktindex_writer_t *writer;
+    guint8 hdr[PKTINDEX_HDR_LEN];
+    FILE *fh;
+
+    fh = ws_fopen(filename, "wb");
+    if (fh == NULL) {
+        *err = errno;
+        return NULL;
+    }
+
+    if (stride == 0)
+        stride = PKTINDEX_DEFAULT_STRIDE;
+
+    /* Write a provisional header; it's completed when the index is closed. */
+    pktindex_fill_header(hdr, stride, 0, 0, 0);
+    if (fwrite(hdr, 1, sizeof hdr, fh) != sizeof hdr) {
+        *err = errno;
+        fclose(fh);
+        ws_unlink(filename);
+        return NULL;
+    }
+
+    writer = g_new0(pktindex_writer_t, 1);
+    writer->fh = fh;
+    writer->stride = stride;
+    return writer;
+}
+
+gboolean
+pktindex_writer_add(pktindex_writer_t *writer, guint64 offset, gint64 secs,
+                    guint32 nsecs, int *err)
+{
+    guint8 entry[PKTINDEX_ENTRY_LEN];
+
+    if (writer->frame_count++ % writer->stride != 0)
+        return TRUE;
+
+    put_le64(entry, offset);
+    put_le64(entry + 8, (guint64)secs);
+    put_le32(entry + 16, nsecs);
+    put_le32(entry + 20, writer->frame_count);
+    if (fwrite(entry, 1, sizeof entry, writer->fh) != sizeof entry) {
+        *err = errno;
+        return FALSE;
+    }
+    writer->entry_count++;
+    return TRUE;
+}
+
+gboolean
+pktindex_writer_close(pktindex_writer_t *writer, guint64 data_size, int *err)
+{
+    guint8 hdr[PKTINDEX_HDR_LEN];
+    gboolean ret = TRUE;
+
+    pktindex_fill_header(hdr, writer->stride, writer->frame_count, data_size,
+                         writer->entry_count);
+    if (fseek(writer->fh, 0, SEEK_SET) == -1 ||
+        fwrite(hdr, 1, sizeof hdr, writer->fh) != sizeof hdr) {
+        *err = errno;
+        ret = FALSE;
+    }
+    if (fclose(writer->fh) == EOF && ret) {
+        *err = errno;
+        ret = FALSE;
+    }
+    g_free(writer);
+    return ret;
+}
+
+pktindex_t *
+pktindex_read(const char *filename, int *err)
+{
+    pktindex_t *idx;
+    pktindex_entry_t entry;
+    guint8 hdr[PKTINDEX_HDR_LEN];
+    guint8 buf[PKTINDEX_ENTRY_LEN];
+    guint32 entry_count, i;
+    FILE *fh;
+
+    fh = ws_fopen(filename, "rb");
+    if (fh == NULL) {
+        *err = errno;
+        return NULL;
+    }
+
+    if (fread(hdr, 1, sizeof hdr, fh) != sizeof hdr ||
+        memcmp(hdr, pktindex_magic, sizeof pktindex_magic) != 0 ||
+        get_le16(hdr + 4) != PKTINDEX_VERSION ||
+        get_le32(hdr + 8) == 0) {
+        *err = EINVAL;
+        fclose(fh);
+        return NULL;
+    }
+
+    /*
+     * An index with no capture file size was never finished (the
+     * writer died, or the capture is still being written); don't
+     * trust it.
+     */
+    if (get_le64(hdr + 16) == 0) {
+        *err = EINVAL;
+        fclose(fh);
+        return NULL;
+    }
+
+    entry_count = get_le32(hdr + 24);
+    idx = g_new(pktindex_t, 1);
+    idx->stride = get_le32(hdr + 8);
+    idx->frame_count = get_le32(hdr + 12);
+    idx->data_size = get_le64(hdr + 16);
+    idx->entries = g_array_sized_new(FALSE, FALSE, sizeof(pktindex_entry_t),
+                                     entry_count);
+
+    for (i = 0; i < entry_count; i++) {
+        if (fread(buf, 1, sizeof buf, fh) != sizeof buf) {
+            *err = EINVAL;
+            fclose(fh);
+            pktindex_free(idx);
+            return NULL;
+        }
+        entry.offset = get_le64(buf);
+        entry.secs = (gint64)get_le64(buf + 8);
+        entry.nsecs = get_le32(buf + 16);
+        entry.frame_num = get_le32(buf + 20);
+        g_array_append_val(idx->entries, entry);
+    }
+
+    fclose(fh);
+    return idx;
+}
+
+const pktindex_entry_t *
+pktindex_lookup_frame(const pktindex_t *idx, guint32 frame_num)
+{
+    guint lo, hi, mid;
+    const pktindex_entry_t *entry;
+
+    if (idx->entries->len == 0 || frame_num == 0)
+        return NULL;
+
+    /* Binary search for the last entry with frame_num <= the wanted one. */
+    lo = 0;
+    hi = idx->entries->len;
+    while (hi - lo > 1) {
+        mid = lo + (hi - lo) / 2;
+        entry = &g_array_index(idx->entries, pktindex_entry_t, mid);
+        if (entry->frame_num <= frame_num)
+            lo = mid;
+        else
+            hi = mid;
+    }
+
+    entry = &g_array_index(idx->entries, pktindex_entry_t, lo);
+    if (entry->frame_num > frame_num)
+        return NULL;
+    return entry;
+}
+
+void
+pktindex_free(pktindex_t *idx)
+{
+    if (idx == NULL)
+        return;
+    g_array_free(idx->entries, TRUE);
+    g_free(idx);
+}
+
+/*
+ * Editor modelines  -  http://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 4
+ * tab-width: 8
+ * indent-tabs-mode: nil
+ * End:
+ *
+ * vi: set shiftwidth=4 tabstop=8 expandtab:
+ * :indentSize=4:tabSize=8:noTabs=true:
+ */
@@ -0,0 +1,148 @@
+/* pktindex.h
+ * Definitions for packet index sidecar files
+ *
+ * $Id$
+ *
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 1998 Gerald Combs
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef __PKTINDEX_H__
+#define __PKTINDEX_H__
+
+#include <glib.h>
+
+#include "ws_symbol_export.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/** @file
+ * A packet index is a small sidecar file written next to a capture file.
+ * It holds the file offset and timestamp of every Nth record ("stride"),
+ * so that a reader can seek directly to the neighbourhood of a given
+ * frame instead of reading every record before it.
+ *
+ * Indexes are currently only written by "editcap -I", and only used by
+ * editcap, to skip to the first packet selected with "-r".  dumpcap
+ * writes through pcapio rather than a wtap_dumper, so it doesn't write
+ * them, and neither Wireshark nor TShark reads them.
+ *
+ * The file starts with a fixed-size header, followed by fixed-size
+ * entries in increasing frame order.  All values are little-endian.
+ */
+
+/** Suffix appended to the capture file name to get the index file name. */
+#define PKTINDEX_FILE_SUFFIX    ".pidx"
+
+/** Default number of records between two index entries. */
+#define PKTINDEX_DEFAULT_STRIDE 1000
+
+/** One index entry. */
+typedef struct {
+    guint64 offset;     /**< offset of the record in the (uncompressed) file */
+    gint64  secs;       /**< record timestamp, seconds */
+    guint32 nsecs;      /**< record timestamp, nanoseconds */
+    guint32 frame_num;  /**< 1-based number of the record */
+} pktindex_entry_t;
+
+/** An index read back from disk. */
+typedef struct {
+    guint32 stride;         /**< records between two entries */
+    guint32 frame_count;    /**< total number of records in the capture file */
+    guint64 data_size;      /**< size of the capture file when the index was finished */
+    GArray *entries;        /**< array of pktindex_entry_t */
+} pktindex_t;
+
+typedef struct pktindex_writer pktindex_writer_t;
+
+/**
+ * Return the name of the index file for a capture file.
+ *
+ * @param capture_filename The name of the capture file.
+ * @return A newly allocated string which must be freed with g_free().
+ */
+WS_DLL_PUBLIC gchar *pktindex_filename(const char *capture_filename);
+
+/**
+ * Create an index file for writing.
+ *
+ * @param filename The name of the index file.
+ * @param stride Number of records between two entries; 0 selects
+ *               PKTINDEX_DEFAULT_STRIDE.
+ * @param err Receives an errno value on failure.
+ * @return The writer, or NULL on failure.
+ */
+WS_DLL_PUBLIC pktindex_writer_t *pktindex_writer_open(const char *filename,
+    guint32 stride, int *err);
+
+/**
+ * Account for one record being written to the capture file.  Only every
+ * stride-th record actually produces an entry.
+ *
+ * @param writer The index writer.
+ * @param offset Offset in the capture file at which the record starts.
+ * @param secs Timestamp of the record, seconds.
+ * @param nsecs Timestamp of the record, nanoseconds.
+ * @param err Receives an errno value on failure.
+ * @return TRUE on success, FALSE on failure.
+ */
+WS_DLL_PUBLIC gboolean pktindex_writer_add(pktindex_writer_t *writer,
+    guint64 offset, gint64 secs, guint32 nsecs, int *err);
+
+/**
+ * Finish the index, recording the final capture file size, and close it.
+ * The writer is freed even if this fails.
+ *
+ * @param writer The index writer.
+ * @param data_size The final size of the capture file.
+ * @param err Receives an errno value on failure.
+ * @return TRUE on success, FALSE on failure.
+ */
+WS_DLL_PUBLIC gboolean pktindex_writer_close(pktindex_writer_t *writer,
+    guint64 data_size, int *err);
+
+/**
+ * Read an index file.
+ *
+ * @param filename The name of the index file.
+ * @param err Receives an errno value on failure; EINVAL if the file
+ *            isn't a valid packet index.
+ * @return The index, or NULL on failure.  Free it with pktindex_free().
+ */
+WS_DLL_PUBLIC pktindex_t *pktindex_read(const char *filename, int *err);
+
+/**
+ * Find the last entry at or before a frame.
+ *
+ * @param idx The index.
+ * @param frame_num The 1-based number of the wanted frame.
+ * @return The entry, or NULL if the index has no entry at or before the frame.
+ */
+WS_DLL_PUBLIC const pktindex_entry_t *pktindex_lookup_frame(const pktindex_t *idx,
+    guint32 frame_num);
+
+/** Free an index returned by pktindex_read(). */
+WS_DLL_PUBLIC void pktindex_free(pktindex_t *idx);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* __PKTINDEX_H__ */
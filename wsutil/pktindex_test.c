@@ -0,0 +1,207 @@
+/* Standalone program to test writing and reading packet index files.
+ *
+ * $Id$
+ *
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 1998 Gerald Combs
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+#include <glib.h>
+
+#include "pktindex.h"
+#include <wsutil/file_util.h>
+
+#define TEST_STRIDE         3
+#define TEST_FRAMES         10
+#define TEST_DATA_SIZE      1234
+
+static gboolean failed = FALSE;
+
+#define CHECK(test, cond, what) \
+    do { \
+        if (!(cond)) { \
+            printf("%s: %s\n", test, what); \
+            failed = TRUE; \
+        } \
+    } while (0)
+
+/* Write an index of TEST_FRAMES records; frame n is at offset n * 100,
+   with a time stamp of n seconds and n nanoseconds */
+static gboolean
+write_index(const char *test, const char *filename, guint32 stride,
+            guint64 data_size)
+{
+    pktindex_writer_t *writer;
+    guint32 frame;
+    int     err;
+
+    writer = pktindex_writer_open(filename, stride, &err);
+    if (writer == NULL) {
+        printf("%s: can't create %s: %s\n", test, filename, g_strerror(err));
+        failed = TRUE;
+        return FALSE;
+    }
+    for (frame = 1; frame <= TEST_FRAMES; frame++) {
+        if (!pktindex_writer_add(writer, frame * 100, frame, frame, &err)) {
+            printf("%s: can't write %s: %s\n", test, filename, g_strerror(err));
+            failed = TRUE;
+            pktindex_writer_close(writer, data_size, &err);
+            return FALSE;
+        }
+    }
+    if (!pktindex_writer_close(writer, data_size, &err)) {
+        printf("%s: can't close %s: %s\n", test, filename, g_strerror(err));
+        failed = TRUE;
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/* Check that looking up a frame finds the entry of another */
+static void
+check_lookup(const pktindex_t *idx, guint32 frame_num, guint32 expected)
+{
+    const pktindex_entry_t *entry;
+    char what[64];
+
+    entry = pktindex_lookup_frame(idx, frame_num);
+    g_snprintf(what, sizeof what, "wrong entry for frame %u", frame_num);
+    if (expected == 0) {
+        CHECK("04", entry == NULL, what);
+        return;
+    }
+    CHECK("04", entry != NULL && entry->frame_num == expected &&
+          entry->offset == expected * 100 && entry->secs == expected &&
+          entry->nsecs == expected, what);
+}
+
+static void
+run_tests(const char *filename)
+{
+    pktindex_t *idx;
+    const pktindex_entry_t *entry;
+    guint   i;
+    int     err;
+    gchar  *name;
+
+    /* 01: the index file name */
+    name = pktindex_filename("capture.pcapng");
+    CHECK("01", strcmp(name, "capture.pcapng" PKTINDEX_FILE_SUFFIX) == 0,
+          "wrong index file name");
+    g_free(name);
+
+    /* 02: build an index with an entry every TEST_STRIDE records */
+    if (!write_index("02", filename, TEST_STRIDE, TEST_DATA_SIZE))
+        return;
+
+    /* 03: read it back; there's an entry for frames 1, 4, 7 and 10 */
+    idx = pktindex_read(filename, &err);
+    if (idx == NULL) {
+        printf("03: can't read %s: %s\n", filename, g_strerror(err));
+        failed = TRUE;
+        return;
+    }
+    CHECK("03", idx->stride == TEST_STRIDE, "wrong stride");
+    CHECK("03", idx->frame_count == TEST_FRAMES, "wrong frame count");
+    CHECK("03", idx->data_size == TEST_DATA_SIZE, "wrong data size");
+    CHECK("03", idx->entries->len == (TEST_FRAMES + TEST_STRIDE - 1) / TEST_STRIDE,
+          "wrong entry count");
+    for (i = 0; i < idx->entries->len; i++) {
+        entry = &g_array_index(idx->entries, pktindex_entry_t, i);
+        CHECK("03", entry->frame_num == i * TEST_STRIDE + 1, "wrong entry frame");
+    }
+
+    /* 04: a lookup finds the last entry at or before the frame */
+    check_lookup(idx, 0, 0);
+    check_lookup(idx, 1, 1);
+    check_lookup(idx, 3, 1);
+    check_lookup(idx, 4, 4);
+    check_lookup(idx, 9, 7);
+    check_lookup(idx, 10, 10);
+    check_lookup(idx, 1000, 10);
+    pktindex_free(idx);
+
+    /* 05: with no stride given, the default is used */
+    if (write_index("05", filename, 0, TEST_DATA_SIZE)) {
+        idx = pktindex_read(filename, &err);
+        CHECK("05", idx != NULL && idx->stride == PKTINDEX_DEFAULT_STRIDE &&
+              idx->entries->len == 1, "default stride not used");
+        pktindex_free(idx);
+    }
+
+    /* 06: an index that was never finished isn't trusted */
+    if (write_index("06", filename, TEST_STRIDE, 0)) {
+        err = 0;
+        idx = pktindex_read(filename, &err);
+        CHECK("06", idx == NULL && err == EINVAL, "unfinished index read");
+        pktindex_free(idx);
+    }
+
+    /* 07: nor is a file that isn't an index */
+    if (g_file_set_contents(filename, "not an index, but long enough to be one", -1, NULL)) {
+        err = 0;
+        idx = pktindex_read(filename, &err);
+        CHECK("07", idx == NULL && err == EINVAL, "bad index read");
+        pktindex_free(idx);
+    }
+}
+
+int
+main(void)
+{
+    gchar  *filename;
+    GError *error = NULL;
+    int     fd;
+
+    fd = g_file_open_tmp("pktindex_testXXXXXX", &filename, &error);
+    if (fd == -1) {
+        printf("Can't create a temporary file: %s\n", error->message);
+        g_error_free(error);
+        return 1;
+    }
+    ws_close(fd);
+
+    run_tests(filename);
+
+    ws_unlink(filename);
+    g_free(filename);
+    return failed ? 1 : 0;
+}
+
+/*
+ * Editor modelines  -  http://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 4
+ * tab-width: 8
+ * indent-tabs-mode: nil
+ * End:
+ *
+ * vi: set shiftwidth=4 tabstop=8 expandtab:
+ * :indentSize=4:tabSize=8:noTabs=true:
+ */
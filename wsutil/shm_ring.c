@@ -0,0 +1,481 @@
+/* shm_ring.c
+ * Shared memory ring used to hand capture file data from dumpcap to the
+ * program reading the capture file
+ *
+ * $Id$
+ *
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 1998 Gerald Combs
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+
+#include <glib.h>
+
+#include <string.h>
+#include <errno.h>
+
+#ifdef HAVE_FCNTL_H
+#include <fcntl.h>
+#endif
+
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+#if defined(HAVE_MMAP) && !defined(_WIN32)
+#define SHM_RING_SUPPORTED
+#include <sys/mman.h>
+#endif
+
+#include "shm_ring.h"
+#include <wsutil/file_util.h>
+
+#ifdef SHM_RING_SUPPORTED
+
+/*
+ * Layout of the shared memory.  The header is followed, at offset
+ * SHM_RING_HDR_LEN, by the data area; the byte at file offset n is
+ * at n % size in the data area, if it's still there.
+ *
+ * The bytes at file offsets [tail, head) of the file identified by dev
+ * and ino are valid.  The writer advances tail before overwriting data,
+ * and head after writing it.  All the fields after seq are written under
+ * a sequence lock: seq is odd while the writer updates them, and a reader
+ * that sees seq change while it reads them tries again.
+ *
+ * The 64-bit values are split in two halves, as GLib only has atomic
+ * operations on ints.
+ */
+#define SHM_RING_MAGIC          0x57535242      /* "WSRB" */
+#define SHM_RING_VERSION        1
+#define SHM_RING_HDR_LEN        64
+#define SHM_RING_MAX_SIZE       (1024 * 1024 * 1024)
+#define SHM_RING_SNAPSHOT_TRIES 1000
+
+typedef struct {
+    guint32 magic;
+    guint32 version;
+    guint32 size;           /* size of the data area, a power of 2 */
+    volatile gint seq;
+    volatile gint gen;      /* incremented for every new file */
+    volatile gint dev_lo, dev_hi;
+    volatile gint ino_lo, ino_hi;
+    volatile gint head_lo, head_hi;
+    volatile gint tail_lo, tail_hi;
+} shm_ring_hdr_t;
+
+/* A consistent copy of the header fields */
+typedef struct {
+    gint    gen;
+    guint64 dev;
+    guint64 ino;
+    guint64 head;
+    guint64 tail;
+} shm_ring_snapshot_t;
+
+struct shm_ring {
+    volatile gint   refcount;
+    shm_ring_hdr_t *hdr;
+    guint8         *data;
+    gsize           map_len;
+    gchar          *path;           /* set if we created the file and it's still there */
+
+    /* Writer state */
+    gboolean        have_file;      /* TRUE once shm_ring_start_file() succeeded */
+    gint            gen;
+    guint64         dev;
+    guint64         ino;
+    guint64         head;           /* end of the data written so far */
+    guint64         flushed_head;   /* end of the data the reader may see */
+    guint64         tail;
+};
+
+static void
+put_u64(volatile gint *lo, volatile gint *hi, guint64 v)
+{
+    g_atomic_int_set(lo, (gint)(guint32)v);
+    g_atomic_int_set(hi, (gint)(guint32)(v >> 32));
+}
+
+static guint64
+get_u64(volatile gint *lo, volatile gint *hi)
+{
+    return (guint64)(guint32)g_atomic_int_get(lo) |
+           ((guint64)(guint32)g_atomic_int_get(hi) << 32);
+}
+
+static shm_ring_t *
+shm_ring_map(int fd, gsize map_len, int *err)
+{
+    shm_ring_t *ring;
+    void *addr;
+
+    addr = mmap(NULL, map_len, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+    if (addr == MAP_FAILED) {
+        *err = errno;
+        return NULL;
+    }
+    ring = g_new0(shm_ring_t, 1);
+    ring->refcount = 1;
+    ring->hdr = (shm_ring_hdr_t *)addr;
+    ring->data = (guint8 *)addr + SHM_RING_HDR_LEN;
+    ring->map_len = map_len;
+    return ring;
+}
+
+shm_ring_t *
+shm_ring_create(gsize size, int *err)
+{
+    shm_ring_t *ring;
+    const gchar *dir;
+    gchar *path;
+    gsize ring_size;
+    int fd;
+
+    ring_size = 4096;
+    while (ring_size < size && ring_size < SHM_RING_MAX_SIZE)
+        ring_size <<= 1;
+
+    /* Prefer a memory-backed file system, so the pages are never
+       written back to disk */
+    if (g_file_test("/dev/shm", G_FILE_TEST_IS_DIR))
+        dir = "/dev/shm";
+    else
+        dir = g_get_tmp_dir();
+    path = g_build_filename(dir, "wireshark_ring_XXXXXX", NULL);
+    fd = g_mkstemp(path);
+    if (fd == -1) {
+        *err = errno;
+        g_free(path);
+        return NULL;
+    }
+    if (ftruncate(fd, (off_t)(SHM_RING_HDR_LEN + ring_size)) == -1) {
+        *err = errno;
+        ws_close(fd);
+        ws_unlink(path);
+        g_free(path);
+        return NULL;
+    }
+    ring = shm_ring_map(fd, SHM_RING_HDR_LEN + ring_size, err);
+    ws_close(fd);
+    if (ring == NULL) {
+        ws_unlink(path);
+        g_free(path);
+        return NULL;
+    }
+    ring->path = path;
+
+    /* The file is zero-filled: no file, no data */
+    ring->hdr->magic = SHM_RING_MAGIC;
+    ring->hdr->version = SHM_RING_VERSION;
+    ring->hdr->size = (guint32)ring_size;
+    return ring;
+}
+
+const char *
+shm_ring_path(shm_ring_t *ring)
+{
+    return ring->path;
+}
+
+void
+shm_ring_unlink(shm_ring_t *ring)
+{
+    if (ring->path != NULL) {
+        ws_unlink(ring->path);
+        g_free(ring->path);
+        ring->path = NULL;
+    }
+}
+
+shm_ring_t *
+shm_ring_open(const char *path, int *err)
+{
+    shm_ring_t *ring;
+    ws_statb64 statb;
+    int fd;
+
+    fd = ws_open(path, O_RDWR|O_BINARY, 0000);
+    if (fd == -1) {
+        *err = errno;
+        return NULL;
+    }
+    if (ws_fstat64(fd, &statb) == -1) {
+        *err = errno;
+        ws_close(fd);
+        return NULL;
+    }
+    if (statb.st_size < SHM_RING_HDR_LEN) {
+        *err = EINVAL;
+        ws_close(fd);
+        return NULL;
+    }
+    ring = shm_ring_map(fd, (gsize)statb.st_size, err);
+    ws_close(fd);
+    if (ring == NULL)
+        return NULL;
+
+    if (ring->hdr->magic != SHM_RING_MAGIC ||
+        ring->hdr->version != SHM_RING_VERSION ||
+        (ring->hdr->size & (ring->hdr->size - 1)) != 0 ||
+        SHM_RING_HDR_LEN + (gsize)ring->hdr->size > ring->map_len) {
+        munmap((void *)ring->hdr, ring->map_len);
+        g_free(ring);
+        *err = EINVAL;
+        return NULL;
+    }
+    ring->gen = g_atomic_int_get(&ring->hdr->gen);
+    return ring;
+}
+
+shm_ring_t *
+shm_ring_ref(shm_ring_t *ring)
+{
+    g_atomic_int_inc(&ring->refcount);
+    return ring;
+}
+
+void
+shm_ring_unref(shm_ring_t *ring)
+{
+    if (!g_atomic_int_dec_and_test(&ring->refcount))
+        return;
+    shm_ring_unlink(ring);
+    munmap((void *)ring->hdr, ring->map_len);
+    g_free(ring);
+}
+
+/* Writer: make the header match our state */
+static void
+shm_ring_publish(shm_ring_t *ring)
+{
+    shm_ring_hdr_t *hdr = ring->hdr;
+
+    g_atomic_int_inc(&hdr->seq);
+    g_atomic_int_set(&hdr->gen, ring->gen);
+    put_u64(&hdr->dev_lo, &hdr->dev_hi, ring->dev);
+    put_u64(&hdr->ino_lo, &hdr->ino_hi, ring->ino);
+    put_u64(&hdr->head_lo, &hdr->head_hi, ring->flushed_head);
+    put_u64(&hdr->tail_lo, &hdr->tail_hi, ring->tail);
+    g_atomic_int_inc(&hdr->seq);
+}
+
+void
+shm_ring_start_file(shm_ring_t *ring, int fd)
+{
+    shm_ring_file_t file;
+
+    ring->have_file = shm_ring_file_identify(fd, &file);
+    ring->gen++;
+    ring->dev = ring->have_file ? file.dev : 0;
+    ring->ino = ring->have_file ? file.ino : 0;
+    ring->head = ring->flushed_head = ring->tail = 0;
+    shm_ring_publish(ring);
+}
+
+void
+shm_ring_write(shm_ring_t *ring, const void *data, gsize len)
+{
+    const guint8 *p = (const guint8 *)data;
+    guint32 size = ring->hdr->size;
+    guint64 new_head;
+    guint32 pos, n;
+
+    if (!ring->have_file || len == 0)
+        return;
+
+    new_head = ring->head + len;
+    if (len > size) {
+        /* Only the end of it fits */
+        p += len - size;
+        len = size;
+    }
+
+    /* Invalidate what we're about to overwrite before overwriting it.
+       Move the tail an extra eighth of the ring, so we don't have to
+       do this for every write. */
+    if (new_head > ring->tail + size) {
+        ring->tail = new_head - size + size / 8;
+        if (ring->tail > new_head)
+            ring->tail = new_head;
+        shm_ring_publish(ring);
+    }
+
+    pos = (guint32)((new_head - len) & (size - 1));
+    n = MIN((guint32)len, size - pos);
+    memcpy(ring->data + pos, p, n);
+    if (n < len)
+        memcpy(ring->data, p + n, len - n);
+    ring->head = new_head;
+}
+
+void
+shm_ring_flush(shm_ring_t *ring)
+{
+    if (!ring->have_file || ring->flushed_head == ring->head)
+        return;
+    ring->flushed_head = ring->head;
+    shm_ring_publish(ring);
+}
+
+gboolean
+shm_ring_file_identify(int fd, shm_ring_file_t *file)
+{
+    ws_statb64 statb;
+
+    if (ws_fstat64(fd, &statb) == -1)
+        return FALSE;
+    file->dev = (guint64)statb.st_dev;
+    file->ino = (guint64)statb.st_ino;
+    return TRUE;
+}
+
+/* Reader: take a consistent copy of the header */
+static gboolean
+shm_ring_snapshot(shm_ring_hdr_t *hdr, shm_ring_snapshot_t *snap)
+{
+    gint seq;
+    int tries;
+
+    for (tries = 0; tries < SHM_RING_SNAPSHOT_TRIES; tries++) {
+        seq = g_atomic_int_get(&hdr->seq);
+        if (seq & 1)
+            continue;
+        snap->gen = g_atomic_int_get(&hdr->gen);
+        snap->dev = get_u64(&hdr->dev_lo, &hdr->dev_hi);
+        snap->ino = get_u64(&hdr->ino_lo, &hdr->ino_hi);
+        snap->head = get_u64(&hdr->head_lo, &hdr->head_hi);
+        snap->tail = get_u64(&hdr->tail_lo, &hdr->tail_hi);
+        if (g_atomic_int_get(&hdr->seq) == seq)
+            return TRUE;
+    }
+    /* The writer is very busy, or died while updating the header */
+    return FALSE;
+}
+
+guint
+shm_ring_read(shm_ring_t *ring, const shm_ring_file_t *file, gint64 offset,
+              void *buf, guint count)
+{
+    shm_ring_snapshot_t before, after;
+    guint32 size = ring->hdr->size;
+    guint32 pos, n, len;
+
+    if (offset < 0 || count == 0)
+        return 0;
+    if (!shm_ring_snapshot(ring->hdr, &before) ||
+        before.dev != file->dev || before.ino != file->ino ||
+        (guint64)offset < before.tail || (guint64)offset >= before.head)
+        return 0;
+
+    len = (guint32)MIN((guint64)count, before.head - (guint64)offset);
+    pos = (guint32)((guint64)offset & (size - 1));
+    n = MIN(len, size - pos);
+    memcpy(buf, ring->data + pos, n);
+    if (n < len)
+        memcpy((guint8 *)buf + n, ring->data, len - n);
+
+    /* If the writer moved past what we copied while we were copying it,
+       or started a new file, throw it away */
+    if (!shm_ring_snapshot(ring->hdr, &after) ||
+        after.gen != before.gen || (guint64)offset < after.tail)
+        return 0;
+    return len;
+}
+
+#else /* SHM_RING_SUPPORTED */
+
+shm_ring_t *
+shm_ring_create(gsize size _U_, int *err)
+{
+    *err = ENOSYS;
+    return NULL;
+}
+
+const char *
+shm_ring_path(shm_ring_t *ring _U_)
+{
+    return NULL;
+}
+
+void
+shm_ring_unlink(shm_ring_t *ring _U_)
+{
+}
+
+shm_ring_t *
+shm_ring_open(const char *path _U_, int *err)
+{
+    *err = ENOSYS;
+    return NULL;
+}
+
+shm_ring_t *
+shm_ring_ref(shm_ring_t *ring)
+{
+    return ring;
+}
+
+void
+shm_ring_unref(shm_ring_t *ring _U_)
+{
+}
+
+void
+shm_ring_start_file(shm_ring_t *ring _U_, int fd _U_)
+{
+}
+
+void
+shm_ring_write(shm_ring_t *ring _U_, const void *data _U_, gsize len _U_)
+{
+}
+
+void
+shm_ring_flush(shm_ring_t *ring _U_)
+{
+}
+
+gboolean
+shm_ring_file_identify(int fd _U_, shm_ring_file_t *file _U_)
+{
+    return FALSE;
+}
+
+guint
+shm_ring_read(shm_ring_t *ring _U_, const shm_ring_file_t *file _U_,
+              gint64 offset _U_, void *buf _U_, guint count _U_)
+{
+    return 0;
+}
+
+#endif /* SHM_RING_SUPPORTED */
+
+/*
+ * Editor modelines  -  http://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 4
+ * tab-width: 8
+ * indent-tabs-mode: nil
+ * End:
+ *
+ * vi: set shiftwidth=4 tabstop=8 expandtab:
+ * :indent-size=4:tabSize=8:indentStyle=space:
+ */
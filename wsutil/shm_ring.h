@@ -0,0 +1,154 @@
+/* shm_ring.h
+ * Definitions for the shared memory ring used to hand capture file data
+ * from dumpcap to the program reading the capture file
+ *
+ * $Id$
+ *
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 1998 Gerald Combs
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef __SHM_RING_H__
+#define __SHM_RING_H__
+
+#include <glib.h>
+
+#include "ws_symbol_export.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/** @file
+ * While capturing, dumpcap writes each capture file and the program
+ * displaying the capture (Wireshark or TShark) reads back what was just
+ * written.  A shared memory ring lets the reader skip that second trip
+ * through the kernel: dumpcap copies everything it writes to the current
+ * capture file into the ring as well, and the reader takes the bytes at
+ * a given file offset from the ring whenever they're still there.
+ *
+ * The file is still written as before, and it remains the authority:
+ * the ring only holds the most recent data of the current file, so a
+ * reader that falls behind, or reads a different file, gets nothing from
+ * the ring and reads the file instead.
+ *
+ * There's one writer.  The reader never blocks the writer; it detects
+ * data that was overwritten while it was copying it, and discards it.
+ *
+ * Shared memory rings need mmap(); elsewhere shm_ring_create() and
+ * shm_ring_open() fail, and the reader just reads the file.
+ */
+
+/** Default size of the data area of a ring, in bytes. */
+#define SHM_RING_DEFAULT_SIZE   (32 * 1024 * 1024)
+
+typedef struct shm_ring shm_ring_t;
+
+/** Identifies the file a reader is reading; see shm_ring_file_identify(). */
+typedef struct {
+    guint64 dev;
+    guint64 ino;
+} shm_ring_file_t;
+
+/**
+ * Create a ring, backed by a new temporary file that the writer opens
+ * with shm_ring_open().  The caller holds a reference to it.
+ *
+ * @param size Size of the data area in bytes; rounded up to a power of 2.
+ * @param err Receives an errno value on failure.
+ * @return The ring, or NULL on failure.
+ */
+WS_DLL_PUBLIC shm_ring_t *shm_ring_create(gsize size, int *err);
+
+/**
+ * Return the name of the file backing a ring created with
+ * shm_ring_create(), to be passed to the writer.
+ */
+WS_DLL_PUBLIC const char *shm_ring_path(shm_ring_t *ring);
+
+/**
+ * Remove the file backing a ring created with shm_ring_create().  The
+ * ring stays usable by everybody who has it open; call this once the
+ * writer has opened it, so that the file doesn't outlive the capture.
+ */
+WS_DLL_PUBLIC void shm_ring_unlink(shm_ring_t *ring);
+
+/**
+ * Open a ring created by another process, for writing.  The caller holds
+ * a reference to it.
+ *
+ * @param path The name of the file backing the ring.
+ * @param err Receives an errno value on failure.
+ * @return The ring, or NULL on failure.
+ */
+WS_DLL_PUBLIC shm_ring_t *shm_ring_open(const char *path, int *err);
+
+/** Add a reference to a ring. */
+WS_DLL_PUBLIC shm_ring_t *shm_ring_ref(shm_ring_t *ring);
+
+/**
+ * Drop a reference to a ring; the last one unmaps it and, if this process
+ * created it and hasn't yet done so, removes its file.
+ */
+WS_DLL_PUBLIC void shm_ring_unref(shm_ring_t *ring);
+
+/**
+ * Writer: start a new file.  Everything in the ring is dropped, and data
+ * written from now on is for the file open on fd, starting at offset 0.
+ *
+ * @param ring The ring.
+ * @param fd A descriptor for the new file.
+ */
+WS_DLL_PUBLIC void shm_ring_start_file(shm_ring_t *ring, int fd);
+
+/**
+ * Writer: append data that was just written to the current file.  It
+ * isn't visible to the reader until the next shm_ring_flush().
+ */
+WS_DLL_PUBLIC void shm_ring_write(shm_ring_t *ring, const void *data, gsize len);
+
+/** Writer: make everything written so far visible to the reader. */
+WS_DLL_PUBLIC void shm_ring_flush(shm_ring_t *ring);
+
+/**
+ * Reader: get the identity of the file open on a descriptor, to pass to
+ * shm_ring_read().
+ *
+ * @return TRUE on success, FALSE if it couldn't be determined.
+ */
+WS_DLL_PUBLIC gboolean shm_ring_file_identify(int fd, shm_ring_file_t *file);
+
+/**
+ * Reader: copy data at a file offset out of the ring.
+ *
+ * @param ring The ring.
+ * @param file The file being read.
+ * @param offset The offset in the file of the first byte wanted.
+ * @param buf Where to copy the data.
+ * @param count The maximum number of bytes to copy.
+ * @return The number of bytes copied, starting at offset; 0 if the ring
+ *         doesn't hold data for that file at that offset.
+ */
+WS_DLL_PUBLIC guint shm_ring_read(shm_ring_t *ring, const shm_ring_file_t *file,
+    gint64 offset, void *buf, guint count);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* __SHM_RING_H__ */
@@ -0,0 +1,317 @@
+/* Standalone program to test the shared memory ring.
+ *
+ * $Id$
+ *
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 1998 Gerald Combs
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+#if defined(HAVE_MMAP) && !defined(_WIN32)
+#define SHM_RING_SUPPORTED
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#endif
+
+#include <glib.h>
+
+#include "shm_ring.h"
+#include <wsutil/file_util.h>
+
+/* The smallest ring there is, so that it wraps around often */
+#define TEST_RING_SIZE      4096
+
+/* How much the writer process writes while the reader tries to keep up */
+#define TEST_RACE_BYTES     (64 * 1024 * 1024)
+
+static gboolean failed = FALSE;
+
+#define CHECK(test, cond, what) \
+    do { \
+        if (!(cond)) { \
+            printf("%s: %s\n", test, what); \
+            failed = TRUE; \
+        } \
+    } while (0)
+
+/* The byte at an offset of the test files; it repeats every 251 bytes,
+   so a byte from the wrong place in the ring shows */
+#define TEST_BYTE(offset)   ((guint8)((offset) % 251))
+
+static guint64 written;     /* how much of the current file was written */
+
+/* Write count more bytes of the current file to the ring */
+static void
+write_bytes(shm_ring_t *writer, guint count)
+{
+    guint8 buf[1000];
+    guint  i, n;
+
+    while (count != 0) {
+        n = MIN(count, sizeof buf);
+        for (i = 0; i < n; i++)
+            buf[i] = TEST_BYTE(written + i);
+        shm_ring_write(writer, buf, n);
+        written += n;
+        count -= n;
+    }
+}
+
+/* Read count bytes at an offset, and check that what we got is what
+   was written there; returns the number of bytes read */
+static guint
+read_bytes(const char *test, shm_ring_t *reader, const shm_ring_file_t *file,
+           guint64 offset, guint count)
+{
+    guint8 buf[TEST_RING_SIZE];
+    guint  i, n;
+
+    n = shm_ring_read(reader, file, (gint64)offset, buf, MIN(count, sizeof buf));
+    for (i = 0; i < n; i++) {
+        if (buf[i] != TEST_BYTE(offset + i)) {
+            printf("%s: wrong byte at offset %" G_GINT64_MODIFIER "u\n",
+                   test, offset + i);
+            failed = TRUE;
+            break;
+        }
+    }
+    return n;
+}
+
+#ifdef SHM_RING_SUPPORTED
+/*
+ * A writer process writes as fast as it can, telling us how far it got,
+ * while we read from just behind it.  Whatever we read has to be right:
+ * when the writer laps us while we're copying, the read must fail, not
+ * return the new data.
+ */
+static void
+race(shm_ring_t *reader, shm_ring_t *writer, int fd,
+     const shm_ring_file_t *file)
+{
+    volatile gint *progress;
+    guint64 head, offset;
+    guint   reads = 0, got = 0, lapped = 0, n;
+    pid_t   pid;
+    int     status;
+
+    progress = (volatile gint *)mmap(NULL, sizeof (gint),
+                                     PROT_READ|PROT_WRITE,
+                                     MAP_SHARED|MAP_ANONYMOUS, -1, 0);
+    if (progress == MAP_FAILED) {
+        printf("07: can't map shared memory: %s\n", g_strerror(errno));
+        failed = TRUE;
+        return;
+    }
+    *progress = 0;
+
+    shm_ring_start_file(writer, fd);
+    written = 0;
+    pid = fork();
+    if (pid == -1) {
+        printf("07: can't fork: %s\n", g_strerror(errno));
+        failed = TRUE;
+        munmap((void *)progress, sizeof (gint));
+        return;
+    }
+    if (pid == 0) {
+        /* The writer, in 1000-byte writes, made visible 3000 at a time */
+        while (written < TEST_RACE_BYTES) {
+            write_bytes(writer, 3000);
+            shm_ring_flush(writer);
+            g_atomic_int_set(progress, (gint)(written / 1000));
+        }
+        _exit(0);
+    }
+
+    while (g_atomic_int_get(progress) < TEST_RACE_BYTES / 1000) {
+        /* Somewhere between the oldest data the ring can hold and the
+           newest, so that the writer laps us now and then */
+        head = (guint64)g_atomic_int_get(progress) * 1000;
+        offset = head - MIN(head, (guint64)(reads * 7919) % TEST_RING_SIZE);
+        n = read_bytes("07", reader, file, offset, TEST_RING_SIZE);
+        if (n != 0)
+            got++;
+        else if (offset < head)
+            lapped++;
+        reads++;
+    }
+    waitpid(pid, &status, 0);
+    CHECK("07", WIFEXITED(status) && WEXITSTATUS(status) == 0, "writer failed");
+    CHECK("07", got != 0, "never read anything");
+    CHECK("07", lapped != 0, "never lapped");
+    munmap((void *)progress, sizeof (gint));
+}
+#endif /* SHM_RING_SUPPORTED */
+
+static void
+run_tests(shm_ring_t *reader, shm_ring_t *writer, int fd1, int fd2)
+{
+    shm_ring_file_t file1, file2;
+    guint8  buf[16];
+
+    if (!shm_ring_file_identify(fd1, &file1) ||
+        !shm_ring_file_identify(fd2, &file2)) {
+        printf("Can't identify the test files\n");
+        failed = TRUE;
+        return;
+    }
+
+    /* 01: nothing can be read before anything is written */
+    CHECK("01", shm_ring_read(reader, &file1, 0, buf, sizeof buf) == 0,
+          "read from an empty ring");
+
+    /* 02: data shows up once it's flushed, and only what was written */
+    shm_ring_start_file(writer, fd1);
+    written = 0;
+    write_bytes(writer, 1000);
+    CHECK("02", read_bytes("02", reader, &file1, 0, 1000) == 0,
+          "data read before it was flushed");
+    shm_ring_flush(writer);
+    CHECK("02", read_bytes("02", reader, &file1, 0, 1000) == 1000,
+          "data written missing");
+    CHECK("02", read_bytes("02", reader, &file1, 500, 1000) == 500,
+          "read past the end of the data");
+    CHECK("02", read_bytes("02", reader, &file1, 1000, 1000) == 0,
+          "data read before it was written");
+    CHECK("02", read_bytes("02", reader, &file2, 0, 1000) == 0,
+          "data read from the wrong file");
+
+    /* 03: wrap around the end of the data area; a read across it comes
+       back in one piece */
+    write_bytes(writer, 5000);
+    shm_ring_flush(writer);
+    CHECK("03", written == 6000, "wrong amount written");
+    CHECK("03", read_bytes("03", reader, &file1, 3500, 2500) == 2500,
+          "data across the end of the ring missing");
+    CHECK("03", read_bytes("03", reader, &file1, 4000, 100) == 100,
+          "data at the start of the ring missing");
+
+    /* 04: the oldest data has been overwritten, and a reader still
+       after it gets nothing, not the new data in its place */
+    CHECK("04", read_bytes("04", reader, &file1, 0, 1000) == 0,
+          "overwritten data read");
+    CHECK("04", read_bytes("04", reader, &file1, written - TEST_RING_SIZE - 1, 1) == 0,
+          "overwritten data read");
+    CHECK("04", read_bytes("04", reader, &file1, written - TEST_RING_SIZE * 7 / 8,
+                           TEST_RING_SIZE) == TEST_RING_SIZE * 7 / 8,
+          "recent data missing");
+
+    /* 05: a write bigger than the ring leaves only its end in it */
+    write_bytes(writer, 3 * TEST_RING_SIZE + 123);
+    shm_ring_flush(writer);
+    CHECK("05", read_bytes("05", reader, &file1, written - 100, 100) == 100,
+          "end of a big write missing");
+    CHECK("05", read_bytes("05", reader, &file1, written - TEST_RING_SIZE - 1, 1) == 0,
+          "start of a big write read");
+
+    /* 06: a new file drops everything of the old one */
+    shm_ring_start_file(writer, fd2);
+    CHECK("06", read_bytes("06", reader, &file1, written - 100, 100) == 0,
+          "data of the old file read");
+    written = 0;
+    write_bytes(writer, 100);
+    shm_ring_flush(writer);
+    CHECK("06", read_bytes("06", reader, &file2, 0, 100) == 100,
+          "data of the new file missing");
+    CHECK("06", read_bytes("06", reader, &file1, 0, 100) == 0,
+          "data of the new file read for the old one");
+
+#ifdef SHM_RING_SUPPORTED
+    /* 07: a reader racing the writer */
+    race(reader, writer, fd1, &file1);
+#endif
+}
+
+int
+main(void)
+{
+    shm_ring_t *reader, *writer;
+    gchar  *name1, *name2;
+    GError *error = NULL;
+    int     fd1, fd2, err;
+
+    reader = shm_ring_create(TEST_RING_SIZE, &err);
+    if (reader == NULL) {
+        if (err == ENOSYS) {
+            printf("Shared memory rings aren't supported here\n");
+            return 0;
+        }
+        printf("Can't create a ring: %s\n", g_strerror(err));
+        return 1;
+    }
+    /* Open it again, as the writer would */
+    writer = shm_ring_open(shm_ring_path(reader), &err);
+    if (writer == NULL) {
+        printf("Can't open %s: %s\n", shm_ring_path(reader), g_strerror(err));
+        shm_ring_unref(reader);
+        return 1;
+    }
+    shm_ring_unlink(reader);
+
+    /* The files the ring's data is for; they're only used as identities */
+    fd1 = g_file_open_tmp("shm_ring_testXXXXXX", &name1, &error);
+    if (fd1 == -1) {
+        printf("Can't create a temporary file: %s\n", error->message);
+        g_error_free(error);
+        return 1;
+    }
+    fd2 = g_file_open_tmp("shm_ring_testXXXXXX", &name2, &error);
+    if (fd2 == -1) {
+        printf("Can't create a temporary file: %s\n", error->message);
+        g_error_free(error);
+        ws_close(fd1);
+        ws_unlink(name1);
+        return 1;
+    }
+
+    run_tests(reader, writer, fd1, fd2);
+
+    ws_close(fd1);
+    ws_close(fd2);
+    ws_unlink(name1);
+    ws_unlink(name2);
+    g_free(name1);
+    g_free(name2);
+    shm_ring_unref(writer);
+    shm_ring_unref(reader);
+    return failed ? 1 : 0;
+}
+
+/*
+ * Editor modelines  -  http://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 4
+ * tab-width: 8
+ * indent-tabs-mode: nil
+ * End:
+ *
+ * vi: set shiftwidth=4 tabstop=8 expandtab:
+ * :indentSize=4:tabSize=8:noTabs=true:
+ */